@@ -0,0 +1,64 @@
+// Time reductions over packed arrays against the same loop over a list
+#include "common.h"
+#include <stdio.h>
+
+#define NUM_ELEMS 1000000
+#define NUM_ROUNDS 50
+
+int
+main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_list_t* list = mara_new_list(ctx, zone, NUM_ELEMS);
+	for (mara_index_t i = 0; i < NUM_ELEMS; ++i) {
+		mara_list_push(ctx, list, mara_value_from_real((double)(i % 1000) * 0.5));
+	}
+	mara_array_t* array;
+	bench_check(ctx, mara_array_from_list(ctx, zone, MARA_ARRAY_F64, list, &array));
+
+	double checksum = 0.0;
+	double start = bench_now();
+	for (mara_index_t round = 0; round < NUM_ROUNDS; ++round) {
+		double sum = 0.0;
+		for (mara_index_t i = 0; i < NUM_ELEMS; ++i) {
+			mara_real_t value;
+			bench_check(ctx, mara_value_to_real(ctx, mara_list_get(ctx, list, i), &value));
+			sum += value * value;
+		}
+		checksum += sum;
+	}
+	double list_time = bench_now() - start;
+
+	start = bench_now();
+	for (mara_index_t round = 0; round < NUM_ROUNDS; ++round) {
+		mara_value_t dot;
+		bench_check(ctx, mara_array_dot(ctx, array, array, &dot));
+		mara_real_t sum;
+		bench_check(ctx, mara_value_to_real(ctx, dot, &sum));
+		checksum -= sum;
+	}
+	double array_time = bench_now() - start;
+
+	start = bench_now();
+	for (mara_index_t round = 0; round < NUM_ROUNDS; ++round) {
+		mara_real_t sum;
+		bench_check(ctx, mara_value_to_real(ctx, mara_array_sum(ctx, array), &sum));
+		checksum += sum * 0.0;
+	}
+	double sum_time = bench_now() - start;
+
+	double num_ops = (double)NUM_ROUNDS * NUM_ELEMS;
+	printf("%-12s %8.2fns/elem\n", "list dot", list_time / num_ops * 1e9);
+	printf("%-12s %8.2fns/elem\n", "array dot", array_time / num_ops * 1e9);
+	printf("%-12s %8.2fns/elem\n", "array sum", sum_time / num_ops * 1e9);
+	printf("%-12s %g\n", "difference", checksum);
+
+	mara_end(ctx);
+	mara_destroy_env(env);
+	return 0;
+}
@@ -0,0 +1,74 @@
+// Time calling a small script function once per entity with mara_call
+// against one mara_call_batch
+#include "common.h"
+#include <stdio.h>
+
+#define NUM_ENTITIES 10000
+#define NUM_TICKS 200
+
+static const char rule_source[] =
+	"(fn (x y) (if (< x y) (- y x) (- x y)))\n";
+
+int
+main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_fn_t* fn;
+	bench_check(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = mara_str_from_literal("rule") },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal(rule_source),
+		&fn
+	));
+	mara_value_t rule_value;
+	bench_check(ctx, mara_call(ctx, zone, fn, 0, NULL, &rule_value));
+	mara_fn_t* rule;
+	bench_check(ctx, mara_value_to_fn(ctx, rule_value, &rule));
+
+	static mara_value_t args[NUM_ENTITIES * 2];
+	static mara_value_t results[NUM_ENTITIES];
+	for (mara_index_t i = 0; i < NUM_ENTITIES; ++i) {
+		args[i * 2] = mara_value_from_int(i);
+		args[i * 2 + 1] = mara_value_from_int(NUM_ENTITIES / 2);
+	}
+
+	mara_index_t checksum = 0;
+	double start = bench_now();
+	for (mara_index_t tick = 0; tick < NUM_TICKS; ++tick) {
+		for (mara_index_t i = 0; i < NUM_ENTITIES; ++i) {
+			bench_check(ctx, mara_call(ctx, zone, rule, 2, &args[i * 2], &results[i]));
+		}
+		for (mara_index_t i = 0; i < NUM_ENTITIES; ++i) {
+			mara_index_t value;
+			bench_check(ctx, mara_value_to_int(ctx, results[i], &value));
+			checksum += value;
+		}
+	}
+	double call_time = bench_now() - start;
+
+	start = bench_now();
+	for (mara_index_t tick = 0; tick < NUM_TICKS; ++tick) {
+		bench_check(ctx, mara_call_batch(ctx, zone, rule, NUM_ENTITIES, 2, args, results));
+		for (mara_index_t i = 0; i < NUM_ENTITIES; ++i) {
+			mara_index_t value;
+			bench_check(ctx, mara_value_to_int(ctx, results[i], &value));
+			checksum -= value;
+		}
+	}
+	double batch_time = bench_now() - start;
+
+	double num_calls = (double)NUM_TICKS * NUM_ENTITIES;
+	printf("%-12s %8.2fns/call\n", "mara_call", call_time / num_calls * 1e9);
+	printf("%-12s %8.2fns/call\n", "batch", batch_time / num_calls * 1e9);
+	printf("%-12s %lld\n", "difference", (long long)checksum);
+
+	mara_end(ctx);
+	mara_destroy_env(env);
+	return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef MARA_BENCH_COMMON_H
+#define MARA_BENCH_COMMON_H
+
+#include <mara.h>
+#include <mara/utils.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+	char* data;
+	mara_index_t len;
+	mara_index_t capacity;
+} bench_buffer_t;
+
+static inline mara_index_t
+bench_write_to_buffer(const void* data, mara_index_t size, void* userdata) {
+	bench_buffer_t* buffer = userdata;
+	if (buffer->len + size > buffer->capacity) {
+		mara_index_t new_capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+		while (buffer->len + size > new_capacity) { new_capacity *= 2; }
+		char* new_data = realloc(buffer->data, new_capacity);
+		if (new_data == NULL) { return -1; }
+		buffer->data = new_data;
+		buffer->capacity = new_capacity;
+	}
+
+	memcpy(buffer->data + buffer->len, data, size);
+	buffer->len += size;
+	return size;
+}
+
+static inline mara_writer_t
+bench_buffer_writer(bench_buffer_t* buffer) {
+	buffer->len = 0;
+	return (mara_writer_t){ .fn = bench_write_to_buffer, .userdata = buffer };
+}
+
+static inline double
+bench_now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline void
+bench_check(mara_exec_ctx_t* ctx, mara_error_t* error) {
+	if (error != NULL) {
+		mara_print_error(ctx, error, (mara_print_options_t){ 0 }, (mara_writer_t){
+			.fn = mara_write_to_file,
+			.userdata = stderr,
+		});
+		exit(1);
+	}
+}
+
+#endif
@@ -0,0 +1,116 @@
+// Time map get/set/delete/foreach across map sizes
+#include "common.h"
+#include <stdio.h>
+
+#define OPS_PER_SIZE 2000000
+
+typedef struct {
+	double set;
+	double get;
+	double foreach;
+	double delete;
+} timings_t;
+
+static char count_tag;
+
+static mara_error_t*
+count_entry(
+	mara_exec_ctx_t* ctx,
+	mara_index_t argc,
+	const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)argv;
+	void* count;
+	bench_check(ctx, mara_value_to_ref(ctx, userdata, &count_tag, &count));
+	*(mara_index_t*)count += 1;
+	*result = mara_nil();
+	return NULL;
+}
+
+static void
+run_round(mara_env_t* env, mara_index_t size, bool str_keys, timings_t* timings) {
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_value_t* keys = malloc(sizeof(mara_value_t) * size);
+	for (mara_index_t i = 0; i < size; ++i) {
+		keys[i] = str_keys
+			? mara_new_strf(ctx, zone, "key-%d", i * 7919)
+			: mara_value_from_int(i * 7919);
+	}
+
+	mara_map_t* map = mara_new_map(ctx, zone);
+	double start = bench_now();
+	for (mara_index_t i = 0; i < size; ++i) {
+		mara_map_set(ctx, map, keys[i], mara_value_from_int(i));
+	}
+	timings->set += bench_now() - start;
+
+	start = bench_now();
+	for (mara_index_t i = 0; i < size; ++i) {
+		if (mara_value_is_nil(mara_map_get(ctx, map, keys[i]))) {
+			fprintf(stderr, "Missing key\n");
+			exit(1);
+		}
+	}
+	timings->get += bench_now() - start;
+
+	mara_index_t count = 0;
+	mara_fn_t* fn = mara_new_fn(
+		ctx, zone, count_entry, mara_new_ref(ctx, zone, &count_tag, &count)
+	);
+	start = bench_now();
+	bench_check(ctx, mara_map_foreach(ctx, map, fn));
+	timings->foreach += bench_now() - start;
+
+	start = bench_now();
+	for (mara_index_t i = 0; i < size; ++i) {
+		mara_map_delete(ctx, map, keys[i]);
+	}
+	timings->delete += bench_now() - start;
+
+	if (count != size || mara_map_len(ctx, map) != 0) {
+		fprintf(stderr, "Wrong count\n");
+		exit(1);
+	}
+
+	free(keys);
+	mara_end(ctx);
+}
+
+int
+main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_index_t sizes[] = { 4, 8, 64, 1024, 65536 };
+
+	printf("%-6s %8s %10s %10s %10s %10s\n", "keys", "size", "set", "get", "foreach", "delete");
+	for (int str_keys = 0; str_keys <= 1; ++str_keys) {
+		for (size_t i = 0; i < mara_count_of(sizes); ++i) {
+			mara_index_t size = sizes[i];
+			mara_index_t num_rounds = OPS_PER_SIZE / size;
+			timings_t timings = { 0 };
+			for (mara_index_t round = 0; round < num_rounds; ++round) {
+				run_round(env, size, str_keys, &timings);
+			}
+
+			double num_ops = (double)num_rounds * (double)size;
+			printf(
+				"%-6s %8d %8.1fns %8.1fns %8.1fns %8.1fns\n",
+				str_keys ? "str" : "int", size,
+				timings.set / num_ops * 1e9,
+				timings.get / num_ops * 1e9,
+				timings.foreach / num_ops * 1e9,
+				timings.delete / num_ops * 1e9
+			);
+		}
+	}
+
+	mara_destroy_env(env);
+	return 0;
+}
@@ -0,0 +1,91 @@
+// Compare mara_load against reparsing the same data from text
+#include "common.h"
+
+#define NUM_RECORDS 10000
+#define NUM_ITERATIONS 20
+
+static mara_value_t
+make_data(mara_exec_ctx_t* ctx, mara_zone_t* zone) {
+	mara_value_t tags[] = {
+		mara_new_sym(ctx, mara_str_from_literal("alpha")),
+		mara_new_sym(ctx, mara_str_from_literal("beta")),
+		mara_new_sym(ctx, mara_str_from_literal("gamma")),
+	};
+
+	mara_list_t* records = mara_new_list(ctx, zone, NUM_RECORDS);
+	for (mara_index_t i = 0; i < NUM_RECORDS; ++i) {
+		mara_list_t* record = mara_new_list(ctx, zone, 5);
+		mara_list_push(ctx, record, mara_value_from_int(i * 7919));
+		mara_list_push(ctx, record, mara_value_from_real(i * 0.25));
+		mara_list_push(ctx, record, mara_new_strf(ctx, zone, "record-%d", i));
+		mara_list_push(ctx, record, tags[i % mara_count_of(tags)]);
+
+		mara_list_t* values = mara_new_list(ctx, zone, 4);
+		for (mara_index_t j = 0; j < 4; ++j) {
+			mara_list_push(ctx, values, mara_value_from_int(i + j));
+		}
+		mara_list_push(ctx, record, mara_value_from_list(values));
+
+		mara_list_push(ctx, records, mara_value_from_list(record));
+	}
+
+	return mara_value_from_list(records);
+}
+
+int
+main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_value_t data = make_data(ctx, mara_get_local_zone(ctx));
+
+	bench_buffer_t text = { 0 };
+	mara_print_value(
+		ctx, data,
+		(mara_print_options_t){ .max_length = INT32_MAX, .max_depth = INT32_MAX },
+		bench_buffer_writer(&text)
+	);
+
+	bench_buffer_t binary = { 0 };
+	bench_check(ctx, mara_dump(ctx, data, bench_buffer_writer(&binary), NULL));
+
+	printf("text: %d bytes, binary: %d bytes\n", text.len, binary.len);
+
+	double parse_time = 0.0;
+	double load_time = 0.0;
+	for (int i = 0; i < NUM_ITERATIONS; ++i) {
+		mara_end(ctx);
+		ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+
+		mara_str_reader_t reader;
+		mara_list_t* exprs;
+		double start = bench_now();
+		bench_check(ctx, mara_parse(
+			ctx, mara_get_local_zone(ctx),
+			(mara_parse_options_t){ .filename = mara_str_from_literal("bench") },
+			mara_init_str_reader(&reader, (mara_str_t){ .data = text.data, .len = text.len }),
+			&exprs
+		));
+		parse_time += bench_now() - start;
+
+		mara_value_t result;
+		start = bench_now();
+		bench_check(ctx, mara_load(
+			ctx, mara_get_local_zone(ctx),
+			mara_init_str_reader(&reader, (mara_str_t){ .data = binary.data, .len = binary.len }),
+			&result
+		));
+		load_time += bench_now() - start;
+	}
+
+	printf("mara_parse: %.3f ms/iteration\n", parse_time * 1000.0 / NUM_ITERATIONS);
+	printf("mara_load:  %.3f ms/iteration\n", load_time * 1000.0 / NUM_ITERATIONS);
+
+	free(text.data);
+	free(binary.data);
+	mara_end(ctx);
+	mara_destroy_env(env);
+	return 0;
+}
@@ -0,0 +1,98 @@
+// Run the same workload on 1..N threads sharing a single env
+#include "common.h"
+#include "../src/thread.h"
+#include <stdio.h>
+
+#define MAX_THREADS 8
+#define NUM_ITERATIONS 20
+#define NUM_SYMBOLS 256
+
+static const char fib_source[] =
+	"(fn (self n)\n"
+	"  (if (<= n 1)\n"
+	"    n\n"
+	"    (+ (self self (- n 1))\n"
+	"       (self self (- n 2)))))\n";
+
+typedef struct {
+	mara_env_t* env;
+	mara_index_t id;
+	mara_thread_t thread;
+} worker_t;
+
+static void
+run_worker(void* userdata) {
+	worker_t* worker = userdata;
+
+	for (int i = 0; i < NUM_ITERATIONS; ++i) {
+		mara_exec_ctx_t* ctx = mara_begin(worker->env, (mara_exec_options_t){ 0 });
+		mara_zone_t* zone = mara_get_local_zone(ctx);
+
+		// Mostly hits, some symbols are new to the table
+		for (mara_index_t j = 0; j < NUM_SYMBOLS; ++j) {
+			char name[32];
+			int len = snprintf(
+				name, sizeof(name),
+				"sym-%d-%d", j, (worker->id * NUM_ITERATIONS + i) % 64
+			);
+			mara_new_sym(ctx, (mara_str_t){ .len = len, .data = name });
+		}
+
+		mara_fn_t* fn;
+		bench_check(ctx, mara_compile_str(
+			ctx, zone,
+			(mara_parse_options_t){ .filename = mara_str_from_literal("fib") },
+			(mara_compile_options_t){ .standalone = true },
+			mara_str_from_literal(fib_source),
+			&fn
+		));
+
+		mara_value_t fib;
+		bench_check(ctx, mara_call(ctx, zone, fn, 0, NULL, &fib));
+		mara_value_t result;
+		mara_value_t args[] = { fib, mara_value_from_int(20) };
+		bench_check(ctx, mara_value_to_fn(ctx, fib, &fn));
+		bench_check(ctx, mara_call(ctx, zone, fn, mara_count_of(args), args, &result));
+
+		mara_end(ctx);
+	}
+}
+
+int
+main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	mara_env_t* env = mara_create_env((mara_env_options_t){ .compile_cache_size = 16 });
+	worker_t workers[MAX_THREADS];
+
+	double baseline = 0.0;
+	for (mara_index_t num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+		for (mara_index_t i = 0; i < num_threads; ++i) {
+			workers[i] = (worker_t){ .env = env, .id = i };
+		}
+
+		double start = bench_now();
+		for (mara_index_t i = 1; i < num_threads; ++i) {
+			if (!mara_thread_start(&workers[i].thread, run_worker, &workers[i])) {
+				fprintf(stderr, "Could not start thread\n");
+				return 1;
+			}
+		}
+		run_worker(&workers[0]);
+		for (mara_index_t i = 1; i < num_threads; ++i) {
+			mara_thread_join(&workers[i].thread);
+		}
+		double elapsed = bench_now() - start;
+
+		double throughput = (double)(num_threads * NUM_ITERATIONS) / elapsed;
+		if (num_threads == 1) { baseline = throughput; }
+		printf(
+			"%d thread(s): %.1f runs/s, %.2fx\n",
+			num_threads, throughput, throughput / baseline
+		);
+	}
+
+	mara_destroy_env(env);
+	return 0;
+}
@@ -10,8 +10,12 @@ compile(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 		"compile [options] [--] [filename]",
 		NULL,
 	};
+	const char* output_filename = NULL;
+	int strip_debug = 0;
 	struct argparse_option options[] = {
 		OPT_HELP(),
+		OPT_STRING('o', "output", &output_filename, "Write a bytecode image to this file instead", NULL, 0, 0),
+		OPT_BOOLEAN(0, "strip-debug", &strip_debug, "Strip debug info", NULL, 0, 0),
 		OPT_END(),
 	};
 	struct argparse argparse;
@@ -20,7 +24,8 @@ compile(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 		&argparse,
 		"Compile a file and pretty print the result.",
 		"By default, read from stdin.\n"
-		"If filename is `-` it is also treated as stdin."
+		"If filename is `-` it is also treated as stdin.\n"
+		"With --output, a bytecode image is written instead. It can be run with `exec`."
 	);
 	argc = argparse_parse(&argparse, argc, argv);
 	if (argc > 1 || argparse.state != ARGPARSE_OK) {
@@ -29,6 +34,7 @@ compile(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 	}
 
 	FILE* input = stdin;
+	FILE* output = NULL;
 	const char* filename = "<stdin>";
 	int exit_code = 0;
 	if (argc == 1 && strcmp(argv[0], "-")) {
@@ -75,7 +81,7 @@ compile(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 	error = mara_compile(
 		ctx,
 		mara_get_local_zone(ctx),
-		(mara_compile_options_t){ 0 },
+		(mara_compile_options_t){ .strip_debug_info = strip_debug },
 		expr,
 		&fn
 	);
@@ -95,20 +101,66 @@ compile(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 		goto end;
 	}
 
-	mara_print_value(
+	if (output_filename == NULL) {
+		mara_print_value(
+			ctx,
+			mara_value_from_fn(fn),
+			(mara_print_options_t){ 0 },
+			(mara_writer_t){
+				.fn = mara_write_to_file,
+				.userdata = stdout,
+			}
+		);
+		goto end;
+	}
+
+	output = stdout;
+	if (strcmp(output_filename, "-")) {
+		errno = 0;
+		output = fopen(output_filename, "wb");
+		if (output == NULL) {
+			fprintf(stderr, "Could not open %s: %s\n", output_filename, strerror(errno));
+			exit_code = 1;
+			goto end;
+		}
+	}
+
+	error = mara_dump(
 		ctx,
 		mara_value_from_fn(fn),
-		(mara_print_options_t){ 0 },
 		(mara_writer_t){
 			.fn = mara_write_to_file,
-			.userdata = stdout,
-		}
+			.userdata = output,
+		},
+		NULL
 	);
 
+	if (error != NULL) {
+		mara_print_error(
+			ctx,
+			error,
+			(mara_print_options_t){ 0 },
+			(mara_writer_t){
+				.fn = mara_write_to_file,
+				.userdata = stderr,
+			}
+		);
+
+		exit_code = 1;
+		goto end;
+	}
+
 end:
 	if (input != stdin && input != NULL) {
 		fclose(input);
 	}
 
+	if (output != stdout && output != NULL) {
+		if (fclose(output) != 0 && exit_code == 0) {
+			fprintf(stderr, "Could not write %s: %s\n", output_filename, strerror(errno));
+			exit_code = 1;
+		}
+	}
+
 	return exit_code;
 }
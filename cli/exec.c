@@ -1,9 +1,35 @@
 #include <mara.h>
 #include <mara/utils.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include "vendor/argparse/argparse.h"
 
+static char*
+read_all(FILE* file, size_t* size_out) {
+	size_t size = 0;
+	size_t capacity = 4096;
+	char* buffer = malloc(capacity);
+
+	while (buffer != NULL) {
+		size += fread(buffer + size, 1, capacity - size, file);
+		if (size < capacity) {
+			if (ferror(file)) { break; }
+
+			*size_out = size;
+			return buffer;
+		}
+
+		capacity *= 2;
+		char* new_buffer = realloc(buffer, capacity);
+		if (new_buffer == NULL) { break; }
+		buffer = new_buffer;
+	}
+
+	free(buffer);
+	return NULL;
+}
+
 int
 exec(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 	const char* const usage[] = {
@@ -20,7 +46,8 @@ exec(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 		&argparse,
 		"Compile a file and execute it, printing the result.",
 		"By default, read from stdin.\n"
-		"If filename is `-` it is also treated as stdin."
+		"If filename is `-` it is also treated as stdin.\n"
+		"Bytecode images produced by `compile --output` are executed directly."
 	);
 	argc = argparse_parse(&argparse, argc, argv);
 	if (argc > 1 || argparse.state != ARGPARSE_OK) {
@@ -29,6 +56,7 @@ exec(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 	}
 
 	FILE* input = stdin;
+	char* input_buffer = NULL;
 	const char* filename = "<stdin>";
 	int exit_code = 0;
 	if (argc == 1 && strcmp(argv[0], "-")) {
@@ -42,43 +70,40 @@ exec(int argc, const char* argv[], mara_exec_ctx_t* ctx) {
 		}
 	}
 
-	mara_list_t* expr;
-	mara_error_t* error = mara_parse(
-		ctx,
-		mara_get_local_zone(ctx),
-		(mara_parse_options_t) {
-			.filename = mara_str_from_cstr(filename)
-		},
-		(mara_reader_t){
-			.fn = mara_read_from_file,
-			.userdata = input,
-		},
-		&expr
-	);
-
-	if (error != NULL) {
-		mara_print_error(
-			ctx,
-			error,
-			(mara_print_options_t){ 0 },
-			(mara_writer_t){
-				.fn = mara_write_to_file,
-				.userdata = stderr,
-			}
-		);
-
+	// Images are loaded in place so the whole input is kept in memory
+	size_t input_size = 0;
+	input_buffer = read_all(input, &input_size);
+	if (input_buffer == NULL) {
+		fprintf(stderr, "Could not read %s: %s\n", filename, strerror(errno));
 		exit_code = 1;
 		goto end;
 	}
 
+	mara_error_t* error;
 	mara_fn_t* fn;
-	error = mara_compile(
-		ctx,
-		mara_get_local_zone(ctx),
-		(mara_compile_options_t){ 0 },
-		expr,
-		&fn
-	);
+	if (mara_is_code_image(input_buffer, input_size)) {
+		mara_value_t loaded;
+		error = mara_load_from_buffer(
+			ctx,
+			mara_get_local_zone(ctx),
+			input_buffer, input_size,
+			&loaded
+		);
+		if (error == NULL) {
+			error = mara_value_to_fn(ctx, loaded, &fn);
+		}
+	} else {
+		error = mara_compile_str(
+			ctx,
+			mara_get_local_zone(ctx),
+			(mara_parse_options_t) {
+				.filename = mara_str_from_cstr(filename)
+			},
+			(mara_compile_options_t){ 0 },
+			(mara_str_t){ .data = input_buffer, .len = (mara_index_t)input_size },
+			&fn
+		);
+	}
 
 	if (error != NULL) {
 		mara_print_error(
@@ -137,5 +162,7 @@ end:
 		fclose(input);
 	}
 
+	free(input_buffer);
+
 	return exit_code;
 }
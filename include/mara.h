@@ -36,6 +36,10 @@ typedef struct mara_zone_s mara_zone_t;
 typedef struct mara_list_s mara_list_t;
 typedef struct mara_map_s mara_map_t;
 typedef struct mara_fn_s mara_fn_t;
+typedef struct mara_pmap_s mara_pmap_t;
+typedef struct mara_pvec_s mara_pvec_t;
+typedef struct mara_array_s mara_array_t;
+typedef struct mara_snapshot_s mara_snapshot_t;
 typedef struct { uint64_t internal; } mara_value_t;
 typedef int32_t mara_index_t;
 typedef double mara_real_t;
@@ -61,6 +65,27 @@ typedef struct {
 	const char* data;
 } mara_str_t;
 
+// Strings up to this length are always stored inline in the value instead of
+// in a string object so equal short strings are also bitwise equal
+#define MARA_SMALL_STR_MAX_LEN 5
+
+// Number of short strings mara_value_to_str can return before reusing a buffer
+#define MARA_SMALL_STR_SCRATCH_SIZE 16
+
+// Holds the characters of a short string while they are read
+typedef struct {
+	char data[MARA_SMALL_STR_MAX_LEN];
+} mara_small_str_buf_t;
+
+// Accumulates bytes in a buffer that grows inside zone.
+// Start with `(mara_str_builder_t){ .zone = zone }`.
+typedef struct {
+	mara_zone_t* zone;
+	char* data;
+	mara_index_t len;
+	mara_index_t capacity;
+} mara_str_builder_t;
+
 typedef struct {
 	mara_index_t line;
 	mara_index_t col;
@@ -97,14 +122,43 @@ typedef mara_error_t* (*mara_native_fn_t)(
 	mara_value_t* result
 );
 
+typedef mara_error_t* (*mara_protected_fn_t)(mara_exec_ctx_t* ctx, void* userdata);
+
+typedef enum {
+	// Arena chunks come from the allocator
+	MARA_CHUNK_PROVIDER_ALLOCATOR = 0,
+	// Arena chunks are carved out of large regions mapped from the OS.
+	// Falls back to the allocator where this is not supported.
+	MARA_CHUNK_PROVIDER_PAGES,
+} mara_chunk_provider_t;
+
 typedef struct {
 	mara_allocator_t allocator;
 	size_t alloc_chunk_size;
+	// Free chunks beyond this many bytes are returned to the allocator, 0 to keep all
+	size_t max_free_chunk_bytes;
+	mara_chunk_provider_t chunk_provider;
+	// Size of each region mapped by MARA_CHUNK_PROVIDER_PAGES, default 64 MiB
+	size_t page_region_size;
+	// Ask the OS to back regions with huge pages
+	bool use_huge_pages;
+	// Number of compiled sources kept by mara_compile_str, 0 to disable
+	mara_index_t compile_cache_size;
 } mara_env_options_t;
 
 typedef struct {
 	mara_index_t max_stack_frames;
 	mara_index_t max_stack_size;
+	// Bytes of zone memory a context may hold, 0 for no limit.
+	// During a call, an allocation which would go over the limit fails the
+	// call with core/limit-reached/memory.
+	// The failure does not return to any native function on the way, so a
+	// native holding resources that no zone owns (malloc, files, locks) must
+	// allocate through mara_protected_call.
+	// Outside of a call, it goes through and the next call fails instead.
+	size_t max_memory;
+	// Start from a state frozen with mara_freeze instead of an empty one
+	mara_snapshot_t* snapshot;
 } mara_exec_options_t;
 
 typedef struct {
@@ -137,8 +191,17 @@ typedef enum {
 	MARA_VAL_FN,
 	MARA_VAL_LIST,
 	MARA_VAL_MAP,
+	MARA_VAL_PMAP,
+	MARA_VAL_PVEC,
+	MARA_VAL_RECORD,
+	MARA_VAL_ARRAY,
 } mara_value_type_t;
 
+typedef enum {
+	MARA_ARRAY_I32,
+	MARA_ARRAY_F64,
+} mara_array_type_t;
+
 typedef struct {
 	mara_str_t filename;
 	bool parse_one;
@@ -150,6 +213,12 @@ typedef struct {
 	bool strip_debug_info;
 } mara_compile_options_t;
 
+typedef struct {
+	mara_parse_options_t parse_options;
+	mara_compile_options_t compile_options;
+	mara_str_t source;
+} mara_compile_job_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -171,6 +240,19 @@ mara_end(mara_exec_ctx_t* ctx);
 MARA_API bool
 mara_reset(mara_env_t* env);
 
+// Freeze the module loaders of a context together with a host value.
+// The snapshot is shared read-only by every context started from it and is
+// valid until the env is reset.
+// Lists, maps, arrays and records in it are frozen: writing to them fails
+// with core/frozen.
+// The same applies to module exports since they live in the env-wide module
+// cache.
+MARA_API mara_snapshot_t*
+mara_freeze(mara_exec_ctx_t* ctx, mara_value_t data);
+
+MARA_API mara_value_t
+mara_get_snapshot_data(mara_exec_ctx_t* ctx);
+
 // Debug
 
 MARA_API void
@@ -250,6 +332,18 @@ mara_value_is_list(mara_value_t value);
 MARA_API bool
 mara_value_is_map(mara_value_t value);
 
+MARA_API bool
+mara_value_is_pmap(mara_value_t value);
+
+MARA_API bool
+mara_value_is_pvec(mara_value_t value);
+
+MARA_API bool
+mara_value_is_record(mara_value_t value);
+
+MARA_API bool
+mara_value_is_array(mara_value_t value);
+
 MARA_API mara_value_type_t
 mara_value_type(mara_value_t value, void** tag);
 
@@ -262,9 +356,26 @@ mara_value_to_real(mara_exec_ctx_t* ctx, mara_value_t value, mara_real_t* result
 MARA_API mara_error_t*
 mara_value_to_bool(mara_exec_ctx_t* ctx, mara_value_t value, bool* result);
 
+// Breaking change: short strings are stored in the value itself, so the
+// result no longer lives as long as the value.
+// The characters of a short string are decoded into a scratch buffer of ctx
+// which is reused after MARA_SMALL_STR_SCRATCH_SIZE more short strings are
+// read this way.
+// Nothing is allocated.
+// Copy the result or use mara_value_to_str_buf to keep it longer.
 MARA_API mara_error_t*
 mara_value_to_str(mara_exec_ctx_t* ctx, mara_value_t value, mara_str_t* result);
 
+// Same as mara_value_to_str but a short string is decoded into buf, which
+// must outlive the result, and nothing is allocated
+MARA_API mara_error_t*
+mara_value_to_str_buf(
+	mara_exec_ctx_t* ctx,
+	mara_value_t value,
+	mara_small_str_buf_t* buf,
+	mara_str_t* result
+);
+
 MARA_API mara_error_t*
 mara_value_to_ref(mara_exec_ctx_t* ctx, mara_value_t value, void* tag, void** result);
 
@@ -274,6 +385,15 @@ mara_value_to_list(mara_exec_ctx_t* ctx, mara_value_t value, mara_list_t** resul
 MARA_API mara_error_t*
 mara_value_to_map(mara_exec_ctx_t* ctx, mara_value_t value, mara_map_t** result);
 
+MARA_API mara_error_t*
+mara_value_to_pmap(mara_exec_ctx_t* ctx, mara_value_t value, mara_pmap_t** result);
+
+MARA_API mara_error_t*
+mara_value_to_pvec(mara_exec_ctx_t* ctx, mara_value_t value, mara_pvec_t** result);
+
+MARA_API mara_error_t*
+mara_value_to_array(mara_exec_ctx_t* ctx, mara_value_t value, mara_array_t** result);
+
 MARA_API mara_error_t*
 mara_value_to_fn(mara_exec_ctx_t* ctx, mara_value_t value, mara_fn_t** result);
 
@@ -295,6 +415,15 @@ mara_value_from_list(mara_list_t* list);
 MARA_API mara_value_t
 mara_value_from_map(mara_map_t* map);
 
+MARA_API mara_value_t
+mara_value_from_pmap(mara_pmap_t* map);
+
+MARA_API mara_value_t
+mara_value_from_pvec(mara_pvec_t* vec);
+
+MARA_API mara_value_t
+mara_value_from_array(mara_array_t* array);
+
 MARA_API mara_value_t
 mara_value_from_fn(mara_fn_t* fn);
 
@@ -334,6 +463,16 @@ mara_new_list(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_index_t initial_capa
 MARA_API mara_map_t*
 mara_new_map(mara_exec_ctx_t* ctx, mara_zone_t* zone);
 
+MARA_API mara_pmap_t*
+mara_new_pmap(mara_exec_ctx_t* ctx, mara_zone_t* zone);
+
+MARA_API mara_pvec_t*
+mara_new_pvec(mara_exec_ctx_t* ctx, mara_zone_t* zone);
+
+// Elements start at zero
+MARA_API mara_array_t*
+mara_new_array(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_array_type_t type, mara_index_t len);
+
 MARA_API mara_value_t
 mara_new_ref(mara_exec_ctx_t* ctx, mara_zone_t* zone, void* tag, void* value);
 
@@ -360,6 +499,41 @@ mara_errorv(
 	va_list args
 );
 
+// String
+// Offsets are in bytes
+
+// Offset of the first occurrence of needle at or after start, -1 if there is
+// none
+MARA_API mara_index_t
+mara_str_find(mara_str_t str, mara_str_t needle, mara_index_t start);
+
+// Negative, zero or positive like memcmp, shorter strings go first
+MARA_API int
+mara_str_compare(mara_str_t lhs, mara_str_t rhs);
+
+// An empty separator yields the whole string
+MARA_API mara_list_t*
+mara_str_split(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_str_t str, mara_str_t separator);
+
+MARA_API mara_error_t*
+mara_str_join(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_list_t* parts,
+	mara_str_t separator,
+	mara_value_t* result
+);
+
+MARA_API void
+mara_str_builder_reserve(mara_exec_ctx_t* ctx, mara_str_builder_t* builder, mara_index_t capacity);
+
+MARA_API void
+mara_str_builder_append(mara_exec_ctx_t* ctx, mara_str_builder_t* builder, mara_str_t str);
+
+// The string takes over the buffer and the builder starts over empty
+MARA_API mara_value_t
+mara_str_builder_build(mara_exec_ctx_t* ctx, mara_str_builder_t* builder);
+
 // List
 
 MARA_API mara_index_t
@@ -383,9 +557,27 @@ mara_list_swap_delete(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t inde
 MARA_API void
 mara_list_resize(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t len);
 
+// Elements from start up to but excluding end, shared with the list until
+// the slice is written to
+MARA_API mara_list_t*
+mara_list_slice(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_list_t* list,
+	mara_index_t start,
+	mara_index_t end
+);
+
 MARA_API mara_error_t*
 mara_list_foreach(mara_exec_ctx_t* ctx, mara_list_t* list, mara_fn_t* fn);
 
+// Stable sort in place.
+// less_fn is called with two elements and returns whether the first one goes
+// before the second.
+// When it is NULL, elements are compared with `<`.
+MARA_API mara_error_t*
+mara_list_sort(mara_exec_ctx_t* ctx, mara_list_t* list, mara_fn_t* less_fn);
+
 // Map
 
 MARA_API mara_index_t
@@ -403,8 +595,153 @@ mara_map_delete(mara_exec_ctx_t* ctx, mara_map_t* map, mara_value_t key);
 MARA_API mara_error_t*
 mara_map_foreach(mara_exec_ctx_t* ctx, mara_map_t* map, mara_fn_t* fn);
 
+// Make room for at least capacity entries
+MARA_API void
+mara_map_reserve(mara_exec_ctx_t* ctx, mara_map_t* map, mara_index_t capacity);
+
+// Set every entry of src in dst
+MARA_API void
+mara_map_merge(mara_exec_ctx_t* ctx, mara_map_t* dst, mara_map_t* src);
+
+// Build a map from num_pairs keys and values laid out as key, value, key, value...
+MARA_API mara_map_t*
+mara_map_from_pairs(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t num_pairs,
+	const mara_value_t* pairs
+);
+
+// Look up num_keys keys at once, missing ones give nil
+MARA_API void
+mara_map_get_many(
+	mara_exec_ctx_t* ctx,
+	mara_map_t* map,
+	mara_index_t num_keys,
+	const mara_value_t* keys,
+	mara_value_t* values
+);
+
+// Persistent map
+// Updates return a new map in the given zone and leave the old one intact.
+// Parts of the old map that already outlive the zone are shared.
+
+MARA_API mara_index_t
+mara_pmap_len(mara_exec_ctx_t* ctx, mara_pmap_t* map);
+
+MARA_API mara_value_t
+mara_pmap_get(mara_exec_ctx_t* ctx, mara_pmap_t* map, mara_value_t key);
+
+MARA_API mara_pmap_t*
+mara_pmap_set(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pmap_t* map,
+	mara_value_t key,
+	mara_value_t value
+);
+
+MARA_API mara_pmap_t*
+mara_pmap_delete(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pmap_t* map, mara_value_t key);
+
+MARA_API mara_error_t*
+mara_pmap_foreach(mara_exec_ctx_t* ctx, mara_pmap_t* map, mara_fn_t* fn);
+
+// Persistent vector
+
+MARA_API mara_index_t
+mara_pvec_len(mara_exec_ctx_t* ctx, mara_pvec_t* vec);
+
+MARA_API mara_value_t
+mara_pvec_get(mara_exec_ctx_t* ctx, mara_pvec_t* vec, mara_index_t index);
+
+// Setting the element right after the end appends it
+MARA_API mara_pvec_t*
+mara_pvec_set(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pvec_t* vec,
+	mara_index_t index,
+	mara_value_t value
+);
+
+MARA_API mara_pvec_t*
+mara_pvec_push(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pvec_t* vec, mara_value_t value);
+
+MARA_API mara_pvec_t*
+mara_pvec_pop(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pvec_t* vec);
+
+MARA_API mara_error_t*
+mara_pvec_foreach(mara_exec_ctx_t* ctx, mara_pvec_t* vec, mara_fn_t* fn);
+
+// Packed array
+// Elements are stored unboxed: int32_t or double.
+// Integer arithmetic wraps around like +.
+// Functions taking two arrays expect them to have the same type and length.
+
+MARA_API mara_array_type_t
+mara_array_type(mara_exec_ctx_t* ctx, mara_array_t* array);
+
+MARA_API mara_index_t
+mara_array_len(mara_exec_ctx_t* ctx, mara_array_t* array);
+
+MARA_API void*
+mara_array_data(mara_exec_ctx_t* ctx, mara_array_t* array);
+
+MARA_API mara_value_t
+mara_array_get(mara_exec_ctx_t* ctx, mara_array_t* array, mara_index_t index);
+
+MARA_API mara_error_t*
+mara_array_set(mara_exec_ctx_t* ctx, mara_array_t* array, mara_index_t index, mara_value_t value);
+
+MARA_API mara_error_t*
+mara_array_from_list(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_array_type_t type,
+	mara_list_t* list,
+	mara_array_t** result
+);
+
+MARA_API mara_list_t*
+mara_array_to_list(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_array_t* array);
+
+MARA_API mara_value_t
+mara_array_sum(mara_exec_ctx_t* ctx, mara_array_t* array);
+
+// Empty arrays give nil
+MARA_API mara_value_t
+mara_array_min(mara_exec_ctx_t* ctx, mara_array_t* array);
+
+MARA_API mara_value_t
+mara_array_max(mara_exec_ctx_t* ctx, mara_array_t* array);
+
+MARA_API mara_error_t*
+mara_array_dot(mara_exec_ctx_t* ctx, mara_array_t* lhs, mara_array_t* rhs, mara_value_t* result);
+
+MARA_API mara_error_t*
+mara_array_add(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_array_t* lhs,
+	mara_array_t* rhs,
+	mara_array_t** result
+);
+
+MARA_API mara_error_t*
+mara_array_scale(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_array_t* array,
+	mara_value_t factor,
+	mara_array_t** result
+);
+
 // Module
 
+// Waits when another context is loading the same module.
+// Importing a module that is being loaded by the same context, directly or
+// through contexts waiting on it, fails with core/circular-dependency.
 MARA_API mara_error_t*
 mara_import(
 	mara_exec_ctx_t* ctx,
@@ -460,6 +797,27 @@ mara_apply(
 	mara_value_t* result
 );
 
+// Call fn n times with argc arguments each.
+// Call i takes its arguments from argv_matrix[i * argc] onwards and stores
+// its result in results[i].
+// Stops at the first error.
+MARA_API mara_error_t*
+mara_call_batch(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_fn_t* fn,
+	mara_index_t n,
+	mara_index_t argc,
+	mara_value_t* argv_matrix,
+	mara_value_t* results
+);
+
+// Run fn so that reaching max_memory inside it returns
+// core/limit-reached/memory from here instead of unwinding the caller.
+// Zones entered by fn are exited on failure.
+MARA_API mara_error_t*
+mara_protected_call(mara_exec_ctx_t* ctx, mara_protected_fn_t fn, void* userdata);
+
 // Compile
 
 MARA_API mara_error_t*
@@ -480,11 +838,50 @@ mara_compile(
 	mara_fn_t** result
 );
 
+MARA_API mara_error_t*
+mara_compile_str(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_parse_options_t parse_options,
+	mara_compile_options_t compile_options,
+	mara_str_t source,
+	mara_fn_t** result
+);
+
+// Compile independent sources on up to num_threads threads.
+// The allocator of the env must be thread-safe.
+// results[i] receives the function compiled from jobs[i].
+MARA_API mara_error_t*
+mara_compile_parallel(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t num_threads,
+	mara_index_t num_jobs,
+	const mara_compile_job_t* jobs,
+	mara_fn_t** results
+);
+
 // Serialization
 
 MARA_API mara_error_t*
 mara_load(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_reader_t reader, mara_value_t* result);
 
+MARA_API bool
+mara_is_code_image(const void* buffer, size_t size);
+
+// Load a code image in place.
+// The buffer must stay valid and unmodified for as long as the code is used.
+MARA_API mara_error_t*
+mara_load_from_buffer(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	const void* buffer,
+	size_t size,
+	mara_value_t* result
+);
+
+// Functions are written as code images, other values as data.
+// On success, result (if not NULL) is set to the number of bytes written.
 MARA_API mara_error_t*
 mara_dump(mara_exec_ctx_t* ctx, mara_value_t value, mara_writer_t writer, mara_value_t* result);
 
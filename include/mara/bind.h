@@ -11,6 +11,9 @@
 		bool: mara_value_from_bool, \
 		mara_list_t*: mara_value_from_list, \
 		mara_map_t*: mara_value_from_map, \
+		mara_pmap_t*: mara_value_from_pmap, \
+		mara_pvec_t*: mara_value_from_pvec, \
+		mara_array_t*: mara_value_from_array, \
 		mara_fn_t*: mara_value_from_fn, \
 		mara_value_t: mara_wrap_identity \
 	)((VALUE))
@@ -65,6 +68,9 @@
 		mara_str_t: mara_value_to_str, \
 		mara_list_t*: mara_value_to_list, \
 		mara_map_t*: mara_value_to_map, \
+		mara_pmap_t*: mara_value_to_pmap, \
+		mara_pvec_t*: mara_value_to_pvec, \
+		mara_array_t*: mara_value_to_array, \
 		mara_fn_t*: mara_value_to_fn, \
 		mara_value_t: mara_unwrap_identity \
 	)
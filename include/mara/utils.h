@@ -21,9 +21,9 @@
 
 #define mara_add_native_debug_info(ctx) \
 	do { \
-		static mara_source_info_t native_debug_info; \
-		native_debug_info = (mara_source_info_t){ \
-			.filename = mara_str_from_literal(__FILE__), \
+		/* Constant so that threads can share it */ \
+		static const mara_source_info_t native_debug_info = { \
+			.filename = { .data = __FILE__, .len = sizeof(__FILE__) - 1 }, \
 			.range = { \
 				.start = { .line = __LINE__, .col = 1, .byte_offset = 0 }, \
 				.end = { .line = __LINE__, .col = 1, .byte_offset = 0 }, \
@@ -36,32 +36,203 @@ mara_realloc(mara_allocator_t allocator, void* ptr, size_t new_size) {
 	return allocator.fn(ptr, new_size, allocator.userdata);
 }
 
+void
+mara_quota_charge(mara_memory_quota_t* quota, size_t size) {
+	quota->used += size;
+	if (quota->used > quota->limit && quota->stack_frames_end == NULL) {
+		mara_exec_ctx_t* ctx = mara_container_of(quota, mara_exec_ctx_t, memory_quota);
+		quota->stack_frames_end = ctx->stack_frames_end;
+		ctx->stack_frames_end = ctx->stack_frames_begin;
+	}
+}
+
+_Noreturn void
+mara_quota_fail(mara_memory_quota_t* quota) {
+	// The error zone is not accounted so the error can always be created
+	mara_exec_ctx_t* ctx = mara_container_of(quota, mara_exec_ctx_t, memory_quota);
+	mara_errorf(
+		ctx, mara_str_from_literal("core/limit-reached/memory"),
+		"Memory limit reached",
+		mara_nil()
+	);
+	longjmp(*quota->recovery_point, 1);
+}
+
+void
+mara_quota_refund(mara_memory_quota_t* quota, size_t size) {
+	quota->used -= size;
+	if (quota->used <= quota->limit && quota->stack_frames_end != NULL) {
+		mara_exec_ctx_t* ctx = mara_container_of(quota, mara_exec_ctx_t, memory_quota);
+		ctx->stack_frames_end = quota->stack_frames_end;
+		quota->stack_frames_end = NULL;
+	}
+}
+
+MARA_PRIVATE size_t
+mara_chunk_size(mara_arena_chunk_t* chunk) {
+	return (size_t)(chunk->end - (char*)chunk);
+}
+
+MARA_PRIVATE mara_index_t
+mara_chunk_bin(mara_env_t* env, size_t chunk_size) {
+	size_t bin_size = env->options.alloc_chunk_size;
+	mara_index_t bin = 0;
+	while (bin < MARA_NUM_CHUNK_BINS - 1 && chunk_size >= bin_size * 2) {
+		bin_size *= 2;
+		++bin;
+	}
+
+	return bin;
+}
+
+MARA_PRIVATE mara_arena_chunk_t*
+mara_take_free_chunk(mara_env_t* env, mara_chunk_cache_t* cache, size_t chunk_size) {
+	mara_index_t bin = mara_chunk_bin(env, chunk_size);
+
+	// Chunks in the same bin may still be too small
+	mara_arena_chunk_t** itr = &cache->free_chunks[bin];
+	if (*itr != NULL && mara_chunk_size(*itr) < chunk_size) {
+		if (bin == MARA_NUM_CHUNK_BINS - 1) {
+			while (*itr != NULL && mara_chunk_size(*itr) < chunk_size) {
+				itr = &(*itr)->next;
+			}
+		} else {
+			++bin;
+			itr = &cache->free_chunks[bin];
+		}
+	}
+
+	// Chunks in bigger bins always fit
+	while (*itr == NULL && bin < MARA_NUM_CHUNK_BINS - 1) {
+		++bin;
+		itr = &cache->free_chunks[bin];
+	}
+
+	mara_arena_chunk_t* chunk = *itr;
+	if (chunk != NULL && mara_chunk_size(chunk) >= chunk_size) {
+		*itr = chunk->next;
+		cache->free_chunk_bytes -= mara_chunk_size(chunk);
+		return chunk;
+	} else {
+		return NULL;
+	}
+}
+
+MARA_PRIVATE bool
+mara_cache_chunk(mara_env_t* env, mara_chunk_cache_t* cache, mara_arena_chunk_t* chunk) {
+	size_t chunk_size = mara_chunk_size(chunk);
+	size_t max_free_chunk_bytes = env->options.max_free_chunk_bytes;
+	if (
+		max_free_chunk_bytes > 0
+		&& cache->free_chunk_bytes + chunk_size > max_free_chunk_bytes
+	) {
+		return false;
+	} else {
+		mara_index_t bin = mara_chunk_bin(env, chunk_size);
+		chunk->next = cache->free_chunks[bin];
+		cache->free_chunks[bin] = chunk;
+		cache->free_chunk_bytes += chunk_size;
+		return true;
+	}
+}
+
+// Must be called with chunk_lock held
+MARA_PRIVATE void
+mara_release_shared_chunk(mara_env_t* env, mara_arena_chunk_t* chunk) {
+	if (!mara_cache_chunk(env, &env->chunk_cache, chunk)) {
+		if (env->options.chunk_provider == MARA_CHUNK_PROVIDER_PAGES) {
+			mara_page_decommit_chunk(env, chunk);
+		} else {
+			mara_free(env->options.allocator, chunk);
+		}
+	}
+}
+
+MARA_PRIVATE mara_arena_chunk_t*
+mara_acquire_chunk(mara_env_t* env, mara_chunk_cache_t* cache, size_t chunk_size) {
+	// The thread's own cache is tried first so most acquisitions do not lock
+	if (cache != NULL) {
+		mara_arena_chunk_t* chunk = mara_take_free_chunk(env, cache, chunk_size);
+		if (chunk != NULL) { return chunk; }
+	}
+
+	mara_mutex_lock(&env->chunk_lock);
+	mara_arena_chunk_t* chunk = mara_take_free_chunk(env, &env->chunk_cache, chunk_size);
+	if (chunk == NULL && env->options.chunk_provider == MARA_CHUNK_PROVIDER_PAGES) {
+		chunk = mara_page_alloc_chunk(env, chunk_size);
+	}
+	mara_mutex_unlock(&env->chunk_lock);
+
+	if (chunk == NULL) {
+		chunk = mara_malloc(env->options.allocator, chunk_size);
+		if (chunk == NULL) { return NULL; }
+		chunk->end = (char*)chunk + chunk_size;
+	}
+
+	return chunk;
+}
+
+MARA_PRIVATE void
+mara_release_chunk(mara_env_t* env, mara_chunk_cache_t* cache, mara_arena_chunk_t* chunk) {
+	if (cache == NULL || !mara_cache_chunk(env, cache, chunk)) {
+		mara_mutex_lock(&env->chunk_lock);
+		mara_release_shared_chunk(env, chunk);
+		mara_mutex_unlock(&env->chunk_lock);
+	}
+}
+
+void
+mara_chunk_cache_flush(mara_env_t* env, mara_chunk_cache_t* cache) {
+	mara_mutex_lock(&env->chunk_lock);
+	for (mara_index_t i = 0; i < MARA_NUM_CHUNK_BINS; ++i) {
+		for (mara_arena_chunk_t* itr = cache->free_chunks[i]; itr != NULL;) {
+			mara_arena_chunk_t* next = itr->next;
+			mara_release_shared_chunk(env, itr);
+			itr = next;
+		}
+		cache->free_chunks[i] = NULL;
+	}
+	mara_mutex_unlock(&env->chunk_lock);
+
+	cache->free_chunk_bytes = 0;
+}
+
 void*
 mara_arena_alloc_ex(mara_env_t* env, mara_arena_t* arena, size_t size, size_t alignment) {
 	void* mem = mara_alloc_from_chunk(arena->current_chunk, size, alignment);
 	if (MARA_EXPECT(mem != NULL)) {
 		return mem;
 	} else {
+		// Each new chunk doubles in size up to the largest bin so an arena
+		// which allocates a lot goes back to the allocator less often
 		size_t configured_chunk_size = env->options.alloc_chunk_size;
-		size_t required_chunk_size = sizeof(mara_arena_chunk_t) + size;
-		size_t chunk_size = mara_max(configured_chunk_size, required_chunk_size);
-
-		mara_arena_chunk_t* new_chunk;
-		{
-			mara_arena_chunk_t* free_chunk = env->free_chunks;
-			if (
-				free_chunk != NULL
-				&& (size_t)(free_chunk->end - (char*)free_chunk) >= chunk_size
-			) {
-				new_chunk = free_chunk;
-				env->free_chunks = new_chunk->next;
-			} else {
-				new_chunk = mara_malloc(env->options.allocator, chunk_size);
-				mara_assert(new_chunk != NULL, "Out of memory");
-				new_chunk->end = (char*)new_chunk + chunk_size;
+		size_t max_chunk_size = configured_chunk_size << (MARA_NUM_CHUNK_BINS - 1);
+		size_t preferred_chunk_size = mara_max(arena->next_chunk_size, configured_chunk_size);
+		arena->next_chunk_size = mara_min(preferred_chunk_size * 2, max_chunk_size);
+
+		size_t required_chunk_size = sizeof(mara_arena_chunk_t) + size + alignment - 1;
+		size_t chunk_size = mara_max(preferred_chunk_size, required_chunk_size);
+
+		mara_memory_quota_t* quota = arena->quota;
+		bool recoverable = quota != NULL && quota->recovery_point != NULL;
+		if (recoverable && quota->used + chunk_size > quota->limit) {
+			// Settle for a smaller chunk before giving up
+			chunk_size = mara_max(configured_chunk_size, required_chunk_size);
+			if (quota->used + chunk_size > quota->limit) {
+				mara_quota_fail(quota);
 			}
 		}
 
+		mara_arena_chunk_t* new_chunk = mara_acquire_chunk(env, arena->chunk_cache, chunk_size);
+		if (new_chunk == NULL) {
+			if (recoverable) { mara_quota_fail(quota); }
+			mara_assert(new_chunk != NULL, "Out of memory");
+		}
+
+		if (quota != NULL) {
+			mara_quota_charge(quota, mara_chunk_size(new_chunk));
+		}
+
 		new_chunk->bump_ptr = new_chunk->begin;
 		new_chunk->next = arena->current_chunk;
 		arena->current_chunk = new_chunk;
@@ -74,6 +245,33 @@ mara_arena_alloc(mara_env_t* env, mara_arena_t* arena, size_t size) {
 	return mara_arena_alloc_ex(env, arena, size, _Alignof(MARA_ALIGN_TYPE));
 }
 
+bool
+mara_arena_try_extend(
+	mara_env_t* env,
+	mara_arena_t* arena,
+	void* ptr,
+	size_t old_size,
+	size_t new_size
+) {
+	// The permanent zone is shared by every context
+	bool shared = arena == &env->permanent_zone.arena;
+	if (shared) { mara_mutex_lock(&env->lock); }
+
+	// Only the last allocation in the current chunk can grow
+	bool extended = false;
+	mara_arena_chunk_t* chunk = arena->current_chunk;
+	if (chunk != NULL && (char*)ptr + old_size == chunk->bump_ptr) {
+		char* next_bump_ptr = (char*)ptr + new_size;
+		if (next_bump_ptr <= chunk->end) {
+			chunk->bump_ptr = next_bump_ptr;
+			extended = true;
+		}
+	}
+
+	if (shared) { mara_mutex_unlock(&env->lock); }
+	return extended;
+}
+
 mara_arena_snapshot_t
 mara_arena_snapshot(mara_env_t* env, mara_arena_t* arena) {
 	(void)env;
@@ -92,8 +290,10 @@ mara_arena_restore(mara_env_t* env, mara_arena_t* arena, mara_arena_snapshot_t s
 			break;
 		} else {
 			mara_arena_chunk_t* next = chunk->next;
-			chunk->next = env->free_chunks;
-			env->free_chunks = chunk;
+			if (arena->quota != NULL) {
+				mara_quota_refund(arena->quota, mara_chunk_size(chunk));
+			}
+			mara_release_chunk(env, arena->chunk_cache, chunk);
 			chunk = next;
 		}
 	}
@@ -108,4 +308,5 @@ mara_arena_reset(mara_env_t* env, mara_arena_t* arena) {
 		.chunk = NULL,
 		.bump_ptr = NULL,
 	});
+	arena->next_chunk_size = 0;
 }
@@ -0,0 +1,782 @@
+#include "internal.h"
+#include <mara/utils.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define MARA_ARRAY_SSE2
+#	include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled for the target regardless of the build flags
+// and only picked when the CPU has it
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define MARA_ARRAY_AVX2
+#	define MARA_ARRAY_AVX2_FN __attribute__((target("avx2")))
+#	include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#	define MARA_ARRAY_AVX2
+#	define MARA_ARRAY_AVX2_FN
+#	include <immintrin.h>
+#	include <intrin.h>
+#endif
+
+struct mara_array_kernels_s {
+	int32_t (*sum_i32)(const int32_t* values, mara_index_t len);
+	double (*sum_f64)(const double* values, mara_index_t len);
+	// len must be positive
+	void (*range_i32)(const int32_t* values, mara_index_t len, int32_t* min, int32_t* max);
+	void (*range_f64)(const double* values, mara_index_t len, double* min, double* max);
+	int32_t (*dot_i32)(const int32_t* lhs, const int32_t* rhs, mara_index_t len);
+	double (*dot_f64)(const double* lhs, const double* rhs, mara_index_t len);
+	void (*add_i32)(int32_t* out, const int32_t* lhs, const int32_t* rhs, mara_index_t len);
+	void (*add_f64)(double* out, const double* lhs, const double* rhs, mara_index_t len);
+	void (*scale_i32)(int32_t* out, const int32_t* values, int32_t factor, mara_index_t len);
+	void (*scale_f64)(double* out, const double* values, double factor, mara_index_t len);
+};
+
+// Scalar kernels, also used for the tail of vectorized ones.
+// Integer arithmetic is done unsigned so it wraps like +.
+
+MARA_PRIVATE int32_t
+mara_array_sum_i32_scalar(const int32_t* values, mara_index_t len) {
+	uint32_t sum = 0;
+	for (mara_index_t i = 0; i < len; ++i) {
+		sum += (uint32_t)values[i];
+	}
+	return (int32_t)sum;
+}
+
+MARA_PRIVATE double
+mara_array_sum_f64_scalar(const double* values, mara_index_t len) {
+	double sum = 0.0;
+	for (mara_index_t i = 0; i < len; ++i) {
+		sum += values[i];
+	}
+	return sum;
+}
+
+MARA_PRIVATE void
+mara_array_range_i32_scalar(const int32_t* values, mara_index_t len, int32_t* min, int32_t* max) {
+	int32_t lo = *min;
+	int32_t hi = *max;
+	for (mara_index_t i = 0; i < len; ++i) {
+		lo = mara_min(lo, values[i]);
+		hi = mara_max(hi, values[i]);
+	}
+	*min = lo;
+	*max = hi;
+}
+
+MARA_PRIVATE void
+mara_array_range_f64_scalar(const double* values, mara_index_t len, double* min, double* max) {
+	double lo = *min;
+	double hi = *max;
+	for (mara_index_t i = 0; i < len; ++i) {
+		lo = mara_min(lo, values[i]);
+		hi = mara_max(hi, values[i]);
+	}
+	*min = lo;
+	*max = hi;
+}
+
+MARA_PRIVATE void
+mara_array_init_range_i32(const int32_t* values, mara_index_t len, int32_t* min, int32_t* max) {
+	*min = *max = values[0];
+	mara_array_range_i32_scalar(values + 1, len - 1, min, max);
+}
+
+MARA_PRIVATE void
+mara_array_init_range_f64(const double* values, mara_index_t len, double* min, double* max) {
+	*min = *max = values[0];
+	mara_array_range_f64_scalar(values + 1, len - 1, min, max);
+}
+
+MARA_PRIVATE int32_t
+mara_array_dot_i32_scalar(const int32_t* lhs, const int32_t* rhs, mara_index_t len) {
+	uint32_t sum = 0;
+	for (mara_index_t i = 0; i < len; ++i) {
+		sum += (uint32_t)lhs[i] * (uint32_t)rhs[i];
+	}
+	return (int32_t)sum;
+}
+
+MARA_PRIVATE double
+mara_array_dot_f64_scalar(const double* lhs, const double* rhs, mara_index_t len) {
+	double sum = 0.0;
+	for (mara_index_t i = 0; i < len; ++i) {
+		sum += lhs[i] * rhs[i];
+	}
+	return sum;
+}
+
+MARA_PRIVATE void
+mara_array_add_i32_scalar(int32_t* out, const int32_t* lhs, const int32_t* rhs, mara_index_t len) {
+	for (mara_index_t i = 0; i < len; ++i) {
+		out[i] = (int32_t)((uint32_t)lhs[i] + (uint32_t)rhs[i]);
+	}
+}
+
+MARA_PRIVATE void
+mara_array_add_f64_scalar(double* out, const double* lhs, const double* rhs, mara_index_t len) {
+	for (mara_index_t i = 0; i < len; ++i) {
+		out[i] = lhs[i] + rhs[i];
+	}
+}
+
+MARA_PRIVATE void
+mara_array_scale_i32_scalar(int32_t* out, const int32_t* values, int32_t factor, mara_index_t len) {
+	for (mara_index_t i = 0; i < len; ++i) {
+		out[i] = (int32_t)((uint32_t)values[i] * (uint32_t)factor);
+	}
+}
+
+MARA_PRIVATE void
+mara_array_scale_f64_scalar(double* out, const double* values, double factor, mara_index_t len) {
+	for (mara_index_t i = 0; i < len; ++i) {
+		out[i] = values[i] * factor;
+	}
+}
+
+#ifndef MARA_ARRAY_SSE2
+
+static const mara_array_kernels_t mara_array_scalar_kernels = {
+	.sum_i32 = mara_array_sum_i32_scalar,
+	.sum_f64 = mara_array_sum_f64_scalar,
+	.range_i32 = mara_array_init_range_i32,
+	.range_f64 = mara_array_init_range_f64,
+	.dot_i32 = mara_array_dot_i32_scalar,
+	.dot_f64 = mara_array_dot_f64_scalar,
+	.add_i32 = mara_array_add_i32_scalar,
+	.add_f64 = mara_array_add_f64_scalar,
+	.scale_i32 = mara_array_scale_i32_scalar,
+	.scale_f64 = mara_array_scale_f64_scalar,
+};
+
+#endif
+
+#ifdef MARA_ARRAY_SSE2
+
+MARA_PRIVATE int32_t
+mara_array_hsum_epi32_sse2(__m128i sum) {
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, sum);
+	return mara_array_sum_i32_scalar(lanes, 4);
+}
+
+MARA_PRIVATE double
+mara_array_hsum_pd_sse2(__m128d sum) {
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	return lanes[0] + lanes[1];
+}
+
+// SSE2 has no 32-bit compare-and-select or low multiply
+
+MARA_PRIVATE __m128i
+mara_array_min_epi32_sse2(__m128i a, __m128i b) {
+	__m128i a_smaller = _mm_cmplt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(a_smaller, a), _mm_andnot_si128(a_smaller, b));
+}
+
+MARA_PRIVATE __m128i
+mara_array_max_epi32_sse2(__m128i a, __m128i b) {
+	__m128i a_larger = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(a_larger, a), _mm_andnot_si128(a_larger, b));
+}
+
+MARA_PRIVATE __m128i
+mara_array_mullo_epi32_sse2(__m128i a, __m128i b) {
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))
+	);
+}
+
+MARA_PRIVATE int32_t
+mara_array_sum_i32_sse2(const int32_t* values, mara_index_t len) {
+	__m128i sum = _mm_setzero_si128();
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		sum = _mm_add_epi32(sum, _mm_loadu_si128((const __m128i*)(values + i)));
+	}
+	return (int32_t)(
+		(uint32_t)mara_array_hsum_epi32_sse2(sum)
+		+ (uint32_t)mara_array_sum_i32_scalar(values + i, len - i)
+	);
+}
+
+MARA_PRIVATE double
+mara_array_sum_f64_sse2(const double* values, mara_index_t len) {
+	// Two accumulators hide the latency of the adds
+	__m128d sum0 = _mm_setzero_pd();
+	__m128d sum1 = _mm_setzero_pd();
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		sum0 = _mm_add_pd(sum0, _mm_loadu_pd(values + i));
+		sum1 = _mm_add_pd(sum1, _mm_loadu_pd(values + i + 2));
+	}
+	return mara_array_hsum_pd_sse2(_mm_add_pd(sum0, sum1))
+		+ mara_array_sum_f64_scalar(values + i, len - i);
+}
+
+MARA_PRIVATE void
+mara_array_range_i32_sse2(const int32_t* values, mara_index_t len, int32_t* min, int32_t* max) {
+	if (len < 4) {
+		mara_array_init_range_i32(values, len, min, max);
+		return;
+	}
+
+	__m128i lo = _mm_loadu_si128((const __m128i*)values);
+	__m128i hi = lo;
+	mara_index_t i = 4;
+	for (; i + 4 <= len; i += 4) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(values + i));
+		lo = mara_array_min_epi32_sse2(lo, chunk);
+		hi = mara_array_max_epi32_sse2(hi, chunk);
+	}
+
+	int32_t lo_lanes[4], hi_lanes[4];
+	_mm_storeu_si128((__m128i*)lo_lanes, lo);
+	_mm_storeu_si128((__m128i*)hi_lanes, hi);
+	mara_array_init_range_i32(lo_lanes, 4, min, max);
+	mara_array_range_i32_scalar(hi_lanes, 4, min, max);
+	mara_array_range_i32_scalar(values + i, len - i, min, max);
+}
+
+MARA_PRIVATE void
+mara_array_range_f64_sse2(const double* values, mara_index_t len, double* min, double* max) {
+	if (len < 2) {
+		mara_array_init_range_f64(values, len, min, max);
+		return;
+	}
+
+	__m128d lo = _mm_loadu_pd(values);
+	__m128d hi = lo;
+	mara_index_t i = 2;
+	for (; i + 2 <= len; i += 2) {
+		__m128d chunk = _mm_loadu_pd(values + i);
+		lo = _mm_min_pd(lo, chunk);
+		hi = _mm_max_pd(hi, chunk);
+	}
+
+	double lo_lanes[2], hi_lanes[2];
+	_mm_storeu_pd(lo_lanes, lo);
+	_mm_storeu_pd(hi_lanes, hi);
+	mara_array_init_range_f64(lo_lanes, 2, min, max);
+	mara_array_range_f64_scalar(hi_lanes, 2, min, max);
+	mara_array_range_f64_scalar(values + i, len - i, min, max);
+}
+
+MARA_PRIVATE int32_t
+mara_array_dot_i32_sse2(const int32_t* lhs, const int32_t* rhs, mara_index_t len) {
+	__m128i sum = _mm_setzero_si128();
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		sum = _mm_add_epi32(sum, mara_array_mullo_epi32_sse2(
+			_mm_loadu_si128((const __m128i*)(lhs + i)),
+			_mm_loadu_si128((const __m128i*)(rhs + i))
+		));
+	}
+	return (int32_t)(
+		(uint32_t)mara_array_hsum_epi32_sse2(sum)
+		+ (uint32_t)mara_array_dot_i32_scalar(lhs + i, rhs + i, len - i)
+	);
+}
+
+MARA_PRIVATE double
+mara_array_dot_f64_sse2(const double* lhs, const double* rhs, mara_index_t len) {
+	__m128d sum0 = _mm_setzero_pd();
+	__m128d sum1 = _mm_setzero_pd();
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+		sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(lhs + i + 2), _mm_loadu_pd(rhs + i + 2)));
+	}
+	return mara_array_hsum_pd_sse2(_mm_add_pd(sum0, sum1))
+		+ mara_array_dot_f64_scalar(lhs + i, rhs + i, len - i);
+}
+
+MARA_PRIVATE void
+mara_array_add_i32_sse2(int32_t* out, const int32_t* lhs, const int32_t* rhs, mara_index_t len) {
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		_mm_storeu_si128((__m128i*)(out + i), _mm_add_epi32(
+			_mm_loadu_si128((const __m128i*)(lhs + i)),
+			_mm_loadu_si128((const __m128i*)(rhs + i))
+		));
+	}
+	mara_array_add_i32_scalar(out + i, lhs + i, rhs + i, len - i);
+}
+
+MARA_PRIVATE void
+mara_array_add_f64_sse2(double* out, const double* lhs, const double* rhs, mara_index_t len) {
+	mara_index_t i = 0;
+	for (; i + 2 <= len; i += 2) {
+		_mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+	}
+	mara_array_add_f64_scalar(out + i, lhs + i, rhs + i, len - i);
+}
+
+MARA_PRIVATE void
+mara_array_scale_i32_sse2(int32_t* out, const int32_t* values, int32_t factor, mara_index_t len) {
+	__m128i factors = _mm_set1_epi32(factor);
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		_mm_storeu_si128((__m128i*)(out + i), mara_array_mullo_epi32_sse2(
+			_mm_loadu_si128((const __m128i*)(values + i)), factors
+		));
+	}
+	mara_array_scale_i32_scalar(out + i, values + i, factor, len - i);
+}
+
+MARA_PRIVATE void
+mara_array_scale_f64_sse2(double* out, const double* values, double factor, mara_index_t len) {
+	__m128d factors = _mm_set1_pd(factor);
+	mara_index_t i = 0;
+	for (; i + 2 <= len; i += 2) {
+		_mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(values + i), factors));
+	}
+	mara_array_scale_f64_scalar(out + i, values + i, factor, len - i);
+}
+
+static const mara_array_kernels_t mara_array_sse2_kernels = {
+	.sum_i32 = mara_array_sum_i32_sse2,
+	.sum_f64 = mara_array_sum_f64_sse2,
+	.range_i32 = mara_array_range_i32_sse2,
+	.range_f64 = mara_array_range_f64_sse2,
+	.dot_i32 = mara_array_dot_i32_sse2,
+	.dot_f64 = mara_array_dot_f64_sse2,
+	.add_i32 = mara_array_add_i32_sse2,
+	.add_f64 = mara_array_add_f64_sse2,
+	.scale_i32 = mara_array_scale_i32_sse2,
+	.scale_f64 = mara_array_scale_f64_sse2,
+};
+
+#endif
+
+#ifdef MARA_ARRAY_AVX2
+
+MARA_ARRAY_AVX2_FN static inline int32_t
+mara_array_hsum_epi32_avx2(__m256i sum) {
+	int32_t lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, sum);
+	return mara_array_sum_i32_scalar(lanes, 8);
+}
+
+MARA_ARRAY_AVX2_FN static inline double
+mara_array_hsum_pd_avx2(__m256d sum) {
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+MARA_ARRAY_AVX2_FN static int32_t
+mara_array_sum_i32_avx2(const int32_t* values, mara_index_t len) {
+	__m256i sum = _mm256_setzero_si256();
+	mara_index_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i*)(values + i)));
+	}
+	return (int32_t)(
+		(uint32_t)mara_array_hsum_epi32_avx2(sum)
+		+ (uint32_t)mara_array_sum_i32_scalar(values + i, len - i)
+	);
+}
+
+MARA_ARRAY_AVX2_FN static double
+mara_array_sum_f64_avx2(const double* values, mara_index_t len) {
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	mara_index_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(values + i));
+		sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(values + i + 4));
+	}
+	return mara_array_hsum_pd_avx2(_mm256_add_pd(sum0, sum1))
+		+ mara_array_sum_f64_scalar(values + i, len - i);
+}
+
+MARA_ARRAY_AVX2_FN static void
+mara_array_range_i32_avx2(const int32_t* values, mara_index_t len, int32_t* min, int32_t* max) {
+	if (len < 8) {
+		mara_array_init_range_i32(values, len, min, max);
+		return;
+	}
+
+	__m256i lo = _mm256_loadu_si256((const __m256i*)values);
+	__m256i hi = lo;
+	mara_index_t i = 8;
+	for (; i + 8 <= len; i += 8) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)(values + i));
+		lo = _mm256_min_epi32(lo, chunk);
+		hi = _mm256_max_epi32(hi, chunk);
+	}
+
+	int32_t lo_lanes[8], hi_lanes[8];
+	_mm256_storeu_si256((__m256i*)lo_lanes, lo);
+	_mm256_storeu_si256((__m256i*)hi_lanes, hi);
+	mara_array_init_range_i32(lo_lanes, 8, min, max);
+	mara_array_range_i32_scalar(hi_lanes, 8, min, max);
+	mara_array_range_i32_scalar(values + i, len - i, min, max);
+}
+
+MARA_ARRAY_AVX2_FN static void
+mara_array_range_f64_avx2(const double* values, mara_index_t len, double* min, double* max) {
+	if (len < 4) {
+		mara_array_init_range_f64(values, len, min, max);
+		return;
+	}
+
+	__m256d lo = _mm256_loadu_pd(values);
+	__m256d hi = lo;
+	mara_index_t i = 4;
+	for (; i + 4 <= len; i += 4) {
+		__m256d chunk = _mm256_loadu_pd(values + i);
+		lo = _mm256_min_pd(lo, chunk);
+		hi = _mm256_max_pd(hi, chunk);
+	}
+
+	double lo_lanes[4], hi_lanes[4];
+	_mm256_storeu_pd(lo_lanes, lo);
+	_mm256_storeu_pd(hi_lanes, hi);
+	mara_array_init_range_f64(lo_lanes, 4, min, max);
+	mara_array_range_f64_scalar(hi_lanes, 4, min, max);
+	mara_array_range_f64_scalar(values + i, len - i, min, max);
+}
+
+MARA_ARRAY_AVX2_FN static int32_t
+mara_array_dot_i32_avx2(const int32_t* lhs, const int32_t* rhs, mara_index_t len) {
+	__m256i sum = _mm256_setzero_si256();
+	mara_index_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(
+			_mm256_loadu_si256((const __m256i*)(lhs + i)),
+			_mm256_loadu_si256((const __m256i*)(rhs + i))
+		));
+	}
+	return (int32_t)(
+		(uint32_t)mara_array_hsum_epi32_avx2(sum)
+		+ (uint32_t)mara_array_dot_i32_scalar(lhs + i, rhs + i, len - i)
+	);
+}
+
+MARA_ARRAY_AVX2_FN static double
+mara_array_dot_f64_avx2(const double* lhs, const double* rhs, mara_index_t len) {
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	mara_index_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i)));
+		sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(lhs + i + 4), _mm256_loadu_pd(rhs + i + 4)));
+	}
+	return mara_array_hsum_pd_avx2(_mm256_add_pd(sum0, sum1))
+		+ mara_array_dot_f64_scalar(lhs + i, rhs + i, len - i);
+}
+
+MARA_ARRAY_AVX2_FN static void
+mara_array_add_i32_avx2(int32_t* out, const int32_t* lhs, const int32_t* rhs, mara_index_t len) {
+	mara_index_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_add_epi32(
+			_mm256_loadu_si256((const __m256i*)(lhs + i)),
+			_mm256_loadu_si256((const __m256i*)(rhs + i))
+		));
+	}
+	mara_array_add_i32_scalar(out + i, lhs + i, rhs + i, len - i);
+}
+
+MARA_ARRAY_AVX2_FN static void
+mara_array_add_f64_avx2(double* out, const double* lhs, const double* rhs, mara_index_t len) {
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i)));
+	}
+	mara_array_add_f64_scalar(out + i, lhs + i, rhs + i, len - i);
+}
+
+MARA_ARRAY_AVX2_FN static void
+mara_array_scale_i32_avx2(int32_t* out, const int32_t* values, int32_t factor, mara_index_t len) {
+	__m256i factors = _mm256_set1_epi32(factor);
+	mara_index_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_mullo_epi32(
+			_mm256_loadu_si256((const __m256i*)(values + i)), factors
+		));
+	}
+	mara_array_scale_i32_scalar(out + i, values + i, factor, len - i);
+}
+
+MARA_ARRAY_AVX2_FN static void
+mara_array_scale_f64_avx2(double* out, const double* values, double factor, mara_index_t len) {
+	__m256d factors = _mm256_set1_pd(factor);
+	mara_index_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		_mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(values + i), factors));
+	}
+	mara_array_scale_f64_scalar(out + i, values + i, factor, len - i);
+}
+
+static const mara_array_kernels_t mara_array_avx2_kernels = {
+	.sum_i32 = mara_array_sum_i32_avx2,
+	.sum_f64 = mara_array_sum_f64_avx2,
+	.range_i32 = mara_array_range_i32_avx2,
+	.range_f64 = mara_array_range_f64_avx2,
+	.dot_i32 = mara_array_dot_i32_avx2,
+	.dot_f64 = mara_array_dot_f64_avx2,
+	.add_i32 = mara_array_add_i32_avx2,
+	.add_f64 = mara_array_add_f64_avx2,
+	.scale_i32 = mara_array_scale_i32_avx2,
+	.scale_f64 = mara_array_scale_f64_avx2,
+};
+
+MARA_PRIVATE bool
+mara_array_cpu_has_avx2(void) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	if (!os_saves_ymm || (info[2] & (1 << 28)) == 0) { return false; }
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+const mara_array_kernels_t*
+mara_array_select_kernels(void) {
+#ifdef MARA_ARRAY_AVX2
+	if (mara_array_cpu_has_avx2()) {
+		return &mara_array_avx2_kernels;
+	}
+#endif
+
+#ifdef MARA_ARRAY_SSE2
+	return &mara_array_sse2_kernels;
+#else
+	return &mara_array_scalar_kernels;
+#endif
+}
+
+MARA_PRIVATE size_t
+mara_array_elem_size(mara_array_type_t type) {
+	return type == MARA_ARRAY_I32 ? sizeof(int32_t) : sizeof(double);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_array_check_same_shape(mara_exec_ctx_t* ctx, mara_array_t* lhs, mara_array_t* rhs) {
+	if (lhs->type != rhs->type) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/unexpected-type"),
+			"Expecting arrays of the same type",
+			mara_value_from_int(1)
+		);
+	}
+
+	if (lhs->len != rhs->len) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/length-mismatch"),
+			"Expecting arrays of the same length, got %d and %d",
+			mara_value_from_int(1),
+			lhs->len, rhs->len
+		);
+	}
+
+	return NULL;
+}
+
+mara_array_t*
+mara_new_array(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_array_type_t type, mara_index_t len) {
+	len = mara_max(len, 0);
+	size_t data_size = mara_array_elem_size(type) * (size_t)len;
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_array_t) + data_size);
+	obj->type = MARA_OBJ_TYPE_ARRAY;
+
+	mara_array_t* array = (mara_array_t*)obj->body;
+	array->type = type;
+	array->len = len;
+	memset(array->data, 0, data_size);
+
+	return array;
+}
+
+mara_array_type_t
+mara_array_type(mara_exec_ctx_t* ctx, mara_array_t* array) {
+	(void)ctx;
+	return array->type;
+}
+
+mara_index_t
+mara_array_len(mara_exec_ctx_t* ctx, mara_array_t* array) {
+	(void)ctx;
+	return array->len;
+}
+
+void*
+mara_array_data(mara_exec_ctx_t* ctx, mara_array_t* array) {
+	(void)ctx;
+	return array->data;
+}
+
+mara_value_t
+mara_array_get(mara_exec_ctx_t* ctx, mara_array_t* array, mara_index_t index) {
+	(void)ctx;
+	if (MARA_EXPECT(0 <= index && index < array->len)) {
+		return array->type == MARA_ARRAY_I32
+			? mara_value_from_int(((int32_t*)array->data)[index])
+			: mara_value_from_real(((double*)array->data)[index]);
+	} else {
+		return mara_nil();
+	}
+}
+
+mara_error_t*
+mara_array_set(mara_exec_ctx_t* ctx, mara_array_t* array, mara_index_t index, mara_value_t value) {
+	mara_check_error(mara_check_mutable(ctx, mara_value_from_array(array)));
+	if (MARA_EXPECT(0 <= index && index < array->len)) {
+		if (array->type == MARA_ARRAY_I32) {
+			return mara_value_to_int(ctx, value, &((int32_t*)array->data)[index]);
+		} else {
+			return mara_value_to_real(ctx, value, &((double*)array->data)[index]);
+		}
+	} else {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/index-out-of-range"),
+			"Index %d is out of range for an array of length %d",
+			mara_value_from_int(index),
+			index, array->len
+		);
+	}
+}
+
+mara_error_t*
+mara_array_from_list(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_array_type_t type,
+	mara_list_t* list,
+	mara_array_t** result
+) {
+	mara_array_t* array = mara_new_array(ctx, zone, type, list->len);
+	for (mara_index_t i = 0; i < list->len; ++i) {
+		mara_check_error(mara_array_set(ctx, array, i, list->elems[i]));
+	}
+
+	*result = array;
+	return NULL;
+}
+
+mara_list_t*
+mara_array_to_list(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_array_t* array) {
+	mara_list_t* list = mara_new_list(ctx, zone, array->len);
+	for (mara_index_t i = 0; i < array->len; ++i) {
+		list->elems[i] = mara_array_get(ctx, array, i);
+	}
+	list->len = array->len;
+
+	return list;
+}
+
+mara_value_t
+mara_array_sum(mara_exec_ctx_t* ctx, mara_array_t* array) {
+	const mara_array_kernels_t* kernels = ctx->env->array_kernels;
+	return array->type == MARA_ARRAY_I32
+		? mara_value_from_int(kernels->sum_i32((int32_t*)array->data, array->len))
+		: mara_value_from_real(kernels->sum_f64((double*)array->data, array->len));
+}
+
+mara_value_t
+mara_array_min(mara_exec_ctx_t* ctx, mara_array_t* array) {
+	if (array->len == 0) { return mara_nil(); }
+
+	const mara_array_kernels_t* kernels = ctx->env->array_kernels;
+	if (array->type == MARA_ARRAY_I32) {
+		int32_t min, max;
+		kernels->range_i32((int32_t*)array->data, array->len, &min, &max);
+		return mara_value_from_int(min);
+	} else {
+		double min, max;
+		kernels->range_f64((double*)array->data, array->len, &min, &max);
+		return mara_value_from_real(min);
+	}
+}
+
+mara_value_t
+mara_array_max(mara_exec_ctx_t* ctx, mara_array_t* array) {
+	if (array->len == 0) { return mara_nil(); }
+
+	const mara_array_kernels_t* kernels = ctx->env->array_kernels;
+	if (array->type == MARA_ARRAY_I32) {
+		int32_t min, max;
+		kernels->range_i32((int32_t*)array->data, array->len, &min, &max);
+		return mara_value_from_int(max);
+	} else {
+		double min, max;
+		kernels->range_f64((double*)array->data, array->len, &min, &max);
+		return mara_value_from_real(max);
+	}
+}
+
+mara_error_t*
+mara_array_dot(mara_exec_ctx_t* ctx, mara_array_t* lhs, mara_array_t* rhs, mara_value_t* result) {
+	mara_check_error(mara_array_check_same_shape(ctx, lhs, rhs));
+
+	const mara_array_kernels_t* kernels = ctx->env->array_kernels;
+	*result = lhs->type == MARA_ARRAY_I32
+		? mara_value_from_int(kernels->dot_i32((int32_t*)lhs->data, (int32_t*)rhs->data, lhs->len))
+		: mara_value_from_real(kernels->dot_f64((double*)lhs->data, (double*)rhs->data, lhs->len));
+	return NULL;
+}
+
+mara_error_t*
+mara_array_add(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_array_t* lhs,
+	mara_array_t* rhs,
+	mara_array_t** result
+) {
+	mara_check_error(mara_array_check_same_shape(ctx, lhs, rhs));
+
+	const mara_array_kernels_t* kernels = ctx->env->array_kernels;
+	mara_array_t* sum = mara_new_array(ctx, zone, lhs->type, lhs->len);
+	if (lhs->type == MARA_ARRAY_I32) {
+		kernels->add_i32((int32_t*)sum->data, (int32_t*)lhs->data, (int32_t*)rhs->data, lhs->len);
+	} else {
+		kernels->add_f64((double*)sum->data, (double*)lhs->data, (double*)rhs->data, lhs->len);
+	}
+
+	*result = sum;
+	return NULL;
+}
+
+mara_error_t*
+mara_array_scale(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_array_t* array,
+	mara_value_t factor,
+	mara_array_t** result
+) {
+	const mara_array_kernels_t* kernels = ctx->env->array_kernels;
+	mara_array_t* scaled = mara_new_array(ctx, zone, array->type, array->len);
+	if (array->type == MARA_ARRAY_I32) {
+		mara_index_t int_factor;
+		mara_check_error(mara_value_to_int(ctx, factor, &int_factor));
+		kernels->scale_i32((int32_t*)scaled->data, (int32_t*)array->data, int_factor, array->len);
+	} else {
+		mara_real_t real_factor;
+		mara_check_error(mara_value_to_real(ctx, factor, &real_factor));
+		kernels->scale_f64((double*)scaled->data, (double*)array->data, real_factor, array->len);
+	}
+
+	*result = scaled;
+	return NULL;
+}
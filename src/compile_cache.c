@@ -0,0 +1,183 @@
+#include "internal.h"
+#include "xxhash.h"
+
+#define MARA_COMPILE_CACHE_WAYS 4
+
+struct mara_compile_cache_entry_s {
+	XXH128_hash_t key;
+	uint64_t last_used;
+	mara_vm_function_t* function;
+};
+
+MARA_PRIVATE XXH128_hash_t
+mara_compile_cache_key(
+	mara_parse_options_t parse_options,
+	mara_compile_options_t compile_options,
+	mara_str_t source
+) {
+	// Everything that can change the compiled code goes into the seed
+	uint8_t flags[] = {
+		parse_options.parse_one,
+		compile_options.standalone,
+		compile_options.skip_prelude,
+		compile_options.strip_debug_info,
+	};
+	XXH64_hash_t seed = mara_XXH3_64bits_withSeed(
+		parse_options.filename.data, parse_options.filename.len,
+		mara_XXH3_64bits(flags, sizeof(flags))
+	);
+	return mara_XXH3_128bits_withSeed(source.data, source.len, seed);
+}
+
+MARA_PRIVATE mara_compile_cache_entry_t*
+mara_compile_cache_set(mara_env_t* env, XXH128_hash_t key) {
+	if (env->compile_cache == NULL) {
+		size_t size = sizeof(mara_compile_cache_entry_t) * env->compile_cache_num_sets * MARA_COMPILE_CACHE_WAYS;
+		env->compile_cache = mara_malloc(env->options.allocator, size);
+		mara_assert(env->compile_cache != NULL, "Out of memory");
+		memset(env->compile_cache, 0, size);
+	}
+
+	return env->compile_cache + (key.low64 % env->compile_cache_num_sets) * MARA_COMPILE_CACHE_WAYS;
+}
+
+void
+mara_compile_cache_init(mara_env_t* env) {
+	mara_index_t size = env->options.compile_cache_size;
+	env->compile_cache_num_sets = size > 0
+		? (size + MARA_COMPILE_CACHE_WAYS - 1) / MARA_COMPILE_CACHE_WAYS
+		: 0;
+}
+
+void
+mara_compile_cache_clear(mara_env_t* env) {
+	if (env->compile_cache != NULL) {
+		memset(
+			env->compile_cache, 0,
+			sizeof(mara_compile_cache_entry_t) * env->compile_cache_num_sets * MARA_COMPILE_CACHE_WAYS
+		);
+	}
+}
+
+void
+mara_compile_cache_cleanup(mara_env_t* env) {
+	mara_free(env->options.allocator, env->compile_cache);
+	env->compile_cache = NULL;
+}
+
+MARA_PRIVATE mara_vm_function_t*
+mara_compile_cache_get(mara_env_t* env, XXH128_hash_t key) {
+	mara_compile_cache_entry_t* set = mara_compile_cache_set(env, key);
+	env->compile_cache_clock += 1;
+
+	for (mara_index_t i = 0; i < MARA_COMPILE_CACHE_WAYS; ++i) {
+		mara_compile_cache_entry_t* entry = &set[i];
+		if (entry->function != NULL && mara_XXH128_isEqual(entry->key, key)) {
+			entry->last_used = env->compile_cache_clock;
+			return entry->function;
+		}
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE void
+mara_compile_cache_put(mara_env_t* env, XXH128_hash_t key, mara_vm_function_t* function) {
+	mara_compile_cache_entry_t* set = mara_compile_cache_set(env, key);
+	env->compile_cache_clock += 1;
+
+	// Evict the least recently used entry
+	mara_compile_cache_entry_t* victim = &set[0];
+	for (mara_index_t i = 1; i < MARA_COMPILE_CACHE_WAYS; ++i) {
+		if (set[i].last_used < victim->last_used) {
+			victim = &set[i];
+		}
+	}
+
+	*victim = (mara_compile_cache_entry_t){
+		.key = key,
+		.last_used = env->compile_cache_clock,
+		.function = function,
+	};
+}
+
+MARA_PRIVATE mara_fn_t*
+mara_compile_cache_new_closure(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_vm_function_t* function
+) {
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_fn_t));
+	obj->type = MARA_OBJ_TYPE_VM_FN;
+	mara_fn_t* closure = (mara_fn_t*)obj->body;
+	closure->prototype.vm = function;
+	return closure;
+}
+
+mara_error_t*
+mara_compile_str(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_parse_options_t parse_options,
+	mara_compile_options_t compile_options,
+	mara_str_t source,
+	mara_fn_t** result
+) {
+	mara_env_t* env = ctx->env;
+	bool use_cache = env->compile_cache_num_sets > 0;
+	XXH128_hash_t key = { 0 };
+
+	// The lock is not held while compiling so two threads may compile the
+	// same source, the last one wins
+	if (use_cache) {
+		key = mara_compile_cache_key(parse_options, compile_options, source);
+		mara_mutex_lock(&env->lock);
+		mara_vm_function_t* function = mara_compile_cache_get(env, key);
+		mara_mutex_unlock(&env->lock);
+
+		if (function != NULL) {
+			*result = mara_compile_cache_new_closure(ctx, zone, function);
+			return NULL;
+		}
+	}
+
+	mara_zone_t* local_zone = mara_zone_enter(ctx);
+	if (local_zone == NULL) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/stack-overflow"),
+			"Too many stack frames",
+			mara_nil()
+		);
+	}
+
+	mara_str_reader_t str_reader;
+	mara_list_t* exprs;
+	mara_error_t* error = mara_parse(
+		ctx, local_zone,
+		parse_options,
+		mara_init_str_reader(&str_reader, source),
+		&exprs
+	);
+	if (error != NULL) { goto end; }
+
+	if (!use_cache) {
+		error = mara_compile(ctx, zone, compile_options, exprs, result);
+		goto end;
+	}
+
+	// Cached code must outlive every context
+	mara_fn_t* fn;
+	error = mara_compile(ctx, &env->permanent_zone, compile_options, exprs, &fn);
+	if (error != NULL) { goto end; }
+
+	mara_mutex_lock(&env->lock);
+	mara_compile_cache_put(env, key, fn->prototype.vm);
+	mara_mutex_unlock(&env->lock);
+
+	*result = mara_compile_cache_new_closure(ctx, zone, fn->prototype.vm);
+
+end:
+	mara_zone_exit(ctx, local_zone);
+	return error;
+}
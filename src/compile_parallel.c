@@ -0,0 +1,244 @@
+#include "internal.h"
+
+// Each worker compiles into a private env and hands back a code image.
+// Private envs keep workers from contending on the shared env's locks.
+// Publishing loads the images into the shared env on the calling thread.
+
+typedef struct {
+	mara_allocator_t allocator;
+	char* data;
+	mara_index_t len;
+	mara_index_t capacity;
+	// When set, data holds a (type message extra) list instead of code
+	bool failed;
+} mara_compile_output_t;
+
+typedef struct {
+	mara_env_options_t env_options;
+	mara_index_t first_job;
+	mara_index_t job_stride;
+	mara_index_t num_jobs;
+	const mara_compile_job_t* jobs;
+	mara_compile_output_t* outputs;
+	mara_thread_t thread;
+} mara_compile_worker_t;
+
+MARA_PRIVATE mara_index_t
+mara_compile_output_write(const void* buffer, mara_index_t size, void* userdata) {
+	mara_compile_output_t* output = userdata;
+	if (output->len + size > output->capacity) {
+		mara_index_t new_capacity = output->capacity > 0 ? output->capacity : 4096;
+		while (new_capacity < output->len + size) {
+			new_capacity *= 2;
+		}
+
+		char* new_data = mara_realloc(output->allocator, output->data, new_capacity);
+		if (new_data == NULL) { return 0; }
+
+		output->data = new_data;
+		output->capacity = new_capacity;
+	}
+
+	memcpy(output->data + output->len, buffer, size);
+	output->len += size;
+	return size;
+}
+
+MARA_PRIVATE void
+mara_compile_output_error(
+	mara_exec_ctx_t* ctx,
+	mara_compile_output_t* output,
+	mara_error_t* error
+) {
+	mara_writer_t writer = {
+		.fn = mara_compile_output_write,
+		.userdata = output,
+	};
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// Dumping may overwrite the error so it is copied out first
+	mara_list_t* info = mara_new_list(ctx, zone, 3);
+	mara_list_push(ctx, info, mara_new_str(ctx, zone, error->type));
+	mara_list_push(ctx, info, mara_new_str(ctx, zone, error->message));
+	mara_list_push(ctx, info, error->extra);
+
+	output->failed = true;
+	output->len = 0;
+	mara_value_t ignored;
+	if (mara_dump(ctx, mara_value_from_list(info), writer, &ignored) != NULL) {
+		// The extra value may not be serializable
+		output->len = 0;
+		mara_list_set(ctx, info, 2, mara_nil());
+		if (mara_dump(ctx, mara_value_from_list(info), writer, &ignored) != NULL) {
+			output->len = 0;
+		}
+	}
+}
+
+MARA_PRIVATE void
+mara_compile_worker(void* userdata) {
+	mara_compile_worker_t* worker = userdata;
+	mara_env_t* env = mara_create_env(worker->env_options);
+
+	for (
+		mara_index_t i = worker->first_job;
+		i < worker->num_jobs;
+		i += worker->job_stride
+	) {
+		const mara_compile_job_t* job = &worker->jobs[i];
+		mara_compile_output_t* output = &worker->outputs[i];
+		mara_writer_t writer = {
+			.fn = mara_compile_output_write,
+			.userdata = output,
+		};
+
+		mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+
+		mara_fn_t* fn;
+		mara_value_t ignored;
+		mara_error_t* error = mara_compile_str(
+			ctx, mara_get_local_zone(ctx),
+			job->parse_options, job->compile_options,
+			job->source,
+			&fn
+		);
+		if (error == NULL) {
+			error = mara_dump(ctx, mara_value_from_fn(fn), writer, &ignored);
+		}
+		if (error != NULL) {
+			mara_compile_output_error(ctx, output, error);
+		}
+
+		mara_end(ctx);
+	}
+
+	mara_destroy_env(env);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_compile_publish_error(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* local_zone,
+	mara_compile_output_t* output
+) {
+	mara_str_reader_t reader;
+	mara_value_t value;
+	mara_list_t* info;
+	mara_str_t type, message;
+	mara_small_str_buf_t type_buf, message_buf;
+	if (
+		mara_load(
+			ctx, local_zone,
+			mara_init_str_reader(&reader, (mara_str_t){ .len = output->len, .data = output->data }),
+			&value
+		) != NULL
+		|| mara_value_to_list(ctx, value, &info) != NULL
+		|| mara_list_len(ctx, info) != 3
+		|| mara_value_to_str_buf(ctx, mara_list_get(ctx, info, 0), &type_buf, &type) != NULL
+		|| mara_value_to_str_buf(ctx, mara_list_get(ctx, info, 1), &message_buf, &message) != NULL
+	) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/compile-error"),
+			"Compilation failed on a worker thread",
+			mara_nil()
+		);
+	}
+
+	return mara_errorf(
+		ctx,
+		type,
+		"%.*s",
+		mara_list_get(ctx, info, 2),
+		message.len, message.data
+	);
+}
+
+mara_error_t*
+mara_compile_parallel(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t num_threads,
+	mara_index_t num_jobs,
+	const mara_compile_job_t* jobs,
+	mara_fn_t** results
+) {
+	mara_env_t* env = ctx->env;
+	num_threads = mara_max(1, mara_min(num_threads, num_jobs));
+
+	mara_zone_t* local_zone = mara_zone_enter(ctx);
+	if (local_zone == NULL) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/stack-overflow"),
+			"Too many stack frames",
+			mara_nil()
+		);
+	}
+
+	mara_compile_output_t* outputs = mara_zone_alloc_ex(
+		ctx, local_zone,
+		sizeof(mara_compile_output_t) * num_jobs, _Alignof(mara_compile_output_t)
+	);
+	for (mara_index_t i = 0; i < num_jobs; ++i) {
+		outputs[i] = (mara_compile_output_t){ .allocator = env->options.allocator };
+	}
+
+	// Workers share nothing but the allocator so they do not need a cache
+	mara_env_options_t worker_env_options = env->options;
+	worker_env_options.compile_cache_size = 0;
+	mara_compile_worker_t* workers = mara_zone_alloc_ex(
+		ctx, local_zone,
+		sizeof(mara_compile_worker_t) * num_threads, _Alignof(mara_compile_worker_t)
+	);
+	for (mara_index_t i = 0; i < num_threads; ++i) {
+		workers[i] = (mara_compile_worker_t){
+			.env_options = worker_env_options,
+			.first_job = i,
+			.job_stride = num_threads,
+			.num_jobs = num_jobs,
+			.jobs = jobs,
+			.outputs = outputs,
+		};
+	}
+
+	// The calling thread takes the first share instead of idling
+	bool* started = mara_zone_alloc(ctx, local_zone, sizeof(bool) * num_threads);
+	for (mara_index_t i = 1; i < num_threads; ++i) {
+		started[i] = mara_thread_start(&workers[i].thread, mara_compile_worker, &workers[i]);
+	}
+	mara_compile_worker(&workers[0]);
+	for (mara_index_t i = 1; i < num_threads; ++i) {
+		if (started[i]) {
+			mara_thread_join(&workers[i].thread);
+		} else {
+			mara_compile_worker(&workers[i]);
+		}
+	}
+
+	mara_error_t* error = NULL;
+	for (mara_index_t i = 0; i < num_jobs; ++i) {
+		mara_compile_output_t* output = &outputs[i];
+		if (output->failed) {
+			error = mara_compile_publish_error(ctx, local_zone, output);
+			break;
+		}
+
+		// Code is loaded in place so the image must outlive every context
+		void* image = mara_permanent_alloc(ctx, output->len, MARA_IMAGE_ALIGNMENT);
+		memcpy(image, output->data, output->len);
+
+		mara_value_t fn;
+		error = mara_load_from_buffer(ctx, zone, image, output->len, &fn);
+		if (error != NULL) { break; }
+		error = mara_value_to_fn(ctx, fn, &results[i]);
+		if (error != NULL) { break; }
+	}
+
+	for (mara_index_t i = 0; i < num_jobs; ++i) {
+		mara_free(env->options.allocator, outputs[i].data);
+	}
+
+	mara_zone_exit(ctx, local_zone);
+	return error;
+}
@@ -18,6 +18,8 @@ mara_barray_realloc(mara_env_t* env, void* ptr, size_t size);
 #define MARA_MAX_LABELS UINT16_MAX
 #define MARA_MAX_FUNCTIONS UINT8_MAX
 #define MARA_MAX_INSTRUCTIONS (mara_index_t)INT16_MAX
+#define MARA_MAX_RECORD_FIELDS UINT8_MAX
+#define MARA_MAX_RECORD_TYPES UINT16_MAX
 
 typedef struct mara_compile_ctx_s mara_compile_ctx_t;
 
@@ -51,10 +53,19 @@ typedef struct mara_function_scope_s {
 	mara_map_t* constants;
 	barray(mara_vm_function_t*) functions;
 	mara_index_t num_labels;
+	mara_index_t num_inline_caches;
+	barray(const mara_record_type_t*) record_types;
 
 	barray(mara_tagged_instruction_t) instructions;
 } mara_function_scope_t;
 
+// What a name introduced by defrecord refers to
+typedef struct {
+	const mara_record_type_t* type;
+	// -1 for the constructor
+	mara_index_t field;
+} mara_record_op_t;
+
 typedef struct mara_builtin_node_s {
 	mara_value_t key;
 	struct mara_builtin_node_s* children[BHAMT_NUM_CHILDREN];
@@ -66,17 +77,9 @@ typedef struct {
 	mara_builtin_node_t* root;
 } mara_builtin_map_t;
 
-struct mara_compile_ctx_s {
-	mara_exec_ctx_t* exec_ctx;
-	mara_zone_t* zone;
-	mara_compile_options_t options;
-
-	mara_function_scope_t* function_scope;
-	mara_debug_info_key_t debug_key;
-
-	// Temporary list to store captures during compilation
-	barray(mara_value_t) captures;
-
+// Shared by all compilations in an env.
+// It is created once in the permanent zone and never modified afterward.
+struct mara_compiler_s {
 	mara_builtin_map_t builtins;
 
 	// Core symbols
@@ -93,6 +96,24 @@ struct mara_compile_ctx_s {
 	mara_value_t sym_gte;
 };
 
+struct mara_compile_ctx_s {
+	mara_exec_ctx_t* exec_ctx;
+	mara_zone_t* zone;
+	mara_compile_options_t options;
+	mara_compiler_t* compiler;
+
+	mara_function_scope_t* function_scope;
+	mara_debug_info_key_t debug_key;
+
+	// Temporary list to store captures during compilation
+	barray(mara_value_t) captures;
+
+	// Names introduced by defrecord are visible until the end of the
+	// compilation unit
+	mara_map_t* record_names;
+	barray(mara_record_op_t) record_ops;
+};
+
 typedef enum {
 	MARA_NAME_NOT_FOUND,
 	MARA_NAME_LOCAL,
@@ -100,6 +121,7 @@ typedef enum {
 	MARA_NAME_CAPTURE,
 	MARA_NAME_NEW_CAPTURE,
 	MARA_NAME_BUILTIN,
+	MARA_NAME_RECORD_OP,
 } mara_name_type_t;
 
 typedef struct {
@@ -112,12 +134,11 @@ typedef struct {
 
 MARA_PRIVATE void
 mara_compiler_add_builtin(
-	mara_compile_ctx_t* ctx,
+	mara_exec_ctx_t* exec_ctx,
+	mara_compiler_t* compiler,
 	mara_str_t name,
 	mara_builtin_compile_fn_t fn
 ) {
-	mara_exec_ctx_t* exec_ctx = ctx->exec_ctx;
-
 	mara_builtin_node_t** itr;
 	mara_builtin_node_t* free_node;
 	mara_builtin_node_t* node;
@@ -125,12 +146,12 @@ mara_compiler_add_builtin(
 
 	mara_value_t symbol = mara_new_sym(exec_ctx, name);
 	BHAMT_HASH_TYPE hash = mara_XXH3_64bits(&symbol, sizeof(symbol));
-	BHAMT_SEARCH(ctx->builtins.root, itr, node, free_node, hash, symbol);
+	BHAMT_SEARCH(compiler->builtins.root, itr, node, free_node, hash, symbol);
 
 	if (node == NULL) {
 		node = *itr = MARA_ZONE_ALLOC_TYPE(
 			exec_ctx,
-			mara_get_local_zone(exec_ctx),
+			&exec_ctx->env->permanent_zone,
 			mara_builtin_node_t
 		);
 		memset(node->children, 0, sizeof(node->children));
@@ -143,7 +164,7 @@ MARA_PRIVATE mara_builtin_compile_fn_t
 mara_compiler_find_builtin(mara_compile_ctx_t* ctx, mara_value_t name) {
 	mara_builtin_node_t* node;
 	BHAMT_HASH_TYPE hash = mara_XXH3_64bits(&name, sizeof(name));
-	BHAMT_GET(ctx->builtins.root, node, hash, name);
+	BHAMT_GET(ctx->compiler->builtins.root, node, hash, name);
 
 	return node != NULL ? node->fn : NULL;
 }
@@ -226,7 +247,8 @@ mara_compiler_add_argument(mara_compile_ctx_t* ctx, mara_value_t name) {
 		);
 	} else if (!mara_value_is_nil(existing_index)) {
 		mara_str_t name_str;
-		mara_assert_no_error(mara_value_to_str(ctx->exec_ctx, name, &name_str));
+		mara_small_str_buf_t name_str_buf;
+		mara_assert_no_error(mara_value_to_str_buf(ctx->exec_ctx, name, &name_str_buf, &name_str));
 		return mara_compiler_error(
 			ctx,
 			mara_str_from_literal("core/syntax-error/duplicated-names"),
@@ -280,7 +302,8 @@ mara_compiler_add_local(mara_compile_ctx_t* ctx, mara_value_t name, mara_index_t
 
 	if (!mara_value_is_nil(existing_index)) {
 		mara_str_t name_str;
-		mara_assert_no_error(mara_value_to_str(ctx->exec_ctx, name, &name_str));
+		mara_small_str_buf_t name_str_buf;
+		mara_assert_no_error(mara_value_to_str_buf(ctx->exec_ctx, name, &name_str_buf, &name_str));
 		return mara_compiler_error(
 			ctx,
 			mara_str_from_literal("core/syntax-error/duplicated-names"),
@@ -327,6 +350,7 @@ mara_compiler_cleanup_function_scope(mara_env_t* env, void* userdata) {
 	mara_function_scope_t* fn_scope = userdata;
 	barray_free(env, fn_scope->functions);
 	barray_free(env, fn_scope->instructions);
+	barray_free(env, fn_scope->record_types);
 }
 
 MARA_PRIVATE void
@@ -353,6 +377,29 @@ mara_compiler_begin_function(mara_compile_ctx_t* ctx) {
 	mara_compiler_begin_local_scope(ctx);
 }
 
+MARA_PRIVATE bool
+mara_compiler_flows_to_return(
+	const mara_tagged_instruction_t* instructions,
+	mara_index_t num_instructions,
+	mara_index_t pc
+) {
+	// Bounded so that a jump cycle cannot loop forever
+	for (mara_index_t i = 0; i < num_instructions; ++i) {
+		if (pc < 0 || pc >= num_instructions) { return false; }
+
+		mara_opcode_t opcode;
+		mara_operand_t operands;
+		mara_decode_instruction(instructions[pc].instruction, &opcode, &operands);
+		if (opcode == MARA_OP_JUMP) {
+			pc = pc + 1 + (int16_t)(operands & 0xffff);
+		} else {
+			return opcode == MARA_OP_RETURN;
+		}
+	}
+
+	return false;
+}
+
 MARA_PRIVATE mara_vm_function_t*
 mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 	mara_compiler_end_local_scope(ctx);
@@ -482,6 +529,36 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 		}
 	}
 
+	// Aggregates which are returned right away are built in the return zone
+	for (mara_index_t i = 0; i < num_instructions; ++i) {
+		mara_opcode_t opcode;
+		mara_operand_t operands;
+		mara_tagged_instruction_t tagged_instruction = fn_scope->instructions[i];
+		mara_decode_instruction(tagged_instruction.instruction, &opcode, &operands);
+
+		mara_index_t next;
+		mara_opcode_t return_opcode;
+		if (opcode == MARA_OP_MAKE_LIST) {
+			next = i + 1;
+			return_opcode = MARA_OP_MAKE_RETURN_LIST;
+		} else if (opcode == MARA_OP_MAKE_RECORD) {
+			next = i + 1;
+			return_opcode = MARA_OP_MAKE_RETURN_RECORD;
+		} else if (opcode == MARA_OP_MAKE_CLOSURE) {
+			// Skip the capture pseudo instructions
+			next = i + 1 + (uint16_t)(operands & 0xffff);
+			return_opcode = MARA_OP_MAKE_RETURN_CLOSURE;
+		} else {
+			continue;
+		}
+
+		if (mara_compiler_flows_to_return(fn_scope->instructions, num_instructions, next)) {
+			fn_scope->instructions[i].instruction = mara_encode_instruction(
+				return_opcode, operands
+			);
+		}
+	}
+
 	// Split tagged instructions into 2 arrays
 	mara_instruction_t* instructions = mara_zone_alloc_ex(
 		exec_ctx, permanent_zone,
@@ -494,6 +571,8 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 			sizeof(mara_source_info_t) * num_instructions, _Alignof(mara_source_info_t)
 		);
 	}
+	// The string pool is shared by every context
+	if (source_info != NULL) { mara_mutex_lock(&env->lock); }
 	for (mara_index_t i = 0; i < num_instructions; ++i) {
 		mara_tagged_instruction_t tagged_instruction = fn_scope->instructions[i];
 		instructions[i] = tagged_instruction.instruction;
@@ -505,6 +584,7 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 			);
 		}
 	}
+	if (source_info != NULL) { mara_mutex_unlock(&env->lock); }
 
 	// Constant pool
 	mara_index_t num_constants;
@@ -518,10 +598,12 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 			sizeof(mara_value_t) * num_constants, _Alignof(mara_value_t)
 		);
 
-		for (mara_map_node_t* itr = constant_pool->root; itr != NULL; itr = itr->next) {
+		mara_map_itr_t itr = { .map = constant_pool };
+		mara_value_t constant, index;
+		while (mara_map_itr_next(&itr, &constant, &index)) {
 			mara_index_t constant_index;
-			mara_assert_no_error(mara_value_to_int(exec_ctx, itr->value, &constant_index));
-			constants[constant_index] = mara_copy(exec_ctx, permanent_zone, itr->key);
+			mara_assert_no_error(mara_value_to_int(exec_ctx, index, &constant_index));
+			constants[constant_index] = mara_copy(exec_ctx, permanent_zone, constant);
 		}
 	}
 
@@ -535,6 +617,24 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 		memcpy(functions, fn_scope->functions, sizeof(mara_vm_function_t*) * num_functions);
 	}
 
+	mara_index_t num_inline_caches = fn_scope->num_inline_caches;
+	mara_inline_cache_t* inline_caches = mara_zone_alloc_ex(
+		exec_ctx, target_zone,
+		sizeof(mara_inline_cache_t) * num_inline_caches, _Alignof(mara_inline_cache_t)
+	);
+	if (num_inline_caches > 0) {
+		memset(inline_caches, 0, sizeof(mara_inline_cache_t) * num_inline_caches);
+	}
+
+	mara_index_t num_record_types = (mara_index_t)barray_len(fn_scope->record_types);
+	const mara_record_type_t** record_types = mara_zone_alloc_ex(
+		exec_ctx, target_zone,
+		sizeof(mara_record_type_t*) * num_record_types, _Alignof(mara_record_type_t*)
+	);
+	if (num_record_types > 0) {
+		memcpy(record_types, fn_scope->record_types, sizeof(mara_record_type_t*) * num_record_types);
+	}
+
 	// Build the final function
 	mara_vm_function_t* function = MARA_ZONE_ALLOC_TYPE(
 		exec_ctx, target_zone, mara_vm_function_t
@@ -549,6 +649,10 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 		.constants = constants,
 		.num_functions = num_functions,
 		.functions = functions,
+		.num_inline_caches = num_inline_caches,
+		.inline_caches = inline_caches,
+		.num_record_types = num_record_types,
+		.record_types = record_types,
 	};
 	function->num_args = fn_scope->args->len;
 	function->num_captures = fn_scope->captures->len;
@@ -556,7 +660,13 @@ mara_compiler_end_function(mara_compile_ctx_t* ctx) {
 		ctx->exec_ctx, ctx->debug_key
 	);
 	if (debug_info != NULL) {
-		function->filename = debug_info->filename;
+		// Debug info is per context but the function may outlive it
+		mara_mutex_lock(&env->lock);
+		function->filename = mara_strpool_intern(
+			env, &env->permanent_zone.arena,
+			&env->permanent_strpool, debug_info->filename
+		);
+		mara_mutex_unlock(&env->lock);
 	}
 
 	ctx->function_scope = fn_scope->parent;
@@ -664,6 +774,17 @@ mara_compiler_find_name(mara_compile_ctx_t* ctx, mara_value_t name) {
 		local_fn_scope = false;
 	}
 
+	if (ctx->record_names != NULL) {
+		search_result = mara_map_get(exec_ctx, ctx->record_names, name);
+		if (!mara_value_is_nil(search_result)) {
+			mara_assert_no_error(mara_value_to_int(exec_ctx, search_result, &index));
+			return (mara_name_t){
+				.type = MARA_NAME_RECORD_OP,
+				.index = index,
+			};
+		}
+	}
+
 	mara_builtin_compile_fn_t builtin = mara_compiler_find_builtin(ctx, name);
 
 	return builtin != NULL
@@ -697,10 +818,24 @@ mara_compiler_find_var(
 			*load_opcode_out = MARA_OP_GET_CAPTURE;
 			mara_check_error(mara_compiler_add_capture(ctx, var_name, index_out));
 			return NULL;
+		case MARA_NAME_RECORD_OP:
+			{
+				mara_str_t name_str;
+				mara_small_str_buf_t name_str_buf;
+				mara_assert_no_error(mara_value_to_str_buf(ctx->exec_ctx, var_name, &name_str_buf, &name_str));
+				return mara_compiler_error(
+					ctx,
+					mara_str_from_literal("core/syntax-error"),
+					"Record operation '%.*s' can only be called directly",
+					var_name,
+					name_str.len, name_str.data
+				);
+			}
 		default:
 			{
 				mara_str_t name_str;
-				mara_assert_no_error(mara_value_to_str(ctx->exec_ctx, var_name, &name_str));
+				mara_small_str_buf_t name_str_buf;
+				mara_assert_no_error(mara_value_to_str_buf(ctx->exec_ctx, var_name, &name_str_buf, &name_str));
 				return mara_compiler_error(
 					ctx,
 					mara_str_from_literal("core/name-error"),
@@ -781,13 +916,13 @@ mara_compile_bin_ops(mara_compile_ctx_t* ctx, mara_list_t* list) {
 
 	mara_compiler_set_debug_info(ctx, list, MARA_DEBUG_INFO_SELF);
 	mara_value_t first_elem = list->elems[0];
-	if (first_elem.internal == ctx->sym_lt.internal) {
+	if (first_elem.internal == ctx->compiler->sym_lt.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_LT, 0, -1);
-	} else if (first_elem.internal == ctx->sym_lte.internal) {
+	} else if (first_elem.internal == ctx->compiler->sym_lte.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_LTE, 0, -1);
-	} else if (first_elem.internal == ctx->sym_gt.internal) {
+	} else if (first_elem.internal == ctx->compiler->sym_gt.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_GT, 0, -1);
-	} else if (first_elem.internal == ctx->sym_gte.internal) {
+	} else if (first_elem.internal == ctx->compiler->sym_gte.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_GTE, 0, -1);
 	}
 
@@ -863,6 +998,18 @@ mara_compile_list(mara_compile_ctx_t* ctx, mara_list_t* list) {
 	return mara_compiler_emit(ctx, MARA_OP_MAKE_LIST, list_len - 1, -(list_len - 2));
 }
 
+// Operands of GET and PUT: the inline cache index and the arity
+MARA_PRIVATE mara_operand_t
+mara_compiler_alloc_inline_cache(mara_compile_ctx_t* ctx, mara_index_t arity) {
+	mara_function_scope_t* fn_scope = ctx->function_scope;
+	mara_operand_t cache_index = MARA_NO_INLINE_CACHE;
+	if (fn_scope->num_inline_caches < MARA_NO_INLINE_CACHE) {
+		cache_index = (mara_operand_t)fn_scope->num_inline_caches++;
+	}
+
+	return (cache_index << 8) | ((mara_operand_t)arity & 0xff);
+}
+
 MARA_PRIVATE mara_error_t*
 mara_compile_put(mara_compile_ctx_t* ctx, mara_list_t* list) {
 	mara_index_t list_len = list->len;
@@ -873,7 +1020,11 @@ mara_compile_put(mara_compile_ctx_t* ctx, mara_list_t* list) {
 	}
 
 	mara_compiler_set_debug_info(ctx, list, MARA_DEBUG_INFO_SELF);
-	return mara_compiler_emit(ctx, MARA_OP_PUT, list_len - 1, -(list_len - 2));
+	return mara_compiler_emit(
+		ctx, MARA_OP_PUT,
+		mara_compiler_alloc_inline_cache(ctx, list_len - 1),
+		-(list_len - 2)
+	);
 }
 
 MARA_PRIVATE mara_error_t*
@@ -886,7 +1037,11 @@ mara_compile_get(mara_compile_ctx_t* ctx, mara_list_t* list) {
 	}
 
 	mara_compiler_set_debug_info(ctx, list, MARA_DEBUG_INFO_SELF);
-	return mara_compiler_emit(ctx, MARA_OP_GET, list_len - 1, -(list_len - 2));
+	return mara_compiler_emit(
+		ctx, MARA_OP_GET,
+		mara_compiler_alloc_inline_cache(ctx, list_len - 1),
+		-(list_len - 2)
+	);
 }
 
 MARA_PRIVATE mara_error_t*
@@ -1052,14 +1207,12 @@ mara_compile_fn(mara_compile_ctx_t* ctx, mara_list_t* list) {
 	mara_map_t* captures = ctx->function_scope->captures;
 	mara_index_t num_captures = captures->len;
 	barray_resize(ctx->exec_ctx->env, ctx->captures, num_captures);
-	for (
-		mara_map_node_t* itr = captures->root;
-		itr != NULL;
-		itr = itr->next
-	) {
+	mara_map_itr_t itr = { .map = captures };
+	mara_value_t capture_name, capture_index;
+	while (mara_map_itr_next(&itr, &capture_name, &capture_index)) {
 		mara_index_t index;
-		mara_assert_no_error(mara_value_to_int(exec_ctx, itr->value, &index));
-		ctx->captures[index] = itr->key;
+		mara_assert_no_error(mara_value_to_int(exec_ctx, capture_index, &index));
+		ctx->captures[index] = capture_name;
 	}
 
 	// Finish the sub function and emit closure
@@ -1104,6 +1257,175 @@ mara_compile_do(mara_compile_ctx_t* ctx, mara_list_t* list) {
 	return error;
 }
 
+MARA_PRIVATE mara_error_t*
+mara_compiler_add_record_name(
+	mara_compile_ctx_t* ctx,
+	mara_str_t record_name,
+	mara_str_t op_name,
+	mara_record_op_t op
+) {
+	mara_exec_ctx_t* exec_ctx = ctx->exec_ctx;
+	mara_value_t name_str = mara_new_strf(
+		exec_ctx, mara_get_local_zone(exec_ctx),
+		"%.*s/%.*s", record_name.len, record_name.data, op_name.len, op_name.data
+	);
+	mara_str_t str;
+	mara_small_str_buf_t str_buf;
+	mara_assert_no_error(mara_value_to_str_buf(exec_ctx, name_str, &str_buf, &str));
+	mara_value_t name = mara_new_sym(exec_ctx, str);
+
+	mara_index_t index = (mara_index_t)barray_len(ctx->record_ops);
+	barray_push(exec_ctx->env, ctx->record_ops, op);
+	mara_map_set(exec_ctx, ctx->record_names, name, mara_value_from_int(index));
+	return NULL;
+}
+
+// (defrecord name field...) introduces name/new which takes every field in
+// order, and name/field which reads a field or writes it when given a value.
+// Slots are resolved here so the VM only checks the record type.
+MARA_PRIVATE mara_error_t*
+mara_compile_defrecord(mara_compile_ctx_t* ctx, mara_list_t* list) {
+	mara_exec_ctx_t* exec_ctx = ctx->exec_ctx;
+	mara_index_t list_len = list->len;
+	if (list_len < 2 || !mara_value_is_sym(list->elems[1])) {
+		return mara_compiler_error(
+			ctx,
+			mara_str_from_literal("core/syntax-error/defrecord"),
+			"defrecord requires a name",
+			mara_nil()
+		);
+	}
+
+	mara_index_t num_fields = list_len - 2;
+	if (num_fields > MARA_MAX_RECORD_FIELDS) {
+		return mara_compiler_error(
+			ctx,
+			mara_str_from_literal("core/limit-reached/max-record-fields"),
+			"Record has too many fields",
+			mara_nil()
+		);
+	}
+
+	mara_value_t* fields = list->elems + 2;
+	for (mara_index_t i = 0; i < num_fields; ++i) {
+		mara_compiler_set_debug_info(ctx, list, i + 2);
+		if (!mara_value_is_sym(fields[i])) {
+			return mara_compiler_error(
+				ctx,
+				mara_str_from_literal("core/syntax-error/defrecord"),
+				"Record field name must be a symbol",
+				mara_nil()
+			);
+		}
+
+		mara_str_t field_name;
+		mara_small_str_buf_t field_name_buf;
+		mara_assert_no_error(mara_value_to_str_buf(exec_ctx, fields[i], &field_name_buf, &field_name));
+		bool is_duplicated = mara_str_equal(field_name, mara_str_from_literal("new"));
+		for (mara_index_t j = 0; j < i; ++j) {
+			is_duplicated |= fields[j].internal == fields[i].internal;
+		}
+		if (is_duplicated) {
+			return mara_compiler_error(
+				ctx,
+				mara_str_from_literal("core/syntax-error/duplicated-names"),
+				"Field `%.*s` is declared twice in the same record",
+				fields[i],
+				field_name.len, field_name.data
+			);
+		}
+	}
+
+	mara_value_t name = list->elems[1];
+	const mara_record_type_t* type = mara_intern_record_type(exec_ctx, name, num_fields, fields);
+
+	if (ctx->record_names == NULL) {
+		ctx->record_names = mara_new_map(exec_ctx, mara_get_local_zone(exec_ctx));
+	}
+	mara_str_t name_str;
+	mara_small_str_buf_t name_str_buf;
+	mara_assert_no_error(mara_value_to_str_buf(exec_ctx, name, &name_str_buf, &name_str));
+	mara_check_error(mara_compiler_add_record_name(
+		ctx, name_str, mara_str_from_literal("new"),
+		(mara_record_op_t){ .type = type, .field = -1 }
+	));
+	for (mara_index_t i = 0; i < num_fields; ++i) {
+		mara_str_t field_name;
+		mara_small_str_buf_t field_name_buf;
+		mara_assert_no_error(mara_value_to_str_buf(exec_ctx, fields[i], &field_name_buf, &field_name));
+		mara_check_error(mara_compiler_add_record_name(
+			ctx, name_str, field_name,
+			(mara_record_op_t){ .type = type, .field = i }
+		));
+	}
+
+	mara_compiler_set_debug_info(ctx, list, MARA_DEBUG_INFO_SELF);
+	return mara_compiler_emit(ctx, MARA_OP_NIL, 0, 1);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_compiler_find_record_type(
+	mara_compile_ctx_t* ctx,
+	const mara_record_type_t* type,
+	mara_operand_t* index
+) {
+	mara_function_scope_t* fn_scope = ctx->function_scope;
+	mara_index_t num_record_types = (mara_index_t)barray_len(fn_scope->record_types);
+	for (mara_index_t i = 0; i < num_record_types; ++i) {
+		if (fn_scope->record_types[i] == type) {
+			*index = (mara_operand_t)i;
+			return NULL;
+		}
+	}
+
+	if (num_record_types >= MARA_MAX_RECORD_TYPES) {
+		return mara_compiler_error(
+			ctx,
+			mara_str_from_literal("core/limit-reached/max-record-types"),
+			"Function uses too many record types",
+			mara_nil()
+		);
+	}
+
+	barray_push(ctx->exec_ctx->env, fn_scope->record_types, type);
+	*index = (mara_operand_t)num_record_types;
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_compile_record_op(mara_compile_ctx_t* ctx, mara_list_t* list, mara_record_op_t op) {
+	mara_index_t list_len = list->len;
+	mara_index_t num_args = list_len - 1;
+	if (op.field < 0 ? num_args != op.type->num_fields : (num_args != 1 && num_args != 2)) {
+		return mara_compiler_error(
+			ctx,
+			mara_str_from_literal("core/syntax-error"),
+			op.field < 0
+				? "Record constructor requires a value for every field"
+				: "Record field requires a record and an optional value",
+			mara_nil()
+		);
+	}
+
+	for (mara_index_t i = 1; i < list_len; ++i) {
+		mara_compiler_set_debug_info(ctx, list, i);
+		mara_check_error(mara_compile_expression(ctx, list->elems[i]));
+	}
+
+	mara_operand_t type_index;
+	mara_check_error(mara_compiler_find_record_type(ctx, op.type, &type_index));
+
+	mara_compiler_set_debug_info(ctx, list, MARA_DEBUG_INFO_SELF);
+	if (op.field < 0) {
+		return mara_compiler_emit(ctx, MARA_OP_MAKE_RECORD, type_index, 1 - num_args);
+	} else {
+		mara_operand_t operands = (type_index << 8) | (mara_operand_t)op.field;
+		return num_args == 1
+			? mara_compiler_emit(ctx, MARA_OP_RECORD_GET, operands, 0)
+			: mara_compiler_emit(ctx, MARA_OP_RECORD_SET, operands, -1);
+	}
+}
+
 MARA_PRIVATE mara_error_t*
 mara_compile_list_expr(mara_compile_ctx_t* ctx, mara_value_t expr) {
 	mara_list_t* list;
@@ -1121,10 +1443,13 @@ mara_compile_list_expr(mara_compile_ctx_t* ctx, mara_value_t expr) {
 			switch (name.type) {
 				case MARA_NAME_BUILTIN:
 					return name.fn(ctx, list);
+				case MARA_NAME_RECORD_OP:
+					return mara_compile_record_op(ctx, list, ctx->record_ops[name.index]);
 				case MARA_NAME_NOT_FOUND:
 					{
 						mara_str_t name_str;
-						mara_assert_no_error(mara_value_to_str(ctx->exec_ctx, first_elem, &name_str));
+						mara_small_str_buf_t name_str_buf;
+						mara_assert_no_error(mara_value_to_str_buf(ctx->exec_ctx, first_elem, &name_str_buf, &name_str));
 						return mara_compiler_error(
 							ctx,
 							mara_str_from_literal("core/name-error"),
@@ -1183,11 +1508,11 @@ MARA_PRIVATE mara_error_t*
 mara_compile_expression(mara_compile_ctx_t* ctx, mara_value_t expr) {
 	mara_exec_ctx_t* exec_ctx = ctx->exec_ctx;
 
-	if (expr.internal == ctx->sym_nil.internal) {
+	if (expr.internal == ctx->compiler->sym_nil.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_NIL, 0, 1);
-	} else if (expr.internal == ctx->sym_true.internal) {
+	} else if (expr.internal == ctx->compiler->sym_true.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_TRUE, 0, 1);
-	} else if (expr.internal == ctx->sym_false.internal) {
+	} else if (expr.internal == ctx->compiler->sym_false.internal) {
 		return mara_compiler_emit(ctx, MARA_OP_FALSE, 0, 1);
 	} else if (
 		mara_value_is_str(expr)
@@ -1223,6 +1548,13 @@ mara_compile_expression(mara_compile_ctx_t* ctx, mara_value_t expr) {
 	}
 }
 
+MARA_PRIVATE void
+mara_compiler_cleanup(mara_env_t* env, void* userdata) {
+	mara_compile_ctx_t* ctx = userdata;
+	barray_free(env, ctx->captures);
+	barray_free(env, ctx->record_ops);
+}
+
 MARA_PRIVATE mara_error_t*
 mara_do_compile(
 	mara_compile_ctx_t* ctx,
@@ -1233,8 +1565,8 @@ mara_do_compile(
 ) {
 	mara_compiler_begin_function(ctx);
 	if (!options.standalone) {
-		mara_check_error(mara_compiler_add_argument(ctx, ctx->sym_import));
-		mara_check_error(mara_compiler_add_argument(ctx, ctx->sym_export));
+		mara_check_error(mara_compiler_add_argument(ctx, ctx->compiler->sym_import));
+		mara_check_error(mara_compiler_add_argument(ctx, ctx->compiler->sym_export));
 	}
 
 	mara_compiler_set_debug_info(ctx, exprs, MARA_DEBUG_INFO_SELF);
@@ -1254,6 +1586,59 @@ mara_do_compile(
 	return NULL;
 }
 
+MARA_PRIVATE mara_compiler_t*
+mara_get_compiler(mara_exec_ctx_t* ctx) {
+	mara_env_t* env = ctx->env;
+	mara_compiler_t* compiler = mara_atomic_load_ptr((void* const*)&env->compiler);
+	if (MARA_EXPECT(compiler != NULL)) {
+		return compiler;
+	}
+
+	// Another thread may have won the race to create it
+	mara_mutex_lock(&env->lock);
+	if (env->compiler != NULL) {
+		mara_mutex_unlock(&env->lock);
+		return env->compiler;
+	}
+
+	compiler = MARA_ZONE_ALLOC_TYPE(ctx, &env->permanent_zone, mara_compiler_t);
+	*compiler = (mara_compiler_t){
+		.sym_nil = mara_new_sym(ctx, mara_str_from_literal("nil")),
+		.sym_true = mara_new_sym(ctx, mara_str_from_literal("true")),
+		.sym_false = mara_new_sym(ctx, mara_str_from_literal("false")),
+		.sym_import = mara_new_sym(ctx, mara_str_from_literal("import")),
+		.sym_export = mara_new_sym(ctx, mara_str_from_literal("export")),
+
+		.sym_lt = mara_new_sym(ctx, mara_str_from_literal("<")),
+		.sym_lte = mara_new_sym(ctx, mara_str_from_literal("<=")),
+		.sym_gt = mara_new_sym(ctx, mara_str_from_literal(">")),
+		.sym_gte = mara_new_sym(ctx, mara_str_from_literal(">=")),
+	};
+
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("def"), mara_compile_def);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("set"), mara_compile_set);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("if"), mara_compile_if);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("fn"), mara_compile_fn);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("do"), mara_compile_do);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("defrecord"), mara_compile_defrecord);
+
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("<"), mara_compile_bin_ops);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("<="), mara_compile_bin_ops);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal(">"), mara_compile_bin_ops);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal(">="), mara_compile_bin_ops);
+
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("+"), mara_compile_plus);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("-"), mara_compile_minus);
+
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("list"), mara_compile_list);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("put"), mara_compile_put);
+	mara_compiler_add_builtin(ctx, compiler, mara_str_from_literal("get"), mara_compile_get);
+
+	mara_atomic_store_ptr((void**)&env->compiler, compiler);
+	mara_mutex_unlock(&env->lock);
+	return compiler;
+}
+
 mara_error_t*
 mara_compile(
 	mara_exec_ctx_t* ctx,
@@ -1273,45 +1658,22 @@ mara_compile(
 		);
 	}
 
-	mara_compile_ctx_t compile_ctx = {
+	// Only writes to shared state are locked so compiles run in parallel
+	mara_compile_ctx_t* compile_ctx = MARA_ZONE_ALLOC_TYPE(ctx, compiler_zone, mara_compile_ctx_t);
+	*compile_ctx = (mara_compile_ctx_t){
 		.exec_ctx = ctx,
 		.zone = zone,
 		.options = options,
-
-		// Sync this list with symtab.c
-		.sym_nil = mara_new_sym(ctx, mara_str_from_literal("nil")),
-		.sym_true = mara_new_sym(ctx, mara_str_from_literal("true")),
-		.sym_false = mara_new_sym(ctx, mara_str_from_literal("false")),
-		.sym_import = mara_new_sym(ctx, mara_str_from_literal("import")),
-		.sym_export = mara_new_sym(ctx, mara_str_from_literal("export")),
-
-		.sym_lt = mara_new_sym(ctx, mara_str_from_literal("<")),
-		.sym_lte = mara_new_sym(ctx, mara_str_from_literal("<=")),
-		.sym_gt = mara_new_sym(ctx, mara_str_from_literal(">")),
-		.sym_gte = mara_new_sym(ctx, mara_str_from_literal(">=")),
+		.compiler = mara_get_compiler(ctx),
 	};
+	// Also run when an allocation over the memory quota unwinds the compile
+	mara_add_finalizer(ctx, compiler_zone, (mara_callback_t){
+		.fn = mara_compiler_cleanup,
+		.userdata = compile_ctx,
+	});
 
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("def"), mara_compile_def);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("set"), mara_compile_set);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("if"), mara_compile_if);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("fn"), mara_compile_fn);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("do"), mara_compile_do);
-
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("<"), mara_compile_bin_ops);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("<="), mara_compile_bin_ops);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal(">"), mara_compile_bin_ops);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal(">="), mara_compile_bin_ops);
-
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("+"), mara_compile_plus);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("-"), mara_compile_minus);
-
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("list"), mara_compile_list);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("put"), mara_compile_put);
-	mara_compiler_add_builtin(&compile_ctx, mara_str_from_literal("get"), mara_compile_get);
-
-	error = mara_do_compile(&compile_ctx, zone, options, exprs, result);
+	error = mara_do_compile(compile_ctx, zone, options, exprs, result);
 
-	barray_free(ctx->env, compile_ctx.captures);
 	mara_zone_exit(ctx, compiler_zone);
 	return error;
 }
@@ -49,6 +49,104 @@ mara_ptr_map_get(mara_ptr_map_t* map, void* key) {
 	}
 }
 
+MARA_PRIVATE mara_value_t
+mara_deep_copy(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* target_zone,
+	mara_ptr_map_t* copied_objs,
+	mara_value_t value
+);
+
+// Containers in the permanent zone are shared by every context so they are
+// frozen once filled
+MARA_PRIVATE void
+mara_freeze_copy(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_obj_t* obj) {
+	obj->frozen = zone == &ctx->env->permanent_zone;
+}
+
+MARA_PRIVATE mara_value_t
+mara_copy_array(mara_exec_ctx_t* ctx, mara_zone_t* zone, const mara_array_t* array) {
+	mara_array_t* copy = mara_new_array(ctx, zone, array->type, array->len);
+	size_t elem_size = array->type == MARA_ARRAY_I32 ? sizeof(int32_t) : sizeof(double);
+	memcpy(copy->data, array->data, elem_size * (size_t)array->len);
+	mara_freeze_copy(ctx, zone, mara_header_of(copy));
+	return mara_value_from_array(copy);
+}
+
+// Nodes which already outlive the target zone are shared as is
+MARA_PRIVATE mara_pmap_node_t*
+mara_deep_copy_pmap_node(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* target_zone,
+	mara_ptr_map_t* copied_objs,
+	mara_pmap_node_t* node
+) {
+	if (node->zone->level <= target_zone->level) {
+		return node;
+	}
+
+	mara_pmap_node_t* copied_node = mara_ptr_map_get(copied_objs, node);
+	if (copied_node != NULL) {
+		return copied_node;
+	}
+
+	mara_index_t num_entries = mara_pmap_node_num_entries(node);
+	mara_index_t num_children = mara_popcount32(node->nodemap);
+	mara_pmap_node_t* new_node = mara_pmap_alloc_node(ctx, target_zone, num_entries, num_children);
+	mara_ptr_map_put(ctx, mara_get_local_zone(ctx), copied_objs, node, new_node);
+
+	new_node->datamap = node->datamap;
+	new_node->nodemap = node->nodemap;
+	new_node->num_collisions = node->num_collisions;
+	for (mara_index_t i = 0; i < num_entries; ++i) {
+		new_node->entries[i].key = mara_deep_copy(ctx, target_zone, copied_objs, node->entries[i].key);
+		new_node->entries[i].value = mara_deep_copy(ctx, target_zone, copied_objs, node->entries[i].value);
+	}
+
+	mara_pmap_node_t** old_children = mara_pmap_node_children(node);
+	mara_pmap_node_t** new_children = mara_pmap_node_children(new_node);
+	for (mara_index_t i = 0; i < num_children; ++i) {
+		new_children[i] = mara_deep_copy_pmap_node(ctx, target_zone, copied_objs, old_children[i]);
+	}
+
+	return new_node;
+}
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_deep_copy_pvec_node(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* target_zone,
+	mara_ptr_map_t* copied_objs,
+	mara_pvec_node_t* node,
+	mara_index_t level
+) {
+	if (node == NULL || node->zone->level <= target_zone->level) {
+		return node;
+	}
+
+	mara_pvec_node_t* copied_node = mara_ptr_map_get(copied_objs, node);
+	if (copied_node != NULL) {
+		return copied_node;
+	}
+
+	mara_pvec_node_t* new_node = MARA_ZONE_ALLOC_TYPE(ctx, target_zone, mara_pvec_node_t);
+	mara_assert(new_node != NULL, "Out of memory");
+	mara_ptr_map_put(ctx, mara_get_local_zone(ctx), copied_objs, node, new_node);
+
+	new_node->zone = target_zone;
+	for (mara_index_t i = 0; i < MARA_PVEC_BRANCHES; ++i) {
+		if (level == 0) {
+			new_node->elems[i] = mara_deep_copy(ctx, target_zone, copied_objs, node->elems[i]);
+		} else {
+			new_node->children[i] = mara_deep_copy_pvec_node(
+				ctx, target_zone, copied_objs, node->children[i], level - MARA_PVEC_BITS
+			);
+		}
+	}
+
+	return new_node;
+}
+
 MARA_PRIVATE mara_value_t
 mara_deep_copy(
 	mara_exec_ctx_t* ctx,
@@ -74,8 +172,7 @@ mara_deep_copy(
 	switch (obj->type) {
 		case MARA_OBJ_TYPE_STRING:
 			{
-				mara_str_t* str = (mara_str_t*)obj->body;
-				mara_value_t result = mara_new_str(ctx, target_zone, *str);
+				mara_value_t result = mara_copy_str(ctx, target_zone, (mara_str_obj_t*)obj->body);
 				mara_ptr_map_put(ctx, local_zone, copied_objs, obj, mara_value_to_obj(result));
 				return result;
 			}
@@ -103,6 +200,7 @@ mara_deep_copy(
 						ctx, target_zone, copied_objs, old_elems[i]
 					);
 				}
+				mara_freeze_copy(ctx, target_zone, new_list_header);
 
 				return mara_value_from_list(new_list);
 			}
@@ -114,18 +212,17 @@ mara_deep_copy(
 				mara_map_t* new_map = mara_new_map(ctx, target_zone);
 				mara_ptr_map_put(ctx, local_zone, copied_objs, obj, mara_header_of(new_map));
 
-				for (
-					mara_map_node_t* itr = old_map->root;
-					itr != NULL;
-					itr = itr->next
-				) {
+				mara_map_itr_t itr = { .map = old_map };
+				mara_value_t entry_key, entry_value;
+				while (mara_map_itr_next(&itr, &entry_key, &entry_value)) {
 					// The copy must be made here for it to be deep
 					// If we rely on mara_map_set, it will make a shallow copy
 					// starting from the value instead.
-					mara_value_t key_copy = mara_deep_copy(ctx, target_zone, copied_objs, itr->key);
-					mara_value_t value_copy = mara_deep_copy(ctx, target_zone, copied_objs, itr->value);
+					mara_value_t key_copy = mara_deep_copy(ctx, target_zone, copied_objs, entry_key);
+					mara_value_t value_copy = mara_deep_copy(ctx, target_zone, copied_objs, entry_value);
 					mara_map_set(ctx, new_map, key_copy, value_copy);
 				}
+				mara_freeze_copy(ctx, target_zone, mara_header_of(new_map));
 
 				return mara_value_from_map(new_map);
 			}
@@ -154,6 +251,67 @@ mara_deep_copy(
 
 				return mara_obj_to_value(new_closure_header);
 			}
+		case MARA_OBJ_TYPE_PMAP:
+			{
+				mara_pmap_t* old_map = (mara_pmap_t*)obj->body;
+				mara_obj_t* new_map_header = mara_alloc_obj(ctx, target_zone, sizeof(mara_pmap_t));
+				new_map_header->type = MARA_OBJ_TYPE_PMAP;
+				mara_ptr_map_put(ctx, local_zone, copied_objs, obj, new_map_header);
+
+				mara_pmap_t* new_map = (mara_pmap_t*)new_map_header->body;
+				new_map->len = old_map->len;
+				new_map->root = old_map->root != NULL
+					? mara_deep_copy_pmap_node(ctx, target_zone, copied_objs, old_map->root)
+					: NULL;
+
+				return mara_obj_to_value(new_map_header);
+			}
+		case MARA_OBJ_TYPE_PVEC:
+			{
+				mara_pvec_t* old_vec = (mara_pvec_t*)obj->body;
+				mara_obj_t* new_vec_header = mara_alloc_obj(ctx, target_zone, sizeof(mara_pvec_t));
+				new_vec_header->type = MARA_OBJ_TYPE_PVEC;
+				mara_ptr_map_put(ctx, local_zone, copied_objs, obj, new_vec_header);
+
+				mara_pvec_t* new_vec = (mara_pvec_t*)new_vec_header->body;
+				*new_vec = *old_vec;
+				new_vec->root = mara_deep_copy_pvec_node(
+					ctx, target_zone, copied_objs, old_vec->root, old_vec->shift
+				);
+				new_vec->tail = mara_deep_copy_pvec_node(
+					ctx, target_zone, copied_objs, old_vec->tail, 0
+				);
+
+				return mara_obj_to_value(new_vec_header);
+			}
+		case MARA_OBJ_TYPE_RECORD:
+			{
+				mara_record_t* old_record = (mara_record_t*)obj->body;
+				mara_index_t num_fields = old_record->type->num_fields;
+				mara_obj_t* new_record_header = mara_alloc_obj(
+					ctx, target_zone,
+					sizeof(mara_record_t) + sizeof(mara_value_t) * num_fields
+				);
+				new_record_header->type = MARA_OBJ_TYPE_RECORD;
+				mara_ptr_map_put(ctx, local_zone, copied_objs, obj, new_record_header);
+
+				mara_record_t* new_record = (mara_record_t*)new_record_header->body;
+				new_record->type = old_record->type;
+				for (mara_index_t i = 0; i < num_fields; ++i) {
+					new_record->fields[i] = mara_deep_copy(
+						ctx, target_zone, copied_objs, old_record->fields[i]
+					);
+				}
+				mara_freeze_copy(ctx, target_zone, new_record_header);
+
+				return mara_obj_to_value(new_record_header);
+			}
+		case MARA_OBJ_TYPE_ARRAY:
+			{
+				mara_value_t result = mara_copy_array(ctx, target_zone, (mara_array_t*)obj->body);
+				mara_ptr_map_put(ctx, local_zone, copied_objs, obj, mara_value_to_obj(result));
+				return result;
+			}
 		default:
 			return mara_nil();
 	}
@@ -165,8 +323,15 @@ mara_start_deep_copy(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_value_t value
 	mara_zone_t* copy_zone = mara_zone_enter(ctx);
 
 	if (MARA_EXPECT(copy_zone != NULL)) {
+		// Copies into the permanent zone are made while holding the env lock
+		// so a failed allocation must not unwind past it
+		mara_memory_quota_t* quota = &ctx->memory_quota;
+		jmp_buf* recovery_point = quota->recovery_point;
+		if (zone == &ctx->env->permanent_zone) { quota->recovery_point = NULL; }
+
 		mara_ptr_map_t copied_objs = { .root = NULL };
 		mara_value_t result = mara_deep_copy(ctx, zone, &copied_objs, value);
+		quota->recovery_point = recovery_point;
 		mara_zone_exit(ctx, copy_zone);
 		return result;
 	} else {
@@ -190,18 +355,24 @@ mara_copy(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_value_t value) {
 	switch (obj->type) {
 		case MARA_OBJ_TYPE_STRING:
 			{
-				mara_str_t* str = (mara_str_t*)obj->body;
-				return mara_new_str(ctx, zone, *str);
+				return mara_copy_str(ctx, zone, (mara_str_obj_t*)obj->body);
 			}
 		case MARA_OBJ_TYPE_REF:
 			{
 				mara_ref_t* ref = (mara_ref_t*)obj->body;
 				return mara_new_ref(ctx, zone, ref->tag, ref->value);
 			}
+		case MARA_OBJ_TYPE_ARRAY:
+			{
+				return mara_copy_array(ctx, zone, (mara_array_t*)obj->body);
+			}
 		case MARA_OBJ_TYPE_LIST:
 		case MARA_OBJ_TYPE_MAP:
 		case MARA_OBJ_TYPE_NATIVE_FN:
 		case MARA_OBJ_TYPE_VM_FN:
+		case MARA_OBJ_TYPE_PMAP:
+		case MARA_OBJ_TYPE_PVEC:
+		case MARA_OBJ_TYPE_RECORD:
 			return mara_start_deep_copy(ctx, zone, value);
 		default:
 			mara_assert(false, "Invalid object type");
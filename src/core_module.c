@@ -1,6 +1,8 @@
 #include "internal.h"
 #include <mara/bind.h>
 #include "vm_intrinsics.h"
+#include <errno.h>
+#include <stdlib.h>
 
 // List
 
@@ -30,6 +32,7 @@ MARA_PRIVATE MARA_FUNCTION(mara_core_list_push) {
 	MARA_FN_CHECK_ARITY(2);
 	MARA_FN_ARG(mara_list_t*, list, 0);
 	MARA_FN_ARG(mara_value_t, value, 1);
+	mara_check_error(mara_check_mutable(ctx, argv[0]));
 
 	mara_list_push(ctx, list, value);
 	MARA_RETURN(mara_nil());
@@ -42,6 +45,7 @@ MARA_PRIVATE MARA_FUNCTION(mara_core_list_set) {
 	MARA_FN_ARG(mara_list_t*, list, 0);
 	MARA_FN_ARG(mara_index_t, index, 1);
 	MARA_FN_ARG(mara_value_t, value, 2);
+	mara_check_error(mara_check_mutable(ctx, argv[0]));
 
 	MARA_RETURN(mara_list_set(ctx, list, index, value));
 }
@@ -56,6 +60,591 @@ MARA_PRIVATE MARA_FUNCTION(mara_core_list_get) {
 	MARA_RETURN(mara_list_get(ctx, list, index));
 }
 
+MARA_PRIVATE MARA_FUNCTION(mara_core_list_slice) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+	MARA_FN_ARG(mara_index_t, start, 1);
+
+	mara_index_t end = list->len;
+	if (argc >= 3) {
+		MARA_FN_BIND_ARG(end, 2);
+	}
+	MARA_RETURN(mara_list_slice(ctx, mara_get_return_zone(ctx), list, start, end));
+}
+
+// The callbacks of the list functions below share one stack frame and call
+// zone for the whole list
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_list_map) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+	MARA_FN_ARG(mara_fn_t*, fn, 1);
+
+	mara_zone_t* return_zone = mara_get_return_zone(ctx);
+	mara_list_t* output = mara_new_list(ctx, return_zone, list->len);
+	mara_repeat_call_t call;
+	mara_check_error(mara_begin_repeat_call(ctx, return_zone, fn, 3, &call));
+
+	mara_error_t* error = NULL;
+	for (mara_index_t i = 0; i < list->len; ++i) {
+		mara_value_t args[] = { list->elems[i], mara_value_from_int(i), argv[0] };
+		mara_value_t value;
+		if ((error = mara_repeat_call(ctx, &call, args, &value)) != NULL) { break; }
+		mara_list_push(ctx, output, value);
+	}
+
+	mara_end_repeat_call(ctx, &call);
+	if (error != NULL) { return error; }
+	MARA_RETURN(output);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_list_filter) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+	MARA_FN_ARG(mara_fn_t*, fn, 1);
+
+	mara_list_t* output = mara_new_list(ctx, mara_get_return_zone(ctx), 0);
+	mara_repeat_call_t call;
+	mara_check_error(mara_begin_repeat_call(ctx, mara_get_local_zone(ctx), fn, 3, &call));
+
+	mara_error_t* error = NULL;
+	for (mara_index_t i = 0; i < list->len; ++i) {
+		mara_value_t elem = list->elems[i];
+		mara_value_t args[] = { elem, mara_value_from_int(i), argv[0] };
+		mara_value_t keep;
+		if ((error = mara_repeat_call(ctx, &call, args, &keep)) != NULL) { break; }
+		if (!mara_value_is_nil(keep) && !mara_value_is_false(keep)) {
+			mara_list_push(ctx, output, elem);
+		}
+	}
+
+	mara_end_repeat_call(ctx, &call);
+	if (error != NULL) { return error; }
+	MARA_RETURN(output);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_list_find) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+	MARA_FN_ARG(mara_fn_t*, fn, 1);
+
+	mara_repeat_call_t call;
+	mara_check_error(mara_begin_repeat_call(ctx, mara_get_local_zone(ctx), fn, 3, &call));
+
+	mara_error_t* error = NULL;
+	mara_value_t found = mara_nil();
+	for (mara_index_t i = 0; i < list->len; ++i) {
+		mara_value_t elem = list->elems[i];
+		mara_value_t args[] = { elem, mara_value_from_int(i), argv[0] };
+		mara_value_t match;
+		if ((error = mara_repeat_call(ctx, &call, args, &match)) != NULL) { break; }
+		if (!mara_value_is_nil(match) && !mara_value_is_false(match)) {
+			found = elem;
+			break;
+		}
+	}
+
+	mara_end_repeat_call(ctx, &call);
+	if (error != NULL) { return error; }
+	MARA_RETURN(found);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_list_reduce) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(3);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+	MARA_FN_ARG(mara_fn_t*, fn, 1);
+	MARA_FN_ARG(mara_value_t, acc, 2);
+
+	// Intermediate results are only kept until the function returns
+	mara_repeat_call_t call;
+	mara_check_error(mara_begin_repeat_call(ctx, mara_get_local_zone(ctx), fn, 2, &call));
+
+	mara_error_t* error = NULL;
+	for (mara_index_t i = 0; i < list->len; ++i) {
+		mara_value_t args[] = { acc, list->elems[i] };
+		if ((error = mara_repeat_call(ctx, &call, args, &acc)) != NULL) { break; }
+	}
+
+	mara_end_repeat_call(ctx, &call);
+	if (error != NULL) { return error; }
+	MARA_RETURN(acc);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_list_sort) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+
+	mara_fn_t* less_fn = NULL;
+	if (argc >= 2) {
+		MARA_FN_BIND_ARG(less_fn, 1);
+	}
+	mara_check_error(mara_list_sort(ctx, list, less_fn));
+	MARA_RETURN(list);
+}
+
+// Map
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_map_new) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+
+	mara_index_t capacity = 0;
+	if (argc >= 1) {
+		MARA_FN_BIND_ARG(capacity, 0);
+	}
+	mara_map_t* map = mara_new_map(ctx, mara_get_return_zone(ctx));
+	mara_map_reserve(ctx, map, capacity);
+	MARA_RETURN(map);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_map_len) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_map_t*, map, 0);
+
+	MARA_RETURN(mara_map_len(ctx, map));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_map_merge) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_map_t*, dst, 0);
+	MARA_FN_ARG(mara_map_t*, src, 1);
+	mara_check_error(mara_check_mutable(ctx, argv[0]));
+
+	mara_map_merge(ctx, dst, src);
+	MARA_RETURN(dst);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_map_from_pairs) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_list_t*, pairs, 0);
+
+	if (pairs->len % 2 != 0) {
+		return mara_errorf(
+			ctx, mara_str_from_literal("core/unexpected-type"),
+			"Expecting a list of keys and values, got %d elements",
+			mara_value_from_int(0),
+			pairs->len
+		);
+	}
+
+	MARA_RETURN(mara_map_from_pairs(ctx, mara_get_return_zone(ctx), pairs->len / 2, pairs->elems));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_map_get_many) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_map_t*, map, 0);
+	MARA_FN_ARG(mara_list_t*, keys, 1);
+
+	mara_zone_t* zone = mara_get_return_zone(ctx);
+	mara_list_t* values = mara_new_list(ctx, zone, keys->len);
+	mara_map_get_many(ctx, map, keys->len, keys->elems, values->elems);
+	for (mara_index_t i = 0; i < keys->len; ++i) {
+		values->elems[i] = mara_copy(ctx, zone, values->elems[i]);
+	}
+	values->len = keys->len;
+	MARA_RETURN(values);
+}
+
+// Persistent map
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pmap_new) {
+	(void)userdata;
+	(void)argc;
+	(void)argv;
+	mara_add_native_debug_info(ctx);
+
+	MARA_RETURN(mara_new_pmap(ctx, mara_get_return_zone(ctx)));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pmap_len) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_pmap_t*, map, 0);
+
+	MARA_RETURN(mara_pmap_len(ctx, map));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pmap_get) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_pmap_t*, map, 0);
+	MARA_FN_ARG(mara_value_t, key, 1);
+
+	MARA_RETURN(mara_pmap_get(ctx, map, key));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pmap_set) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(3);
+	MARA_FN_ARG(mara_pmap_t*, map, 0);
+	MARA_FN_ARG(mara_value_t, key, 1);
+	MARA_FN_ARG(mara_value_t, value, 2);
+
+	MARA_RETURN(mara_pmap_set(ctx, mara_get_return_zone(ctx), map, key, value));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pmap_delete) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_pmap_t*, map, 0);
+	MARA_FN_ARG(mara_value_t, key, 1);
+
+	MARA_RETURN(mara_pmap_delete(ctx, mara_get_return_zone(ctx), map, key));
+}
+
+// Persistent vector
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pvec_new) {
+	(void)userdata;
+	(void)argc;
+	(void)argv;
+	mara_add_native_debug_info(ctx);
+
+	MARA_RETURN(mara_new_pvec(ctx, mara_get_return_zone(ctx)));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pvec_len) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_pvec_t*, vec, 0);
+
+	MARA_RETURN(mara_pvec_len(ctx, vec));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pvec_get) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_pvec_t*, vec, 0);
+	MARA_FN_ARG(mara_index_t, index, 1);
+
+	MARA_RETURN(mara_pvec_get(ctx, vec, index));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pvec_set) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(3);
+	MARA_FN_ARG(mara_pvec_t*, vec, 0);
+	MARA_FN_ARG(mara_index_t, index, 1);
+	MARA_FN_ARG(mara_value_t, value, 2);
+
+	MARA_RETURN(mara_pvec_set(ctx, mara_get_return_zone(ctx), vec, index, value));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pvec_push) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_pvec_t*, vec, 0);
+	MARA_FN_ARG(mara_value_t, value, 1);
+
+	MARA_RETURN(mara_pvec_push(ctx, mara_get_return_zone(ctx), vec, value));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_pvec_pop) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_pvec_t*, vec, 0);
+
+	MARA_RETURN(mara_pvec_pop(ctx, mara_get_return_zone(ctx), vec));
+}
+
+// Packed array
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_from_list) {
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_list_t*, list, 0);
+
+	mara_index_t type;
+	mara_assert_no_error(mara_value_to_int(ctx, userdata, &type));
+	mara_array_t* array;
+	mara_check_error(mara_array_from_list(
+		ctx, mara_get_return_zone(ctx), (mara_array_type_t)type, list, &array
+	));
+	MARA_RETURN(array);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_to_list) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_array_t*, array, 0);
+
+	MARA_RETURN(mara_array_to_list(ctx, mara_get_return_zone(ctx), array));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_len) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_array_t*, array, 0);
+
+	MARA_RETURN(mara_array_len(ctx, array));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_sum) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_array_t*, array, 0);
+
+	MARA_RETURN(mara_array_sum(ctx, array));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_min) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_array_t*, array, 0);
+
+	MARA_RETURN(mara_array_min(ctx, array));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_max) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_array_t*, array, 0);
+
+	MARA_RETURN(mara_array_max(ctx, array));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_dot) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_array_t*, lhs, 0);
+	MARA_FN_ARG(mara_array_t*, rhs, 1);
+
+	return mara_array_dot(ctx, lhs, rhs, result);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_add) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_array_t*, lhs, 0);
+	MARA_FN_ARG(mara_array_t*, rhs, 1);
+
+	mara_array_t* sum;
+	mara_check_error(mara_array_add(ctx, mara_get_return_zone(ctx), lhs, rhs, &sum));
+	MARA_RETURN(sum);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_array_scale) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_array_t*, array, 0);
+	MARA_FN_ARG(mara_value_t, factor, 1);
+
+	mara_array_t* scaled;
+	mara_check_error(mara_array_scale(ctx, mara_get_return_zone(ctx), array, factor, &scaled));
+	MARA_RETURN(scaled);
+}
+
+// String
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_len) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_str_t, str, 0);
+
+	MARA_RETURN(str.len);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_concat) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+
+	mara_index_t total_len = 0;
+	for (mara_index_t i = 0; i < argc; ++i) {
+		MARA_FN_ARG(mara_str_t, part, i);
+		total_len += part.len;
+	}
+
+	mara_str_builder_t builder = { .zone = mara_get_return_zone(ctx) };
+	mara_str_builder_reserve(ctx, &builder, total_len);
+	for (mara_index_t i = 0; i < argc; ++i) {
+		MARA_FN_ARG(mara_str_t, part, i);
+		mara_str_builder_append(ctx, &builder, part);
+	}
+	MARA_RETURN(mara_str_builder_build(ctx, &builder));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_slice) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_str_t, str, 0);
+	MARA_FN_ARG(mara_index_t, start, 1);
+
+	mara_index_t end = str.len;
+	if (argc >= 3) {
+		MARA_FN_BIND_ARG(end, 2);
+	}
+	if (start < 0) { start = 0; }
+	if (end > str.len) { end = str.len; }
+	if (end < start) { end = start; }
+
+	MARA_RETURN(mara_new_str(ctx, mara_get_return_zone(ctx), (mara_str_t){
+		.data = str.data + start,
+		.len = end - start,
+	}));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_find) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_str_t, str, 0);
+	MARA_FN_ARG(mara_str_t, needle, 1);
+
+	mara_index_t start = 0;
+	if (argc >= 3) {
+		MARA_FN_BIND_ARG(start, 2);
+	}
+	mara_index_t index = mara_str_find(str, needle, start);
+	MARA_RETURN(index >= 0 ? mara_value_from_int(index) : mara_nil());
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_split) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_str_t, str, 0);
+	MARA_FN_ARG(mara_str_t, separator, 1);
+
+	MARA_RETURN(mara_str_split(ctx, mara_get_return_zone(ctx), str, separator));
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_join) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_list_t*, parts, 0);
+
+	mara_str_t separator = { 0 };
+	if (argc >= 2) {
+		MARA_FN_BIND_ARG(separator, 1);
+	}
+	mara_value_t joined;
+	mara_check_error(mara_str_join(ctx, mara_get_return_zone(ctx), parts, separator, &joined));
+	MARA_RETURN(joined);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_compare) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_str_t, lhs, 0);
+	MARA_FN_ARG(mara_str_t, rhs, 1);
+
+	MARA_RETURN((mara_index_t)mara_str_compare(lhs, rhs));
+}
+
+// Returns nil when the whole string is not a number
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_to_number) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_str_t, str, 0);
+
+	if (str.len == 0) { MARA_RETURN(mara_nil()); }
+
+	char* cstr = mara_zone_alloc_ex(ctx, mara_get_local_zone(ctx), str.len + 1, _Alignof(char));
+	mara_assert(cstr != NULL, "Out of memory");
+	memcpy(cstr, str.data, str.len);
+	cstr[str.len] = '\0';
+
+	char* end;
+	errno = 0;
+	long int_value = strtol(cstr, &end, 10);
+	if (*end == '\0' && errno == 0 && int_value >= INT32_MIN && int_value <= INT32_MAX) {
+		MARA_RETURN((mara_index_t)int_value);
+	}
+
+	errno = 0;
+	double real_value = strtod(cstr, &end);
+	if (*end == '\0' && errno == 0) {
+		MARA_RETURN(real_value);
+	}
+
+	MARA_RETURN(mara_nil());
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_from_number) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+
+	mara_zone_t* zone = mara_get_return_zone(ctx);
+	if (mara_value_is_int(argv[0])) {
+		MARA_FN_ARG(mara_index_t, value, 0);
+		MARA_RETURN(mara_new_strf(ctx, zone, "%d", value));
+	} else {
+		MARA_FN_ARG(mara_real_t, value, 0);
+		MARA_RETURN(mara_new_strf(ctx, zone, "%f", value));
+	}
+}
+
+// A script builder is a list of parts joined once by str/build.
+// Unlike a native buffer behind a ref, it stays valid when copied to another
+// zone.
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_append) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(2);
+	MARA_FN_ARG(mara_list_t*, builder, 0);
+	MARA_FN_ARG(mara_str_t, part, 1);
+	(void)part;
+	mara_check_error(mara_check_mutable(ctx, argv[0]));
+
+	mara_list_push(ctx, builder, argv[1]);
+	MARA_RETURN(builder);
+}
+
+MARA_PRIVATE MARA_FUNCTION(mara_core_str_build) {
+	(void)userdata;
+	mara_add_native_debug_info(ctx);
+	MARA_FN_CHECK_ARITY(1);
+	MARA_FN_ARG(mara_list_t*, builder, 0);
+
+	mara_value_t built;
+	mara_check_error(mara_str_join(ctx, mara_get_return_zone(ctx), builder, (mara_str_t){ 0 }, &built));
+	MARA_RETURN(built);
+}
+
 MARA_PRIVATE MARA_FUNCTION(mara_core_module_entry) {
 	(void)argv;
 	(void)userdata;
@@ -74,6 +663,56 @@ MARA_PRIVATE MARA_FUNCTION(mara_core_module_entry) {
 	MARA_EXPORT_FN(list/push, mara_core_list_push, mara_nil());
 	MARA_EXPORT_FN(list/set, mara_core_list_set, mara_nil());
 	MARA_EXPORT_FN(list/get, mara_core_list_get, mara_nil());
+	MARA_EXPORT_FN(list/slice, mara_core_list_slice, mara_nil());
+	MARA_EXPORT_FN(list/map, mara_core_list_map, mara_nil());
+	MARA_EXPORT_FN(list/filter, mara_core_list_filter, mara_nil());
+	MARA_EXPORT_FN(list/find, mara_core_list_find, mara_nil());
+	MARA_EXPORT_FN(list/reduce, mara_core_list_reduce, mara_nil());
+	MARA_EXPORT_FN(list/sort, mara_core_list_sort, mara_nil());
+
+	MARA_EXPORT_FN(map/new, mara_core_map_new, mara_nil());
+	MARA_EXPORT_FN(map/len, mara_core_map_len, mara_nil());
+	MARA_EXPORT_FN(map/merge, mara_core_map_merge, mara_nil());
+	MARA_EXPORT_FN(map/from-pairs, mara_core_map_from_pairs, mara_nil());
+	MARA_EXPORT_FN(map/get-many, mara_core_map_get_many, mara_nil());
+
+	MARA_EXPORT_FN(pmap/new, mara_core_pmap_new, mara_nil());
+	MARA_EXPORT_FN(pmap/len, mara_core_pmap_len, mara_nil());
+	MARA_EXPORT_FN(pmap/get, mara_core_pmap_get, mara_nil());
+	MARA_EXPORT_FN(pmap/set, mara_core_pmap_set, mara_nil());
+	MARA_EXPORT_FN(pmap/delete, mara_core_pmap_delete, mara_nil());
+
+	MARA_EXPORT_FN(pvec/new, mara_core_pvec_new, mara_nil());
+	MARA_EXPORT_FN(pvec/len, mara_core_pvec_len, mara_nil());
+	MARA_EXPORT_FN(pvec/get, mara_core_pvec_get, mara_nil());
+	MARA_EXPORT_FN(pvec/set, mara_core_pvec_set, mara_nil());
+	MARA_EXPORT_FN(pvec/push, mara_core_pvec_push, mara_nil());
+	MARA_EXPORT_FN(pvec/pop, mara_core_pvec_pop, mara_nil());
+
+	MARA_EXPORT_FN(array/i32, mara_core_array_from_list, mara_value_from_int(MARA_ARRAY_I32));
+	MARA_EXPORT_FN(array/f64, mara_core_array_from_list, mara_value_from_int(MARA_ARRAY_F64));
+	MARA_EXPORT_FN(array/to-list, mara_core_array_to_list, mara_nil());
+	MARA_EXPORT_FN(array/len, mara_core_array_len, mara_nil());
+	MARA_EXPORT_FN(array/sum, mara_core_array_sum, mara_nil());
+	MARA_EXPORT_FN(array/min, mara_core_array_min, mara_nil());
+	MARA_EXPORT_FN(array/max, mara_core_array_max, mara_nil());
+	MARA_EXPORT_FN(array/dot, mara_core_array_dot, mara_nil());
+	MARA_EXPORT_FN(array/add, mara_core_array_add, mara_nil());
+	MARA_EXPORT_FN(array/scale, mara_core_array_scale, mara_nil());
+
+
+	MARA_EXPORT_FN(str/len, mara_core_str_len, mara_nil());
+	MARA_EXPORT_FN(str/concat, mara_core_str_concat, mara_nil());
+	MARA_EXPORT_FN(str/slice, mara_core_str_slice, mara_nil());
+	MARA_EXPORT_FN(str/find, mara_core_str_find, mara_nil());
+	MARA_EXPORT_FN(str/split, mara_core_str_split, mara_nil());
+	MARA_EXPORT_FN(str/join, mara_core_str_join, mara_nil());
+	MARA_EXPORT_FN(str/compare, mara_core_str_compare, mara_nil());
+	MARA_EXPORT_FN(str/to-number, mara_core_str_to_number, mara_nil());
+	MARA_EXPORT_FN(str/from-number, mara_core_str_from_number, mara_nil());
+	MARA_EXPORT_FN(str/builder, mara_core_list_new, mara_nil());
+	MARA_EXPORT_FN(str/append, mara_core_str_append, mara_nil());
+	MARA_EXPORT_FN(str/build, mara_core_str_build, mara_nil());
 
 	MARA_RETURN(mara_value_from_bool(true));
 }
@@ -46,12 +46,13 @@ mara_put_debug_info(
 	BHAMT_HASH_TYPE hash = mara_XXH3_64bits(&normalized_key, sizeof(normalized_key));
 	BHAMT_SEARCH(ctx->debug_info_map.root, itr, node, free_node, hash, key);
 
+	// A key left over from a container whose memory was reused is replaced
 	if (node == NULL) {
 		node = *itr = MARA_ARENA_ALLOC_TYPE(ctx->env, &ctx->debug_info_arena, mara_debug_info_node_t);
 		memset(node->children, 0, sizeof(node->children));
 		node->key = key;
-		node->debug_info = debug_info;
 	}
+	node->debug_info = debug_info;
 }
 
 const mara_source_info_t*
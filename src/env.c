@@ -23,15 +23,24 @@ mara_create_env(mara_env_options_t options) {
 		options.alloc_chunk_size = 4096 * 4;
 	}
 
+	if (!mara_page_alloc_supported()) {
+		options.chunk_provider = MARA_CHUNK_PROVIDER_ALLOCATOR;
+	}
+
 	mara_env_t* env = mara_malloc(options.allocator, sizeof(mara_env_t));
 	mara_assert(env != NULL, "Out of memory");
 
 	*env = (mara_env_t){
 		.options = options,
 		.permanent_zone.level = -1,
+		.array_kernels = mara_array_select_kernels(),
 	};
 
+	mara_mutex_init(&env->lock);
+	mara_mutex_init(&env->chunk_lock);
+	mara_cond_init(&env->module_loaded);
 	mara_symtab_init(env, &env->symtab);
+	mara_compile_cache_init(env);
 
 	return env;
 }
@@ -40,11 +49,23 @@ void
 mara_destroy_env(mara_env_t* env) {
 	mara_assert(mara_reset(env), "env is still in use");
 
+	mara_compile_cache_cleanup(env);
+	mara_symtab_destroy(env, &env->symtab);
+	mara_cond_cleanup(&env->module_loaded);
+	mara_mutex_cleanup(&env->chunk_lock);
+	mara_mutex_cleanup(&env->lock);
+
 	mara_allocator_t allocator = env->options.allocator;
-	for (mara_arena_chunk_t* itr = env->free_chunks; itr != NULL;) {
-		mara_arena_chunk_t* next = itr->next;
-		mara_free(allocator, itr);
-		itr = next;
+	if (env->options.chunk_provider == MARA_CHUNK_PROVIDER_PAGES) {
+		mara_page_alloc_cleanup(env);
+	} else {
+		for (mara_index_t i = 0; i < MARA_NUM_CHUNK_BINS; ++i) {
+			for (mara_arena_chunk_t* itr = env->chunk_cache.free_chunks[i]; itr != NULL;) {
+				mara_arena_chunk_t* next = itr->next;
+				mara_free(allocator, itr);
+				itr = next;
+			}
+		}
 	}
 
 	mara_free(allocator, env);
@@ -87,6 +108,7 @@ mara_begin(mara_env_t* env, mara_exec_options_t options) {
 	size_t ctx_size = mem_layout_size(&layout);
 
 	mara_exec_ctx_t* ctx;
+	mara_mutex_lock(&env->lock);
 	if (env->free_contexts != NULL && env->free_contexts->size >= ctx_size) {
 		ctx = env->free_contexts;
 		env->free_contexts = ctx->next;
@@ -94,6 +116,8 @@ mara_begin(mara_env_t* env, mara_exec_options_t options) {
 	} else {
 		ctx = mara_arena_alloc(env, &env->permanent_zone.arena, ctx_size);
 	}
+	env->ref_count += 1;
+	mara_mutex_unlock(&env->lock);
 
 	mara_zone_t* current_zone = mem_layout_locate(ctx, zones_offset);
 	mara_value_t* stack_base = mem_layout_locate(ctx, stack_offset);
@@ -102,6 +126,8 @@ mara_begin(mara_env_t* env, mara_exec_options_t options) {
 		.env = env,
 		.size = ctx_size,
 		.current_module_options.module_name = mara_str_from_literal("."),
+		.snapshot = options.snapshot,
+		.module_loaders = options.snapshot != NULL ? options.snapshot->module_loaders : NULL,
 		.current_zone = current_zone,
 		.stack_frames_begin = current_stack_frame,
 		.vm_state.fp = current_stack_frame,
@@ -111,17 +137,24 @@ mara_begin(mara_env_t* env, mara_exec_options_t options) {
 		.native_debug_info = mem_layout_locate(ctx, debug_info_offset),
 		.error_zone = {
 			.level = options.max_stack_frames,
+			.arena.chunk_cache = &ctx->chunk_cache,
 		},
+		.memory_quota.limit = options.max_memory,
+		.debug_info_arena.chunk_cache = &ctx->chunk_cache,
 	};
 
-	*current_zone = (mara_zone_t){ 0 };
+	*current_zone = (mara_zone_t){
+		.arena = {
+			.quota = options.max_memory > 0 ? &ctx->memory_quota : NULL,
+			.chunk_cache = &ctx->chunk_cache,
+		},
+	};
 	*current_stack_frame = (mara_stack_frame_t){
 		.return_zone = current_zone,
 		.stack = stack_base,
 	};
 	ctx->native_debug_info[0] = NULL;
 
-	env->ref_count += 1;
 	return ctx;
 }
 
@@ -137,20 +170,31 @@ mara_end(mara_exec_ctx_t* ctx) {
 
 	mara_zone_cleanup(env, &ctx->error_zone);
 	mara_arena_reset(env, &ctx->debug_info_arena);
-	env->ref_count -= 1;
+	mara_chunk_cache_flush(env, &ctx->chunk_cache);
 
+	mara_mutex_lock(&env->lock);
+	env->ref_count -= 1;
 	ctx->next = env->free_contexts;
 	env->free_contexts = ctx;
+	mara_mutex_unlock(&env->lock);
 }
 
 bool
 mara_reset(mara_env_t* env) {
-	if (env->ref_count == 0) {
+	mara_mutex_lock(&env->lock);
+	bool unused = env->ref_count == 0;
+	if (unused) {
 		mara_symtab_cleanup(env, &env->symtab);
 		mara_zone_cleanup(env, &env->permanent_zone);
 		env->free_contexts = NULL;
-		return true;
-	} else {
-		return false;
+		// These live in the permanent zone
+		env->module_cache = NULL;
+		env->shape_transitions = NULL;
+		env->record_types = NULL;
+		env->compiler = NULL;
+		mara_compile_cache_clear(env);
 	}
+	mara_mutex_unlock(&env->lock);
+
+	return unused;
 }
@@ -4,10 +4,29 @@
 #include <mara.h>
 #include <mara/utils.h>
 #include <assert.h>
+#include <setjmp.h>
 #define BHAMT_HASH_TYPE uint64_t
 #include "hamt.h"
+#include "thread.h"
 
 #define MARA_DEBUG_INFO_SELF ((mara_index_t)-1)
+#define MARA_NUM_CHUNK_BINS 8
+#define MARA_SYMTAB_FIRST_SEGMENT_BITS 5
+#define MARA_SYMTAB_FIRST_SEGMENT_SIZE (1 << MARA_SYMTAB_FIRST_SEGMENT_BITS)
+#define MARA_SYMTAB_NUM_SEGMENTS 24
+#define MARA_PMAP_BITS 5
+#define MARA_PMAP_BRANCHES (1 << MARA_PMAP_BITS)
+#define MARA_PMAP_HASH_BITS 64
+// Enough levels to exhaust the hash plus one for collisions
+#define MARA_PMAP_MAX_DEPTH ((MARA_PMAP_HASH_BITS + MARA_PMAP_BITS - 1) / MARA_PMAP_BITS + 1)
+#define MARA_PVEC_BITS 5
+#define MARA_PVEC_BRANCHES (1 << MARA_PVEC_BITS)
+#define MARA_PVEC_MASK (MARA_PVEC_BRANCHES - 1)
+#define MARA_MAP_MAX_LINEAR_ENTRIES 8
+#define MARA_MAP_GROUP_SIZE 16
+#define MARA_MAP_MAX_SHAPE_FIELDS 16
+#define MARA_SHAPE_CACHE_SIZE 64
+#define MARA_NO_INLINE_CACHE 0xffff
 
 #ifdef _MSC_VER
 #define MARA_ALIGN_TYPE long double
@@ -79,8 +98,33 @@ typedef struct {
 	char* bump_ptr;
 } mara_arena_snapshot_t;
 
+typedef struct {
+	size_t limit;
+	size_t used;
+	// While over the limit, calls are blocked by emptying the stack frame
+	// range of the owning context so the fast paths need no extra check
+	struct mara_stack_frame_s* stack_frames_end;
+	// Set by the innermost call: a chunk which would go over the limit is not
+	// acquired and the call fails instead.
+	// When NULL, the chunk is acquired and later calls fail.
+	jmp_buf* recovery_point;
+} mara_memory_quota_t;
+
+// Free chunks binned by size: bin i holds chunks of at least
+// alloc_chunk_size * 2^i bytes and the last bin holds everything bigger
+typedef struct {
+	mara_arena_chunk_t* free_chunks[MARA_NUM_CHUNK_BINS];
+	size_t free_chunk_bytes;
+} mara_chunk_cache_t;
+
 typedef struct {
 	mara_arena_chunk_t* current_chunk;
+	// Size of the next chunk, doubled every time a chunk is added
+	size_t next_chunk_size;
+	// NULL when not accounted
+	mara_memory_quota_t* quota;
+	// Cache owned by a single thread, NULL to use the shared cache of the env
+	mara_chunk_cache_t* chunk_cache;
 } mara_arena_t;
 
 typedef enum mara_obj_type_e {
@@ -90,10 +134,17 @@ typedef enum mara_obj_type_e {
 	MARA_OBJ_TYPE_MAP,
 	MARA_OBJ_TYPE_VM_FN,
 	MARA_OBJ_TYPE_NATIVE_FN,
+	MARA_OBJ_TYPE_PMAP,
+	MARA_OBJ_TYPE_PVEC,
+	MARA_OBJ_TYPE_RECORD,
+	MARA_OBJ_TYPE_ARRAY,
 } mara_obj_type_t;
 
 typedef struct {
 	mara_obj_type_t type;
+	// Set on containers copied into the permanent zone since every context
+	// may read them at the same time
+	bool frozen;
 	mara_zone_t* zone;
 	_Alignas(MARA_ALIGN_TYPE) char body[];
 } mara_obj_t;
@@ -103,24 +154,162 @@ typedef struct {
 	void* value;
 } mara_ref_t;
 
-typedef struct mara_map_node_s {
+// The content of a string never changes so its hash is computed on creation
+typedef struct {
+	mara_str_t str;
+	uint64_t hash;
+} mara_str_obj_t;
+
+typedef struct mara_map_shape_s mara_map_shape_t;
+
+// Inline caches point at a field so that a hit takes a single load
+typedef struct {
+	mara_value_t key;
+	const mara_map_shape_t* shape;
+} mara_map_field_t;
+
+// Maps which got the same symbol keys in the same order share a shape.
+// Shapes live in the permanent zone and never change once published.
+struct mara_map_shape_s {
+	mara_index_t num_fields;
+	mara_map_field_t fields[];
+};
+
+typedef struct mara_shape_transition_s {
+	struct {
+		const mara_map_shape_t* shape;
+		mara_value_t key;
+	} key;
+	struct mara_shape_transition_s* children[BHAMT_NUM_CHILDREN];
+
+	const mara_map_shape_t* shape;
+} mara_shape_transition_t;
+
+typedef struct {
+	const mara_map_shape_t* shape;
 	mara_value_t key;
-	struct mara_map_node_s* children[BHAMT_NUM_CHILDREN];
+	const mara_map_shape_t* next_shape;
+} mara_shape_cache_entry_t;
 
+typedef const mara_map_field_t* mara_inline_cache_t;
+
+// Deleted entries have a tombstone key
+typedef struct {
+	uint64_t hash;
+	mara_value_t key;
 	mara_value_t value;
-	struct mara_map_node_s* next;
-} mara_map_node_t;
+} mara_map_entry_t;
 
+// A map with only symbol keys starts with a shape and stores its values in
+// a flat array where deleted fields are nil.
+// Otherwise, entries are kept in insertion order.
+// Maps larger than MARA_MAP_MAX_LINEAR_ENTRIES are indexed by a table of
+// MARA_MAP_GROUP_SIZE-byte groups of control bytes probed in parallel.
 struct mara_map_s {
 	mara_index_t len;
-	mara_map_node_t* root;
+	mara_index_t num_entries;
+	mara_index_t capacity;
+	// Entries are not moved while an iteration is in progress
+	mara_index_t num_iterators;
+	mara_index_t group_mask;
+	mara_index_t num_used_slots;
+	const mara_map_shape_t* shape;
+	mara_value_t* values;
+	mara_map_entry_t* entries;
+	uint8_t* ctrl;
+	mara_index_t* slots;
 };
 
+// Record types are interned per env by name and fields so the same
+// declaration always yields the same type
+typedef struct {
+	mara_value_t name;
+	mara_index_t num_fields;
+	mara_value_t fields[];
+} mara_record_type_t;
+
+typedef struct mara_record_type_node_s {
+	struct {
+		mara_value_t name;
+		mara_index_t num_fields;
+		const mara_value_t* fields;
+	} key;
+	struct mara_record_type_node_s* children[BHAMT_NUM_CHILDREN];
+
+	const mara_record_type_t* type;
+} mara_record_type_node_t;
+
+// Lives on the stack of the context loading the module
+typedef struct mara_module_load_s {
+	struct mara_module_load_s* next;
+	mara_value_t module_name;
+	mara_exec_ctx_t* ctx;
+} mara_module_load_t;
+
+// The fields are allocated together with the object header
+typedef struct {
+	const mara_record_type_t* type;
+	mara_value_t fields[];
+} mara_record_t;
+
+typedef struct mara_array_kernels_s mara_array_kernels_t;
+
+struct mara_array_s {
+	mara_array_type_t type;
+	mara_index_t len;
+	_Alignas(MARA_ALIGN_TYPE) char data[];
+};
+
+// A slice points into the elements of another list.
+// Slicing marks both lists as shared and whichever is written first copies
+// its elements, so neither sees the other's writes.
 struct mara_list_s {
-	bool in_zone;
 	mara_index_t len;
 	mara_index_t capacity;
 	mara_value_t* elems;
+	bool shared;
+};
+
+// Persistent containers are never modified after they are built.
+// Every node records its zone and only refers to nodes and values which live
+// at least as long, so a copy can stop at the first node that already
+// outlives the target zone.
+
+typedef struct {
+	mara_value_t key;
+	mara_value_t value;
+} mara_pmap_entry_t;
+
+// Compressed HAMT node: entries followed by children, both ordered by
+// their bit in the bitmaps
+typedef struct mara_pmap_node_s {
+	mara_zone_t* zone;
+	uint32_t datamap;
+	uint32_t nodemap;
+	// Only set once the hash is exhausted, the entries are then unordered
+	mara_index_t num_collisions;
+	mara_pmap_entry_t entries[];
+} mara_pmap_node_t;
+
+struct mara_pmap_s {
+	mara_index_t len;
+	mara_pmap_node_t* root;
+};
+
+typedef struct mara_pvec_node_s {
+	mara_zone_t* zone;
+	union {
+		struct mara_pvec_node_s* children[MARA_PVEC_BRANCHES];
+		mara_value_t elems[MARA_PVEC_BRANCHES];
+	};
+} mara_pvec_node_t;
+
+// Radix tree of full leaves, new elements go into the tail first
+struct mara_pvec_s {
+	mara_index_t len;
+	mara_index_t shift;
+	mara_pvec_node_t* root;
+	mara_pvec_node_t* tail;
 };
 
 typedef struct {
@@ -153,10 +342,14 @@ typedef struct {
 	mara_index_t children[BHAMT_NUM_CHILDREN];
 } mara_symtab_node_t;
 
+// Nodes are stored in segments which never move so lookups can proceed
+// without a lock while another thread is inserting.
+// Segment i holds MARA_SYMTAB_FIRST_SEGMENT_SIZE << i nodes.
 typedef struct {
-	mara_index_t capacity;
 	mara_index_t len;
-	mara_symtab_node_t* nodes;
+	mara_symtab_node_t* segments[MARA_SYMTAB_NUM_SEGMENTS];
+	mara_arena_t key_arena;
+	mara_mutex_t insert_lock;
 } mara_symtab_t;
 
 typedef struct {
@@ -169,12 +362,23 @@ typedef struct mara_zone_bookmark_s {
 	struct mara_zone_bookmark_s* previous_bookmark;
 } mara_zone_bookmark_t;
 
+typedef struct mara_page_region_s mara_page_region_t;
+
+typedef struct mara_compiler_s mara_compiler_t;
+
+typedef struct mara_compile_cache_entry_s mara_compile_cache_entry_t;
+
 typedef struct mara_module_loader_entry_s {
 	struct mara_module_loader_entry_s* next;
 
 	mara_value_t loader;
 } mara_module_loader_entry_t;
 
+struct mara_snapshot_s {
+	mara_list_t* module_loaders;
+	mara_value_t data;
+};
+
 // VM types
 
 #define MARA_OPCODE(X) \
@@ -196,6 +400,7 @@ typedef struct mara_module_loader_entry_s {
 	X(JUMP) \
 	X(JUMP_IF_FALSE) \
 	X(MAKE_CLOSURE) \
+	X(MAKE_RETURN_CLOSURE) \
 	X(CALL_CAPTURE) \
 	X(CALL_ARG) \
 	X(CALL_LOCAL) \
@@ -207,8 +412,13 @@ typedef struct mara_module_loader_entry_s {
 	X(SUB) \
 	X(NEG) \
 	X(MAKE_LIST) \
+	X(MAKE_RETURN_LIST) \
 	X(PUT) \
 	X(GET) \
+	X(MAKE_RECORD) \
+	X(MAKE_RETURN_RECORD) \
+	X(RECORD_GET) \
+	X(RECORD_SET) \
 
 #define MARA_DEFINE_OPCODE_ENUM(X) \
 	MARA_OP_##X,
@@ -238,6 +448,13 @@ typedef struct mara_function_s {
 
 	mara_index_t num_functions;
 	struct mara_function_s** functions;
+
+	// One per GET and PUT, they only point to shapes
+	mara_index_t num_inline_caches;
+	mara_inline_cache_t* inline_caches;
+
+	mara_index_t num_record_types;
+	const mara_record_type_t** record_types;
 } mara_vm_function_t;
 
 struct mara_fn_s {
@@ -265,6 +482,16 @@ struct mara_stack_frame_s {
 	mara_index_t size;
 };
 
+// A stack frame and call zone reused to call one function many times.
+// The context must not be used for anything else until the call ends.
+typedef struct {
+	mara_fn_t* fn;
+	mara_zone_t* zone;
+	mara_zone_t* call_zone;
+	mara_stack_frame_t* stack_frame;
+	mara_index_t argc;
+} mara_repeat_call_t;
+
 // Public types
 
 struct mara_zone_s {
@@ -275,9 +502,30 @@ struct mara_zone_s {
 
 struct mara_env_s {
 	mara_env_options_t options;
-	mara_arena_chunk_t* free_chunks;
+	// Guards the shared chunk cache and the page allocator
+	mara_mutex_t chunk_lock;
+	mara_chunk_cache_t chunk_cache;
+	// Trimmed chunks whose pages were handed back to the OS
+	mara_arena_chunk_t* decommitted_chunks;
+	mara_page_region_t* page_regions;
+	// Guards everything else shared between contexts: the permanent zone,
+	// free contexts, the module cache, shape transitions, record types, the
+	// compiler and the compile cache
+	mara_mutex_t lock;
 	mara_exec_ctx_t* free_contexts;
 	mara_map_t* module_cache;
+	// Modules marked as being loaded in the cache and who loads them
+	mara_module_load_t* module_loads;
+	// Signaled whenever a module stops being loaded
+	mara_cond_t module_loaded;
+	mara_shape_transition_t* shape_transitions;
+	mara_record_type_node_t* record_types;
+	// Picked for the CPU when the env is created
+	const mara_array_kernels_t* array_kernels;
+	mara_compiler_t* compiler;
+	mara_compile_cache_entry_t* compile_cache;
+	mara_index_t compile_cache_num_sets;
+	uint64_t compile_cache_clock;
 	mara_zone_t permanent_zone;
 	mara_strpool_t permanent_strpool;
 	mara_symtab_t symtab;
@@ -299,17 +547,29 @@ struct mara_exec_ctx_s {
 	mara_stack_frame_t* stack_frames_end;
 	const mara_source_info_t** native_debug_info;
 
+	const mara_snapshot_t* snapshot;
 	mara_list_t* module_loaders;
 	mara_map_t* current_module;
 	mara_module_options_t current_module_options;
+	// The context loading a module this one waits for, guarded by the env lock
+	mara_exec_ctx_t* waiting_for_module_of;
 
 	mara_error_t last_error;
 	mara_zone_t error_zone;
+	mara_memory_quota_t memory_quota;
+	mara_chunk_cache_t chunk_cache;
 
 	mara_arena_t debug_info_arena;
 	mara_strpool_t debug_info_strpool;
 	mara_debug_info_map_t debug_info_map;
 
+	// Transitions looked up without taking the env lock
+	mara_shape_cache_entry_t shape_cache[MARA_SHAPE_CACHE_SIZE];
+
+	// Short strings read by mara_value_to_str, reused in turn
+	mara_small_str_buf_t small_str_scratch[MARA_SMALL_STR_SCRATCH_SIZE];
+	mara_index_t small_str_scratch_index;
+
 	mara_vm_state_t vm_state;
 };
 
@@ -324,12 +584,34 @@ mara_free(mara_allocator_t allocator, void* ptr);
 void*
 mara_realloc(mara_allocator_t allocator, void* ptr, size_t new_size);
 
+void
+mara_quota_charge(mara_memory_quota_t* quota, size_t size);
+
+// Jump back to the recovery point of the quota with a memory error
+_Noreturn void
+mara_quota_fail(mara_memory_quota_t* quota);
+
+void
+mara_quota_refund(mara_memory_quota_t* quota, size_t size);
+
+void
+mara_chunk_cache_flush(mara_env_t* env, mara_chunk_cache_t* cache);
+
 void*
 mara_arena_alloc(mara_env_t* env, mara_arena_t* arena, size_t size);
 
 void*
 mara_arena_alloc_ex(mara_env_t* env, mara_arena_t* arena, size_t size, size_t align);
 
+bool
+mara_arena_try_extend(
+	mara_env_t* env,
+	mara_arena_t* arena,
+	void* ptr,
+	size_t old_size,
+	size_t new_size
+);
+
 mara_arena_snapshot_t
 mara_arena_snapshot(mara_env_t* env, mara_arena_t* arena);
 
@@ -339,6 +621,20 @@ mara_arena_restore(mara_env_t* env, mara_arena_t* arena, mara_arena_snapshot_t s
 void
 mara_arena_reset(mara_env_t* env, mara_arena_t* arena);
 
+// Page allocator
+
+bool
+mara_page_alloc_supported(void);
+
+mara_arena_chunk_t*
+mara_page_alloc_chunk(mara_env_t* env, size_t size);
+
+void
+mara_page_decommit_chunk(mara_env_t* env, mara_arena_chunk_t* chunk);
+
+void
+mara_page_alloc_cleanup(mara_env_t* env);
+
 // Zone
 
 mara_zone_t*
@@ -353,6 +649,10 @@ mara_zone_cleanup(mara_env_t* env, mara_zone_t* zone);
 void
 mara_add_finalizer(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_callback_t callback);
 
+// Allocate in the permanent zone while holding the env lock
+void*
+mara_permanent_alloc(mara_exec_ctx_t* ctx, size_t size, size_t alignment);
+
 mara_zone_snapshot_t
 mara_zone_snapshot(mara_exec_ctx_t* ctx);
 
@@ -364,6 +664,13 @@ mara_zone_restore(mara_exec_ctx_t* ctx, mara_zone_snapshot_t snapshot);
 mara_obj_t*
 mara_alloc_obj(mara_exec_ctx_t* ctx, mara_zone_t* zone, size_t size);
 
+// Characters are stored right after the string and the hash is left unset
+mara_str_obj_t*
+mara_alloc_str_obj(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_index_t len);
+
+mara_value_t
+mara_copy_str(mara_exec_ctx_t* ctx, mara_zone_t* zone, const mara_str_obj_t* str);
+
 bool
 mara_value_is_obj(mara_value_t value);
 
@@ -378,6 +685,10 @@ mara_header_of(void* obj) {
 mara_value_t
 mara_obj_to_value(mara_obj_t* obj);
 
+// Fails with core/frozen when the value is a frozen container
+mara_error_t*
+mara_check_mutable(mara_exec_ctx_t* ctx, mara_value_t container);
+
 mara_str_t
 mara_vsnprintf(mara_exec_ctx_t* ctx, mara_zone_t* zone, const char* fmt, va_list args);
 
@@ -390,6 +701,15 @@ mara_tombstone(void);
 bool
 mara_value_is_tombstone(mara_value_t value);
 
+uint64_t
+mara_hash_value(mara_value_t value);
+
+uint64_t
+mara_hash_str(mara_str_t str);
+
+bool
+mara_value_equal(mara_value_t lhs, mara_value_t rhs);
+
 MARA_PRIVATE const char*
 mara_value_type_name(mara_value_type_t type) {
 	switch (type) {
@@ -413,6 +733,14 @@ mara_value_type_name(mara_value_type_t type) {
 			return "list";
 		case MARA_VAL_MAP:
 			return "map";
+		case MARA_VAL_PMAP:
+			return "pmap";
+		case MARA_VAL_PVEC:
+			return "pvec";
+		case MARA_VAL_RECORD:
+			return "record";
+		case MARA_VAL_ARRAY:
+			return "array";
 		default:
 			mara_assert(false, "Invalid type");
 			return "";
@@ -433,6 +761,9 @@ mara_symtab_lookup(mara_symtab_t* symtab, mara_index_t id);
 void
 mara_symtab_cleanup(mara_env_t* env, mara_symtab_t* symtab);
 
+void
+mara_symtab_destroy(mara_env_t* env, mara_symtab_t* symtab);
+
 // Debug
 
 mara_debug_info_key_t
@@ -451,6 +782,186 @@ mara_get_debug_info(mara_exec_ctx_t* ctx, mara_debug_info_key_t key);
 mara_stacktrace_t*
 mara_build_stacktrace(mara_exec_ctx_t* ctx);
 
+// VM
+
+// Every call made through repeat_call passes argc arguments
+mara_error_t*
+mara_begin_repeat_call(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_fn_t* fn,
+	mara_index_t argc,
+	mara_repeat_call_t* call
+);
+
+mara_error_t*
+mara_repeat_call(
+	mara_exec_ctx_t* ctx,
+	mara_repeat_call_t* call,
+	mara_value_t* argv,
+	mara_value_t* result
+);
+
+void
+mara_end_repeat_call(mara_exec_ctx_t* ctx, mara_repeat_call_t* call);
+
+// Compile cache
+
+void
+mara_compile_cache_init(mara_env_t* env);
+
+void
+mara_compile_cache_clear(mara_env_t* env);
+
+void
+mara_compile_cache_cleanup(mara_env_t* env);
+
+// Maps
+
+typedef struct {
+	mara_map_t* map;
+	mara_index_t index;
+} mara_map_itr_t;
+
+extern const mara_map_shape_t mara_empty_shape;
+
+// Deleted entries are skipped
+MARA_PRIVATE bool
+mara_map_itr_next(mara_map_itr_t* itr, mara_value_t* key, mara_value_t* value) {
+	mara_map_t* map = itr->map;
+	if (map->shape != NULL) {
+		while (itr->index < map->shape->num_fields) {
+			mara_index_t index = itr->index++;
+			if (!mara_value_is_nil(map->values[index])) {
+				*key = map->shape->fields[index].key;
+				*value = map->values[index];
+				return true;
+			}
+		}
+	} else {
+		while (itr->index < map->num_entries) {
+			mara_map_entry_t* entry = &map->entries[itr->index++];
+			if (!mara_value_is_tombstone(entry->key)) {
+				*key = entry->key;
+				*value = entry->value;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Returns the shape with key appended
+const mara_map_shape_t*
+mara_map_shape_add(mara_exec_ctx_t* ctx, const mara_map_shape_t* shape, mara_value_t key);
+
+// The cached paths of GET and PUT.
+// They return false when the container is not a map with a shape.
+bool
+mara_map_get_cached(
+	mara_value_t container,
+	mara_value_t key,
+	mara_inline_cache_t* cache,
+	mara_value_t* result
+);
+
+bool
+mara_map_put_cached(
+	mara_exec_ctx_t* ctx,
+	mara_value_t container,
+	mara_value_t key,
+	mara_value_t value,
+	mara_inline_cache_t* cache,
+	mara_value_t* result
+);
+
+// Packed arrays
+
+// SIMD kernels for the best instruction set the CPU supports
+const mara_array_kernels_t*
+mara_array_select_kernels(void);
+
+// Records
+
+const mara_record_type_t*
+mara_intern_record_type(
+	mara_exec_ctx_t* ctx,
+	mara_value_t name,
+	mara_index_t num_fields,
+	const mara_value_t* fields
+);
+
+// The fields are copied from values
+mara_record_t*
+mara_new_record(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	const mara_record_type_t* type,
+	const mara_value_t* values
+);
+
+MARA_PRIVATE mara_index_t
+mara_record_find_field(const mara_record_type_t* type, mara_value_t field) {
+	for (mara_index_t i = 0; i < type->num_fields; ++i) {
+		if (type->fields[i].internal == field.internal) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Persistent containers
+
+typedef struct {
+	mara_pmap_node_t* nodes[MARA_PMAP_MAX_DEPTH];
+	mara_index_t positions[MARA_PMAP_MAX_DEPTH];
+	mara_index_t depth;
+} mara_pmap_itr_t;
+
+MARA_PRIVATE mara_index_t
+mara_popcount32(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcount(bits);
+#else
+	mara_index_t count = 0;
+	for (; bits != 0; bits &= bits - 1) { ++count; }
+	return count;
+#endif
+}
+
+MARA_PRIVATE mara_index_t
+mara_pmap_node_num_entries(const mara_pmap_node_t* node) {
+	return node->num_collisions > 0
+		? node->num_collisions
+		: mara_popcount32(node->datamap);
+}
+
+MARA_PRIVATE mara_pmap_node_t**
+mara_pmap_node_children(mara_pmap_node_t* node) {
+	return (mara_pmap_node_t**)(node->entries + mara_pmap_node_num_entries(node));
+}
+
+mara_pmap_node_t*
+mara_pmap_alloc_node(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t num_entries,
+	mara_index_t num_children
+);
+
+void
+mara_pmap_itr_init(mara_pmap_itr_t* itr, mara_pmap_t* map);
+
+mara_pmap_entry_t*
+mara_pmap_itr_next(mara_pmap_itr_t* itr);
+
+// Serialization
+
+// Code images are loaded in place from buffers with this alignment
+#define MARA_IMAGE_ALIGNMENT 8
+
 // String pool
 
 mara_str_t
@@ -1,10 +1,6 @@
 #include "internal.h"
 #include <mara/utils.h>
-
-MARA_PRIVATE void
-mara_list_free(mara_env_t* env, void* userdata) {
-	mara_free(env->options.allocator, ((mara_list_t*)userdata)->elems);
-}
+#include "vm_intrinsics.h"
 
 MARA_PRIVATE void
 mara_list_reserve(
@@ -15,37 +11,52 @@ mara_list_reserve(
 	mara_assert(new_capacity >= 0, "Invalid capacity");
 	mara_assert(new_capacity > obj->capacity, "Unnecessary expand");
 
-	if (obj->in_zone) {
-		mara_value_t* new_elems = mara_malloc(
-			ctx->env->options.allocator,
-			sizeof(mara_value_t) * new_capacity
-		);
+	mara_zone_t* zone = mara_header_of(obj)->zone;
+	size_t old_size = sizeof(mara_value_t) * obj->capacity;
+	size_t new_size = sizeof(mara_value_t) * new_capacity;
+
+	// A list being built is usually the last thing allocated in its zone
+	if (
+		obj->elems == NULL
+		|| !mara_arena_try_extend(ctx->env, &zone->arena, obj->elems, old_size, new_size)
+	) {
+		mara_value_t* new_elems = mara_zone_alloc_ex(ctx, zone, new_size, _Alignof(mara_value_t));
 		mara_assert(new_elems, "Out of memory");
-		memcpy(new_elems, obj->elems, sizeof(mara_value_t) * obj->len);
+		if (obj->len > 0) {
+			memcpy(new_elems, obj->elems, sizeof(mara_value_t) * obj->len);
+		}
 		obj->elems = new_elems;
+	}
 
-		mara_obj_t* header = mara_container_of(obj, mara_obj_t, body);
-		mara_add_finalizer(ctx, header->zone, (mara_callback_t){
-			.fn = mara_list_free,
-			.userdata = obj,
-		});
-		obj->in_zone = false;
-	} else {
-		obj->elems = mara_realloc(
-			ctx->env->options.allocator,
-			obj->elems,
-			sizeof(mara_value_t) * new_capacity
+	obj->capacity = new_capacity;
+}
+
+// Take a private copy of the elements before the first write to a slice
+MARA_PRIVATE void
+mara_list_unshare(mara_exec_ctx_t* ctx, mara_list_t* list) {
+	mara_assert(!mara_header_of(list)->frozen, "List is frozen");
+	if (MARA_EXPECT(!list->shared)) { return; }
+
+	mara_value_t* elems = NULL;
+	if (list->len > 0) {
+		elems = mara_zone_alloc_ex(
+			ctx, mara_header_of(list)->zone,
+			sizeof(mara_value_t) * list->len, _Alignof(mara_value_t)
 		);
-		mara_assert(obj->elems, "Out of memory");
+		mara_assert(elems != NULL, "Out of memory");
+		memcpy(elems, list->elems, sizeof(mara_value_t) * list->len);
 	}
 
-	obj->capacity = new_capacity;
+	list->elems = elems;
+	list->capacity = list->len;
+	list->shared = false;
 }
 
 MARA_PRIVATE mara_value_t
 mara_list_do_set(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t index, mara_value_t value) {
 	mara_obj_t* header = mara_header_of(list);
 	mara_value_t copy = mara_copy(ctx, header->zone, value);
+	mara_list_unshare(ctx, list);
 	mara_value_t old_value = list->elems[index];
 	list->elems[index] = copy;
 	return old_value;
@@ -64,7 +75,6 @@ mara_new_list(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_index_t initial_capa
 	*list = (mara_list_t){
 		.capacity = initial_capacity,
 		.len = 0,
-		.in_zone = true,
 	};
 	if (initial_capacity > 0) {
 		list->elems = mara_zone_alloc_ex(
@@ -108,11 +118,12 @@ mara_list_set(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t index, mara_
 
 void
 mara_list_push(mara_exec_ctx_t* ctx, mara_list_t* list, mara_value_t value) {
-	mara_index_t current_capacity = list->capacity;
 	mara_obj_t* header = mara_header_of(list);
 
 	mara_value_t copy = mara_copy(ctx, header->zone, value);
+	mara_list_unshare(ctx, list);
 
+	mara_index_t current_capacity = list->capacity;
 	if (list->len >= current_capacity) {
 		mara_index_t new_capacity = current_capacity > 0 ? current_capacity * 2 : 4;
 		mara_list_reserve(ctx, list, new_capacity);
@@ -123,8 +134,8 @@ mara_list_push(mara_exec_ctx_t* ctx, mara_list_t* list, mara_value_t value) {
 
 mara_value_t
 mara_list_delete(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t index) {
-	(void)ctx;
 	if (MARA_EXPECT(0 <= index && index < list->len)) {
+		mara_list_unshare(ctx, list);
 		mara_value_t old_value = list->elems[index];
 		memmove(
 			list->elems + index,
@@ -140,8 +151,8 @@ mara_list_delete(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t index) {
 
 mara_value_t
 mara_list_swap_delete(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t index) {
-	(void)ctx;
 	if (MARA_EXPECT(0 <= index && index < list->len)) {
+		mara_list_unshare(ctx, list);
 		mara_value_t old_value = list->elems[index];
 		list->elems[index] = list->elems[list->len - 1];
 		list->len -= 1;
@@ -154,6 +165,7 @@ mara_list_swap_delete(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t inde
 void
 mara_list_resize(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t new_len) {
 	new_len = mara_max(0, new_len);
+	mara_list_unshare(ctx, list);
 	if (new_len <= list->len) {
 		list->len = new_len;
 	} else if (new_len <= list->capacity) {
@@ -170,25 +182,169 @@ mara_list_resize(mara_exec_ctx_t* ctx, mara_list_t* list, mara_index_t new_len)
 	}
 }
 
+mara_list_t*
+mara_list_slice(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_list_t* list,
+	mara_index_t start,
+	mara_index_t end
+) {
+	end = mara_min(mara_max(end, 0), list->len);
+	start = mara_min(mara_max(start, 0), end);
+	mara_index_t len = end - start;
+
+	mara_zone_t* list_zone = mara_header_of(list)->zone;
+	if (list_zone->level > zone->level) {
+		// The elements would not outlive the slice
+		mara_list_t* copy = mara_new_list(ctx, zone, len);
+		for (mara_index_t i = 0; i < len; ++i) {
+			copy->elems[i] = mara_copy(ctx, zone, list->elems[start + i]);
+		}
+		copy->len = len;
+		return copy;
+	}
+
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_list_t));
+	obj->type = MARA_OBJ_TYPE_LIST;
+
+	mara_list_t* slice = (mara_list_t*)obj->body;
+	*slice = (mara_list_t){
+		.len = len,
+		.capacity = len,
+		.elems = len > 0 ? list->elems + start : NULL,
+		.shared = len > 0,
+	};
+	// Both sides copy on their first write so neither sees the other's
+	// changes, including a growth or delete which moves the elements.
+	// A frozen list is never written to.
+	if (len > 0 && !mara_header_of(list)->frozen) {
+		list->shared = true;
+	}
+
+	return slice;
+}
+
 mara_error_t*
 mara_list_foreach(mara_exec_ctx_t* ctx, mara_list_t* list, mara_fn_t* fn) {
-	mara_index_t len = list->len;
 	mara_value_t list_value = mara_value_from_list(list);
-	for (mara_index_t i = 0; i < len; ++i) {
+	mara_repeat_call_t call;
+	mara_check_error(mara_begin_repeat_call(ctx, ctx->current_zone, fn, 3, &call));
+
+	mara_error_t* error = NULL;
+	// The function may resize the list
+	for (mara_index_t i = 0; i < list->len; ++i) {
 		mara_value_t args[] = {
 			list->elems[i],
 			mara_value_from_int(i),
 			list_value,
 		};
 		mara_value_t should_continue = mara_nil();
-		mara_check_error(
-			mara_call(ctx, ctx->current_zone, fn, mara_count_of(args), args, &should_continue)
-		);
+		if ((error = mara_repeat_call(ctx, &call, args, &should_continue)) != NULL) {
+			break;
+		}
 
 		if (mara_value_is_false(should_continue)) {
 			break;
 		}
 	}
 
+	mara_end_repeat_call(ctx, &call);
+	return error;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_list_less(
+	mara_exec_ctx_t* ctx,
+	mara_repeat_call_t* call,
+	mara_value_t lhs,
+	mara_value_t rhs,
+	bool* less
+) {
+	mara_value_t args[] = { lhs, rhs };
+	mara_value_t result;
+	if (call != NULL) {
+		mara_check_error(mara_repeat_call(ctx, call, args, &result));
+	} else {
+		mara_check_error(mara_intrin_lt(ctx, 2, args, mara_nil(), &result));
+	}
+
+	*less = !mara_value_is_nil(result) && !mara_value_is_false(result);
 	return NULL;
 }
+
+// Bottom-up merge sort between two buffers.
+// Taking from the right run only when it is strictly less keeps it stable.
+MARA_PRIVATE mara_error_t*
+mara_list_merge_sort(
+	mara_exec_ctx_t* ctx,
+	mara_repeat_call_t* call,
+	mara_index_t len,
+	mara_value_t* elems,
+	mara_value_t* buf,
+	mara_value_t** sorted
+) {
+	mara_value_t* src = elems;
+	mara_value_t* dst = buf;
+	for (mara_index_t width = 1; width < len; width *= 2) {
+		for (mara_index_t start = 0; start < len; start += width * 2) {
+			mara_index_t mid = start + width < len ? start + width : len;
+			mara_index_t end = mid + width < len ? mid + width : len;
+			mara_index_t left = start;
+			mara_index_t right = mid;
+			mara_index_t out = start;
+			while (left < mid && right < end) {
+				bool less;
+				mara_check_error(mara_list_less(ctx, call, src[right], src[left], &less));
+				dst[out++] = less ? src[right++] : src[left++];
+			}
+			while (left < mid) { dst[out++] = src[left++]; }
+			while (right < end) { dst[out++] = src[right++]; }
+		}
+
+		mara_value_t* tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	*sorted = src;
+	return NULL;
+}
+
+mara_error_t*
+mara_list_sort(mara_exec_ctx_t* ctx, mara_list_t* list, mara_fn_t* less_fn) {
+	mara_check_error(mara_check_mutable(ctx, mara_value_from_list(list)));
+	mara_index_t len = list->len;
+	if (len < 2) { return NULL; }
+
+	// Sort a copy so the list is left untouched if the comparator fails
+	mara_zone_t* local_zone = mara_zone_enter(ctx);
+	mara_assert(local_zone != NULL, "Could not allocate local zone");
+	mara_value_t* elems = mara_zone_alloc_ex(
+		ctx, local_zone, sizeof(mara_value_t) * len * 2, _Alignof(mara_value_t)
+	);
+	mara_assert(elems != NULL, "Out of memory");
+	memcpy(elems, list->elems, sizeof(mara_value_t) * len);
+
+	mara_error_t* error = NULL;
+	mara_value_t* sorted = NULL;
+	if (less_fn != NULL) {
+		mara_repeat_call_t call;
+		error = mara_begin_repeat_call(ctx, local_zone, less_fn, 2, &call);
+		if (error == NULL) {
+			error = mara_list_merge_sort(ctx, &call, len, elems, elems + len, &sorted);
+			mara_end_repeat_call(ctx, &call);
+		}
+	} else {
+		error = mara_list_merge_sort(ctx, NULL, len, elems, elems + len, &sorted);
+	}
+
+	if (error == NULL) {
+		// The comparator may have resized the list
+		mara_list_unshare(ctx, list);
+		memcpy(list->elems, sorted, sizeof(mara_value_t) * (len < list->len ? len : list->len));
+	}
+
+	mara_zone_exit(ctx, local_zone);
+	return error;
+}
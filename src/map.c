@@ -1,28 +1,57 @@
 #include "internal.h"
 #include "xxhash.h"
 
-#define BHAMT_KEYEQ(lhs, rhs) mara_value_equal(lhs, rhs)
-#define BHAMT_IS_TOMBSTONE(value) mara_value_is_tombstone((value)->key)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define MARA_MAP_SSE2
+#	include <emmintrin.h>
+#endif
 
-MARA_PRIVATE BHAMT_HASH_TYPE
+#if defined(__GNUC__) || defined(__clang__)
+#	define MARA_MAP_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#	define MARA_MAP_PREFETCH(ptr) (void)(ptr)
+#endif
+
+#define MARA_MAP_GET_MANY_BATCH 16
+
+// Full slots hold the top 7 bits of the hash so the high bit marks a free slot
+#define MARA_MAP_CTRL_EMPTY 0x80
+#define MARA_MAP_CTRL_DELETED 0xfe
+
+// Finalizer of MurmurHash3, enough to spread immediates and pointers
+MARA_PRIVATE uint64_t
+mara_mix_hash(uint64_t bits) {
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdULL;
+	bits ^= bits >> 33;
+	bits *= 0xc4ceb9fe1a85ec53ULL;
+	bits ^= bits >> 33;
+	return bits;
+}
+
+uint64_t
+mara_hash_str(mara_str_t str) {
+	return mara_XXH3_64bits(str.data, str.len);
+}
+
+uint64_t
 mara_hash_value(mara_value_t value) {
 	if (mara_value_is_obj(value)) {
 		mara_obj_t* obj = mara_value_to_obj(value);
 		if (obj->type == MARA_OBJ_TYPE_STRING) {
-			mara_str_t* str = (mara_str_t*)obj->body;
-			return mara_XXH3_64bits(str->data, str->len);
+			return ((mara_str_obj_t*)obj->body)->hash;
 		} else if (obj->type == MARA_OBJ_TYPE_REF) {
 			mara_ref_t* ref = (mara_ref_t*)obj->body;
-			return mara_XXH3_64bits(ref, sizeof(*ref));
+			return mara_mix_hash((uintptr_t)ref->tag ^ mara_mix_hash((uintptr_t)ref->value));
 		} else {
-			return mara_XXH3_64bits(&value, sizeof(value));
+			return mara_mix_hash((uintptr_t)obj);
 		}
 	} else {
-		return mara_XXH3_64bits(&value, sizeof(value));
+		return mara_mix_hash(value.internal);
 	}
 }
 
-MARA_PRIVATE bool
+bool
 mara_value_equal(mara_value_t lhs, mara_value_t rhs) {
 	if (mara_value_is_obj(lhs)) {
 		mara_obj_t* lobj = mara_value_to_obj(lhs);
@@ -33,9 +62,9 @@ mara_value_equal(mara_value_t lhs, mara_value_t rhs) {
 			} else if (lobj->type != robj->type) {
 				return false;
 			} else if (lobj->type == MARA_OBJ_TYPE_STRING) {
-				mara_str_t* lstr = (mara_str_t*)lobj->body;
-				mara_str_t* rstr = (mara_str_t*)robj->body;
-				return mara_str_equal(*lstr, *rstr);
+				mara_str_obj_t* lstr = (mara_str_obj_t*)lobj->body;
+				mara_str_obj_t* rstr = (mara_str_obj_t*)robj->body;
+				return lstr->hash == rstr->hash && mara_str_equal(lstr->str, rstr->str);
 			} else if (lobj->type == MARA_OBJ_TYPE_REF) {
 				mara_ref_t* lref = (mara_ref_t*)lobj->body;
 				mara_ref_t* rref = (mara_ref_t*)robj->body;
@@ -52,16 +81,329 @@ mara_value_equal(mara_value_t lhs, mara_value_t rhs) {
 	}
 }
 
+MARA_PRIVATE mara_index_t
+mara_map_ctz(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctz(bits);
+#else
+	mara_index_t count = 0;
+	for (; (bits & 1) == 0; bits >>= 1) { ++count; }
+	return count;
+#endif
+}
+
+// Bit i is set when control byte i of the group equals tag
+MARA_PRIVATE uint32_t
+mara_map_group_match(const uint8_t* group, uint8_t tag) {
+#ifdef MARA_MAP_SSE2
+	__m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+#else
+	uint32_t mask = 0;
+	for (mara_index_t i = 0; i < MARA_MAP_GROUP_SIZE; ++i) {
+		mask |= (uint32_t)(group[i] == tag) << i;
+	}
+	return mask;
+#endif
+}
+
+// Bit i is set when slot i of the group is empty or deleted
+MARA_PRIVATE uint32_t
+mara_map_group_match_free(const uint8_t* group) {
+#ifdef MARA_MAP_SSE2
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+	uint32_t mask = 0;
+	for (mara_index_t i = 0; i < MARA_MAP_GROUP_SIZE; ++i) {
+		mask |= (uint32_t)(group[i] >> 7) << i;
+	}
+	return mask;
+#endif
+}
+
+MARA_PRIVATE uint8_t
+mara_map_tag(uint64_t hash) {
+	return (uint8_t)(hash >> 57);
+}
+
+MARA_PRIVATE mara_index_t
+mara_map_num_slots(mara_map_t* map) {
+	return (map->group_mask + 1) * MARA_MAP_GROUP_SIZE;
+}
+
+// Returns the slot holding the key or -1
+MARA_PRIVATE mara_index_t
+mara_map_find_slot(mara_map_t* map, uint64_t hash, mara_value_t key) {
+	uint8_t tag = mara_map_tag(hash);
+	mara_index_t group = (mara_index_t)(hash & (uint64_t)map->group_mask);
+	// Triangular probing visits every group when there is a power of 2 of them
+	for (mara_index_t step = 1; ; ++step) {
+		const uint8_t* ctrl = map->ctrl + group * MARA_MAP_GROUP_SIZE;
+		for (
+			uint32_t matches = mara_map_group_match(ctrl, tag);
+			matches != 0;
+			matches &= matches - 1
+		) {
+			mara_index_t slot = group * MARA_MAP_GROUP_SIZE + mara_map_ctz(matches);
+			mara_map_entry_t* entry = &map->entries[map->slots[slot]];
+			if (entry->hash == hash && mara_value_equal(entry->key, key)) {
+				return slot;
+			}
+		}
+
+		if (mara_map_group_match(ctrl, MARA_MAP_CTRL_EMPTY) != 0) {
+			return -1;
+		}
+
+		group = (group + step) & map->group_mask;
+	}
+}
+
+MARA_PRIVATE void
+mara_map_insert_slot(mara_map_t* map, uint64_t hash, mara_index_t entry_index) {
+	mara_index_t group = (mara_index_t)(hash & (uint64_t)map->group_mask);
+	for (mara_index_t step = 1; ; ++step) {
+		uint8_t* ctrl = map->ctrl + group * MARA_MAP_GROUP_SIZE;
+		uint32_t free_slots = mara_map_group_match_free(ctrl);
+		if (free_slots != 0) {
+			mara_index_t slot = group * MARA_MAP_GROUP_SIZE + mara_map_ctz(free_slots);
+			if (map->ctrl[slot] == MARA_MAP_CTRL_EMPTY) {
+				map->num_used_slots += 1;
+			}
+			map->ctrl[slot] = mara_map_tag(hash);
+			map->slots[slot] = entry_index;
+			return;
+		}
+
+		group = (group + step) & map->group_mask;
+	}
+}
+
+// Returns the index of the entry with the key or -1
+MARA_PRIVATE mara_index_t
+mara_map_find(mara_map_t* map, mara_value_t key, uint64_t hash, mara_index_t* slot_out) {
+	if (map->ctrl == NULL) {
+		// Small maps are scanned linearly
+		for (mara_index_t i = 0; i < map->num_entries; ++i) {
+			mara_map_entry_t* entry = &map->entries[i];
+			if (entry->hash == hash && mara_value_equal(entry->key, key)) {
+				return i;
+			}
+		}
+		return -1;
+	} else {
+		mara_index_t slot = mara_map_find_slot(map, hash, key);
+		*slot_out = slot;
+		return slot >= 0 ? map->slots[slot] : -1;
+	}
+}
+
+// Move entries into a new array, dropping deleted ones unless an iteration
+// is in progress, then rebuild the index
+MARA_PRIVATE void
+mara_map_rebuild(mara_exec_ctx_t* ctx, mara_map_t* map, mara_index_t new_capacity) {
+	mara_zone_t* zone = mara_header_of(map)->zone;
+	bool compact = map->num_iterators == 0;
+
+	mara_map_entry_t* entries = map->entries;
+	if (new_capacity != map->capacity) {
+		entries = mara_zone_alloc_ex(
+			ctx, zone,
+			sizeof(mara_map_entry_t) * new_capacity, _Alignof(mara_map_entry_t)
+		);
+		mara_assert(entries != NULL, "Out of memory");
+	}
+
+	mara_index_t num_entries = 0;
+	for (mara_index_t i = 0; i < map->num_entries; ++i) {
+		if (compact && mara_value_is_tombstone(map->entries[i].key)) { continue; }
+		entries[num_entries++] = map->entries[i];
+	}
+	map->entries = entries;
+	map->num_entries = num_entries;
+
+	if (new_capacity > MARA_MAP_MAX_LINEAR_ENTRIES) {
+		// Keep the table at most half full
+		mara_index_t num_groups = 1;
+		while (num_groups * MARA_MAP_GROUP_SIZE < new_capacity * 2) {
+			num_groups *= 2;
+		}
+
+		if (map->ctrl == NULL || num_groups != map->group_mask + 1) {
+			mara_index_t num_slots = num_groups * MARA_MAP_GROUP_SIZE;
+			map->ctrl = mara_zone_alloc_ex(ctx, zone, num_slots, MARA_MAP_GROUP_SIZE);
+			map->slots = mara_zone_alloc_ex(
+				ctx, zone,
+				sizeof(mara_index_t) * num_slots, _Alignof(mara_index_t)
+			);
+			mara_assert(map->ctrl != NULL && map->slots != NULL, "Out of memory");
+			map->group_mask = num_groups - 1;
+		}
+
+		memset(map->ctrl, MARA_MAP_CTRL_EMPTY, mara_map_num_slots(map));
+		map->num_used_slots = 0;
+		for (mara_index_t i = 0; i < num_entries; ++i) {
+			if (mara_value_is_tombstone(entries[i].key)) { continue; }
+			mara_map_insert_slot(map, entries[i].hash, i);
+		}
+	}
+
+	map->capacity = new_capacity;
+}
+
+MARA_PRIVATE mara_index_t
+mara_map_shape_find(const mara_map_shape_t* shape, mara_value_t key) {
+	for (mara_index_t i = 0; i < shape->num_fields; ++i) {
+		if (shape->fields[i].key.internal == key.internal) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+MARA_PRIVATE mara_value_t
+mara_map_set_field(
+	mara_exec_ctx_t* ctx,
+	mara_map_t* map,
+	mara_index_t index,
+	mara_value_t value
+) {
+	mara_value_t old_value = map->values[index];
+	map->values[index] = mara_copy(ctx, mara_header_of(map)->zone, value);
+	map->len += (mara_index_t)mara_value_is_nil(old_value) - (mara_index_t)mara_value_is_nil(value);
+	return old_value;
+}
+
+MARA_PRIVATE void
+mara_map_reserve_fields(mara_exec_ctx_t* ctx, mara_map_t* map, mara_index_t new_capacity) {
+	mara_zone_t* zone = mara_header_of(map)->zone;
+	size_t old_size = sizeof(mara_value_t) * map->capacity;
+	size_t new_size = sizeof(mara_value_t) * new_capacity;
+	if (
+		map->values == NULL
+		|| !mara_arena_try_extend(ctx->env, &zone->arena, map->values, old_size, new_size)
+	) {
+		mara_value_t* values = mara_zone_alloc_ex(ctx, zone, new_size, _Alignof(mara_value_t));
+		mara_assert(values != NULL, "Out of memory");
+		if (map->shape->num_fields > 0) {
+			memcpy(values, map->values, sizeof(mara_value_t) * map->shape->num_fields);
+		}
+		map->values = values;
+	}
+	map->capacity = new_capacity;
+}
+
+MARA_PRIVATE void
+mara_map_add_field(mara_exec_ctx_t* ctx, mara_map_t* map, mara_value_t key, mara_value_t value) {
+	const mara_map_shape_t* shape = map->shape;
+	mara_index_t num_fields = shape->num_fields;
+
+	if (num_fields == map->capacity) {
+		mara_map_reserve_fields(
+			ctx, map,
+			mara_min(map->capacity > 0 ? map->capacity * 2 : 4, MARA_MAP_MAX_SHAPE_FIELDS)
+		);
+	}
+
+	map->values[num_fields] = mara_copy(ctx, mara_header_of(map)->zone, value);
+	map->shape = mara_map_shape_add(ctx, shape, key);
+	map->len += 1;
+}
+
+// Switch to entries for good.
+// Deleted fields become deleted entries so an iteration in progress does
+// not skip anything.
+MARA_PRIVATE void
+mara_map_leave_shape(mara_exec_ctx_t* ctx, mara_map_t* map) {
+	const mara_map_shape_t* shape = map->shape;
+	mara_index_t num_fields = shape->num_fields;
+
+	mara_index_t capacity = 4;
+	while (capacity <= num_fields) {
+		capacity *= 2;
+	}
+	mara_map_entry_t* entries = mara_zone_alloc_ex(
+		ctx, mara_header_of(map)->zone,
+		sizeof(mara_map_entry_t) * capacity, _Alignof(mara_map_entry_t)
+	);
+	mara_assert(entries != NULL, "Out of memory");
+	for (mara_index_t i = 0; i < num_fields; ++i) {
+		mara_value_t key = shape->fields[i].key;
+		mara_value_t value = map->values[i];
+		entries[i] = (mara_map_entry_t){
+			.hash = mara_hash_value(key),
+			.key = mara_value_is_nil(value) ? mara_tombstone() : key,
+			.value = value,
+		};
+	}
+
+	map->shape = NULL;
+	map->values = NULL;
+	map->entries = entries;
+	map->num_entries = num_fields;
+	map->capacity = capacity;
+	mara_map_rebuild(ctx, map, capacity);
+}
+
+// Set a key of a map without a shape given its hash
+MARA_PRIVATE mara_value_t
+mara_map_set_hashed(
+	mara_exec_ctx_t* ctx,
+	mara_map_t* map,
+	mara_value_t key,
+	uint64_t hash,
+	mara_value_t value
+) {
+	mara_zone_t* map_zone = mara_header_of(map)->zone;
+	mara_index_t slot = -1;
+	mara_index_t index = mara_map_find(map, key, hash, &slot);
+	if (index >= 0) {
+		mara_map_entry_t* entry = &map->entries[index];
+		mara_value_t old_value = entry->value;
+		entry->value = mara_copy(ctx, map_zone, value);
+		return old_value;
+	}
+
+	if (map->num_entries == map->capacity) {
+		// Reclaim deleted entries before resorting to growth
+		mara_index_t num_deleted = map->num_entries - map->len;
+		bool can_compact = map->num_iterators == 0 && num_deleted >= map->capacity / 4;
+		mara_map_rebuild(
+			ctx, map,
+			can_compact && num_deleted > 0
+				? map->capacity
+				: (map->capacity > 0 ? map->capacity * 2 : 4)
+		);
+	} else if (
+		map->ctrl != NULL
+		&& map->num_used_slots >= mara_map_num_slots(map) / 4 * 3
+	) {
+		// Too many deleted slots make probing long
+		mara_map_rebuild(ctx, map, map->capacity);
+	}
+
+	index = map->num_entries++;
+	map->entries[index] = (mara_map_entry_t){
+		.hash = hash,
+		.key = mara_copy(ctx, map_zone, key),
+		.value = mara_copy(ctx, map_zone, value),
+	};
+	if (map->ctrl != NULL) {
+		mara_map_insert_slot(map, hash, index);
+	}
+	map->len += 1;
+
+	return mara_nil();
+}
+
 mara_map_t*
 mara_new_map(mara_exec_ctx_t* ctx, mara_zone_t* zone) {
 	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_map_t));
 	obj->type = MARA_OBJ_TYPE_MAP;
 
 	mara_map_t* map = (mara_map_t*)obj->body;
-	*map = (mara_map_t){
-		.len = 0,
-		.root = NULL,
-	};
+	*map = (mara_map_t){ .len = 0 };
 
 	return map;
 }
@@ -74,103 +416,309 @@ mara_map_len(mara_exec_ctx_t* ctx, mara_map_t* map) {
 
 mara_value_t
 mara_map_set(mara_exec_ctx_t* ctx, mara_map_t* map, mara_value_t key, mara_value_t value) {
+	mara_assert(!mara_header_of(map)->frozen, "Map is frozen");
 	if (mara_value_is_nil(value)) {
 		return mara_map_delete(ctx, map, key);
 	}
 
-	mara_map_node_t** itr;
-	mara_map_node_t* head = map->root;
-	mara_map_node_t* free_node;
-	mara_map_node_t* node;
-	BHAMT_HASH_TYPE hash = mara_hash_value(key);
-	BHAMT_SEARCH(map->root, itr, node, free_node, hash, key);
+	// A map starts with a shape if its first key is a symbol
+	if (map->shape == NULL && map->entries == NULL && mara_value_is_sym(key)) {
+		map->shape = &mara_empty_shape;
+	}
 
-	mara_obj_t* header = mara_header_of(map);
-	mara_zone_t* map_zone = header->zone;
-	mara_value_t old_value = mara_nil();
-	if (node == NULL) {
-		if (free_node != NULL) {
-			node = free_node;
+	if (map->shape != NULL) {
+		mara_index_t index = mara_map_shape_find(map->shape, key);
+		if (index >= 0) {
+			return mara_map_set_field(ctx, map, index, value);
+		} else if (mara_value_is_sym(key) && map->shape->num_fields < MARA_MAP_MAX_SHAPE_FIELDS) {
+			mara_map_add_field(ctx, map, key, value);
+			return mara_nil();
 		} else {
-			node = *itr = MARA_ZONE_ALLOC_TYPE(ctx, map_zone, mara_map_node_t);
-			memset(node->children, 0, sizeof(node->children));
-			if (head != NULL) {
-				node->next = head->next;
-				head->next = node;
-			} else {
-				node->next = NULL;
-			}
+			mara_map_leave_shape(ctx, map);
 		}
-
-		map->len += 1;
-		node->key = mara_copy(ctx, map_zone, key);
-	} else {
-		old_value = node->value;
 	}
 
-	node->value = mara_copy(ctx, map_zone, value);
-	return old_value;
+	return mara_map_set_hashed(ctx, map, key, mara_hash_value(key), value);
 }
 
 mara_value_t
 mara_map_get(mara_exec_ctx_t* ctx, mara_map_t* map, mara_value_t key) {
 	(void)ctx;
-	mara_map_node_t* node;
-	BHAMT_HASH_TYPE hash = mara_hash_value(key);
-	BHAMT_GET(map->root, node, hash, key);
-
-	if (node != NULL) {
-		return node->value;
-	} else {
-		return mara_nil();
+	if (map->shape != NULL) {
+		mara_index_t index = mara_map_shape_find(map->shape, key);
+		return index >= 0 ? map->values[index] : mara_nil();
 	}
+
+	uint64_t hash = mara_hash_value(key);
+	mara_index_t slot = -1;
+	mara_index_t index = mara_map_find(map, key, hash, &slot);
+	return index >= 0 ? map->entries[index].value : mara_nil();
 }
 
 mara_value_t
 mara_map_delete(mara_exec_ctx_t* ctx, mara_map_t* map, mara_value_t key) {
-	(void)ctx;
-	mara_map_node_t* node;
-	BHAMT_HASH_TYPE hash = mara_hash_value(key);
-	BHAMT_GET(map->root, node, hash, key);
-
-	if (node != NULL) {
-		mara_value_t old_value = node->value;
-		map->len -= 1;
-		node->key = mara_tombstone();
-		node->value = mara_nil();
-		return old_value;
-	} else {
-		return mara_nil();
+	mara_assert(!mara_header_of(map)->frozen, "Map is frozen");
+	if (map->shape != NULL) {
+		mara_index_t index = mara_map_shape_find(map->shape, key);
+		return index >= 0 ? mara_map_set_field(ctx, map, index, mara_nil()) : mara_nil();
 	}
+
+	uint64_t hash = mara_hash_value(key);
+	mara_index_t slot = -1;
+	mara_index_t index = mara_map_find(map, key, hash, &slot);
+	if (index < 0) { return mara_nil(); }
+
+	mara_map_entry_t* entry = &map->entries[index];
+	mara_value_t old_value = entry->value;
+	entry->key = mara_tombstone();
+	entry->value = mara_nil();
+	map->len -= 1;
+
+	if (map->ctrl != NULL) {
+		// A group with an empty slot never made a probe move on so the slot
+		// can be emptied
+		const uint8_t* group = map->ctrl + (slot / MARA_MAP_GROUP_SIZE) * MARA_MAP_GROUP_SIZE;
+		if (mara_map_group_match(group, MARA_MAP_CTRL_EMPTY) != 0) {
+			map->ctrl[slot] = MARA_MAP_CTRL_EMPTY;
+			map->num_used_slots -= 1;
+		} else {
+			map->ctrl[slot] = MARA_MAP_CTRL_DELETED;
+		}
+	}
+
+	while (
+		map->num_entries > 0
+		&& mara_value_is_tombstone(map->entries[map->num_entries - 1].key)
+	) {
+		map->num_entries -= 1;
+	}
+
+	if (map->num_iterators == 0 && map->num_entries - map->len > map->len) {
+		mara_map_rebuild(ctx, map, map->capacity);
+	}
+
+	return old_value;
 }
 
 mara_error_t*
 mara_map_foreach(mara_exec_ctx_t* ctx, mara_map_t* map, mara_fn_t* fn) {
 	mara_value_t map_value = mara_value_from_map(map);
-	for (
-		mara_map_node_t* itr = map->root;
-		itr != NULL;
-		itr = itr->next
-	) {
-		if (mara_value_is_tombstone(itr->key)) { continue; }
+	mara_error_t* error = NULL;
 
+	map->num_iterators += 1;
+	mara_map_itr_t itr = { .map = map };
+	mara_value_t key, value;
+	while (mara_map_itr_next(&itr, &key, &value)) {
 		mara_value_t args[] = {
-			itr->value,
-			itr->key,
+			value,
+			key,
 			map_value
 		};
 		mara_value_t should_continue = mara_nil();
-		mara_check_error(
-			mara_call(
-				ctx, ctx->current_zone,
-				fn, mara_count_of(args), args, &should_continue
-			)
+		error = mara_call(
+			ctx, ctx->current_zone,
+			fn, mara_count_of(args), args, &should_continue
 		);
 
-		if (mara_value_is_false(should_continue)) {
+		if (error != NULL || mara_value_is_false(should_continue)) {
 			break;
 		}
 	}
+	map->num_iterators -= 1;
+
+	return error;
+}
+
+void
+mara_map_reserve(mara_exec_ctx_t* ctx, mara_map_t* map, mara_index_t capacity) {
+	mara_assert(!mara_header_of(map)->frozen, "Map is frozen");
+	if (map->shape != NULL) {
+		if (capacity <= MARA_MAP_MAX_SHAPE_FIELDS) {
+			if (capacity > map->capacity) {
+				mara_map_reserve_fields(ctx, map, capacity);
+			}
+			return;
+		}
+
+		mara_map_leave_shape(ctx, map);
+	} else if (map->entries == NULL && capacity <= MARA_MAP_MAX_SHAPE_FIELDS) {
+		// Wait for the first key so a small map of symbols still gets a shape
+		return;
+	}
+
+	if (capacity > map->capacity) {
+		mara_map_rebuild(ctx, map, capacity);
+	}
+}
+
+void
+mara_map_merge(mara_exec_ctx_t* ctx, mara_map_t* dst, mara_map_t* src) {
+	mara_assert(!mara_header_of(dst)->frozen, "Map is frozen");
+	if (dst == src || src->len == 0) { return; }
+
+	const mara_map_shape_t* shape = src->shape;
+	if (shape != NULL) {
+		if (dst->shape == NULL && dst->entries == NULL) {
+			// An empty map takes over the shape as is
+			dst->shape = &mara_empty_shape;
+			mara_map_reserve_fields(ctx, dst, shape->num_fields);
+			dst->shape = shape;
+			mara_zone_t* zone = mara_header_of(dst)->zone;
+			for (mara_index_t i = 0; i < shape->num_fields; ++i) {
+				dst->values[i] = mara_copy(ctx, zone, src->values[i]);
+			}
+			dst->len = src->len;
+		} else {
+			for (mara_index_t i = 0; i < shape->num_fields; ++i) {
+				if (mara_value_is_nil(src->values[i])) { continue; }
+				mara_map_set(ctx, dst, shape->fields[i].key, src->values[i]);
+			}
+		}
+		return;
+	}
+
+	// Entries bring their hash along
+	mara_map_reserve(ctx, dst, dst->num_entries + src->len);
+	for (mara_index_t i = 0; i < src->num_entries; ++i) {
+		mara_map_entry_t* entry = &src->entries[i];
+		if (mara_value_is_tombstone(entry->key)) { continue; }
+
+		if (dst->shape != NULL) {
+			mara_map_set(ctx, dst, entry->key, entry->value);
+		} else {
+			mara_map_set_hashed(ctx, dst, entry->key, entry->hash, entry->value);
+		}
+	}
+}
+
+mara_map_t*
+mara_map_from_pairs(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t num_pairs,
+	const mara_value_t* pairs
+) {
+	mara_map_t* map = mara_new_map(ctx, zone);
+	mara_map_reserve(ctx, map, num_pairs);
+	for (mara_index_t i = 0; i < num_pairs; ++i) {
+		mara_map_set(ctx, map, pairs[i * 2], pairs[i * 2 + 1]);
+	}
+
+	return map;
+}
+
+void
+mara_map_get_many(
+	mara_exec_ctx_t* ctx,
+	mara_map_t* map,
+	mara_index_t num_keys,
+	const mara_value_t* keys,
+	mara_value_t* values
+) {
+	if (map->ctrl == NULL) {
+		for (mara_index_t i = 0; i < num_keys; ++i) {
+			values[i] = mara_map_get(ctx, map, keys[i]);
+		}
+		return;
+	}
+
+	// Hash a batch of keys and prefetch their groups before probing so the
+	// cache misses overlap
+	uint64_t hashes[MARA_MAP_GET_MANY_BATCH];
+	for (mara_index_t start = 0; start < num_keys; start += MARA_MAP_GET_MANY_BATCH) {
+		mara_index_t batch_size = mara_min(num_keys - start, MARA_MAP_GET_MANY_BATCH);
+		for (mara_index_t i = 0; i < batch_size; ++i) {
+			uint64_t hash = hashes[i] = mara_hash_value(keys[start + i]);
+			mara_index_t group = (mara_index_t)(hash & (uint64_t)map->group_mask);
+			MARA_MAP_PREFETCH(map->ctrl + group * MARA_MAP_GROUP_SIZE);
+		}
+
+		for (mara_index_t i = 0; i < batch_size; ++i) {
+			mara_index_t slot = mara_map_find_slot(map, hashes[i], keys[start + i]);
+			values[start + i] = slot >= 0 ? map->entries[map->slots[slot]].value : mara_nil();
+		}
+	}
+}
+
+// A hit is a pointer load and two compares: the field of the cached shape
+// holding the key must belong to the current shape of the map
+bool
+mara_map_get_cached(
+	mara_value_t container,
+	mara_value_t key,
+	mara_inline_cache_t* cache,
+	mara_value_t* result
+) {
+	if (!mara_value_is_map(container)) { return false; }
+
+	mara_map_t* map = (mara_map_t*)mara_value_to_obj(container)->body;
+	const mara_map_shape_t* shape = map->shape;
+	if (shape == NULL) { return false; }
+
+	if (cache != NULL) {
+		const mara_map_field_t* field = mara_atomic_load_ptr((void* const*)cache);
+		if (
+			MARA_EXPECT(field != NULL)
+			&& MARA_EXPECT(field->shape == shape)
+			&& MARA_EXPECT(field->key.internal == key.internal)
+		) {
+			*result = map->values[field - shape->fields];
+			return true;
+		}
+	}
+
+	mara_index_t index = mara_map_shape_find(shape, key);
+	if (index >= 0) {
+		if (cache != NULL) {
+			mara_atomic_store_ptr((void**)cache, (void*)&shape->fields[index]);
+		}
+		*result = map->values[index];
+	} else {
+		*result = mara_nil();
+	}
+
+	return true;
+}
+
+bool
+mara_map_put_cached(
+	mara_exec_ctx_t* ctx,
+	mara_value_t container,
+	mara_value_t key,
+	mara_value_t value,
+	mara_inline_cache_t* cache,
+	mara_value_t* result
+) {
+	if (!mara_value_is_map(container)) { return false; }
+
+	// Frozen maps take the slow path which reports the error
+	mara_obj_t* obj = mara_value_to_obj(container);
+	mara_map_t* map = (mara_map_t*)obj->body;
+	const mara_map_shape_t* shape = map->shape;
+	if (shape == NULL || obj->frozen) { return false; }
+
+	if (cache != NULL) {
+		const mara_map_field_t* field = mara_atomic_load_ptr((void* const*)cache);
+		if (
+			MARA_EXPECT(field != NULL)
+			&& MARA_EXPECT(field->shape == shape)
+			&& MARA_EXPECT(field->key.internal == key.internal)
+		) {
+			*result = mara_map_set_field(ctx, map, (mara_index_t)(field - shape->fields), value);
+			return true;
+		}
+	}
+
+	*result = mara_map_set(ctx, map, key, value);
+
+	// Cache the field in the shape the map ends up with
+	shape = map->shape;
+	if (cache != NULL && shape != NULL) {
+		mara_index_t index = mara_map_shape_find(shape, key);
+		if (index >= 0) {
+			mara_atomic_store_ptr((void**)cache, (void*)&shape->fields[index]);
+		}
+	}
 
-	return NULL;
+	return true;
 }
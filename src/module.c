@@ -1,5 +1,7 @@
 #include "internal.h"
 
+// The cache lives in the permanent zone so it must only be touched while
+// holding the env lock
 MARA_PRIVATE mara_map_t*
 mara_get_module_cache(mara_exec_ctx_t* ctx) {
 	mara_env_t* env = ctx->env;
@@ -34,10 +36,12 @@ mara_internal_import(
 	}
 
 	mara_str_t module_name;
-	mara_check_error(mara_value_to_str(ctx, argv[0], &module_name));
+	mara_small_str_buf_t module_name_buf;
+	mara_check_error(mara_value_to_str_buf(ctx, argv[0], &module_name_buf, &module_name));
 
 	mara_str_t export_name;
-	mara_check_error(mara_value_to_str(ctx, argv[1], &export_name));
+	mara_small_str_buf_t export_name_buf;
+	mara_check_error(mara_value_to_str_buf(ctx, argv[1], &export_name_buf, &export_name));
 	return mara_import(ctx, module_name, export_name, result);
 }
 
@@ -64,17 +68,71 @@ mara_internal_export(
 	}
 
 	mara_str_t export_name;
-	mara_check_error(mara_value_to_str(ctx, argv[0], &export_name));
+	mara_small_str_buf_t export_name_buf;
+	mara_check_error(mara_value_to_str_buf(ctx, argv[0], &export_name_buf, &export_name));
 	mara_export(ctx, export_name, argv[1]);
 	*result = argv[1];
 	return NULL;
 }
 
+MARA_PRIVATE mara_list_t*
+mara_snapshot_module_loaders(mara_exec_ctx_t* ctx) {
+	return ctx->snapshot != NULL ? ctx->snapshot->module_loaders : NULL;
+}
+
 MARA_PRIVATE void
 mara_clear_module_loaders(mara_env_t* env, void* userdata) {
 	(void)env;
 	mara_exec_ctx_t* ctx = userdata;
-	ctx->module_loaders = NULL;
+	ctx->module_loaders = mara_snapshot_module_loaders(ctx);
+}
+
+// Waits while another context loads the module then returns its cache entry.
+// The entry is only still false when ctx itself is loading the module,
+// directly or through contexts waiting on it, as waiting would never end.
+// The env lock must be held exactly once.
+MARA_PRIVATE mara_value_t
+mara_wait_for_module(mara_exec_ctx_t* ctx, mara_value_t module_name) {
+	mara_env_t* env = ctx->env;
+	while (true) {
+		mara_value_t module = mara_map_get(ctx, mara_get_module_cache(ctx), module_name);
+		if (!mara_value_is_false(module)) { return module; }
+
+		mara_exec_ctx_t* loader = NULL;
+		for (mara_module_load_t* itr = env->module_loads; itr != NULL; itr = itr->next) {
+			if (itr->module_name.internal == module_name.internal) {
+				loader = itr->ctx;
+				break;
+			}
+		}
+		for (
+			mara_exec_ctx_t* owner = loader;
+			owner != NULL;
+			owner = owner->waiting_for_module_of
+		) {
+			if (owner == ctx) { return module; }
+		}
+		if (loader == NULL) { return module; }
+
+		ctx->waiting_for_module_of = loader;
+		mara_cond_wait(&env->module_loaded, &env->lock);
+		ctx->waiting_for_module_of = NULL;
+	}
+}
+
+MARA_PRIVATE void
+mara_finish_module_load(mara_exec_ctx_t* ctx, mara_module_load_t* load, mara_value_t module) {
+	mara_env_t* env = ctx->env;
+	mara_mutex_lock(&env->lock);
+	mara_map_set(ctx, mara_get_module_cache(ctx), load->module_name, module);
+	for (mara_module_load_t** itr = &env->module_loads; *itr != NULL; itr = &(*itr)->next) {
+		if (*itr == load) {
+			*itr = load->next;
+			break;
+		}
+	}
+	mara_cond_broadcast(&env->module_loaded);
+	mara_mutex_unlock(&env->lock);
 }
 
 MARA_PRIVATE mara_error_t*
@@ -82,17 +140,30 @@ mara_internal_init_module(
 	mara_exec_ctx_t* ctx,
 	mara_module_options_t options,
 	mara_fn_t* entry_fn,
+	bool reuse_loaded,
 	mara_map_t** module_map_out,
 	mara_value_t* entry_result_out
 ) {
 	// Avoid allocation in the permanent zone until the module is confirmed
 	mara_zone_t* local_zone = ctx->current_zone;
 
+	mara_env_t* env = ctx->env;
 	mara_value_t module_name = mara_nil();
 	mara_value_t existing_module = mara_nil();
+	mara_module_load_t load = { .ctx = ctx };
 	if (!options.ignore_export) {
 		module_name = mara_new_sym(ctx, options.module_name);
-		existing_module = mara_map_get(ctx, mara_get_module_cache(ctx), module_name);
+		load.module_name = module_name;
+
+		// Mark the module as being loaded by this context
+		mara_mutex_lock(&env->lock);
+		existing_module = mara_wait_for_module(ctx, module_name);
+		if (mara_value_is_nil(existing_module)) {
+			mara_map_set(ctx, mara_get_module_cache(ctx), module_name, mara_value_from_bool(false));
+			load.next = env->module_loads;
+			env->module_loads = &load;
+		}
+		mara_mutex_unlock(&env->lock);
 	}
 
 	if (MARA_EXPECT(mara_value_is_nil(existing_module))) {
@@ -100,11 +171,6 @@ mara_internal_init_module(
 		mara_map_t* previous_module = ctx->current_module;
 		mara_module_options_t previous_module_options = ctx->current_module_options;
 
-		// Mark the module as being loaded
-		if (!options.ignore_export) {
-			mara_map_set(ctx, mara_get_module_cache(ctx), module_name, mara_value_from_bool(false));
-		}
-
 		// Userdata cannot be safely used as module code may save these functions
 		mara_fn_t* import_fn = mara_new_fn(ctx, local_zone, mara_internal_import, mara_nil());
 		mara_fn_t* export_fn = mara_new_fn(ctx, local_zone, mara_internal_export, mara_nil());
@@ -128,15 +194,22 @@ mara_internal_init_module(
 			// TODO: maybe cache the symbol?
 			if (!options.ignore_export) {
 				mara_map_set(ctx, module, mara_new_sym(ctx, mara_str_from_literal("*main*")), entry_result);
-				mara_map_set(ctx, mara_get_module_cache(ctx), module_name, mara_value_from_map(module));
+				mara_finish_module_load(ctx, &load, mara_value_from_map(module));
 			}
 			*entry_result_out = entry_result;
 			*module_map_out = module;
-		} else {
-			mara_map_set(ctx, mara_get_module_cache(ctx), module_name, mara_nil());
+		} else if (!options.ignore_export) {
+			mara_finish_module_load(ctx, &load, mara_nil());
 		}
 
 		return error;
+	} else if (reuse_loaded && mara_value_is_map(existing_module)) {
+		// Another context loaded it first
+		mara_assert_no_error(mara_value_to_map(ctx, existing_module, module_map_out));
+		*entry_result_out = mara_map_get(
+			ctx, *module_map_out, mara_new_sym(ctx, mara_str_from_literal("*main*"))
+		);
+		return NULL;
 	} else {
 		bool being_loaded = mara_value_is_false(existing_module);
 		return mara_errorf(
@@ -161,7 +234,7 @@ mara_init_module(
 	mara_value_t entry_result;
 	mara_error_t* error = mara_internal_init_module(
 		ctx,
-		options, entry_fn,
+		options, entry_fn, false,
 		&module_map, &entry_result
 	);
 	if (error == NULL) {
@@ -173,8 +246,14 @@ mara_init_module(
 
 void
 mara_add_module_loader(mara_exec_ctx_t* ctx, mara_fn_t* fn) {
-	if (ctx->module_loaders == NULL) {
-		ctx->module_loaders = mara_new_list(ctx, ctx->current_zone, 1);
+	mara_list_t* shared_loaders = mara_snapshot_module_loaders(ctx);
+	if (ctx->module_loaders == NULL || ctx->module_loaders == shared_loaders) {
+		// Loaders from a snapshot are shared so they are copied on write
+		mara_index_t num_shared_loaders = shared_loaders != NULL ? shared_loaders->len : 0;
+		ctx->module_loaders = mara_new_list(ctx, ctx->current_zone, num_shared_loaders + 1);
+		for (mara_index_t i = 0; i < num_shared_loaders; ++i) {
+			mara_list_push(ctx, ctx->module_loaders, shared_loaders->elems[i]);
+		}
 		// This list is created in this zone and implicitly passed to all
 		// subsequent zones.
 		// It cannot exist after this zone is exited.
@@ -195,6 +274,7 @@ mara_import(
 	mara_value_t* result
 ) {
 	// Qualify relative import
+	mara_small_str_buf_t module_name_buf;
 	if (
 		module_name.len > 2
 		&& module_name.data[0] == '.'
@@ -207,15 +287,15 @@ mara_import(
 			module_name.len - 2, module_name.data + 2
 		);
 		mara_assert_no_error(
-			mara_value_to_str(ctx, qualified_name, &module_name)
+			mara_value_to_str_buf(ctx, qualified_name, &module_name_buf, &module_name)
 		);
 	}
 	mara_value_t module_name_sym = mara_new_sym(ctx, module_name);
 	mara_value_t export_name_sym = mara_new_sym(ctx, export_name);
 
-	mara_value_t existing_module = mara_map_get(
-		ctx, mara_get_module_cache(ctx), module_name_sym
-	);
+	mara_mutex_lock(&ctx->env->lock);
+	mara_value_t existing_module = mara_wait_for_module(ctx, module_name_sym);
+	mara_mutex_unlock(&ctx->env->lock);
 
 	if (MARA_EXPECT(mara_value_is_map(existing_module))) {
 		mara_map_t* module_map;
@@ -278,7 +358,7 @@ mara_import(
 			mara_check_error(
 				mara_internal_init_module(
 					ctx,
-					module_options, module_entry,
+					module_options, module_entry, true,
 					&module, &module_main
 				)
 			);
@@ -341,3 +421,31 @@ mara_export(mara_exec_ctx_t* ctx, mara_str_t export_name, mara_value_t value) {
 		return false;
 	}
 }
+
+mara_snapshot_t*
+mara_freeze(mara_exec_ctx_t* ctx, mara_value_t data) {
+	mara_env_t* env = ctx->env;
+	mara_zone_t* permanent_zone = &env->permanent_zone;
+
+	// Imported modules are already in the env-wide module cache
+	mara_mutex_lock(&env->lock);
+	mara_snapshot_t* snapshot = MARA_ZONE_ALLOC_TYPE(ctx, permanent_zone, mara_snapshot_t);
+	mara_assert(snapshot != NULL, "Out of memory");
+	snapshot->module_loaders = NULL;
+	if (ctx->module_loaders != NULL) {
+		mara_value_t loaders = mara_copy(
+			ctx, permanent_zone,
+			mara_value_from_list(ctx->module_loaders)
+		);
+		mara_assert_no_error(mara_value_to_list(ctx, loaders, &snapshot->module_loaders));
+	}
+	snapshot->data = mara_copy(ctx, permanent_zone, data);
+	mara_mutex_unlock(&env->lock);
+
+	return snapshot;
+}
+
+mara_value_t
+mara_get_snapshot_data(mara_exec_ctx_t* ctx) {
+	return ctx->snapshot != NULL ? ctx->snapshot->data : mara_nil();
+}
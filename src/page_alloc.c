@@ -0,0 +1,165 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#	define _DEFAULT_SOURCE
+#endif
+
+#include "internal.h"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#	define MARA_PAGE_ALLOC_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+#	include <sys/mman.h>
+#	include <unistd.h>
+#	define MARA_PAGE_ALLOC_MMAP
+#endif
+
+#define MARA_DEFAULT_PAGE_REGION_SIZE ((size_t)64 * 1024 * 1024)
+
+// Regions are only ever bumped.
+// Trimmed chunks keep their address range but their pages are handed back
+// to the OS so they can be reused later without mapping more memory.
+struct mara_page_region_s {
+	mara_page_region_t* next;
+	char* bump_ptr;
+	char* end;
+};
+
+MARA_PRIVATE size_t
+mara_page_size(void) {
+#if defined(MARA_PAGE_ALLOC_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#elif defined(MARA_PAGE_ALLOC_MMAP)
+	return (size_t)sysconf(_SC_PAGESIZE);
+#else
+	return 4096;
+#endif
+}
+
+MARA_PRIVATE size_t
+mara_page_round_up(size_t size, size_t page_size) {
+	return (size + page_size - 1) & ~(page_size - 1);
+}
+
+MARA_PRIVATE void*
+mara_page_map(size_t size, bool use_huge_pages) {
+#if defined(MARA_PAGE_ALLOC_WIN32)
+	// Large pages need a privilege most processes do not hold
+	(void)use_huge_pages;
+	return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(MARA_PAGE_ALLOC_MMAP)
+	void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) { return NULL; }
+#	if defined(MADV_HUGEPAGE)
+	if (use_huge_pages) { madvise(mem, size, MADV_HUGEPAGE); }
+#	else
+	(void)use_huge_pages;
+#	endif
+	return mem;
+#else
+	(void)size;
+	(void)use_huge_pages;
+	return NULL;
+#endif
+}
+
+MARA_PRIVATE void
+mara_page_unmap(void* mem, size_t size) {
+#if defined(MARA_PAGE_ALLOC_WIN32)
+	(void)size;
+	VirtualFree(mem, 0, MEM_RELEASE);
+#elif defined(MARA_PAGE_ALLOC_MMAP)
+	munmap(mem, size);
+#else
+	(void)mem;
+	(void)size;
+#endif
+}
+
+MARA_PRIVATE void
+mara_page_decommit(void* mem, size_t size) {
+#if defined(MARA_PAGE_ALLOC_WIN32)
+	// The range stays committed but its content can be discarded
+	VirtualAlloc(mem, size, MEM_RESET, PAGE_READWRITE);
+#elif defined(MARA_PAGE_ALLOC_MMAP)
+	madvise(mem, size, MADV_DONTNEED);
+#else
+	(void)mem;
+	(void)size;
+#endif
+}
+
+bool
+mara_page_alloc_supported(void) {
+#if defined(MARA_PAGE_ALLOC_WIN32) || defined(MARA_PAGE_ALLOC_MMAP)
+	return true;
+#else
+	return false;
+#endif
+}
+
+mara_arena_chunk_t*
+mara_page_alloc_chunk(mara_env_t* env, size_t size) {
+	size_t page_size = mara_page_size();
+	size = mara_page_round_up(size, page_size);
+
+	for (
+		mara_arena_chunk_t** itr = &env->decommitted_chunks;
+		*itr != NULL;
+		itr = &(*itr)->next
+	) {
+		mara_arena_chunk_t* chunk = *itr;
+		if ((size_t)(chunk->end - (char*)chunk) >= size) {
+			*itr = chunk->next;
+			return chunk;
+		}
+	}
+
+	mara_page_region_t* region = env->page_regions;
+	if (region == NULL || (size_t)(region->end - region->bump_ptr) < size) {
+		size_t region_size = env->options.page_region_size > 0
+			? env->options.page_region_size
+			: MARA_DEFAULT_PAGE_REGION_SIZE;
+		// The region header takes the first page
+		region_size = mara_page_round_up(mara_max(region_size, size + page_size), page_size);
+
+		region = mara_page_map(region_size, env->options.use_huge_pages);
+		mara_assert(region != NULL, "Out of memory");
+		region->next = env->page_regions;
+		region->bump_ptr = (char*)region + page_size;
+		region->end = (char*)region + region_size;
+		env->page_regions = region;
+	}
+
+	mara_arena_chunk_t* chunk = (mara_arena_chunk_t*)region->bump_ptr;
+	region->bump_ptr += size;
+	chunk->end = (char*)chunk + size;
+	return chunk;
+}
+
+void
+mara_page_decommit_chunk(mara_env_t* env, mara_arena_chunk_t* chunk) {
+	// Keep the page holding the chunk header
+	size_t page_size = mara_page_size();
+	char* first_page = (char*)chunk + page_size;
+	if (first_page < chunk->end) {
+		mara_page_decommit(first_page, (size_t)(chunk->end - first_page));
+	}
+
+	chunk->next = env->decommitted_chunks;
+	env->decommitted_chunks = chunk;
+}
+
+void
+mara_page_alloc_cleanup(mara_env_t* env) {
+	for (mara_page_region_t* itr = env->page_regions; itr != NULL;) {
+		mara_page_region_t* next = itr->next;
+		mara_page_unmap(itr, (size_t)(itr->end - (char*)itr));
+		itr = next;
+	}
+
+	env->page_regions = NULL;
+	env->decommitted_chunks = NULL;
+}
@@ -370,6 +370,7 @@ mara_do_parse(
 		mara_token_t token;
 		error = mara_lexer_next(ctx, &lexer, &token);
 		if (error != NULL) { break; }
+		tmp_list.source_range.end = token.location.end;
 		if (token.type == MARA_TOK_END) { break; }
 
 		mara_value_t elem;
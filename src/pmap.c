@@ -0,0 +1,470 @@
+#include "internal.h"
+
+MARA_PRIVATE uint32_t
+mara_pmap_bit(uint64_t hash, mara_index_t shift) {
+	return (uint32_t)1 << ((hash >> shift) & (MARA_PMAP_BRANCHES - 1));
+}
+
+MARA_PRIVATE mara_index_t
+mara_pmap_index(uint32_t bitmap, uint32_t bit) {
+	return mara_popcount32(bitmap & (bit - 1));
+}
+
+mara_pmap_node_t*
+mara_pmap_alloc_node(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t num_entries,
+	mara_index_t num_children
+) {
+	mara_pmap_node_t* node = mara_zone_alloc_ex(
+		ctx, zone,
+		sizeof(mara_pmap_node_t)
+			+ sizeof(mara_pmap_entry_t) * num_entries
+			+ sizeof(mara_pmap_node_t*) * num_children,
+		_Alignof(mara_pmap_node_t)
+	);
+	mara_assert(node != NULL, "Out of memory");
+
+	node->zone = zone;
+	node->datamap = 0;
+	node->nodemap = 0;
+	node->num_collisions = 0;
+	return node;
+}
+
+// Build a copy of node with the given layout.
+// Every bit in the new maps is taken from the old node unless it is the
+// replaced entry or child.
+MARA_PRIVATE mara_pmap_node_t*
+mara_pmap_rebuild_node(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pmap_node_t* node,
+	uint32_t datamap,
+	uint32_t nodemap,
+	uint32_t entry_bit,
+	mara_pmap_entry_t entry,
+	uint32_t child_bit,
+	mara_pmap_node_t* child
+) {
+	mara_pmap_node_t* new_node = mara_pmap_alloc_node(
+		ctx, zone,
+		mara_popcount32(datamap), mara_popcount32(nodemap)
+	);
+	new_node->datamap = datamap;
+	new_node->nodemap = nodemap;
+
+	mara_index_t num_entries = 0;
+	for (uint32_t bits = datamap; bits != 0; bits &= bits - 1) {
+		uint32_t bit = bits & (~bits + 1);
+		new_node->entries[num_entries++] = bit == entry_bit
+			? entry
+			: node->entries[mara_pmap_index(node->datamap, bit)];
+	}
+
+	mara_pmap_node_t** new_children = mara_pmap_node_children(new_node);
+	mara_index_t num_children = 0;
+	for (uint32_t bits = nodemap; bits != 0; bits &= bits - 1) {
+		uint32_t bit = bits & (~bits + 1);
+		new_children[num_children++] = bit == child_bit
+			? child
+			: mara_pmap_node_children(node)[mara_pmap_index(node->nodemap, bit)];
+	}
+
+	return new_node;
+}
+
+MARA_PRIVATE mara_pmap_node_t*
+mara_pmap_collision_node(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	const mara_pmap_entry_t* entries,
+	mara_index_t num_entries
+) {
+	mara_pmap_node_t* node = mara_pmap_alloc_node(ctx, zone, num_entries, 0);
+	node->num_collisions = num_entries;
+	memcpy(node->entries, entries, sizeof(mara_pmap_entry_t) * num_entries);
+	return node;
+}
+
+// Make a node holding two entries whose hashes agree up to shift
+MARA_PRIVATE mara_pmap_node_t*
+mara_pmap_merge(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pmap_entry_t lhs,
+	uint64_t lhs_hash,
+	mara_pmap_entry_t rhs,
+	uint64_t rhs_hash,
+	mara_index_t shift
+) {
+	if (shift >= MARA_PMAP_HASH_BITS) {
+		mara_pmap_entry_t entries[] = { lhs, rhs };
+		return mara_pmap_collision_node(ctx, zone, entries, 2);
+	}
+
+	uint32_t lhs_bit = mara_pmap_bit(lhs_hash, shift);
+	uint32_t rhs_bit = mara_pmap_bit(rhs_hash, shift);
+	if (lhs_bit == rhs_bit) {
+		mara_pmap_node_t* node = mara_pmap_alloc_node(ctx, zone, 0, 1);
+		node->nodemap = lhs_bit;
+		mara_pmap_node_children(node)[0] = mara_pmap_merge(
+			ctx, zone,
+			lhs, lhs_hash,
+			rhs, rhs_hash,
+			shift + MARA_PMAP_BITS
+		);
+		return node;
+	} else {
+		mara_pmap_node_t* node = mara_pmap_alloc_node(ctx, zone, 2, 0);
+		node->datamap = lhs_bit | rhs_bit;
+		node->entries[lhs_bit < rhs_bit ? 0 : 1] = lhs;
+		node->entries[lhs_bit < rhs_bit ? 1 : 0] = rhs;
+		return node;
+	}
+}
+
+MARA_PRIVATE mara_pmap_node_t*
+mara_pmap_node_set(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pmap_node_t* node,
+	mara_pmap_entry_t entry,
+	uint64_t hash,
+	mara_index_t shift,
+	bool* added
+) {
+	if (node->num_collisions > 0) {
+		mara_index_t num_entries = node->num_collisions;
+		for (mara_index_t i = 0; i < num_entries; ++i) {
+			if (mara_value_equal(node->entries[i].key, entry.key)) {
+				mara_pmap_node_t* new_node = mara_pmap_collision_node(
+					ctx, zone, node->entries, num_entries
+				);
+				new_node->entries[i] = entry;
+				return new_node;
+			}
+		}
+
+		mara_pmap_node_t* new_node = mara_pmap_alloc_node(ctx, zone, num_entries + 1, 0);
+		new_node->num_collisions = num_entries + 1;
+		memcpy(new_node->entries, node->entries, sizeof(mara_pmap_entry_t) * num_entries);
+		new_node->entries[num_entries] = entry;
+		*added = true;
+		return new_node;
+	}
+
+	uint32_t bit = mara_pmap_bit(hash, shift);
+	if (node->datamap & bit) {
+		mara_pmap_entry_t existing = node->entries[mara_pmap_index(node->datamap, bit)];
+		if (mara_value_equal(existing.key, entry.key)) {
+			if (existing.value.internal == entry.value.internal) { return node; }
+
+			return mara_pmap_rebuild_node(
+				ctx, zone, node,
+				node->datamap, node->nodemap,
+				bit, entry,
+				0, NULL
+			);
+		}
+
+		*added = true;
+		mara_pmap_node_t* child = mara_pmap_merge(
+			ctx, zone,
+			existing, mara_hash_value(existing.key),
+			entry, hash,
+			shift + MARA_PMAP_BITS
+		);
+		return mara_pmap_rebuild_node(
+			ctx, zone, node,
+			node->datamap & ~bit, node->nodemap | bit,
+			0, (mara_pmap_entry_t){ 0 },
+			bit, child
+		);
+	} else if (node->nodemap & bit) {
+		mara_pmap_node_t* child = mara_pmap_node_children(node)[mara_pmap_index(node->nodemap, bit)];
+		mara_pmap_node_t* new_child = mara_pmap_node_set(
+			ctx, zone, child, entry, hash, shift + MARA_PMAP_BITS, added
+		);
+		if (new_child == child) { return node; }
+
+		return mara_pmap_rebuild_node(
+			ctx, zone, node,
+			node->datamap, node->nodemap,
+			0, (mara_pmap_entry_t){ 0 },
+			bit, new_child
+		);
+	} else {
+		*added = true;
+		return mara_pmap_rebuild_node(
+			ctx, zone, node,
+			node->datamap | bit, node->nodemap,
+			bit, entry,
+			0, NULL
+		);
+	}
+}
+
+// Returns NULL when the node becomes empty
+MARA_PRIVATE mara_pmap_node_t*
+mara_pmap_node_delete(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pmap_node_t* node,
+	mara_value_t key,
+	uint64_t hash,
+	mara_index_t shift,
+	bool* removed
+) {
+	if (node->num_collisions > 0) {
+		mara_index_t num_entries = node->num_collisions;
+		for (mara_index_t i = 0; i < num_entries; ++i) {
+			if (!mara_value_equal(node->entries[i].key, key)) { continue; }
+
+			*removed = true;
+			if (num_entries == 1) { return NULL; }
+
+			mara_pmap_node_t* new_node = mara_pmap_collision_node(
+				ctx, zone, node->entries, num_entries - 1
+			);
+			if (i < num_entries - 1) {
+				new_node->entries[i] = node->entries[num_entries - 1];
+			}
+			return new_node;
+		}
+
+		return node;
+	}
+
+	uint32_t bit = mara_pmap_bit(hash, shift);
+	if (node->datamap & bit) {
+		mara_pmap_entry_t existing = node->entries[mara_pmap_index(node->datamap, bit)];
+		if (!mara_value_equal(existing.key, key)) { return node; }
+
+		*removed = true;
+		if (node->datamap == bit && node->nodemap == 0) { return NULL; }
+
+		return mara_pmap_rebuild_node(
+			ctx, zone, node,
+			node->datamap & ~bit, node->nodemap,
+			0, (mara_pmap_entry_t){ 0 },
+			0, NULL
+		);
+	} else if (node->nodemap & bit) {
+		mara_pmap_node_t* child = mara_pmap_node_children(node)[mara_pmap_index(node->nodemap, bit)];
+		mara_pmap_node_t* new_child = mara_pmap_node_delete(
+			ctx, zone, child, key, hash, shift + MARA_PMAP_BITS, removed
+		);
+		if (new_child == child) { return node; }
+
+		if (new_child == NULL) {
+			if (node->datamap == 0 && node->nodemap == bit) { return NULL; }
+
+			return mara_pmap_rebuild_node(
+				ctx, zone, node,
+				node->datamap, node->nodemap & ~bit,
+				0, (mara_pmap_entry_t){ 0 },
+				0, NULL
+			);
+		} else if (new_child->nodemap == 0 && mara_pmap_node_num_entries(new_child) == 1) {
+			// Pull the last entry of the child up into this node
+			return mara_pmap_rebuild_node(
+				ctx, zone, node,
+				node->datamap | bit, node->nodemap & ~bit,
+				bit, new_child->entries[0],
+				0, NULL
+			);
+		} else {
+			return mara_pmap_rebuild_node(
+				ctx, zone, node,
+				node->datamap, node->nodemap,
+				0, (mara_pmap_entry_t){ 0 },
+				bit, new_child
+			);
+		}
+	} else {
+		return node;
+	}
+}
+
+MARA_PRIVATE mara_pmap_t*
+mara_pmap_new_version(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t len,
+	mara_pmap_node_t* root
+) {
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_pmap_t));
+	obj->type = MARA_OBJ_TYPE_PMAP;
+
+	mara_pmap_t* map = (mara_pmap_t*)obj->body;
+	*map = (mara_pmap_t){
+		.len = len,
+		.root = root,
+	};
+
+	return map;
+}
+
+// Nodes deeper than the zone would not outlive the result so they are
+// copied out before being shared
+MARA_PRIVATE mara_pmap_t*
+mara_pmap_in_zone(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pmap_t* map) {
+	mara_value_t copy = mara_copy(ctx, zone, mara_value_from_pmap(map));
+	mara_pmap_t* result;
+	mara_assert_no_error(mara_value_to_pmap(ctx, copy, &result));
+	return result;
+}
+
+mara_pmap_t*
+mara_new_pmap(mara_exec_ctx_t* ctx, mara_zone_t* zone) {
+	return mara_pmap_new_version(ctx, zone, 0, NULL);
+}
+
+mara_index_t
+mara_pmap_len(mara_exec_ctx_t* ctx, mara_pmap_t* map) {
+	(void)ctx;
+	return map->len;
+}
+
+mara_value_t
+mara_pmap_get(mara_exec_ctx_t* ctx, mara_pmap_t* map, mara_value_t key) {
+	(void)ctx;
+	mara_pmap_node_t* node = map->root;
+	if (node == NULL) { return mara_nil(); }
+
+	uint64_t hash = mara_hash_value(key);
+	for (mara_index_t shift = 0;; shift += MARA_PMAP_BITS) {
+		if (node->num_collisions > 0) {
+			for (mara_index_t i = 0; i < node->num_collisions; ++i) {
+				if (mara_value_equal(node->entries[i].key, key)) {
+					return node->entries[i].value;
+				}
+			}
+
+			return mara_nil();
+		}
+
+		uint32_t bit = mara_pmap_bit(hash, shift);
+		if (node->datamap & bit) {
+			mara_pmap_entry_t* entry = &node->entries[mara_pmap_index(node->datamap, bit)];
+			return mara_value_equal(entry->key, key) ? entry->value : mara_nil();
+		} else if (node->nodemap & bit) {
+			node = mara_pmap_node_children(node)[mara_pmap_index(node->nodemap, bit)];
+		} else {
+			return mara_nil();
+		}
+	}
+}
+
+mara_pmap_t*
+mara_pmap_set(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pmap_t* map,
+	mara_value_t key,
+	mara_value_t value
+) {
+	if (mara_value_is_nil(value)) {
+		return mara_pmap_delete(ctx, zone, map, key);
+	}
+
+	map = mara_pmap_in_zone(ctx, zone, map);
+	mara_pmap_entry_t entry = {
+		.key = mara_copy(ctx, zone, key),
+		.value = mara_copy(ctx, zone, value),
+	};
+	uint64_t hash = mara_hash_value(key);
+
+	bool added = false;
+	mara_pmap_node_t* root;
+	if (map->root == NULL) {
+		uint32_t bit = mara_pmap_bit(hash, 0);
+		root = mara_pmap_rebuild_node(ctx, zone, NULL, bit, 0, bit, entry, 0, NULL);
+		added = true;
+	} else {
+		root = mara_pmap_node_set(ctx, zone, map->root, entry, hash, 0, &added);
+	}
+
+	if (root == map->root) { return map; }
+
+	return mara_pmap_new_version(ctx, zone, map->len + (added ? 1 : 0), root);
+}
+
+mara_pmap_t*
+mara_pmap_delete(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pmap_t* map, mara_value_t key) {
+	map = mara_pmap_in_zone(ctx, zone, map);
+	if (map->root == NULL) { return map; }
+
+	bool removed = false;
+	mara_pmap_node_t* root = mara_pmap_node_delete(
+		ctx, zone, map->root, key, mara_hash_value(key), 0, &removed
+	);
+	if (!removed) { return map; }
+
+	return mara_pmap_new_version(ctx, zone, map->len - 1, root);
+}
+
+void
+mara_pmap_itr_init(mara_pmap_itr_t* itr, mara_pmap_t* map) {
+	itr->nodes[0] = map->root;
+	itr->positions[0] = 0;
+	itr->depth = map->root != NULL ? 1 : 0;
+}
+
+mara_pmap_entry_t*
+mara_pmap_itr_next(mara_pmap_itr_t* itr) {
+	while (itr->depth > 0) {
+		mara_index_t level = itr->depth - 1;
+		mara_pmap_node_t* node = itr->nodes[level];
+		mara_index_t position = itr->positions[level]++;
+
+		mara_index_t num_entries = mara_pmap_node_num_entries(node);
+		if (position < num_entries) {
+			return &node->entries[position];
+		}
+
+		position -= num_entries;
+		if (position < mara_popcount32(node->nodemap)) {
+			itr->nodes[itr->depth] = mara_pmap_node_children(node)[position];
+			itr->positions[itr->depth] = 0;
+			itr->depth += 1;
+		} else {
+			itr->depth -= 1;
+		}
+	}
+
+	return NULL;
+}
+
+mara_error_t*
+mara_pmap_foreach(mara_exec_ctx_t* ctx, mara_pmap_t* map, mara_fn_t* fn) {
+	mara_value_t map_value = mara_value_from_pmap(map);
+	mara_pmap_itr_t itr;
+	mara_pmap_itr_init(&itr, map);
+	for (
+		mara_pmap_entry_t* entry = mara_pmap_itr_next(&itr);
+		entry != NULL;
+		entry = mara_pmap_itr_next(&itr)
+	) {
+		mara_value_t args[] = {
+			entry->value,
+			entry->key,
+			map_value
+		};
+		mara_value_t should_continue = mara_nil();
+		mara_check_error(
+			mara_call(
+				ctx, ctx->current_zone,
+				fn, mara_count_of(args), args, &should_continue
+			)
+		);
+
+		if (mara_value_is_false(should_continue)) {
+			break;
+		}
+	}
+
+	return NULL;
+}
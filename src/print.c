@@ -162,6 +162,12 @@ mara_print_vm_function(
 							operands & 0xffff
 						);
 						break;
+					case MARA_OP_MAKE_RETURN_CLOSURE:
+						mara_print_indented(output, body_options.indent, "(MAKE_RETURN_CLOSURE %d %d)",
+							(uint8_t)(operands >> 16) & 0xff,
+							operands & 0xffff
+						);
+						break;
 					case MARA_OP_CALL_CAPTURE:
 						mara_print_indented(output, body_options.indent, "(CALL_CAPTURE %d %d)",
 							(uint8_t)(operands >> 16) & 0xff,
@@ -201,6 +207,9 @@ mara_print_vm_function(
 					case MARA_OP_MAKE_LIST:
 						mara_print_indented(output, body_options.indent, "(MAKE_LIST %d)", operands);
 						break;
+					case MARA_OP_MAKE_RETURN_LIST:
+						mara_print_indented(output, body_options.indent, "(MAKE_RETURN_LIST %d)", operands);
+						break;
 					case MARA_OP_PUT:
 						mara_print_indented(output, body_options.indent, "(PUT)");
 						break;
@@ -210,6 +219,24 @@ mara_print_vm_function(
 					case MARA_OP_NEG:
 						mara_print_indented(output, body_options.indent, "(NEG)");
 						break;
+					case MARA_OP_MAKE_RECORD:
+						mara_print_indented(output, body_options.indent, "(MAKE_RECORD %d)", operands);
+						break;
+					case MARA_OP_MAKE_RETURN_RECORD:
+						mara_print_indented(output, body_options.indent, "(MAKE_RETURN_RECORD %d)", operands);
+						break;
+					case MARA_OP_RECORD_GET:
+						mara_print_indented(output, body_options.indent, "(RECORD_GET %d %d)",
+							operands >> 8,
+							operands & 0xff
+						);
+						break;
+					case MARA_OP_RECORD_SET:
+						mara_print_indented(output, body_options.indent, "(RECORD_SET %d %d)",
+							operands >> 8,
+							operands & 0xff
+						);
+						break;
 				}
 
 				if (fn->source_info != NULL) {
@@ -281,7 +308,8 @@ mara_do_print_value(
 	} else if (mara_value_is_sym(value) || mara_value_is_str(value)) {
 		// TODO: escape new lines and quotes
 		mara_str_t result = { 0 };
-		mara_value_to_str(ctx, value, &result);
+		mara_small_str_buf_t buf;
+		mara_value_to_str_buf(ctx, value, &buf, &result);
 		bool need_quotes = mara_value_is_str(value);
 		mara_print_indented(
 			output, options.indent,
@@ -344,16 +372,133 @@ mara_do_print_value(
 				children_options.indent += 2;
 
 				mara_index_t print_len = mara_min(map->len, options.max_length);
-				mara_index_t i = 0;
-				for (
-					mara_map_node_t* node = map->root;
-					i < print_len && node != NULL;
-					++i, node = node->next
-				) {
+				mara_index_t num_printed = 0;
+				mara_map_itr_t itr = { .map = map };
+				mara_value_t entry_key, entry_value;
+				while (num_printed < print_len && mara_map_itr_next(&itr, &entry_key, &entry_value)) {
+					++num_printed;
+					mara_print_indented(output, options.indent + 1, "(\n");
+					{
+						mara_do_print_value(ctx, entry_key, children_options, dummy_key, output);
+						mara_do_print_value(ctx, entry_value, children_options, dummy_key, output);
+					}
+					mara_print_indented(output, options.indent + 1, ")\n");
+				}
+				mara_print_omitted_ellipsis(output, options.indent, map->len - print_len);
+			}
+			mara_print_indented(output, options.indent, ")");
+		}
+	} else if (mara_value_is_pvec(value)) {
+		mara_pvec_t* vec;
+		mara_assert_no_error(mara_value_to_pvec(ctx, value, &vec));
+		if (options.max_depth <= 0) {
+			mara_print_indented(
+				output, options.indent,
+				"(pvec ...)  ; %d element%s",
+				vec->len, vec->len > 1 ? "s" : ""
+			);
+		} else {
+			mara_print_indented(output, options.indent, "(pvec\n");
+			{
+				mara_print_options_t children_options = options;
+				children_options.max_depth -= 1;
+				children_options.indent += 1;
+
+				mara_index_t print_len = mara_min(vec->len, options.max_length);
+				for (mara_index_t i = 0; i < print_len; ++i) {
+					mara_do_print_value(
+						ctx, mara_pvec_get(ctx, vec, i), children_options, dummy_key, output
+					);
+				}
+				mara_print_omitted_ellipsis(output, children_options.indent, vec->len - print_len);
+			}
+			mara_print_indented(output, options.indent, ")");
+		}
+	} else if (mara_value_is_array(value)) {
+		mara_array_t* array;
+		mara_assert_no_error(mara_value_to_array(ctx, value, &array));
+		const char* name = array->type == MARA_ARRAY_I32 ? "array/i32" : "array/f64";
+		if (options.max_depth <= 0) {
+			mara_print_indented(
+				output, options.indent,
+				"(%s ...)  ; %d element%s",
+				name, array->len, array->len > 1 ? "s" : ""
+			);
+		} else {
+			mara_print_indented(output, options.indent, "(%s\n", name);
+			{
+				mara_print_options_t children_options = options;
+				children_options.max_depth -= 1;
+				children_options.indent += 1;
+
+				mara_index_t print_len = mara_min(array->len, options.max_length);
+				for (mara_index_t i = 0; i < print_len; ++i) {
+					mara_do_print_value(
+						ctx, mara_array_get(ctx, array, i), children_options, dummy_key, output
+					);
+				}
+				mara_print_omitted_ellipsis(output, children_options.indent, array->len - print_len);
+			}
+			mara_print_indented(output, options.indent, ")");
+		}
+	} else if (mara_value_is_record(value)) {
+		mara_record_t* record = (mara_record_t*)mara_value_to_obj(value)->body;
+		const mara_record_type_t* type = record->type;
+		mara_str_t name;
+		mara_small_str_buf_t name_buf;
+		mara_assert_no_error(mara_value_to_str_buf(ctx, type->name, &name_buf, &name));
+		if (options.max_depth <= 0) {
+			mara_print_indented(
+				output, options.indent,
+				"(%.*s ...)  ; %d field%s",
+				name.len, name.data,
+				type->num_fields, type->num_fields > 1 ? "s" : ""
+			);
+		} else {
+			mara_print_indented(output, options.indent, "(%.*s\n", name.len, name.data);
+			{
+				mara_print_options_t children_options = options;
+				children_options.max_depth -= 1;
+				children_options.indent += 2;
+
+				mara_index_t print_len = mara_min(type->num_fields, options.max_length);
+				for (mara_index_t i = 0; i < print_len; ++i) {
+					mara_print_indented(output, options.indent + 1, "(\n");
+					{
+						mara_do_print_value(ctx, type->fields[i], children_options, dummy_key, output);
+						mara_do_print_value(ctx, record->fields[i], children_options, dummy_key, output);
+					}
+					mara_print_indented(output, options.indent + 1, ")\n");
+				}
+				mara_print_omitted_ellipsis(output, options.indent, type->num_fields - print_len);
+			}
+			mara_print_indented(output, options.indent, ")");
+		}
+	} else if (mara_value_is_pmap(value)) {
+		mara_pmap_t* map;
+		mara_assert_no_error(mara_value_to_pmap(ctx, value, &map));
+		if (options.max_depth <= 0) {
+			mara_print_indented(
+				output, options.indent,
+				"(pmap ...)  ; %d element%s",
+				map->len, map->len > 1 ? "s" : ""
+			);
+		} else {
+			mara_print_indented(output, options.indent, "(pmap\n");
+			{
+				mara_print_options_t children_options = options;
+				children_options.max_depth -= 1;
+				children_options.indent += 2;
+
+				mara_index_t print_len = mara_min(map->len, options.max_length);
+				mara_pmap_itr_t itr;
+				mara_pmap_itr_init(&itr, map);
+				for (mara_index_t i = 0; i < print_len; ++i) {
+					mara_pmap_entry_t* entry = mara_pmap_itr_next(&itr);
 					mara_print_indented(output, options.indent + 1, "(\n");
 					{
-						mara_do_print_value(ctx, node->key, children_options, dummy_key, output);
-						mara_do_print_value(ctx, node->value, children_options, dummy_key, output);
+						mara_do_print_value(ctx, entry->key, children_options, dummy_key, output);
+						mara_do_print_value(ctx, entry->value, children_options, dummy_key, output);
 					}
 					mara_print_indented(output, options.indent + 1, ")\n");
 				}
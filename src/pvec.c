@@ -0,0 +1,289 @@
+#include "internal.h"
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_new_leaf(mara_exec_ctx_t* ctx, mara_zone_t* zone) {
+	mara_pvec_node_t* node = MARA_ZONE_ALLOC_TYPE(ctx, zone, mara_pvec_node_t);
+	mara_assert(node != NULL, "Out of memory");
+
+	node->zone = zone;
+	for (mara_index_t i = 0; i < MARA_PVEC_BRANCHES; ++i) {
+		node->elems[i] = mara_nil();
+	}
+	return node;
+}
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_new_branch(mara_exec_ctx_t* ctx, mara_zone_t* zone) {
+	mara_pvec_node_t* node = MARA_ZONE_ALLOC_TYPE(ctx, zone, mara_pvec_node_t);
+	mara_assert(node != NULL, "Out of memory");
+
+	node->zone = zone;
+	memset(node->children, 0, sizeof(node->children));
+	return node;
+}
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_copy_node(mara_exec_ctx_t* ctx, mara_zone_t* zone, const mara_pvec_node_t* node) {
+	mara_pvec_node_t* copy = MARA_ZONE_ALLOC_TYPE(ctx, zone, mara_pvec_node_t);
+	mara_assert(copy != NULL, "Out of memory");
+
+	*copy = *node;
+	copy->zone = zone;
+	return copy;
+}
+
+// Index of the first element in the tail
+MARA_PRIVATE mara_index_t
+mara_pvec_tail_offset(mara_index_t len) {
+	return len < MARA_PVEC_BRANCHES ? 0 : ((len - 1) >> MARA_PVEC_BITS) << MARA_PVEC_BITS;
+}
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_leaf_for(mara_pvec_t* vec, mara_index_t index) {
+	if (index >= mara_pvec_tail_offset(vec->len)) {
+		return vec->tail;
+	}
+
+	mara_pvec_node_t* node = vec->root;
+	for (mara_index_t level = vec->shift; level > 0; level -= MARA_PVEC_BITS) {
+		node = node->children[(index >> level) & MARA_PVEC_MASK];
+	}
+	return node;
+}
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_new_path(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_index_t level, mara_pvec_node_t* leaf) {
+	if (level == 0) { return leaf; }
+
+	mara_pvec_node_t* node = mara_pvec_new_branch(ctx, zone);
+	node->children[0] = mara_pvec_new_path(ctx, zone, level - MARA_PVEC_BITS, leaf);
+	return node;
+}
+
+// Put the full tail of a vector with len elements into the tree
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_push_tail(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t len,
+	mara_index_t level,
+	mara_pvec_node_t* parent,
+	mara_pvec_node_t* tail
+) {
+	mara_index_t index = ((len - 1) >> level) & MARA_PVEC_MASK;
+	mara_pvec_node_t* node = parent != NULL
+		? mara_pvec_copy_node(ctx, zone, parent)
+		: mara_pvec_new_branch(ctx, zone);
+
+	if (level == MARA_PVEC_BITS) {
+		node->children[index] = tail;
+	} else {
+		mara_pvec_node_t* child = parent != NULL ? parent->children[index] : NULL;
+		node->children[index] = child != NULL
+			? mara_pvec_push_tail(ctx, zone, len, level - MARA_PVEC_BITS, child, tail)
+			: mara_pvec_new_path(ctx, zone, level - MARA_PVEC_BITS, tail);
+	}
+
+	return node;
+}
+
+// Remove the last leaf of a vector with len elements from the tree
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_pop_tail(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t len,
+	mara_index_t level,
+	mara_pvec_node_t* node
+) {
+	mara_index_t index = ((len - 2) >> level) & MARA_PVEC_MASK;
+	if (level > MARA_PVEC_BITS) {
+		mara_pvec_node_t* new_child = mara_pvec_pop_tail(
+			ctx, zone, len, level - MARA_PVEC_BITS, node->children[index]
+		);
+		if (new_child == NULL && index == 0) { return NULL; }
+
+		mara_pvec_node_t* new_node = mara_pvec_copy_node(ctx, zone, node);
+		new_node->children[index] = new_child;
+		return new_node;
+	} else if (index == 0) {
+		return NULL;
+	} else {
+		mara_pvec_node_t* new_node = mara_pvec_copy_node(ctx, zone, node);
+		new_node->children[index] = NULL;
+		return new_node;
+	}
+}
+
+MARA_PRIVATE mara_pvec_node_t*
+mara_pvec_assoc(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t level,
+	mara_pvec_node_t* node,
+	mara_index_t index,
+	mara_value_t value
+) {
+	mara_pvec_node_t* new_node = mara_pvec_copy_node(ctx, zone, node);
+	if (level == 0) {
+		new_node->elems[index & MARA_PVEC_MASK] = value;
+	} else {
+		mara_index_t child_index = (index >> level) & MARA_PVEC_MASK;
+		new_node->children[child_index] = mara_pvec_assoc(
+			ctx, zone, level - MARA_PVEC_BITS, node->children[child_index], index, value
+		);
+	}
+
+	return new_node;
+}
+
+MARA_PRIVATE mara_pvec_t*
+mara_pvec_new_version(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pvec_t vec) {
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_pvec_t));
+	obj->type = MARA_OBJ_TYPE_PVEC;
+
+	mara_pvec_t* result = (mara_pvec_t*)obj->body;
+	*result = vec;
+	return result;
+}
+
+MARA_PRIVATE mara_pvec_t*
+mara_pvec_in_zone(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pvec_t* vec) {
+	mara_value_t copy = mara_copy(ctx, zone, mara_value_from_pvec(vec));
+	mara_pvec_t* result;
+	mara_assert_no_error(mara_value_to_pvec(ctx, copy, &result));
+	return result;
+}
+
+mara_pvec_t*
+mara_new_pvec(mara_exec_ctx_t* ctx, mara_zone_t* zone) {
+	return mara_pvec_new_version(ctx, zone, (mara_pvec_t){ .shift = MARA_PVEC_BITS });
+}
+
+mara_index_t
+mara_pvec_len(mara_exec_ctx_t* ctx, mara_pvec_t* vec) {
+	(void)ctx;
+	return vec->len;
+}
+
+mara_value_t
+mara_pvec_get(mara_exec_ctx_t* ctx, mara_pvec_t* vec, mara_index_t index) {
+	(void)ctx;
+	if (MARA_EXPECT(0 <= index && index < vec->len)) {
+		return mara_pvec_leaf_for(vec, index)->elems[index & MARA_PVEC_MASK];
+	} else {
+		return mara_nil();
+	}
+}
+
+mara_pvec_t*
+mara_pvec_set(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_pvec_t* vec,
+	mara_index_t index,
+	mara_value_t value
+) {
+	if (index == vec->len) {
+		return mara_pvec_push(ctx, zone, vec, value);
+	}
+
+	vec = mara_pvec_in_zone(ctx, zone, vec);
+	if (index < 0 || index > vec->len) { return vec; }
+
+	value = mara_copy(ctx, zone, value);
+
+	mara_pvec_t result = *vec;
+	if (index >= mara_pvec_tail_offset(vec->len)) {
+		result.tail = mara_pvec_copy_node(ctx, zone, vec->tail);
+		result.tail->elems[index & MARA_PVEC_MASK] = value;
+	} else {
+		result.root = mara_pvec_assoc(ctx, zone, vec->shift, vec->root, index, value);
+	}
+
+	return mara_pvec_new_version(ctx, zone, result);
+}
+
+mara_pvec_t*
+mara_pvec_push(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pvec_t* vec, mara_value_t value) {
+	vec = mara_pvec_in_zone(ctx, zone, vec);
+	value = mara_copy(ctx, zone, value);
+
+	mara_index_t len = vec->len;
+	mara_index_t tail_len = len - mara_pvec_tail_offset(len);
+	mara_pvec_t result = *vec;
+	result.len = len + 1;
+
+	if (tail_len < MARA_PVEC_BRANCHES) {
+		result.tail = vec->tail != NULL
+			? mara_pvec_copy_node(ctx, zone, vec->tail)
+			: mara_pvec_new_leaf(ctx, zone);
+		result.tail->elems[tail_len] = value;
+	} else {
+		if ((len >> MARA_PVEC_BITS) > ((mara_index_t)1 << vec->shift)) {
+			// The root is full, grow the tree by one level
+			result.root = mara_pvec_new_branch(ctx, zone);
+			result.root->children[0] = vec->root;
+			result.root->children[1] = mara_pvec_new_path(ctx, zone, vec->shift, vec->tail);
+			result.shift += MARA_PVEC_BITS;
+		} else {
+			result.root = mara_pvec_push_tail(ctx, zone, len, vec->shift, vec->root, vec->tail);
+		}
+
+		result.tail = mara_pvec_new_leaf(ctx, zone);
+		result.tail->elems[0] = value;
+	}
+
+	return mara_pvec_new_version(ctx, zone, result);
+}
+
+mara_pvec_t*
+mara_pvec_pop(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_pvec_t* vec) {
+	mara_index_t len = vec->len;
+	if (len == 1) { return mara_new_pvec(ctx, zone); }
+
+	vec = mara_pvec_in_zone(ctx, zone, vec);
+	if (len == 0) { return vec; }
+
+	mara_index_t tail_len = len - mara_pvec_tail_offset(len);
+	mara_pvec_t result = *vec;
+	result.len = len - 1;
+
+	if (tail_len > 1) {
+		result.tail = mara_pvec_copy_node(ctx, zone, vec->tail);
+		result.tail->elems[tail_len - 1] = mara_nil();
+	} else {
+		// The last leaf in the tree becomes the tail
+		result.tail = mara_pvec_leaf_for(vec, len - 2);
+		result.root = mara_pvec_pop_tail(ctx, zone, len, vec->shift, vec->root);
+		if (result.shift > MARA_PVEC_BITS && result.root->children[1] == NULL) {
+			result.root = result.root->children[0];
+			result.shift -= MARA_PVEC_BITS;
+		}
+	}
+
+	return mara_pvec_new_version(ctx, zone, result);
+}
+
+mara_error_t*
+mara_pvec_foreach(mara_exec_ctx_t* ctx, mara_pvec_t* vec, mara_fn_t* fn) {
+	mara_index_t len = vec->len;
+	mara_value_t vec_value = mara_value_from_pvec(vec);
+	for (mara_index_t i = 0; i < len; ++i) {
+		mara_value_t args[] = {
+			mara_pvec_get(ctx, vec, i),
+			mara_value_from_int(i),
+			vec_value,
+		};
+		mara_value_t should_continue = mara_nil();
+		mara_check_error(
+			mara_call(ctx, ctx->current_zone, fn, mara_count_of(args), args, &should_continue)
+		);
+
+		if (mara_value_is_false(should_continue)) {
+			break;
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,100 @@
+#include "internal.h"
+#include "xxhash.h"
+
+#define BHAMT_IS_TOMBSTONE(node) false
+#define BHAMT_KEYEQ(lhs, rhs) mara_record_type_key_equal(&(lhs), &(rhs))
+
+typedef struct {
+	mara_value_t name;
+	mara_index_t num_fields;
+	const mara_value_t* fields;
+} mara_record_type_key_t;
+
+MARA_PRIVATE bool
+mara_record_type_key_equal(const void* lhs_ptr, const void* rhs_ptr) {
+	const mara_record_type_key_t* lhs = lhs_ptr;
+	const mara_record_type_key_t* rhs = rhs_ptr;
+	return lhs->name.internal == rhs->name.internal
+		&& lhs->num_fields == rhs->num_fields
+		&& (
+			lhs->num_fields == 0
+			|| memcmp(lhs->fields, rhs->fields, sizeof(mara_value_t) * lhs->num_fields) == 0
+		);
+}
+
+const mara_record_type_t*
+mara_intern_record_type(
+	mara_exec_ctx_t* ctx,
+	mara_value_t name,
+	mara_index_t num_fields,
+	const mara_value_t* fields
+) {
+	mara_env_t* env = ctx->env;
+	mara_zone_t* permanent_zone = &env->permanent_zone;
+
+	mara_record_type_key_t key = {
+		.name = name,
+		.num_fields = num_fields,
+		.fields = fields,
+	};
+	BHAMT_HASH_TYPE hash = mara_XXH3_64bits_withSeed(
+		fields, sizeof(mara_value_t) * num_fields, name.internal
+	);
+
+	mara_mutex_lock(&env->lock);
+
+	mara_record_type_node_t** itr;
+	mara_record_type_node_t* free_node;
+	mara_record_type_node_t* node;
+	(void)free_node;
+	BHAMT_SEARCH(env->record_types, itr, node, free_node, hash, key);
+
+	if (node == NULL) {
+		mara_record_type_t* type = mara_zone_alloc_ex(
+			ctx, permanent_zone,
+			sizeof(mara_record_type_t) + sizeof(mara_value_t) * num_fields,
+			_Alignof(mara_record_type_t)
+		);
+		mara_assert(type != NULL, "Out of memory");
+		type->name = name;
+		type->num_fields = num_fields;
+		if (num_fields > 0) {
+			memcpy(type->fields, fields, sizeof(mara_value_t) * num_fields);
+		}
+
+		node = *itr = MARA_ZONE_ALLOC_TYPE(ctx, permanent_zone, mara_record_type_node_t);
+		mara_assert(node != NULL, "Out of memory");
+		memset(node->children, 0, sizeof(node->children));
+		node->key.name = name;
+		node->key.num_fields = num_fields;
+		node->key.fields = type->fields;
+		node->type = type;
+	}
+
+	mara_mutex_unlock(&env->lock);
+
+	return node->type;
+}
+
+mara_record_t*
+mara_new_record(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	const mara_record_type_t* type,
+	const mara_value_t* values
+) {
+	mara_index_t num_fields = type->num_fields;
+	mara_obj_t* obj = mara_alloc_obj(
+		ctx, zone,
+		sizeof(mara_record_t) + sizeof(mara_value_t) * num_fields
+	);
+	obj->type = MARA_OBJ_TYPE_RECORD;
+
+	mara_record_t* record = (mara_record_t*)obj->body;
+	record->type = type;
+	for (mara_index_t i = 0; i < num_fields; ++i) {
+		record->fields[i] = mara_copy(ctx, zone, values[i]);
+	}
+
+	return record;
+}
@@ -0,0 +1,1418 @@
+#include "internal.h"
+
+MARA_PRIVATE void*
+mara_barray_realloc(mara_env_t* env, void* ptr, size_t size);
+
+#define BARRAY_REALLOC(ctx, ptr, size) mara_barray_realloc(ctx, ptr, size)
+#define BARRAY_CTX_TYPE mara_env_t*
+#include "barray.h"
+
+// Code images are laid out so that they can be used in place:
+//
+// header | string table | root function
+//
+// A function is followed by its nested functions in pre-order:
+//
+// function header | instructions | constant kinds | constant values
+// | record types | source info (optional) | nested functions
+//
+// A record type is its name, its number of fields and the field names, all as
+// int32.
+//
+// Every section starts at a multiple of MARA_IMAGE_ALIGNMENT from the start
+// of the image.
+// Images are produced by mara_dump and are trusted: instructions are not
+// validated on load.
+//
+// Data is a stream of tagged values in pre-order:
+//
+// magic | version | value
+//
+// Lengths and ids are LEB128 varints, ints are zigzag varints and reals are
+// 8 bytes little-endian.
+// Strings, lists and maps are numbered in the order they are first written so
+// later occurrences, including cycles, become back references.
+// Symbols are written by name once and referenced by index afterward.
+
+#define MARA_IMAGE_VERSION 4
+#define MARA_IMAGE_BYTE_ORDER 0x0102
+#define MARA_IMAGE_NO_STRING ((int32_t)-1)
+
+#define MARA_DATA_VERSION 1
+#define MARA_DATA_BUFFER_SIZE 4096
+#define MARA_DATA_MAX_DEPTH 1024
+#define MARA_DATA_MAX_INITIAL_CAPACITY 1024
+#define MARA_DATA_READ_CHUNK_SIZE 4096
+#define MARA_DATA_REAL_EXPONENT_MASK 0x7ff0000000000000llu
+#define MARA_DATA_REAL_MANTISSA_MASK 0x000fffffffffffffllu
+#define MARA_DATA_REAL_CANONICAL_NAN 0x7ff8000000000000llu
+
+static const char MARA_CODE_IMAGE_MAGIC[4] = { 'm', 'a', 'r', 'c' };
+static const char MARA_DATA_IMAGE_MAGIC[4] = { 'm', 'a', 'r', 'd' };
+
+typedef enum {
+	MARA_IMAGE_FUNCTION_HAS_SOURCE_INFO = 1 << 0,
+} mara_image_function_flag_t;
+
+typedef enum {
+	MARA_IMAGE_CONSTANT_IMMEDIATE,
+	MARA_IMAGE_CONSTANT_STR,
+	MARA_IMAGE_CONSTANT_SYM,
+} mara_image_constant_kind_t;
+
+typedef enum {
+	MARA_DATA_NIL,
+	MARA_DATA_TRUE,
+	MARA_DATA_FALSE,
+	MARA_DATA_INT,
+	MARA_DATA_REAL,
+	MARA_DATA_STR,
+	MARA_DATA_SYM,
+	MARA_DATA_SYM_REF,
+	MARA_DATA_LIST,
+	MARA_DATA_MAP,
+	MARA_DATA_OBJ_REF,
+} mara_data_tag_t;
+
+typedef struct {
+	char magic[4];
+	uint16_t version;
+	uint16_t byte_order;
+	uint32_t size;
+	uint32_t num_strings;
+} mara_image_header_t;
+
+typedef struct {
+	uint32_t flags;
+	int32_t filename;
+	uint32_t num_args;
+	uint32_t num_locals;
+	uint32_t num_captures;
+	uint32_t stack_size;
+	uint32_t num_instructions;
+	uint32_t num_constants;
+	uint32_t num_functions;
+	uint32_t num_inline_caches;
+	uint32_t num_record_types;
+	// In int32
+	uint32_t record_types_size;
+} mara_image_function_t;
+
+typedef struct {
+	int32_t filename;
+	int32_t start_line;
+	int32_t start_col;
+	int32_t start_byte_offset;
+	int32_t end_line;
+	int32_t end_col;
+	int32_t end_byte_offset;
+} mara_image_source_info_t;
+
+_Static_assert(sizeof(mara_image_header_t) % MARA_IMAGE_ALIGNMENT == 0, "Misaligned image header");
+_Static_assert(sizeof(mara_image_function_t) % MARA_IMAGE_ALIGNMENT == 0, "Misaligned function header");
+
+typedef struct {
+	mara_exec_ctx_t* ctx;
+	mara_zone_t* local_zone;
+	mara_writer_t writer;
+	size_t offset;
+
+	mara_map_t* string_ids;
+	mara_list_t* strings;
+} mara_dump_ctx_t;
+
+typedef struct {
+	mara_exec_ctx_t* ctx;
+	const char* begin;
+	const char* ptr;
+	const char* end;
+
+	uint32_t num_strings;
+	mara_str_t* strings;
+} mara_load_ctx_t;
+
+typedef struct {
+	mara_exec_ctx_t* ctx;
+	mara_writer_t writer;
+	size_t size;
+	mara_index_t depth;
+
+	mara_map_t* object_ids;
+	mara_map_t* symbol_ids;
+
+	mara_index_t buffer_len;
+	uint8_t buffer[MARA_DATA_BUFFER_SIZE];
+} mara_data_encoder_t;
+
+typedef struct {
+	mara_exec_ctx_t* ctx;
+	mara_zone_t* zone;
+	mara_zone_t* local_zone;
+	mara_reader_t reader;
+	mara_index_t depth;
+
+	barray(mara_value_t) objects;
+	barray(mara_value_t) symbols;
+} mara_data_decoder_t;
+
+MARA_PRIVATE void*
+mara_barray_realloc(mara_env_t* env, void* ptr, size_t size) {
+	return mara_realloc(env->options.allocator, ptr, size);
+}
+
+MARA_PRIVATE size_t
+mara_image_align(size_t size) {
+	return (size + MARA_IMAGE_ALIGNMENT - 1) & ~(size_t)(MARA_IMAGE_ALIGNMENT - 1);
+}
+
+// Dump
+
+MARA_PRIVATE mara_error_t*
+mara_dump_write(mara_dump_ctx_t* ctx, const void* data, size_t size) {
+	if (size == 0) { return NULL; }
+
+	mara_index_t bytes_written = mara_write(data, (mara_index_t)size, ctx->writer);
+	if (MARA_EXPECT(bytes_written == (mara_index_t)size)) {
+		ctx->offset += size;
+		return NULL;
+	} else {
+		return mara_errorf(
+			ctx->ctx,
+			mara_str_from_literal("core/io-error"),
+			"Writer returned: %d",
+			mara_value_from_int(bytes_written),
+			bytes_written
+		);
+	}
+}
+
+MARA_PRIVATE mara_error_t*
+mara_dump_pad(mara_dump_ctx_t* ctx) {
+	static const char zeros[MARA_IMAGE_ALIGNMENT] = { 0 };
+	return mara_dump_write(ctx, zeros, mara_image_align(ctx->offset) - ctx->offset);
+}
+
+MARA_PRIVATE int32_t
+mara_dump_string_id(mara_dump_ctx_t* ctx, mara_str_t str) {
+	mara_exec_ctx_t* exec_ctx = ctx->ctx;
+	mara_value_t key = mara_new_str(exec_ctx, ctx->local_zone, str);
+	mara_value_t id = mara_map_get(exec_ctx, ctx->string_ids, key);
+
+	mara_index_t result;
+	if (mara_value_is_int(id)) {
+		mara_assert_no_error(mara_value_to_int(exec_ctx, id, &result));
+	} else {
+		result = mara_list_len(exec_ctx, ctx->strings);
+		mara_list_push(exec_ctx, ctx->strings, key);
+		mara_map_set(exec_ctx, ctx->string_ids, key, mara_value_from_int(result));
+	}
+
+	return result;
+}
+
+MARA_PRIVATE int32_t
+mara_dump_filename_id(mara_dump_ctx_t* ctx, mara_str_t filename) {
+	return filename.data != NULL
+		? mara_dump_string_id(ctx, filename)
+		: MARA_IMAGE_NO_STRING;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_dump_classify_constant(
+	mara_dump_ctx_t* ctx,
+	mara_value_t constant,
+	mara_image_constant_kind_t* kind,
+	uint64_t* value
+) {
+	mara_exec_ctx_t* exec_ctx = ctx->ctx;
+	mara_str_t str;
+	mara_small_str_buf_t buf;
+
+	if (mara_value_is_str(constant)) {
+		mara_assert_no_error(mara_value_to_str_buf(exec_ctx, constant, &buf, &str));
+		*kind = MARA_IMAGE_CONSTANT_STR;
+		*value = (uint64_t)mara_dump_string_id(ctx, str);
+		return NULL;
+	} else if (mara_value_is_sym(constant)) {
+		mara_assert_no_error(mara_value_to_str_buf(exec_ctx, constant, &buf, &str));
+		*kind = MARA_IMAGE_CONSTANT_SYM;
+		*value = (uint64_t)mara_dump_string_id(ctx, str);
+		return NULL;
+	} else if (!mara_value_is_obj(constant)) {
+		*kind = MARA_IMAGE_CONSTANT_IMMEDIATE;
+		*value = constant.internal;
+		return NULL;
+	} else {
+		return mara_errorf(
+			exec_ctx,
+			mara_str_from_literal("core/dump-error/unsupported-value"),
+			"Cannot dump a constant of type %s",
+			constant,
+			mara_value_type_name(mara_value_type(constant, NULL))
+		);
+	}
+}
+
+MARA_PRIVATE int32_t
+mara_dump_sym_id(mara_dump_ctx_t* ctx, mara_value_t sym) {
+	mara_str_t str;
+	mara_small_str_buf_t str_buf;
+	mara_assert_no_error(mara_value_to_str_buf(ctx->ctx, sym, &str_buf, &str));
+	return mara_dump_string_id(ctx, str);
+}
+
+MARA_PRIVATE size_t
+mara_dump_record_types_size(const mara_vm_function_t* function) {
+	size_t size = 0;
+	for (mara_index_t i = 0; i < function->num_record_types; ++i) {
+		size += 2 + (size_t)function->record_types[i]->num_fields;
+	}
+	return size;
+}
+
+// Intern every string and compute the size of the function tree
+MARA_PRIVATE mara_error_t*
+mara_dump_prepare_function(
+	mara_dump_ctx_t* ctx,
+	const mara_vm_function_t* function,
+	size_t* size
+) {
+	mara_dump_filename_id(ctx, function->filename);
+
+	*size += sizeof(mara_image_function_t);
+	*size += mara_image_align(sizeof(mara_instruction_t) * function->num_instructions);
+	*size += mara_image_align(sizeof(uint8_t) * function->num_constants);
+	*size += sizeof(uint64_t) * function->num_constants;
+
+	for (mara_index_t i = 0; i < function->num_constants; ++i) {
+		mara_image_constant_kind_t kind;
+		uint64_t value;
+		mara_check_error(mara_dump_classify_constant(ctx, function->constants[i], &kind, &value));
+	}
+
+	*size += mara_image_align(sizeof(int32_t) * mara_dump_record_types_size(function));
+	for (mara_index_t i = 0; i < function->num_record_types; ++i) {
+		const mara_record_type_t* type = function->record_types[i];
+		mara_dump_sym_id(ctx, type->name);
+		for (mara_index_t j = 0; j < type->num_fields; ++j) {
+			mara_dump_sym_id(ctx, type->fields[j]);
+		}
+	}
+
+	if (function->source_info != NULL) {
+		*size += mara_image_align(sizeof(mara_image_source_info_t) * function->num_instructions);
+		for (mara_index_t i = 0; i < function->num_instructions; ++i) {
+			mara_dump_filename_id(ctx, function->source_info[i].filename);
+		}
+	}
+
+	for (mara_index_t i = 0; i < function->num_functions; ++i) {
+		mara_check_error(mara_dump_prepare_function(ctx, function->functions[i], size));
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_dump_function(mara_dump_ctx_t* ctx, const mara_vm_function_t* function) {
+	mara_image_function_t header = {
+		.flags = function->source_info != NULL ? MARA_IMAGE_FUNCTION_HAS_SOURCE_INFO : 0,
+		.filename = mara_dump_filename_id(ctx, function->filename),
+		.num_args = (uint32_t)function->num_args,
+		.num_locals = (uint32_t)function->num_locals,
+		.num_captures = (uint32_t)function->num_captures,
+		.stack_size = (uint32_t)function->stack_size,
+		.num_instructions = (uint32_t)function->num_instructions,
+		.num_constants = (uint32_t)function->num_constants,
+		.num_functions = (uint32_t)function->num_functions,
+		.num_inline_caches = (uint32_t)function->num_inline_caches,
+		.num_record_types = (uint32_t)function->num_record_types,
+		.record_types_size = (uint32_t)mara_dump_record_types_size(function),
+	};
+	mara_check_error(mara_dump_write(ctx, &header, sizeof(header)));
+
+	mara_check_error(mara_dump_write(
+		ctx,
+		function->instructions,
+		sizeof(mara_instruction_t) * function->num_instructions
+	));
+	mara_check_error(mara_dump_pad(ctx));
+
+	for (mara_index_t i = 0; i < function->num_constants; ++i) {
+		mara_image_constant_kind_t kind;
+		uint64_t value;
+		mara_check_error(mara_dump_classify_constant(ctx, function->constants[i], &kind, &value));
+		uint8_t kind_byte = (uint8_t)kind;
+		mara_check_error(mara_dump_write(ctx, &kind_byte, sizeof(kind_byte)));
+	}
+	mara_check_error(mara_dump_pad(ctx));
+
+	for (mara_index_t i = 0; i < function->num_constants; ++i) {
+		mara_image_constant_kind_t kind;
+		uint64_t value;
+		mara_check_error(mara_dump_classify_constant(ctx, function->constants[i], &kind, &value));
+		mara_check_error(mara_dump_write(ctx, &value, sizeof(value)));
+	}
+
+	for (mara_index_t i = 0; i < function->num_record_types; ++i) {
+		const mara_record_type_t* type = function->record_types[i];
+		int32_t type_header[] = { mara_dump_sym_id(ctx, type->name), type->num_fields };
+		mara_check_error(mara_dump_write(ctx, type_header, sizeof(type_header)));
+		for (mara_index_t j = 0; j < type->num_fields; ++j) {
+			int32_t field_id = mara_dump_sym_id(ctx, type->fields[j]);
+			mara_check_error(mara_dump_write(ctx, &field_id, sizeof(field_id)));
+		}
+	}
+	mara_check_error(mara_dump_pad(ctx));
+
+	if (function->source_info != NULL) {
+		for (mara_index_t i = 0; i < function->num_instructions; ++i) {
+			mara_source_info_t source_info = function->source_info[i];
+			mara_image_source_info_t image_source_info = {
+				.filename = mara_dump_filename_id(ctx, source_info.filename),
+				.start_line = source_info.range.start.line,
+				.start_col = source_info.range.start.col,
+				.start_byte_offset = source_info.range.start.byte_offset,
+				.end_line = source_info.range.end.line,
+				.end_col = source_info.range.end.col,
+				.end_byte_offset = source_info.range.end.byte_offset,
+			};
+			mara_check_error(mara_dump_write(ctx, &image_source_info, sizeof(image_source_info)));
+		}
+		mara_check_error(mara_dump_pad(ctx));
+	}
+
+	for (mara_index_t i = 0; i < function->num_functions; ++i) {
+		mara_check_error(mara_dump_function(ctx, function->functions[i]));
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_dump_code(mara_dump_ctx_t* ctx, const mara_vm_function_t* function, size_t* size_out) {
+	mara_exec_ctx_t* exec_ctx = ctx->ctx;
+
+	size_t functions_size = 0;
+	mara_check_error(mara_dump_prepare_function(ctx, function, &functions_size));
+
+	mara_index_t num_strings = mara_list_len(exec_ctx, ctx->strings);
+	size_t strings_size = 0;
+	for (mara_index_t i = 0; i < num_strings; ++i) {
+		mara_str_t str;
+		mara_small_str_buf_t str_buf;
+		mara_assert_no_error(mara_value_to_str_buf(exec_ctx, mara_list_get(exec_ctx, ctx->strings, i), &str_buf, &str));
+		strings_size += sizeof(uint32_t) + (size_t)str.len;
+	}
+	strings_size = mara_image_align(strings_size);
+
+	size_t size = sizeof(mara_image_header_t) + strings_size + functions_size;
+	if (size > UINT32_MAX) {
+		return mara_errorf(
+			exec_ctx,
+			mara_str_from_literal("core/dump-error/too-large"),
+			"Image is too large",
+			mara_nil()
+		);
+	}
+
+	mara_image_header_t header = {
+		.version = MARA_IMAGE_VERSION,
+		.byte_order = MARA_IMAGE_BYTE_ORDER,
+		.size = (uint32_t)size,
+		.num_strings = (uint32_t)num_strings,
+	};
+	memcpy(header.magic, MARA_CODE_IMAGE_MAGIC, sizeof(header.magic));
+	mara_check_error(mara_dump_write(ctx, &header, sizeof(header)));
+
+	for (mara_index_t i = 0; i < num_strings; ++i) {
+		mara_str_t str;
+		mara_small_str_buf_t str_buf;
+		mara_assert_no_error(mara_value_to_str_buf(exec_ctx, mara_list_get(exec_ctx, ctx->strings, i), &str_buf, &str));
+		uint32_t len = (uint32_t)str.len;
+		mara_check_error(mara_dump_write(ctx, &len, sizeof(len)));
+		mara_check_error(mara_dump_write(ctx, str.data, (size_t)str.len));
+	}
+	mara_check_error(mara_dump_pad(ctx));
+
+	mara_check_error(mara_dump_function(ctx, function));
+	mara_assert(ctx->offset == size, "Image size mismatch");
+
+	*size_out = size;
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_dump_code_value(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* local_zone,
+	mara_value_t value,
+	mara_writer_t writer,
+	size_t* size
+) {
+	mara_obj_t* obj = mara_value_to_obj(value);
+	mara_fn_t* fn = (mara_fn_t*)obj->body;
+	if (obj->type != MARA_OBJ_TYPE_VM_FN) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/dump-error/unsupported-value"),
+			"Cannot dump a native function",
+			value
+		);
+	} else if (fn->prototype.vm->num_captures > 0) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/dump-error/unsupported-value"),
+			"Cannot dump a closure with captures",
+			value
+		);
+	}
+
+	mara_dump_ctx_t dump_ctx = {
+		.ctx = ctx,
+		.local_zone = local_zone,
+		.writer = writer,
+		.string_ids = mara_new_map(ctx, local_zone),
+		.strings = mara_new_list(ctx, local_zone, 8),
+	};
+	return mara_dump_code(&dump_ctx, fn->prototype.vm, size);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_flush(mara_data_encoder_t* encoder) {
+	if (encoder->buffer_len == 0) { return NULL; }
+
+	mara_index_t bytes_written = mara_write(encoder->buffer, encoder->buffer_len, encoder->writer);
+	if (MARA_EXPECT(bytes_written == encoder->buffer_len)) {
+		encoder->buffer_len = 0;
+		return NULL;
+	} else {
+		return mara_errorf(
+			encoder->ctx,
+			mara_str_from_literal("core/io-error"),
+			"Writer returned: %d",
+			mara_value_from_int(bytes_written),
+			bytes_written
+		);
+	}
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_write(mara_data_encoder_t* encoder, const void* data, mara_index_t size) {
+	encoder->size += (size_t)size;
+
+	if (MARA_EXPECT(encoder->buffer_len + size <= MARA_DATA_BUFFER_SIZE)) {
+		memcpy(encoder->buffer + encoder->buffer_len, data, size);
+		encoder->buffer_len += size;
+		return NULL;
+	}
+
+	mara_check_error(mara_data_flush(encoder));
+	if (size <= MARA_DATA_BUFFER_SIZE) {
+		memcpy(encoder->buffer, data, size);
+		encoder->buffer_len = size;
+		return NULL;
+	}
+
+	mara_index_t bytes_written = mara_write(data, size, encoder->writer);
+	if (MARA_EXPECT(bytes_written == size)) {
+		return NULL;
+	} else {
+		return mara_errorf(
+			encoder->ctx,
+			mara_str_from_literal("core/io-error"),
+			"Writer returned: %d",
+			mara_value_from_int(bytes_written),
+			bytes_written
+		);
+	}
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_write_varint(mara_data_encoder_t* encoder, uint64_t value) {
+	uint8_t bytes[10];
+	mara_index_t len = 0;
+	do {
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		bytes[len++] = value != 0 ? (byte | 0x80) : byte;
+	} while (value != 0);
+
+	return mara_data_write(encoder, bytes, len);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_write_tag(mara_data_encoder_t* encoder, mara_data_tag_t tag) {
+	uint8_t byte = (uint8_t)tag;
+	return mara_data_write(encoder, &byte, 1);
+}
+
+// Return true if the value was written before
+MARA_PRIVATE bool
+mara_data_register(
+	mara_data_encoder_t* encoder,
+	mara_map_t* ids,
+	mara_value_t value,
+	mara_index_t* id
+) {
+	mara_exec_ctx_t* ctx = encoder->ctx;
+	mara_value_t existing_id = mara_map_get(ctx, ids, value);
+	if (mara_value_is_int(existing_id)) {
+		mara_assert_no_error(mara_value_to_int(ctx, existing_id, id));
+		return true;
+	} else {
+		*id = mara_map_len(ctx, ids);
+		mara_map_set(ctx, ids, value, mara_value_from_int(*id));
+		return false;
+	}
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_encode(mara_data_encoder_t* encoder, mara_value_t value) {
+	mara_exec_ctx_t* ctx = encoder->ctx;
+	mara_value_type_t type = mara_value_type(value, NULL);
+	mara_index_t id;
+
+	switch (type) {
+		case MARA_VAL_NIL:
+			return mara_data_write_tag(encoder, MARA_DATA_NIL);
+		case MARA_VAL_BOOL:
+			return mara_data_write_tag(
+				encoder,
+				mara_value_is_true(value) ? MARA_DATA_TRUE : MARA_DATA_FALSE
+			);
+		case MARA_VAL_INT: {
+			mara_index_t int_value;
+			mara_assert_no_error(mara_value_to_int(ctx, value, &int_value));
+			uint32_t zigzag = ((uint32_t)int_value << 1) ^ (uint32_t)(int_value >> 31);
+			mara_check_error(mara_data_write_tag(encoder, MARA_DATA_INT));
+			return mara_data_write_varint(encoder, zigzag);
+		}
+		case MARA_VAL_REAL: {
+			mara_real_t real_value;
+			mara_assert_no_error(mara_value_to_real(ctx, value, &real_value));
+			uint64_t bits;
+			memcpy(&bits, &real_value, sizeof(bits));
+			uint8_t bytes[8];
+			for (int i = 0; i < 8; ++i) {
+				bytes[i] = (uint8_t)(bits >> (i * 8));
+			}
+			mara_check_error(mara_data_write_tag(encoder, MARA_DATA_REAL));
+			return mara_data_write(encoder, bytes, sizeof(bytes));
+		}
+		case MARA_VAL_SYM: {
+			if (mara_data_register(encoder, encoder->symbol_ids, value, &id)) {
+				mara_check_error(mara_data_write_tag(encoder, MARA_DATA_SYM_REF));
+				return mara_data_write_varint(encoder, (uint64_t)id);
+			}
+
+			mara_str_t name;
+			mara_small_str_buf_t name_buf;
+			mara_assert_no_error(mara_value_to_str_buf(ctx, value, &name_buf, &name));
+			mara_check_error(mara_data_write_tag(encoder, MARA_DATA_SYM));
+			mara_check_error(mara_data_write_varint(encoder, (uint64_t)name.len));
+			return mara_data_write(encoder, name.data, name.len);
+		}
+		case MARA_VAL_STR:
+		case MARA_VAL_LIST:
+		case MARA_VAL_MAP:
+			if (mara_data_register(encoder, encoder->object_ids, value, &id)) {
+				mara_check_error(mara_data_write_tag(encoder, MARA_DATA_OBJ_REF));
+				return mara_data_write_varint(encoder, (uint64_t)id);
+			}
+			break;
+		default:
+			return mara_errorf(
+				ctx,
+				mara_str_from_literal("core/dump-error/unsupported-value"),
+				"Cannot dump a value of type %s",
+				value,
+				mara_value_type_name(type)
+			);
+	}
+
+	if (encoder->depth >= MARA_DATA_MAX_DEPTH) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/max-depth"),
+			"Value is nested too deeply",
+			mara_nil()
+		);
+	}
+
+	if (type == MARA_VAL_STR) {
+		mara_str_t str;
+		mara_small_str_buf_t buf;
+		mara_assert_no_error(mara_value_to_str_buf(ctx, value, &buf, &str));
+		mara_check_error(mara_data_write_tag(encoder, MARA_DATA_STR));
+		mara_check_error(mara_data_write_varint(encoder, (uint64_t)str.len));
+		return mara_data_write(encoder, str.data, str.len);
+	}
+
+	encoder->depth += 1;
+	if (type == MARA_VAL_LIST) {
+		mara_list_t* list;
+		mara_assert_no_error(mara_value_to_list(ctx, value, &list));
+		mara_check_error(mara_data_write_tag(encoder, MARA_DATA_LIST));
+		mara_check_error(mara_data_write_varint(encoder, (uint64_t)list->len));
+		for (mara_index_t i = 0; i < list->len; ++i) {
+			mara_check_error(mara_data_encode(encoder, list->elems[i]));
+		}
+	} else {
+		mara_map_t* map;
+		mara_assert_no_error(mara_value_to_map(ctx, value, &map));
+		mara_check_error(mara_data_write_tag(encoder, MARA_DATA_MAP));
+		mara_check_error(mara_data_write_varint(encoder, (uint64_t)map->len));
+		mara_map_itr_t itr = { .map = map };
+		mara_value_t entry_key, entry_value;
+		while (mara_map_itr_next(&itr, &entry_key, &entry_value)) {
+			mara_check_error(mara_data_encode(encoder, entry_key));
+			mara_check_error(mara_data_encode(encoder, entry_value));
+		}
+	}
+	encoder->depth -= 1;
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_dump_data(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* local_zone,
+	mara_value_t value,
+	mara_writer_t writer,
+	size_t* size
+) {
+	mara_data_encoder_t* encoder = MARA_ZONE_ALLOC_TYPE(ctx, local_zone, mara_data_encoder_t);
+	encoder->ctx = ctx;
+	encoder->writer = writer;
+	encoder->size = 0;
+	encoder->depth = 0;
+	encoder->object_ids = mara_new_map(ctx, local_zone);
+	encoder->symbol_ids = mara_new_map(ctx, local_zone);
+	encoder->buffer_len = 0;
+
+	uint8_t version = MARA_DATA_VERSION;
+	mara_check_error(mara_data_write(encoder, MARA_DATA_IMAGE_MAGIC, sizeof(MARA_DATA_IMAGE_MAGIC)));
+	mara_check_error(mara_data_write(encoder, &version, sizeof(version)));
+	mara_check_error(mara_data_encode(encoder, value));
+	mara_check_error(mara_data_flush(encoder));
+
+	*size = encoder->size;
+	return NULL;
+}
+
+mara_error_t*
+mara_dump(mara_exec_ctx_t* ctx, mara_value_t value, mara_writer_t writer, mara_value_t* result) {
+	mara_zone_t* local_zone = mara_zone_enter(ctx);
+	if (local_zone == NULL) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/stack-overflow"),
+			"Too many stack frames",
+			mara_nil()
+		);
+	}
+
+	// Functions are dumped as code images, everything else as data
+	size_t size;
+	mara_error_t* error = mara_value_is_fn(value)
+		? mara_dump_code_value(ctx, local_zone, value, writer, &size)
+		: mara_dump_data(ctx, local_zone, value, writer, &size);
+	if (error == NULL && result != NULL) {
+		*result = mara_value_from_int((mara_index_t)size);
+	}
+
+	mara_zone_exit(ctx, local_zone);
+	return error;
+}
+
+// Load
+
+MARA_PRIVATE mara_error_t*
+mara_load_bad_format(mara_load_ctx_t* ctx) {
+	return mara_errorf(
+		ctx->ctx,
+		mara_str_from_literal("core/load-error/bad-format"),
+		"Image is malformed at offset %d",
+		mara_value_from_int((mara_index_t)(ctx->ptr - ctx->begin)),
+		(int)(ctx->ptr - ctx->begin)
+	);
+}
+
+// Take a section of `count * elem_size` bytes and advance to the next
+// aligned offset
+MARA_PRIVATE mara_error_t*
+mara_load_take(mara_load_ctx_t* ctx, size_t count, size_t elem_size, const void** result) {
+	size_t bytes_left = (size_t)(ctx->end - ctx->ptr);
+	if (count > bytes_left / elem_size) {
+		return mara_load_bad_format(ctx);
+	}
+
+	size_t size = mara_image_align(count * elem_size);
+	if (size > bytes_left) {
+		return mara_load_bad_format(ctx);
+	}
+
+	*result = ctx->ptr;
+	ctx->ptr += size;
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_load_string(mara_load_ctx_t* ctx, int32_t id, mara_str_t* result) {
+	if (id == MARA_IMAGE_NO_STRING) {
+		*result = (mara_str_t){ 0 };
+		return NULL;
+	} else if (0 <= id && (uint32_t)id < ctx->num_strings) {
+		*result = ctx->strings[id];
+		return NULL;
+	} else {
+		return mara_load_bad_format(ctx);
+	}
+}
+
+MARA_PRIVATE mara_error_t*
+mara_load_record_types(
+	mara_load_ctx_t* ctx,
+	mara_vm_function_t* function,
+	uint32_t num_record_types,
+	uint32_t size,
+	const int32_t* words
+) {
+	mara_exec_ctx_t* exec_ctx = ctx->ctx;
+	function->num_record_types = (mara_index_t)num_record_types;
+	function->record_types = mara_zone_alloc_ex(
+		exec_ctx, &exec_ctx->env->permanent_zone,
+		sizeof(mara_record_type_t*) * num_record_types, _Alignof(mara_record_type_t*)
+	);
+
+	mara_value_t* fields = mara_zone_alloc_ex(
+		exec_ctx, mara_get_local_zone(exec_ctx),
+		sizeof(mara_value_t) * UINT8_MAX, _Alignof(mara_value_t)
+	);
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < num_record_types; ++i) {
+		if (size - offset < 2) { return mara_load_bad_format(ctx); }
+
+		mara_str_t str;
+		mara_check_error(mara_load_string(ctx, words[offset], &str));
+		mara_value_t name = mara_new_sym(exec_ctx, str);
+		int32_t num_fields = words[offset + 1];
+		offset += 2;
+		if (
+			num_fields < 0
+			|| num_fields > UINT8_MAX
+			|| (uint32_t)num_fields > size - offset
+		) {
+			return mara_load_bad_format(ctx);
+		}
+
+		for (int32_t j = 0; j < num_fields; ++j) {
+			mara_check_error(mara_load_string(ctx, words[offset++], &str));
+			fields[j] = mara_new_sym(exec_ctx, str);
+		}
+		function->record_types[i] = mara_intern_record_type(exec_ctx, name, num_fields, fields);
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_load_function(mara_load_ctx_t* ctx, mara_vm_function_t** result) {
+	mara_exec_ctx_t* exec_ctx = ctx->ctx;
+	mara_zone_t* permanent_zone = &exec_ctx->env->permanent_zone;
+
+	const void* section;
+	mara_check_error(mara_load_take(ctx, 1, sizeof(mara_image_function_t), &section));
+	const mara_image_function_t* header = section;
+	if (
+		header->num_instructions > (uint32_t)INT32_MAX
+		|| header->num_constants > (uint32_t)INT32_MAX
+		|| header->num_functions > (uint32_t)INT32_MAX
+		|| header->num_inline_caches > MARA_NO_INLINE_CACHE
+		|| header->num_record_types > UINT16_MAX
+	) {
+		return mara_load_bad_format(ctx);
+	}
+
+	// The prototype outlives the zone of any closure made from it
+	mara_vm_function_t* function = MARA_ZONE_ALLOC_TYPE(exec_ctx, permanent_zone, mara_vm_function_t);
+	*function = (mara_vm_function_t){
+		.num_args = (mara_index_t)header->num_args,
+		.num_locals = (mara_index_t)header->num_locals,
+		.num_captures = (mara_index_t)header->num_captures,
+		.stack_size = (mara_index_t)header->stack_size,
+		.num_instructions = (mara_index_t)header->num_instructions,
+		.num_constants = (mara_index_t)header->num_constants,
+		.num_functions = (mara_index_t)header->num_functions,
+		.num_inline_caches = (mara_index_t)header->num_inline_caches,
+	};
+	mara_check_error(mara_load_string(ctx, header->filename, &function->filename));
+
+	mara_check_error(mara_load_take(
+		ctx, header->num_instructions, sizeof(mara_instruction_t), &section
+	));
+	function->instructions = (mara_instruction_t*)section;
+
+	mara_check_error(mara_load_take(ctx, header->num_constants, sizeof(uint8_t), &section));
+	const uint8_t* constant_kinds = section;
+	mara_check_error(mara_load_take(ctx, header->num_constants, sizeof(uint64_t), &section));
+	const uint64_t* constant_values = section;
+
+	// Immediate constants can be used in place
+	bool all_immediate = true;
+	for (uint32_t i = 0; i < header->num_constants; ++i) {
+		all_immediate &= constant_kinds[i] == MARA_IMAGE_CONSTANT_IMMEDIATE;
+	}
+
+	if (all_immediate) {
+		function->constants = (mara_value_t*)constant_values;
+	} else {
+		function->constants = mara_zone_alloc_ex(
+			exec_ctx, permanent_zone,
+			sizeof(mara_value_t) * header->num_constants, _Alignof(mara_value_t)
+		);
+		for (uint32_t i = 0; i < header->num_constants; ++i) {
+			mara_str_t str;
+			switch ((mara_image_constant_kind_t)constant_kinds[i]) {
+				case MARA_IMAGE_CONSTANT_IMMEDIATE:
+					function->constants[i].internal = constant_values[i];
+					break;
+				case MARA_IMAGE_CONSTANT_STR:
+					if (constant_values[i] > INT32_MAX) { return mara_load_bad_format(ctx); }
+					mara_check_error(mara_load_string(ctx, (int32_t)constant_values[i], &str));
+					function->constants[i] = mara_new_str(exec_ctx, permanent_zone, str);
+					break;
+				case MARA_IMAGE_CONSTANT_SYM:
+					if (constant_values[i] > INT32_MAX) { return mara_load_bad_format(ctx); }
+					mara_check_error(mara_load_string(ctx, (int32_t)constant_values[i], &str));
+					function->constants[i] = mara_new_sym(exec_ctx, str);
+					break;
+				default:
+					return mara_load_bad_format(ctx);
+			}
+		}
+	}
+
+	mara_check_error(mara_load_take(ctx, header->record_types_size, sizeof(int32_t), &section));
+	mara_check_error(mara_load_record_types(
+		ctx, function, header->num_record_types, header->record_types_size, section
+	));
+
+	if ((header->flags & MARA_IMAGE_FUNCTION_HAS_SOURCE_INFO) != 0) {
+		mara_check_error(mara_load_take(
+			ctx, header->num_instructions, sizeof(mara_image_source_info_t), &section
+		));
+		const mara_image_source_info_t* image_source_info = section;
+
+		function->source_info = mara_zone_alloc_ex(
+			exec_ctx, permanent_zone,
+			sizeof(mara_source_info_t) * header->num_instructions, _Alignof(mara_source_info_t)
+		);
+		for (uint32_t i = 0; i < header->num_instructions; ++i) {
+			mara_source_info_t* source_info = &function->source_info[i];
+			mara_check_error(mara_load_string(ctx, image_source_info[i].filename, &source_info->filename));
+			source_info->range = (mara_source_range_t){
+				.start = {
+					.line = image_source_info[i].start_line,
+					.col = image_source_info[i].start_col,
+					.byte_offset = image_source_info[i].start_byte_offset,
+				},
+				.end = {
+					.line = image_source_info[i].end_line,
+					.col = image_source_info[i].end_col,
+					.byte_offset = image_source_info[i].end_byte_offset,
+				},
+			};
+		}
+	}
+
+	function->inline_caches = mara_zone_alloc_ex(
+		exec_ctx, permanent_zone,
+		sizeof(mara_inline_cache_t) * header->num_inline_caches, _Alignof(mara_inline_cache_t)
+	);
+	if (header->num_inline_caches > 0) {
+		memset(function->inline_caches, 0, sizeof(mara_inline_cache_t) * header->num_inline_caches);
+	}
+
+	function->functions = mara_zone_alloc_ex(
+		exec_ctx, permanent_zone,
+		sizeof(mara_vm_function_t*) * header->num_functions, _Alignof(mara_vm_function_t*)
+	);
+	for (uint32_t i = 0; i < header->num_functions; ++i) {
+		mara_check_error(mara_load_function(ctx, &function->functions[i]));
+	}
+
+	*result = function;
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_load_code(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	const char* buffer,
+	size_t size,
+	mara_value_t* result
+) {
+	mara_zone_t* local_zone = mara_zone_enter(ctx);
+	if (local_zone == NULL) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/stack-overflow"),
+			"Too many stack frames",
+			mara_nil()
+		);
+	}
+
+	mara_load_ctx_t load_ctx = {
+		.ctx = ctx,
+		.begin = buffer,
+		.ptr = buffer,
+		.end = buffer + size,
+	};
+	mara_error_t* error = NULL;
+
+	const void* section;
+	error = mara_load_take(&load_ctx, 1, sizeof(mara_image_header_t), &section);
+	if (error != NULL) { goto end; }
+	const mara_image_header_t* header = section;
+
+	if (memcmp(header->magic, MARA_CODE_IMAGE_MAGIC, sizeof(header->magic)) != 0) {
+		error = mara_errorf(
+			ctx,
+			mara_str_from_literal("core/load-error/bad-format"),
+			"Not a code image",
+			mara_nil()
+		);
+		goto end;
+	} else if (
+		header->version != MARA_IMAGE_VERSION
+		|| header->byte_order != MARA_IMAGE_BYTE_ORDER
+	) {
+		error = mara_errorf(
+			ctx,
+			mara_str_from_literal("core/load-error/unsupported-version"),
+			"Image version %d is not supported",
+			mara_value_from_int(header->version),
+			header->version
+		);
+		goto end;
+	} else if (header->size > size) {
+		error = mara_load_bad_format(&load_ctx);
+		goto end;
+	}
+	load_ctx.end = buffer + header->size;
+
+	// The string table is variable-length so it is walked once up front
+	load_ctx.num_strings = header->num_strings;
+	if (header->num_strings > size / sizeof(uint32_t)) {
+		error = mara_load_bad_format(&load_ctx);
+		goto end;
+	}
+	load_ctx.strings = mara_zone_alloc_ex(
+		ctx, local_zone,
+		sizeof(mara_str_t) * header->num_strings, _Alignof(mara_str_t)
+	);
+	for (uint32_t i = 0; i < header->num_strings; ++i) {
+		uint32_t len;
+		if ((size_t)(load_ctx.end - load_ctx.ptr) < sizeof(len)) {
+			error = mara_load_bad_format(&load_ctx);
+			goto end;
+		}
+		memcpy(&len, load_ctx.ptr, sizeof(len));
+		load_ctx.ptr += sizeof(len);
+
+		if (len > (uint32_t)(load_ctx.end - load_ctx.ptr) || len > INT32_MAX) {
+			error = mara_load_bad_format(&load_ctx);
+			goto end;
+		}
+		load_ctx.strings[i] = (mara_str_t){ .len = (mara_index_t)len, .data = load_ctx.ptr };
+		load_ctx.ptr += len;
+	}
+	load_ctx.ptr = buffer + mara_image_align((size_t)(load_ctx.ptr - buffer));
+	if (load_ctx.ptr > load_ctx.end) {
+		error = mara_load_bad_format(&load_ctx);
+		goto end;
+	}
+
+	// Functions are loaded into the permanent zone.
+	// A failed allocation must not unwind past the lock.
+	mara_vm_function_t* function;
+	jmp_buf* recovery_point = ctx->memory_quota.recovery_point;
+	ctx->memory_quota.recovery_point = NULL;
+	mara_mutex_lock(&ctx->env->lock);
+	error = mara_load_function(&load_ctx, &function);
+	mara_mutex_unlock(&ctx->env->lock);
+	ctx->memory_quota.recovery_point = recovery_point;
+	if (error != NULL) { goto end; }
+
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_fn_t));
+	obj->type = MARA_OBJ_TYPE_VM_FN;
+	mara_fn_t* closure = (mara_fn_t*)obj->body;
+	closure->prototype.vm = function;
+	*result = mara_obj_to_value(obj);
+
+end:
+	mara_zone_exit(ctx, local_zone);
+	return error;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_read_exactly(mara_exec_ctx_t* ctx, mara_reader_t reader, void* buffer, size_t size) {
+	char* ptr = buffer;
+	while (size > 0) {
+		mara_index_t bytes_read = mara_read(ptr, (mara_index_t)size, reader);
+		if (bytes_read <= 0) {
+			return mara_errorf(
+				ctx,
+				mara_str_from_literal("core/io-error"),
+				"Reader returned: %d",
+				mara_value_from_int(bytes_read),
+				bytes_read
+			);
+		}
+
+		ptr += bytes_read;
+		size -= (size_t)bytes_read;
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_bad_format(mara_data_decoder_t* decoder, const char* reason) {
+	return mara_errorf(
+		decoder->ctx,
+		mara_str_from_literal("core/load-error/bad-format"),
+		"Data is malformed: %s",
+		mara_nil(),
+		reason
+	);
+}
+
+// Nothing is read ahead so another value can follow in the same stream
+MARA_PRIVATE mara_error_t*
+mara_data_read(mara_data_decoder_t* decoder, void* buffer, mara_index_t size) {
+	char* ptr = buffer;
+	while (size > 0) {
+		mara_index_t bytes_read = mara_read(ptr, size, decoder->reader);
+		if (bytes_read == 0) {
+			return mara_data_bad_format(decoder, "unexpected end of stream");
+		} else if (bytes_read < 0) {
+			return mara_errorf(
+				decoder->ctx,
+				mara_str_from_literal("core/io-error"),
+				"Reader returned: %d",
+				mara_value_from_int(bytes_read),
+				bytes_read
+			);
+		}
+
+		ptr += bytes_read;
+		size -= bytes_read;
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_read_varint(mara_data_decoder_t* decoder, uint64_t* result) {
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		uint8_t byte;
+		mara_check_error(mara_data_read(decoder, &byte, 1));
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			*result = value;
+			return NULL;
+		}
+	}
+
+	return mara_data_bad_format(decoder, "varint is too long");
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_read_len(mara_data_decoder_t* decoder, mara_index_t* result) {
+	uint64_t len;
+	mara_check_error(mara_data_read_varint(decoder, &len));
+	if (len > INT32_MAX) {
+		return mara_data_bad_format(decoder, "length is too large");
+	}
+
+	*result = (mara_index_t)len;
+	return NULL;
+}
+
+// The buffer only grows as bytes arrive so a bogus length runs into the end
+// of the stream before it can reserve that much memory
+MARA_PRIVATE mara_error_t*
+mara_data_read_chars(mara_data_decoder_t* decoder, mara_str_builder_t* builder, mara_index_t len) {
+	mara_index_t end = builder->len + len;
+	while (builder->len < end) {
+		mara_index_t chunk_len = mara_min(end - builder->len, MARA_DATA_READ_CHUNK_SIZE);
+		if (builder->len + chunk_len > builder->capacity) {
+			mara_index_t new_capacity = end - builder->capacity > builder->capacity
+				? mara_max(builder->capacity * 2, builder->len + chunk_len)
+				: end;
+			mara_str_builder_reserve(decoder->ctx, builder, new_capacity);
+		}
+
+		mara_check_error(mara_data_read(decoder, builder->data + builder->len, chunk_len));
+		builder->len += chunk_len;
+	}
+
+	return NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_data_decode(mara_data_decoder_t* decoder, mara_value_t* result) {
+	mara_exec_ctx_t* ctx = decoder->ctx;
+	mara_env_t* env = ctx->env;
+	mara_zone_t* zone = decoder->zone;
+
+	uint8_t tag;
+	mara_check_error(mara_data_read(decoder, &tag, 1));
+
+	mara_index_t len;
+	uint64_t id;
+	switch ((mara_data_tag_t)tag) {
+		case MARA_DATA_NIL:
+			*result = mara_nil();
+			return NULL;
+		case MARA_DATA_TRUE:
+			*result = mara_value_from_bool(true);
+			return NULL;
+		case MARA_DATA_FALSE:
+			*result = mara_value_from_bool(false);
+			return NULL;
+		case MARA_DATA_INT: {
+			uint64_t zigzag;
+			mara_check_error(mara_data_read_varint(decoder, &zigzag));
+			if (zigzag > UINT32_MAX) {
+				return mara_data_bad_format(decoder, "int is out of range");
+			}
+			uint32_t bits = (uint32_t)zigzag;
+			*result = mara_value_from_int((mara_index_t)((bits >> 1) ^ (0u - (bits & 1))));
+			return NULL;
+		}
+		case MARA_DATA_REAL: {
+			uint8_t bytes[8];
+			mara_check_error(mara_data_read(decoder, bytes, sizeof(bytes)));
+			uint64_t bits = 0;
+			for (int i = 0; i < 8; ++i) {
+				bits |= (uint64_t)bytes[i] << (i * 8);
+			}
+			// Other NaN payloads would not fit in a nan-boxed value
+			if (
+				(bits & MARA_DATA_REAL_EXPONENT_MASK) == MARA_DATA_REAL_EXPONENT_MASK
+				&& (bits & MARA_DATA_REAL_MANTISSA_MASK) != 0
+			) {
+				bits = MARA_DATA_REAL_CANONICAL_NAN;
+			}
+			mara_real_t real_value;
+			memcpy(&real_value, &bits, sizeof(real_value));
+			*result = mara_value_from_real(real_value);
+			return NULL;
+		}
+		case MARA_DATA_STR: {
+			// Long strings are read straight into the string object
+			mara_check_error(mara_data_read_len(decoder, &len));
+			if (len <= MARA_SMALL_STR_MAX_LEN) {
+				mara_small_str_buf_t buf;
+				mara_check_error(mara_data_read(decoder, buf.data, len));
+				*result = mara_new_str(ctx, zone, (mara_str_t){ .len = len, .data = buf.data });
+			} else if (len <= MARA_DATA_READ_CHUNK_SIZE) {
+				mara_str_obj_t* str = mara_alloc_str_obj(ctx, zone, len);
+				mara_check_error(mara_data_read(decoder, (char*)str->str.data, len));
+				str->hash = mara_hash_str(str->str);
+				*result = mara_obj_to_value(mara_header_of(str));
+			} else {
+				mara_str_builder_t builder = { .zone = zone };
+				mara_check_error(mara_data_read_chars(decoder, &builder, len));
+				*result = mara_str_builder_build(ctx, &builder);
+			}
+
+			barray_push(env, decoder->objects, *result);
+			return NULL;
+		}
+		case MARA_DATA_SYM: {
+			mara_check_error(mara_data_read_len(decoder, &len));
+			mara_str_builder_t name = { .zone = decoder->local_zone };
+			mara_check_error(mara_data_read_chars(decoder, &name, len));
+
+			*result = mara_new_sym(ctx, (mara_str_t){ .len = name.len, .data = name.len > 0 ? name.data : "" });
+			barray_push(env, decoder->symbols, *result);
+			return NULL;
+		}
+		case MARA_DATA_SYM_REF:
+			mara_check_error(mara_data_read_varint(decoder, &id));
+			if (id >= barray_len(decoder->symbols)) {
+				return mara_data_bad_format(decoder, "invalid symbol reference");
+			}
+			*result = decoder->symbols[id];
+			return NULL;
+		case MARA_DATA_OBJ_REF:
+			mara_check_error(mara_data_read_varint(decoder, &id));
+			if (id >= barray_len(decoder->objects)) {
+				return mara_data_bad_format(decoder, "invalid object reference");
+			}
+			*result = decoder->objects[id];
+			return NULL;
+		case MARA_DATA_LIST:
+		case MARA_DATA_MAP:
+			break;
+		default:
+			return mara_data_bad_format(decoder, "unknown tag");
+	}
+
+	if (decoder->depth >= MARA_DATA_MAX_DEPTH) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/max-depth"),
+			"Value is nested too deeply",
+			mara_nil()
+		);
+	}
+
+	// Containers are registered before their elements so cycles resolve
+	mara_check_error(mara_data_read_len(decoder, &len));
+	decoder->depth += 1;
+	if (tag == MARA_DATA_LIST) {
+		mara_list_t* list = mara_new_list(
+			ctx, zone, mara_min(len, MARA_DATA_MAX_INITIAL_CAPACITY)
+		);
+		*result = mara_value_from_list(list);
+		barray_push(env, decoder->objects, *result);
+
+		for (mara_index_t i = 0; i < len; ++i) {
+			mara_value_t elem;
+			mara_check_error(mara_data_decode(decoder, &elem));
+			mara_list_push(ctx, list, elem);
+		}
+	} else {
+		mara_map_t* map = mara_new_map(ctx, zone);
+		*result = mara_value_from_map(map);
+		barray_push(env, decoder->objects, *result);
+
+		for (mara_index_t i = 0; i < len; ++i) {
+			mara_value_t key, value;
+			mara_check_error(mara_data_decode(decoder, &key));
+			mara_check_error(mara_data_decode(decoder, &value));
+			mara_map_set(ctx, map, key, value);
+		}
+	}
+	decoder->depth -= 1;
+
+	return NULL;
+}
+
+MARA_PRIVATE void
+mara_data_decoder_cleanup(mara_env_t* env, void* userdata) {
+	mara_data_decoder_t* decoder = userdata;
+	barray_free(env, decoder->objects);
+	barray_free(env, decoder->symbols);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_load_data(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_reader_t reader, mara_value_t* result) {
+	mara_zone_t* local_zone = mara_zone_enter(ctx);
+	if (local_zone == NULL) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/stack-overflow"),
+			"Too many stack frames",
+			mara_nil()
+		);
+	}
+
+	mara_data_decoder_t* decoder = MARA_ZONE_ALLOC_TYPE(ctx, local_zone, mara_data_decoder_t);
+	decoder->ctx = ctx;
+	decoder->zone = zone;
+	decoder->local_zone = local_zone;
+	decoder->reader = reader;
+	decoder->depth = 0;
+	decoder->objects = NULL;
+	decoder->symbols = NULL;
+	// Also run when an allocation over the memory quota unwinds the load
+	mara_add_finalizer(ctx, local_zone, (mara_callback_t){
+		.fn = mara_data_decoder_cleanup,
+		.userdata = decoder,
+	});
+
+	uint8_t version;
+	mara_error_t* error = mara_data_read(decoder, &version, sizeof(version));
+	if (error == NULL && version != MARA_DATA_VERSION) {
+		error = mara_errorf(
+			ctx,
+			mara_str_from_literal("core/load-error/unsupported-version"),
+			"Data version %d is not supported",
+			mara_value_from_int(version),
+			version
+		);
+	}
+	if (error == NULL) {
+		error = mara_data_decode(decoder, result);
+	}
+
+	mara_zone_exit(ctx, local_zone);
+	return error;
+}
+
+mara_error_t*
+mara_load(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_reader_t reader, mara_value_t* result) {
+	mara_image_header_t header;
+	mara_check_error(mara_read_exactly(ctx, reader, header.magic, sizeof(header.magic)));
+	if (memcmp(header.magic, MARA_DATA_IMAGE_MAGIC, sizeof(header.magic)) == 0) {
+		return mara_load_data(ctx, zone, reader, result);
+	}
+
+	mara_check_error(mara_read_exactly(
+		ctx, reader,
+		(char*)&header + sizeof(header.magic), sizeof(header) - sizeof(header.magic)
+	));
+	if (
+		memcmp(header.magic, MARA_CODE_IMAGE_MAGIC, sizeof(header.magic)) != 0
+		|| header.size < sizeof(header)
+	) {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/load-error/bad-format"),
+			"Image is malformed",
+			mara_nil()
+		);
+	}
+
+	// Code is permanent so the image is read into the permanent zone
+	char* buffer = mara_permanent_alloc(ctx, header.size, MARA_IMAGE_ALIGNMENT);
+	memcpy(buffer, &header, sizeof(header));
+	mara_check_error(mara_read_exactly(
+		ctx, reader, buffer + sizeof(header), header.size - sizeof(header)
+	));
+
+	return mara_load_code(ctx, zone, buffer, header.size, result);
+}
+
+bool
+mara_is_code_image(const void* buffer, size_t size) {
+	return size >= sizeof(MARA_CODE_IMAGE_MAGIC)
+		&& memcmp(buffer, MARA_CODE_IMAGE_MAGIC, sizeof(MARA_CODE_IMAGE_MAGIC)) == 0;
+}
+
+mara_error_t*
+mara_load_from_buffer(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	const void* buffer,
+	size_t size,
+	mara_value_t* result
+) {
+	if (((uintptr_t)buffer % MARA_IMAGE_ALIGNMENT) != 0) {
+		char* copy = mara_permanent_alloc(ctx, size, MARA_IMAGE_ALIGNMENT);
+		memcpy(copy, buffer, size);
+		buffer = copy;
+	}
+
+	return mara_load_code(ctx, zone, buffer, size, result);
+}
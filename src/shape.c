@@ -0,0 +1,87 @@
+#include "internal.h"
+#include "xxhash.h"
+
+#define BHAMT_IS_TOMBSTONE(node) false
+#define BHAMT_KEYEQ(lhs, rhs) \
+	((lhs).shape == (rhs).shape && (lhs).key.internal == (rhs).key.internal)
+
+const mara_map_shape_t mara_empty_shape = { .num_fields = 0 };
+
+MARA_PRIVATE mara_index_t
+mara_shape_cache_index(const mara_map_shape_t* shape, mara_value_t key) {
+	uint64_t bits = ((uint64_t)(uintptr_t)shape >> 4) ^ key.internal;
+	return (mara_index_t)((bits * 0x9e3779b97f4a7c15ULL) >> 58) & (MARA_SHAPE_CACHE_SIZE - 1);
+}
+
+// Must be called with the env lock held
+MARA_PRIVATE const mara_map_shape_t*
+mara_shape_find_or_create(mara_exec_ctx_t* ctx, const mara_map_shape_t* shape, mara_value_t key) {
+	mara_env_t* env = ctx->env;
+	mara_zone_t* permanent_zone = &env->permanent_zone;
+
+	mara_shape_transition_t** itr;
+	mara_shape_transition_t* free_node;
+	mara_shape_transition_t* node;
+	(void)free_node;
+	struct { const mara_map_shape_t* shape; mara_value_t key; } transition_key = {
+		.shape = shape,
+		.key = key,
+	};
+	uint64_t hash_input[] = { (uint64_t)(uintptr_t)shape, key.internal };
+	BHAMT_HASH_TYPE hash = mara_XXH3_64bits(hash_input, sizeof(hash_input));
+	BHAMT_SEARCH(env->shape_transitions, itr, node, free_node, hash, transition_key);
+	if (node != NULL) {
+		return node->shape;
+	}
+
+	mara_index_t num_fields = shape->num_fields + 1;
+	mara_map_shape_t* new_shape = mara_zone_alloc_ex(
+		ctx, permanent_zone,
+		sizeof(mara_map_shape_t) + sizeof(mara_map_field_t) * num_fields,
+		_Alignof(mara_map_shape_t)
+	);
+	mara_assert(new_shape != NULL, "Out of memory");
+	new_shape->num_fields = num_fields;
+	for (mara_index_t i = 0; i < shape->num_fields; ++i) {
+		new_shape->fields[i] = (mara_map_field_t){
+			.key = shape->fields[i].key,
+			.shape = new_shape,
+		};
+	}
+	new_shape->fields[num_fields - 1] = (mara_map_field_t){
+		.key = key,
+		.shape = new_shape,
+	};
+
+	node = *itr = MARA_ZONE_ALLOC_TYPE(ctx, permanent_zone, mara_shape_transition_t);
+	mara_assert(node != NULL, "Out of memory");
+	memset(node->children, 0, sizeof(node->children));
+	node->key.shape = shape;
+	node->key.key = key;
+	node->shape = new_shape;
+
+	return new_shape;
+}
+
+const mara_map_shape_t*
+mara_map_shape_add(mara_exec_ctx_t* ctx, const mara_map_shape_t* shape, mara_value_t key) {
+	mara_shape_cache_entry_t* cache_entry = &ctx->shape_cache[mara_shape_cache_index(shape, key)];
+	if (
+		MARA_EXPECT(cache_entry->shape == shape)
+		&& MARA_EXPECT(cache_entry->key.internal == key.internal)
+	) {
+		return cache_entry->next_shape;
+	}
+
+	mara_env_t* env = ctx->env;
+	mara_mutex_lock(&env->lock);
+	const mara_map_shape_t* next_shape = mara_shape_find_or_create(ctx, shape, key);
+	mara_mutex_unlock(&env->lock);
+
+	*cache_entry = (mara_shape_cache_entry_t){
+		.shape = shape,
+		.key = key,
+		.next_shape = next_shape,
+	};
+	return next_shape;
+}
@@ -0,0 +1,210 @@
+#include "internal.h"
+#include <mara/utils.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define MARA_STR_SSE2
+#	include <emmintrin.h>
+#endif
+
+MARA_PRIVATE mara_index_t
+mara_str_ctz(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctz(bits);
+#else
+	mara_index_t count = 0;
+	for (; (bits & 1) == 0; bits >>= 1) { ++count; }
+	return count;
+#endif
+}
+
+// Candidates are positions where both the first and the last byte of the
+// needle match, only those are compared in full
+MARA_PRIVATE const char*
+mara_str_search(const char* begin, const char* end, const char* needle, mara_index_t needle_len) {
+	const char* last = end - needle_len;
+	const char* itr = begin;
+#ifdef MARA_STR_SSE2
+	__m128i first_byte = _mm_set1_epi8(needle[0]);
+	__m128i last_byte = _mm_set1_epi8(needle[needle_len - 1]);
+	for (; last - itr >= 16; itr += 16) {
+		__m128i first_block = _mm_loadu_si128((const __m128i*)itr);
+		__m128i last_block = _mm_loadu_si128((const __m128i*)(itr + needle_len - 1));
+		uint32_t candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(first_block, first_byte),
+			_mm_cmpeq_epi8(last_block, last_byte)
+		));
+		while (candidates != 0) {
+			const char* candidate = itr + mara_str_ctz(candidates);
+			if (memcmp(candidate + 1, needle + 1, needle_len - 2) == 0) {
+				return candidate;
+			}
+			candidates &= candidates - 1;
+		}
+	}
+#endif
+
+	for (; itr <= last; ++itr) {
+		if (
+			itr[0] == needle[0]
+			&& itr[needle_len - 1] == needle[needle_len - 1]
+			&& memcmp(itr + 1, needle + 1, needle_len - 2) == 0
+		) {
+			return itr;
+		}
+	}
+
+	return NULL;
+}
+
+mara_index_t
+mara_str_find(mara_str_t str, mara_str_t needle, mara_index_t start) {
+	if (start < 0) { start = 0; }
+	if (start > str.len) { return -1; }
+	if (needle.len == 0) { return start; }
+	if (needle.len > str.len - start) { return -1; }
+
+	const char* begin = str.data + start;
+	const char* found;
+	if (needle.len == 1) {
+		// libc vectorizes this already
+		found = memchr(begin, needle.data[0], (size_t)(str.len - start));
+	} else {
+		found = mara_str_search(begin, str.data + str.len, needle.data, needle.len);
+	}
+
+	return found != NULL ? (mara_index_t)(found - str.data) : -1;
+}
+
+int
+mara_str_compare(mara_str_t lhs, mara_str_t rhs) {
+	mara_index_t min_len = lhs.len < rhs.len ? lhs.len : rhs.len;
+	int cmp = min_len > 0 ? memcmp(lhs.data, rhs.data, (size_t)min_len) : 0;
+	if (cmp != 0) {
+		return cmp < 0 ? -1 : 1;
+	} else {
+		return lhs.len < rhs.len ? -1 : (lhs.len > rhs.len ? 1 : 0);
+	}
+}
+
+mara_list_t*
+mara_str_split(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_str_t str, mara_str_t separator) {
+	mara_list_t* parts = mara_new_list(ctx, zone, 0);
+	if (separator.len == 0) {
+		mara_list_push(ctx, parts, mara_new_str(ctx, zone, str));
+		return parts;
+	}
+
+	mara_index_t start = 0;
+	while (true) {
+		mara_index_t end = mara_str_find(str, separator, start);
+		if (end < 0) { break; }
+
+		mara_list_push(ctx, parts, mara_new_str(ctx, zone, (mara_str_t){
+			.data = str.data + start,
+			.len = end - start,
+		}));
+		start = end + separator.len;
+	}
+	mara_list_push(ctx, parts, mara_new_str(ctx, zone, (mara_str_t){
+		.data = str.data + start,
+		.len = str.len - start,
+	}));
+
+	return parts;
+}
+
+mara_error_t*
+mara_str_join(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_list_t* parts,
+	mara_str_t separator,
+	mara_value_t* result
+) {
+	// Size the buffer up front so it is allocated once
+	mara_index_t total_len = parts->len > 0 ? separator.len * (parts->len - 1) : 0;
+	mara_small_str_buf_t buf;
+	for (mara_index_t i = 0; i < parts->len; ++i) {
+		mara_str_t part;
+		mara_error_t* error = mara_value_to_str_buf(ctx, parts->elems[i], &buf, &part);
+		if (error != NULL) {
+			error->extra = mara_value_from_int(i);
+			return error;
+		}
+		total_len += part.len;
+	}
+
+	mara_str_builder_t builder = { .zone = zone };
+	mara_str_builder_reserve(ctx, &builder, total_len);
+	for (mara_index_t i = 0; i < parts->len; ++i) {
+		if (i > 0) {
+			mara_str_builder_append(ctx, &builder, separator);
+		}
+
+		mara_str_t part;
+		mara_assert_no_error(mara_value_to_str_buf(ctx, parts->elems[i], &buf, &part));
+		mara_str_builder_append(ctx, &builder, part);
+	}
+
+	*result = mara_str_builder_build(ctx, &builder);
+	return NULL;
+}
+
+void
+mara_str_builder_reserve(mara_exec_ctx_t* ctx, mara_str_builder_t* builder, mara_index_t capacity) {
+	if (capacity <= builder->capacity) { return; }
+
+	mara_zone_t* zone = builder->zone;
+	// The buffer is usually the last thing allocated in its zone
+	if (
+		builder->data == NULL
+		|| !mara_arena_try_extend(ctx->env, &zone->arena, builder->data, builder->capacity, capacity)
+	) {
+		char* data = mara_zone_alloc_ex(ctx, zone, capacity, _Alignof(char));
+		mara_assert(data != NULL, "Out of memory");
+		if (builder->len > 0) {
+			memcpy(data, builder->data, builder->len);
+		}
+		builder->data = data;
+	}
+
+	builder->capacity = capacity;
+}
+
+void
+mara_str_builder_append(mara_exec_ctx_t* ctx, mara_str_builder_t* builder, mara_str_t str) {
+	if (str.len == 0) { return; }
+
+	mara_index_t new_len = builder->len + str.len;
+	if (new_len > builder->capacity) {
+		mara_index_t new_capacity = builder->capacity > 0 ? builder->capacity * 2 : 16;
+		while (new_capacity < new_len) { new_capacity *= 2; }
+		mara_str_builder_reserve(ctx, builder, new_capacity);
+	}
+
+	memcpy(builder->data + builder->len, str.data, str.len);
+	builder->len = new_len;
+}
+
+mara_value_t
+mara_str_builder_build(mara_exec_ctx_t* ctx, mara_str_builder_t* builder) {
+	if (builder->len <= MARA_SMALL_STR_MAX_LEN) {
+		mara_value_t result = mara_new_str(ctx, builder->zone, (mara_str_t){
+			.len = builder->len,
+			.data = builder->data,
+		});
+		*builder = (mara_str_builder_t){ .zone = builder->zone };
+		return result;
+	}
+
+	// The string takes over the buffer
+	mara_obj_t* obj = mara_alloc_obj(ctx, builder->zone, sizeof(mara_str_obj_t));
+	obj->type = MARA_OBJ_TYPE_STRING;
+
+	mara_str_obj_t* str = (mara_str_obj_t*)obj->body;
+	str->str = (mara_str_t){ .len = builder->len, .data = builder->data };
+	str->hash = mara_hash_str(str->str);
+
+	*builder = (mara_str_builder_t){ .zone = builder->zone };
+	return mara_obj_to_value(obj);
+}
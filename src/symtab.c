@@ -1,35 +1,43 @@
 #include "internal.h"
 #include "xxhash.h"
 
-MARA_WARNING_PUSH()
-#if defined(__clang__)
-#pragma clang diagnostic ignored "-Wunneeded-internal-declaration"
+// Segment i holds ids [(FIRST_SEGMENT_SIZE << i) - FIRST_SEGMENT_SIZE, (FIRST_SEGMENT_SIZE << (i + 1)) - FIRST_SEGMENT_SIZE)
+MARA_PRIVATE mara_index_t
+mara_symtab_segment(uint32_t biased_id) {
+#if defined(__GNUC__) || defined(__clang__)
+	return (31 - __builtin_clz(biased_id)) - MARA_SYMTAB_FIRST_SEGMENT_BITS;
+#else
+	mara_index_t segment = 0;
+	while ((biased_id >> (segment + 1)) >= MARA_SYMTAB_FIRST_SEGMENT_SIZE) {
+		++segment;
+	}
+	return segment;
 #endif
+}
 
-// Sync this list with compiler.c
-static const char* mara_builtin_symbols[] = {
-	"def", "set", "if", "fn", "do", "nil", "true", "false", "import", "export"
-};
-
-MARA_WARNING_POP()
-
-static const size_t MARA_NUM_BUILTIN_SYMBOLS =
-	sizeof(mara_builtin_symbols) / sizeof(mara_builtin_symbols[0]);
-
-void
-mara_symtab_init(mara_env_t* env, mara_symtab_t* symtab) {
-	(void)env;
-	(void)symtab;
+MARA_PRIVATE mara_symtab_node_t*
+mara_symtab_node(mara_symtab_t* symtab, mara_index_t id) {
+	uint32_t biased_id = (uint32_t)id + MARA_SYMTAB_FIRST_SEGMENT_SIZE;
+	mara_index_t segment = mara_symtab_segment(biased_id);
+	uint32_t segment_start = (uint32_t)MARA_SYMTAB_FIRST_SEGMENT_SIZE << segment;
+	return &symtab->segments[segment][biased_id - segment_start];
 }
 
-mara_index_t
-mara_symtab_intern(mara_env_t* env, mara_symtab_t* symtab, mara_str_t string) {
-	mara_index_t index_itr = symtab->len > 0 ? 0 : -1;
-	uint64_t hash_itr = mara_XXH3_64bits(string.data, string.len);
+// Safe to call concurrently with an insertion
+MARA_PRIVATE mara_index_t
+mara_symtab_find(
+	mara_symtab_t* symtab,
+	mara_str_t string,
+	uint64_t hash,
+	mara_index_t* last_node_index_out,
+	uint64_t* last_hash_out
+) {
+	mara_index_t index_itr = mara_atomic_load_i32(&symtab->len) > 0 ? 0 : -1;
+	uint64_t hash_itr = hash;
 	mara_index_t last_node_index = index_itr;
 	uint64_t last_hash_itr = hash_itr;
 	for (; index_itr >= 0; hash_itr >>= BHAMT_NUM_BITS) {
-		mara_symtab_node_t* node = &symtab->nodes[index_itr];
+		mara_symtab_node_t* node = mara_symtab_node(symtab, index_itr);
 		if (mara_str_equal(node->key, string)) {
 			break;
 		}
@@ -37,32 +45,49 @@ mara_symtab_intern(mara_env_t* env, mara_symtab_t* symtab, mara_str_t string) {
 		// Offset all indicies by 1 so we can zero the new node
 		last_node_index = index_itr;
 		last_hash_itr = hash_itr;
-		index_itr = node->children[hash_itr & BHAMT_MASK] - 1;
+		index_itr = mara_atomic_load_i32(&node->children[hash_itr & BHAMT_MASK]) - 1;
 	}
 
-	if (index_itr >= 0) {
-		return index_itr;
-	} else {
-		mara_index_t current_len = symtab->len;
-		mara_index_t current_capacity = symtab->capacity;
-		if (current_len >= symtab->capacity) {
-			mara_index_t new_capacity = current_capacity > 0
-				? current_capacity * 2
-				: (mara_index_t)MARA_NUM_BUILTIN_SYMBOLS * 2;
-			symtab->nodes = mara_realloc(
+	*last_node_index_out = last_node_index;
+	*last_hash_out = last_hash_itr;
+	return index_itr;
+}
+
+void
+mara_symtab_init(mara_env_t* env, mara_symtab_t* symtab) {
+	(void)env;
+	mara_mutex_init(&symtab->insert_lock);
+}
+
+mara_index_t
+mara_symtab_intern(mara_env_t* env, mara_symtab_t* symtab, mara_str_t string) {
+	uint64_t hash = mara_XXH3_64bits(string.data, string.len);
+	mara_index_t last_node_index;
+	uint64_t last_hash_itr;
+	mara_index_t index = mara_symtab_find(symtab, string, hash, &last_node_index, &last_hash_itr);
+	if (MARA_EXPECT(index >= 0)) { return index; }
+
+	mara_mutex_lock(&symtab->insert_lock);
+
+	// Another thread may have inserted the same string
+	index = mara_symtab_find(symtab, string, hash, &last_node_index, &last_hash_itr);
+	if (index < 0) {
+		index = symtab->len;
+		mara_index_t segment = mara_symtab_segment((uint32_t)index + MARA_SYMTAB_FIRST_SEGMENT_SIZE);
+		mara_assert(segment < MARA_SYMTAB_NUM_SEGMENTS, "Too many symbols");
+		if (symtab->segments[segment] == NULL) {
+			symtab->segments[segment] = mara_malloc(
 				env->options.allocator,
-				symtab->nodes,
-				sizeof(mara_symtab_node_t) * new_capacity
+				sizeof(mara_symtab_node_t) * ((size_t)MARA_SYMTAB_FIRST_SEGMENT_SIZE << segment)
 			);
-			mara_assert(symtab->nodes != NULL, "Out of memory");
-			symtab->capacity = new_capacity;
+			mara_assert(symtab->segments[segment] != NULL, "Out of memory");
 		}
 
-		mara_symtab_node_t* new_node = &symtab->nodes[symtab->len++];
+		mara_symtab_node_t* new_node = mara_symtab_node(symtab, index);
 
 		memset(new_node->children, 0, sizeof(new_node->children));
 		char* chars = mara_arena_alloc_ex(
-			env, &env->permanent_zone.arena,
+			env, &symtab->key_arena,
 			string.len, _Alignof(char)
 		);
 		mara_assert(chars != NULL, "Out of memory");
@@ -72,23 +97,35 @@ mara_symtab_intern(mara_env_t* env, mara_symtab_t* symtab, mara_str_t string) {
 			.data = chars,
 		};
 
+		// Publish the node only after it is fully initialized
 		if (last_node_index >= 0) {
-			symtab->nodes[last_node_index].children[last_hash_itr & BHAMT_MASK] = current_len + 1;
+			mara_symtab_node_t* parent = mara_symtab_node(symtab, last_node_index);
+			mara_atomic_store_i32(&parent->children[last_hash_itr & BHAMT_MASK], index + 1);
 		}
-
-		return current_len;
+		mara_atomic_store_i32(&symtab->len, index + 1);
 	}
+
+	mara_mutex_unlock(&symtab->insert_lock);
+	return index;
 }
 
 mara_str_t
 mara_symtab_lookup(mara_symtab_t* symtab, mara_index_t id) {
-	return symtab->nodes[id].key;
+	return mara_symtab_node(symtab, id)->key;
 }
 
 void
 mara_symtab_cleanup(mara_env_t* env, mara_symtab_t* symtab) {
-	mara_free(env->options.allocator, symtab->nodes);
+	for (mara_index_t i = 0; i < MARA_SYMTAB_NUM_SEGMENTS; ++i) {
+		mara_free(env->options.allocator, symtab->segments[i]);
+		symtab->segments[i] = NULL;
+	}
+	mara_arena_reset(env, &symtab->key_arena);
 	symtab->len = 0;
-	symtab->capacity = 0;
-	symtab->nodes = NULL;
+}
+
+void
+mara_symtab_destroy(mara_env_t* env, mara_symtab_t* symtab) {
+	mara_symtab_cleanup(env, symtab);
+	mara_mutex_cleanup(&symtab->insert_lock);
 }
@@ -0,0 +1,229 @@
+#ifndef MARA_THREAD_H
+#define MARA_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+typedef void (*mara_thread_fn_t)(void* userdata);
+
+typedef struct {
+#if defined(_WIN32)
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	mara_thread_fn_t fn;
+	void* userdata;
+} mara_thread_t;
+
+#if defined(_WIN32)
+
+static inline DWORD WINAPI
+mara_thread_entry(LPVOID arg) {
+	mara_thread_t* thread = arg;
+	thread->fn(thread->userdata);
+	return 0;
+}
+
+static inline bool
+mara_thread_start(mara_thread_t* thread, mara_thread_fn_t fn, void* userdata) {
+	thread->fn = fn;
+	thread->userdata = userdata;
+	thread->handle = CreateThread(NULL, 0, mara_thread_entry, thread, 0, NULL);
+	return thread->handle != NULL;
+}
+
+static inline void
+mara_thread_join(mara_thread_t* thread) {
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+}
+
+#else
+
+static inline void*
+mara_thread_entry(void* arg) {
+	mara_thread_t* thread = arg;
+	thread->fn(thread->userdata);
+	return NULL;
+}
+
+static inline bool
+mara_thread_start(mara_thread_t* thread, mara_thread_fn_t fn, void* userdata) {
+	thread->fn = fn;
+	thread->userdata = userdata;
+	return pthread_create(&thread->handle, NULL, mara_thread_entry, thread) == 0;
+}
+
+static inline void
+mara_thread_join(mara_thread_t* thread) {
+	pthread_join(thread->handle, NULL);
+}
+
+#endif
+
+// Mutexes are recursive so public entry points can lock without caring
+// whether the caller already holds the lock
+
+#if defined(_WIN32)
+
+typedef CRITICAL_SECTION mara_mutex_t;
+
+static inline void
+mara_mutex_init(mara_mutex_t* mutex) {
+	InitializeCriticalSection(mutex);
+}
+
+static inline void
+mara_mutex_cleanup(mara_mutex_t* mutex) {
+	DeleteCriticalSection(mutex);
+}
+
+static inline void
+mara_mutex_lock(mara_mutex_t* mutex) {
+	EnterCriticalSection(mutex);
+}
+
+static inline void
+mara_mutex_unlock(mara_mutex_t* mutex) {
+	LeaveCriticalSection(mutex);
+}
+
+#else
+
+typedef pthread_mutex_t mara_mutex_t;
+
+static inline void
+mara_mutex_init(mara_mutex_t* mutex) {
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+static inline void
+mara_mutex_cleanup(mara_mutex_t* mutex) {
+	pthread_mutex_destroy(mutex);
+}
+
+static inline void
+mara_mutex_lock(mara_mutex_t* mutex) {
+	pthread_mutex_lock(mutex);
+}
+
+static inline void
+mara_mutex_unlock(mara_mutex_t* mutex) {
+	pthread_mutex_unlock(mutex);
+}
+
+#endif
+
+// Waiting on a condition releases a mutex that must be held exactly once
+
+#if defined(_WIN32)
+
+typedef CONDITION_VARIABLE mara_cond_t;
+
+static inline void
+mara_cond_init(mara_cond_t* cond) {
+	InitializeConditionVariable(cond);
+}
+
+static inline void
+mara_cond_cleanup(mara_cond_t* cond) {
+	(void)cond;
+}
+
+static inline void
+mara_cond_wait(mara_cond_t* cond, mara_mutex_t* mutex) {
+	SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+static inline void
+mara_cond_broadcast(mara_cond_t* cond) {
+	WakeAllConditionVariable(cond);
+}
+
+#else
+
+typedef pthread_cond_t mara_cond_t;
+
+static inline void
+mara_cond_init(mara_cond_t* cond) {
+	pthread_cond_init(cond, NULL);
+}
+
+static inline void
+mara_cond_cleanup(mara_cond_t* cond) {
+	pthread_cond_destroy(cond);
+}
+
+static inline void
+mara_cond_wait(mara_cond_t* cond, mara_mutex_t* mutex) {
+	pthread_cond_wait(cond, mutex);
+}
+
+static inline void
+mara_cond_broadcast(mara_cond_t* cond) {
+	pthread_cond_broadcast(cond);
+}
+
+#endif
+
+// Acquire/release access to plain 32-bit integers and pointers
+
+#if defined(_MSC_VER)
+
+static inline int32_t
+mara_atomic_load_i32(const int32_t* ptr) {
+	return InterlockedOr((volatile LONG*)ptr, 0);
+}
+
+static inline void
+mara_atomic_store_i32(int32_t* ptr, int32_t value) {
+	InterlockedExchange((volatile LONG*)ptr, value);
+}
+
+static inline void*
+mara_atomic_load_ptr(void* const* ptr) {
+	return InterlockedCompareExchangePointer((void* volatile*)ptr, NULL, NULL);
+}
+
+static inline void
+mara_atomic_store_ptr(void** ptr, void* value) {
+	InterlockedExchangePointer((void* volatile*)ptr, value);
+}
+
+#else
+
+static inline int32_t
+mara_atomic_load_i32(const int32_t* ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+mara_atomic_store_i32(int32_t* ptr, int32_t value) {
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+static inline void*
+mara_atomic_load_ptr(void* const* ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+mara_atomic_store_ptr(void** ptr, void* value) {
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+#endif
+
+#endif
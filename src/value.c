@@ -14,6 +14,48 @@ mara_value_to_nanbox(mara_value_t value) {
 	return (nanbox_t){ .as_int64 = value.internal };
 }
 
+// Small strings use the aux range after symbols.
+// The first 4 bytes are in the payload, the last byte and the length are in
+// the low half of the tag.
+#define MARA_SMALL_STR_TAG (NANBOX_MIN_AUX_TAG + 0x00010000)
+
+MARA_PRIVATE bool
+mara_value_is_small_str(mara_value_t value) {
+	nanbox_t nanbox = mara_value_to_nanbox(value);
+	return (nanbox.as_bits.tag & 0xffff0000) == MARA_SMALL_STR_TAG;
+}
+
+MARA_PRIVATE mara_value_t
+mara_new_small_str(mara_str_t str) {
+	uint64_t bits = 0;
+	for (mara_index_t i = 0; i < str.len; ++i) {
+		bits |= (uint64_t)(uint8_t)str.data[i] << (i * 8);
+	}
+
+	nanbox_t nanbox = {
+		.as_bits = {
+			.payload = (uint32_t)bits,
+			.tag = MARA_SMALL_STR_TAG | ((uint32_t)str.len << 8) | (uint32_t)(bits >> 32),
+		},
+	};
+	return mara_nanbox_to_value(nanbox);
+}
+
+MARA_PRIVATE mara_str_t
+mara_small_str_read(mara_value_t value, mara_small_str_buf_t* buf) {
+	nanbox_t nanbox = mara_value_to_nanbox(value);
+	uint64_t bits = ((uint64_t)(nanbox.as_bits.tag & 0xff) << 32) | nanbox.as_bits.payload;
+	mara_index_t len = (mara_index_t)((nanbox.as_bits.tag >> 8) & 0xff);
+	mara_assert(len <= MARA_SMALL_STR_MAX_LEN, "Invalid small string");
+	// Also bounds the copy and the shift below in release builds
+	len = len <= MARA_SMALL_STR_MAX_LEN ? len : MARA_SMALL_STR_MAX_LEN;
+	for (mara_index_t i = 0; i < len; ++i) {
+		buf->data[i] = (char)(uint8_t)(bits >> (i * 8));
+	}
+
+	return (mara_str_t){ .len = len, .data = buf->data };
+}
+
 mara_error_t*
 mara_type_error(
 	mara_exec_ctx_t* ctx,
@@ -36,6 +78,7 @@ mara_alloc_obj(mara_exec_ctx_t* ctx, mara_zone_t* zone, size_t size) {
 	mara_assert(obj != NULL, "Out of memory");
 
 	obj->zone = zone;
+	obj->frozen = false;
 
 	return obj;
 }
@@ -55,6 +98,21 @@ mara_obj_to_value(mara_obj_t* obj) {
 	return mara_nanbox_to_value(nanbox_from_pointer(obj));
 }
 
+mara_error_t*
+mara_check_mutable(mara_exec_ctx_t* ctx, mara_value_t container) {
+	if (MARA_EXPECT(!mara_value_is_obj(container) || !mara_value_to_obj(container)->frozen)) {
+		return NULL;
+	}
+
+	return mara_errorf(
+		ctx,
+		mara_str_from_literal("core/frozen"),
+		"Cannot modify a frozen %s",
+		mara_nil(),
+		mara_value_type_name(mara_value_type(container, NULL))
+	);
+}
+
 bool
 mara_value_is_nil(mara_value_t value) {
 	nanbox_t nanbox = mara_value_to_nanbox(value);
@@ -85,7 +143,7 @@ mara_value_is_str(mara_value_t value) {
 		mara_obj_t* obj = mara_value_to_obj(value);
 		return obj->type == MARA_OBJ_TYPE_STRING;
 	} else {
-		return false;
+		return mara_value_is_small_str(value);
 	}
 }
 
@@ -137,6 +195,46 @@ mara_value_is_map(mara_value_t value) {
 	}
 }
 
+bool
+mara_value_is_pmap(mara_value_t value) {
+	if (mara_value_is_obj(value)) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		return obj->type == MARA_OBJ_TYPE_PMAP;
+	} else {
+		return false;
+	}
+}
+
+bool
+mara_value_is_pvec(mara_value_t value) {
+	if (mara_value_is_obj(value)) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		return obj->type == MARA_OBJ_TYPE_PVEC;
+	} else {
+		return false;
+	}
+}
+
+bool
+mara_value_is_record(mara_value_t value) {
+	if (mara_value_is_obj(value)) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		return obj->type == MARA_OBJ_TYPE_RECORD;
+	} else {
+		return false;
+	}
+}
+
+bool
+mara_value_is_array(mara_value_t value) {
+	if (mara_value_is_obj(value)) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		return obj->type == MARA_OBJ_TYPE_ARRAY;
+	} else {
+		return false;
+	}
+}
+
 mara_value_type_t
 mara_value_type(mara_value_t value, void** tag) {
 	nanbox_t nanbox = mara_value_to_nanbox(value);
@@ -153,6 +251,8 @@ mara_value_type(mara_value_t value, void** tag) {
 		&& nanbox.as_bits.tag == NANBOX_MIN_AUX_TAG
 	) {
 		return MARA_VAL_SYM;
+	} else if (mara_value_is_small_str(value)) {
+		return MARA_VAL_STR;
 	} else if (nanbox_is_pointer(nanbox)) {
 		mara_obj_t* obj = nanbox_to_pointer(nanbox);
 		switch (obj->type) {
@@ -170,6 +270,14 @@ mara_value_type(mara_value_t value, void** tag) {
 				return MARA_VAL_LIST;
 			case MARA_OBJ_TYPE_MAP:
 				return MARA_VAL_MAP;
+			case MARA_OBJ_TYPE_PMAP:
+				return MARA_VAL_PMAP;
+			case MARA_OBJ_TYPE_PVEC:
+				return MARA_VAL_PVEC;
+			case MARA_OBJ_TYPE_RECORD:
+				return MARA_VAL_RECORD;
+			case MARA_OBJ_TYPE_ARRAY:
+				return MARA_VAL_ARRAY;
 			default:
 				mara_assert(false, "Corrupted value");
 				return MARA_VAL_NIL;
@@ -221,10 +329,29 @@ mara_value_to_bool(mara_exec_ctx_t* ctx, mara_value_t value, bool* result) {
 
 mara_error_t*
 mara_value_to_str(mara_exec_ctx_t* ctx, mara_value_t value, mara_str_t* result) {
-	if (mara_value_is_str(value)) {
+	mara_small_str_buf_t* buf = &ctx->small_str_scratch[ctx->small_str_scratch_index];
+	mara_error_t* error = mara_value_to_str_buf(ctx, value, buf, result);
+	if (error == NULL && result->data == buf->data) {
+		ctx->small_str_scratch_index = (ctx->small_str_scratch_index + 1) % MARA_SMALL_STR_SCRATCH_SIZE;
+	}
+
+	return error;
+}
+
+mara_error_t*
+mara_value_to_str_buf(
+	mara_exec_ctx_t* ctx,
+	mara_value_t value,
+	mara_small_str_buf_t* buf,
+	mara_str_t* result
+) {
+	if (mara_value_is_obj(value) && mara_value_to_obj(value)->type == MARA_OBJ_TYPE_STRING) {
 		mara_obj_t* obj = mara_value_to_obj(value);
 		*result = *(mara_str_t*)obj->body;
 		return NULL;
+	} else if (mara_value_is_small_str(value)) {
+		*result = mara_small_str_read(value, buf);
+		return NULL;
 	} else if (mara_value_is_sym(value)) {
 		nanbox_t nanbox = mara_value_to_nanbox(value);
 		*result = mara_symtab_lookup(&ctx->env->symtab, nanbox.as_bits.payload);
@@ -295,6 +422,39 @@ mara_value_to_map(mara_exec_ctx_t* ctx, mara_value_t value, mara_map_t** result)
 	}
 }
 
+mara_error_t*
+mara_value_to_pmap(mara_exec_ctx_t* ctx, mara_value_t value, mara_pmap_t** result) {
+	if (MARA_EXPECT(mara_value_is_pmap(value))) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		*result = (mara_pmap_t*)obj->body;
+		return NULL;
+	} else {
+		return mara_type_error(ctx, MARA_VAL_PMAP, value);
+	}
+}
+
+mara_error_t*
+mara_value_to_pvec(mara_exec_ctx_t* ctx, mara_value_t value, mara_pvec_t** result) {
+	if (MARA_EXPECT(mara_value_is_pvec(value))) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		*result = (mara_pvec_t*)obj->body;
+		return NULL;
+	} else {
+		return mara_type_error(ctx, MARA_VAL_PVEC, value);
+	}
+}
+
+mara_error_t*
+mara_value_to_array(mara_exec_ctx_t* ctx, mara_value_t value, mara_array_t** result) {
+	if (MARA_EXPECT(mara_value_is_array(value))) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		*result = (mara_array_t*)obj->body;
+		return NULL;
+	} else {
+		return mara_type_error(ctx, MARA_VAL_ARRAY, value);
+	}
+}
+
 mara_error_t*
 mara_value_to_fn(mara_exec_ctx_t* ctx, mara_value_t value, mara_fn_t** result) {
 	if (MARA_EXPECT(mara_value_is_fn(value))) {
@@ -347,6 +507,27 @@ mara_value_from_map(mara_map_t* map) {
 		: mara_nil();
 }
 
+mara_value_t
+mara_value_from_pmap(mara_pmap_t* map) {
+	return map != NULL
+		? mara_obj_to_value(mara_header_of(map))
+		: mara_nil();
+}
+
+mara_value_t
+mara_value_from_pvec(mara_pvec_t* vec) {
+	return vec != NULL
+		? mara_obj_to_value(mara_header_of(vec))
+		: mara_nil();
+}
+
+mara_value_t
+mara_value_from_array(mara_array_t* array) {
+	return array != NULL
+		? mara_obj_to_value(mara_header_of(array))
+		: mara_nil();
+}
+
 mara_value_t
 mara_value_from_fn(mara_fn_t* fn) {
 	return fn != NULL
@@ -378,16 +559,34 @@ mara_vsnprintf(mara_exec_ctx_t* ctx, mara_zone_t* zone, const char* fmt, va_list
 
 mara_value_t
 mara_new_str(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_str_t value) {
-	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_str_t) + value.len);
+	if (value.len <= MARA_SMALL_STR_MAX_LEN) {
+		return mara_new_small_str(value);
+	}
+
+	mara_str_obj_t* str = mara_alloc_str_obj(ctx, zone, value.len);
+	memcpy((char*)str->str.data, value.data, value.len);
+	str->hash = mara_hash_str(str->str);
+
+	return mara_obj_to_value(mara_header_of(str));
+}
+
+mara_str_obj_t*
+mara_alloc_str_obj(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_index_t len) {
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_str_obj_t) + len);
 	obj->type = MARA_OBJ_TYPE_STRING;
 
-	mara_str_t* str = (mara_str_t*)obj->body;
-	str->len = value.len;
-	char* chars = (char*)str + sizeof(mara_str_t);
-	str->data = chars;
-	memcpy(chars, value.data, value.len);
+	mara_str_obj_t* str = (mara_str_obj_t*)obj->body;
+	str->str = (mara_str_t){ .len = len, .data = (char*)str + sizeof(mara_str_obj_t) };
+	return str;
+}
 
-	return mara_obj_to_value(obj);
+mara_value_t
+mara_copy_str(mara_exec_ctx_t* ctx, mara_zone_t* zone, const mara_str_obj_t* str) {
+	mara_str_obj_t* copy = mara_alloc_str_obj(ctx, zone, str->str.len);
+	memcpy((char*)copy->str.data, str->str.data, str->str.len);
+	copy->hash = str->hash;
+
+	return mara_obj_to_value(mara_header_of(copy));
 }
 
 mara_value_t
@@ -406,11 +605,24 @@ mara_new_strv(
 	const char* fmt,
 	va_list args
 ) {
-	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_str_t));
+	// Most results fit in the buffer and only need to be allocated once
+	va_list args_copy;
+	va_copy(args_copy, args);
+	char buf[512];
+	int len = npf_vsnprintf(buf, sizeof(buf), fmt, args_copy);
+	va_end(args_copy);
+	if (len < 0) { len = 0; }
+
+	if ((size_t)len < sizeof(buf)) {
+		return mara_new_str(ctx, zone, (mara_str_t){ .len = len, .data = buf });
+	}
+
+	mara_obj_t* obj = mara_alloc_obj(ctx, zone, sizeof(mara_str_obj_t));
 	obj->type = MARA_OBJ_TYPE_STRING;
 
-	mara_str_t* str = (mara_str_t*)obj->body;
-	*str = mara_vsnprintf(ctx, zone, fmt, args);
+	mara_str_obj_t* str = (mara_str_obj_t*)obj->body;
+	str->str = mara_vsnprintf(ctx, zone, fmt, args);
+	str->hash = mara_hash_str(str->str);
 
 	return mara_obj_to_value(obj);
 }
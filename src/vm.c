@@ -38,6 +38,21 @@ mara_vm_alloc_stack_frame(
 	}
 }
 
+// Stack frames cannot be allocated while the memory quota is exceeded
+MARA_PRIVATE bool
+mara_vm_memory_exceeded(const mara_exec_ctx_t* ctx) {
+	return ctx->memory_quota.stack_frames_end != NULL;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_vm_memory_error(mara_exec_ctx_t* ctx) {
+	return mara_errorf(
+		ctx, mara_str_from_literal("core/limit-reached/memory"),
+		"Memory limit reached",
+		mara_nil()
+	);
+}
+
 MARA_PRIVATE void
 mara_vm_pop_stack_frame(mara_exec_ctx_t* ctx, mara_stack_frame_t* stack_frame) {
 	mara_vm_state_t* vm = &ctx->vm_state;
@@ -45,6 +60,16 @@ mara_vm_pop_stack_frame(mara_exec_ctx_t* ctx, mara_stack_frame_t* stack_frame) {
 	*vm = stack_frame->previous_vm_state;
 }
 
+// RETURN to a native frame does not exit the call zone and a failed call
+// leaves its frames and zones in place for the stacktrace
+MARA_PRIVATE void
+mara_vm_unwind(mara_exec_ctx_t* ctx, mara_stack_frame_t* stack_frame, mara_zone_t* call_zone) {
+	while (ctx->current_zone != call_zone) {
+		mara_zone_exit(ctx, ctx->current_zone);
+	}
+	ctx->vm_state = stack_frame->previous_vm_state;
+}
+
 mara_error_t*
 mara_apply(
 	mara_exec_ctx_t* ctx,
@@ -56,8 +81,19 @@ mara_apply(
 	return mara_call(ctx, zone, fn, args->len, args->elems, result);
 }
 
-mara_error_t*
-mara_call(
+// A failed allocation jumps back to the recovery point of the innermost call,
+// which discards everything the call left behind
+MARA_PRIVATE mara_error_t*
+mara_vm_recover(mara_exec_ctx_t* ctx, mara_zone_t* current_zone, mara_vm_state_t vm_state) {
+	while (ctx->current_zone != current_zone) {
+		mara_zone_exit(ctx, ctx->current_zone);
+	}
+	ctx->vm_state = vm_state;
+	return &ctx->last_error;
+}
+
+MARA_PRIVATE mara_error_t*
+mara_vm_call(
 	mara_exec_ctx_t* ctx,
 	mara_zone_t* zone,
 	mara_fn_t* fn,
@@ -101,12 +137,17 @@ mara_call(
 
 				mara_zone_t* call_zone = mara_zone_enter(ctx);
 				// There are as many zones as stack frames
-				(void)call_zone;
 				mara_assert(call_zone != NULL, "Cannot alloc call zone");
 
 				// The VM always copy the result into the return zone
 				error = mara_vm_execute(ctx, result);
-				// call_zone will be cleaned up by the VM
+
+				if (error == NULL && mara_vm_memory_exceeded(ctx)) {
+					error = mara_vm_memory_error(ctx);
+				}
+
+				mara_vm_unwind(ctx, stack_frame, call_zone);
+				mara_zone_exit(ctx, call_zone);
 			} else {
 				error = mara_errorf(
 					ctx, mara_str_from_literal("core/wrong-arity"),
@@ -116,6 +157,8 @@ mara_call(
 				);
 			}
 		}
+	} else if (mara_vm_memory_exceeded(ctx)) {
+		error = mara_vm_memory_error(ctx);
 	} else {
 		error = mara_errorf(
 			ctx,
@@ -128,6 +171,264 @@ mara_call(
 	return error;
 }
 
+mara_error_t*
+mara_call(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_fn_t* fn,
+	mara_index_t argc,
+	mara_value_t* argv,
+	mara_value_t* result
+) {
+	mara_memory_quota_t* quota = &ctx->memory_quota;
+	if (MARA_EXPECT(quota->limit == 0)) {
+		return mara_vm_call(ctx, zone, fn, argc, argv, result);
+	}
+
+	jmp_buf recovery_point;
+	jmp_buf* previous_recovery_point = quota->recovery_point;
+	mara_zone_t* current_zone = ctx->current_zone;
+	mara_vm_state_t vm_state = ctx->vm_state;
+	mara_error_t* error;
+	if (setjmp(recovery_point) == 0) {
+		quota->recovery_point = &recovery_point;
+		error = mara_vm_call(ctx, zone, fn, argc, argv, result);
+	} else {
+		error = mara_vm_recover(ctx, current_zone, vm_state);
+	}
+	quota->recovery_point = previous_recovery_point;
+
+	return error;
+}
+
+mara_error_t*
+mara_begin_repeat_call(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_fn_t* fn,
+	mara_index_t argc,
+	mara_repeat_call_t* call
+) {
+	if (
+		mara_header_of(fn)->type == MARA_OBJ_TYPE_VM_FN
+		&& MARA_EXPECT(fn->prototype.vm->num_args > argc)
+	) {
+		return mara_errorf(
+			ctx, mara_str_from_literal("core/wrong-arity"),
+			"Function expects %d arguments, got %d",
+			mara_nil(),
+			fn->prototype.vm->num_args, argc
+		);
+	}
+
+	mara_stack_frame_t* stack_frame = mara_vm_alloc_stack_frame(ctx, &ctx->vm_state, fn, zone);
+	if (MARA_EXPECT(stack_frame != NULL)) {
+		mara_zone_t* call_zone = mara_zone_enter(ctx);
+		mara_assert(call_zone != NULL, "Cannot alloc call zone");
+
+		*call = (mara_repeat_call_t){
+			.fn = fn,
+			.zone = zone,
+			.call_zone = call_zone,
+			.stack_frame = stack_frame,
+			.argc = argc,
+		};
+		return NULL;
+	} else if (mara_vm_memory_exceeded(ctx)) {
+		return mara_vm_memory_error(ctx);
+	} else {
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/limit-reached/stack-overflow"),
+			"Too many stack frames",
+			mara_nil()
+		);
+	}
+}
+
+mara_error_t*
+mara_repeat_call(
+	mara_exec_ctx_t* ctx,
+	mara_repeat_call_t* call,
+	mara_value_t* argv,
+	mara_value_t* result
+) {
+	mara_fn_t* fn = call->fn;
+	mara_stack_frame_t* stack_frame = call->stack_frame;
+	mara_vm_state_t* vm_state = &ctx->vm_state;
+	mara_error_t* error;
+
+	if (mara_header_of(fn)->type == MARA_OBJ_TYPE_NATIVE_FN) {
+		vm_state->fp = stack_frame;
+		vm_state->args = argv;
+		vm_state->ip = NULL;
+		vm_state->sp = NULL;
+
+		mara_value_t return_value = mara_nil();
+		error = fn->prototype.native(ctx, call->argc, argv, fn->captures[0], &return_value);
+		if (MARA_EXPECT(error == NULL)) {
+			*result = mara_copy(ctx, call->zone, return_value);
+		}
+	} else {
+		mara_vm_function_t* prototype = fn->prototype.vm;
+		stack_frame->stack[0] = mara_tombstone();
+		vm_state->fp = stack_frame;
+		vm_state->args = argv;
+		vm_state->sp = stack_frame->stack + prototype->num_locals;
+		vm_state->ip = prototype->instructions;
+
+		error = mara_vm_execute(ctx, result);
+		if (error == NULL && mara_vm_memory_exceeded(ctx)) {
+			error = mara_vm_memory_error(ctx);
+		}
+	}
+
+	// The call zone starts out empty and most calls allocate nothing
+	mara_zone_t* call_zone = call->call_zone;
+	mara_vm_unwind(ctx, stack_frame, call_zone);
+	if (call_zone->arena.current_chunk != NULL) {
+		mara_zone_cleanup(ctx->env, call_zone);
+		call_zone->finalizers = NULL;
+	}
+	return error;
+}
+
+void
+mara_end_repeat_call(mara_exec_ctx_t* ctx, mara_repeat_call_t* call) {
+	mara_zone_exit(ctx, call->call_zone);
+}
+
+MARA_PRIVATE mara_error_t*
+mara_vm_call_batch(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_fn_t* fn,
+	mara_index_t n,
+	mara_index_t argc,
+	mara_value_t* argv_matrix,
+	mara_value_t* results
+) {
+
+	mara_repeat_call_t call;
+	mara_check_error(mara_begin_repeat_call(ctx, zone, fn, argc, &call));
+
+	mara_error_t* error = NULL;
+	for (mara_index_t i = 0; i < n; ++i) {
+		mara_value_t* argv = argc > 0 ? argv_matrix + i * argc : argv_matrix;
+		error = mara_repeat_call(ctx, &call, argv, &results[i]);
+		if (error != NULL) { break; }
+	}
+
+	mara_end_repeat_call(ctx, &call);
+	return error;
+}
+
+mara_error_t*
+mara_call_batch(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_fn_t* fn,
+	mara_index_t n,
+	mara_index_t argc,
+	mara_value_t* argv_matrix,
+	mara_value_t* results
+) {
+	if (n <= 0) { return NULL; }
+
+	mara_memory_quota_t* quota = &ctx->memory_quota;
+	if (MARA_EXPECT(quota->limit == 0)) {
+		return mara_vm_call_batch(ctx, zone, fn, n, argc, argv_matrix, results);
+	}
+
+	jmp_buf recovery_point;
+	jmp_buf* previous_recovery_point = quota->recovery_point;
+	mara_zone_t* current_zone = ctx->current_zone;
+	mara_vm_state_t vm_state = ctx->vm_state;
+	mara_error_t* error;
+	if (setjmp(recovery_point) == 0) {
+		quota->recovery_point = &recovery_point;
+		error = mara_vm_call_batch(ctx, zone, fn, n, argc, argv_matrix, results);
+	} else {
+		error = mara_vm_recover(ctx, current_zone, vm_state);
+	}
+	quota->recovery_point = previous_recovery_point;
+
+	return error;
+}
+
+mara_error_t*
+mara_protected_call(mara_exec_ctx_t* ctx, mara_protected_fn_t fn, void* userdata) {
+	mara_memory_quota_t* quota = &ctx->memory_quota;
+	if (MARA_EXPECT(quota->limit == 0)) {
+		return fn(ctx, userdata);
+	}
+
+	jmp_buf recovery_point;
+	jmp_buf* previous_recovery_point = quota->recovery_point;
+	mara_zone_t* current_zone = ctx->current_zone;
+	mara_vm_state_t vm_state = ctx->vm_state;
+	mara_error_t* error;
+	if (setjmp(recovery_point) == 0) {
+		quota->recovery_point = &recovery_point;
+		error = fn(ctx, userdata);
+	} else {
+		error = mara_vm_recover(ctx, current_zone, vm_state);
+	}
+	quota->recovery_point = previous_recovery_point;
+
+	return error;
+}
+
+MARA_PRIVATE mara_obj_t*
+mara_vm_make_closure(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_vm_function_t* function,
+	mara_fn_t* closure,
+	mara_stack_frame_t* fp,
+	mara_value_t* args,
+	mara_instruction_t* ip,
+	mara_operand_t operands
+) {
+	// By loading num_captures from the instruction, we avoid
+	// loading the function just to read that info
+	mara_index_t function_index = (uint8_t)((operands >> 16) & 0xff);
+	mara_index_t num_captures = (uint16_t)(operands & 0xffff);
+	mara_obj_t* new_obj = mara_alloc_obj(
+		ctx, zone,
+		sizeof(mara_fn_t) + sizeof(mara_value_t) * num_captures
+	);
+	new_obj->type = MARA_OBJ_TYPE_VM_FN;
+	mara_fn_t* new_closure = (mara_fn_t*)new_obj->body;
+	new_closure->prototype.vm = function->functions[function_index];
+	for (mara_index_t i = 0; i < num_captures; ++i) {
+		mara_instruction_t capture_instruction = ip[i];
+		mara_opcode_t capture_opcode;
+		mara_operand_t capture_operand;
+		mara_decode_instruction(capture_instruction, &capture_opcode, &capture_operand);
+
+		mara_value_t captured_value = mara_nil();
+		switch (capture_opcode) {
+			case MARA_OP_GET_ARG:
+				captured_value = args[capture_operand];
+				break;
+			case MARA_OP_GET_LOCAL:
+				captured_value = fp->stack[capture_operand];
+				break;
+			case MARA_OP_GET_CAPTURE:
+				captured_value = closure->captures[capture_operand];
+				break;
+			default:
+				mara_assert(false, "Illegal closure pseudo instruction");
+				break;
+		}
+		// No-op unless the closure is built in a shallower zone
+		new_closure->captures[i] = mara_copy(ctx, zone, captured_value);
+	}
+
+	return new_obj;
+}
+
 // VM dispatch loop
 // It has to be here so that certain functions are inlined
 
@@ -210,6 +511,21 @@ MARA_WARNING_PUSH()
 #pragma warning(disable: 4702)
 #endif
 
+MARA_PRIVATE mara_record_t*
+mara_vm_as_record(mara_value_t value, const mara_record_type_t* type) {
+	if (MARA_EXPECT(mara_value_is_obj(value))) {
+		mara_obj_t* obj = mara_value_to_obj(value);
+		if (MARA_EXPECT(obj->type == MARA_OBJ_TYPE_RECORD)) {
+			mara_record_t* record = (mara_record_t*)obj->body;
+			if (MARA_EXPECT(record->type == type)) {
+				return record;
+			}
+		}
+	}
+
+	return NULL;
+}
+
 MARA_PRIVATE mara_error_t*
 mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 #define MARA_VM_SAVE_STATE(STATE) \
@@ -244,6 +560,7 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 	mara_fn_t* closure;
 	mara_vm_function_t* function;
 	mara_obj_t* closure_header;
+	const mara_record_type_t* record_type;
 	// Cache the stack top in a local var.
 	// This has been shown through profiling to improve performance.
 	mara_value_t stack_top = mara_tombstone();
@@ -323,6 +640,9 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 							sp = stack_frame->stack + next_closure->prototype.vm->num_locals;
 							ip = next_closure->prototype.vm->instructions;
 							MARA_VM_DERIVE_STATE();
+						} else if (mara_vm_memory_exceeded(ctx)) {
+							MARA_VM_SAVE_STATE(vm);
+							return mara_vm_memory_error(ctx);
 						} else {
 							MARA_VM_SAVE_STATE(vm);
 							return mara_errorf(
@@ -348,9 +668,8 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 					mara_stack_frame_t* stack_frame = mara_vm_alloc_stack_frame(
 						ctx, &frame_state, native_closure, return_zone
 					);
-					ctx->native_debug_info[stack_frame - ctx->stack_frames_begin] = NULL;
-
 					if (MARA_EXPECT(stack_frame != NULL)) {
+						ctx->native_debug_info[stack_frame - ctx->stack_frames_begin] = NULL;
 						args = sp;
 						fp = stack_frame;
 						sp = NULL;
@@ -381,6 +700,9 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 							// native function
 							return error;
 						}
+					} else if (mara_vm_memory_exceeded(ctx)) {
+						MARA_VM_SAVE_STATE(vm);
+						return mara_vm_memory_error(ctx);
 					} else {
 						MARA_VM_SAVE_STATE(vm);
 						return mara_errorf(
@@ -427,43 +749,22 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 			stack_top = *(--sp);
 		MARA_END_OP()
 		MARA_BEGIN_OP(MAKE_CLOSURE)
-			// By loading num_captures from the instruction, we avoid
-			// loading the function just to read that info
-			mara_index_t function_index = (uint8_t)((operands >> 16) & 0xff);
-			mara_index_t num_captures = (uint16_t)(operands & 0xffff);
-			mara_obj_t* new_obj = mara_alloc_obj(
+			mara_obj_t* new_obj = mara_vm_make_closure(
 				ctx, ctx->current_zone,
-				sizeof(mara_fn_t) + sizeof(mara_value_t) * num_captures
+				function, closure, fp, args, ip, operands
+			);
+			*(++sp) = stack_top = mara_obj_to_value(new_obj);
+			ip += (uint16_t)(operands & 0xffff);
+		MARA_END_OP()
+		MARA_BEGIN_OP(MAKE_RETURN_CLOSURE)
+			// The closure is returned right away so it is built in the
+			// return zone and RETURN does not have to copy it
+			mara_obj_t* new_obj = mara_vm_make_closure(
+				ctx, fp->return_zone,
+				function, closure, fp, args, ip, operands
 			);
-			new_obj->type = MARA_OBJ_TYPE_VM_FN;
-			mara_fn_t* new_closure = (mara_fn_t*)new_obj->body;
-			new_closure->prototype.vm = function->functions[function_index];
-			for (mara_index_t i = 0; i < num_captures; ++i) {
-				mara_instruction_t capture_instruction = ip[i];
-				mara_opcode_t capture_opcode;
-				mara_operand_t capture_operand;
-				mara_decode_instruction(capture_instruction, &capture_opcode, &capture_operand);
-
-				mara_value_t captured_value = mara_nil();
-				switch (capture_opcode) {
-					case MARA_OP_GET_ARG:
-						captured_value = args[capture_operand];
-						break;
-					case MARA_OP_GET_LOCAL:
-						captured_value = fp->stack[capture_operand];
-						break;
-					case MARA_OP_GET_CAPTURE:
-						captured_value = closure->captures[capture_operand];
-						break;
-					default:
-						mara_assert(false, "Illegal closure pseudo instruction");
-						break;
-				}
-				new_closure->captures[i] = captured_value;
-			}
-
 			*(++sp) = stack_top = mara_obj_to_value(new_obj);
-			ip += num_captures;
+			ip += (uint16_t)(operands & 0xffff);
 		MARA_END_OP()
 		// Intrinsics
 		MARA_BEGIN_OP(LT)
@@ -522,16 +823,33 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 			}
 		MARA_END_OP()
 		MARA_BEGIN_OP(MAKE_LIST)
-			sp -= operands - 1;
+			sp -= (mara_index_t)operands - 1;
 			if (MARA_EXPECT((error = mara_intrin_make_list(ctx, operands, sp, mara_nil(), &stack_top)) == NULL)) {
 				*sp = stack_top;
 			} else {
 				goto intrinsic_error;
 			}
 		MARA_END_OP()
+		MARA_BEGIN_OP(MAKE_RETURN_LIST)
+			sp -= (mara_index_t)operands - 1;
+			*sp = stack_top = mara_value_from_list(
+				mara_vm_new_list(ctx, fp->return_zone, operands, sp)
+			);
+		MARA_END_OP()
 		MARA_BEGIN_OP(PUT)
 			sp -= 2;
-			if (MARA_EXPECT((error = mara_intrin_put(ctx, operands, sp, mara_nil(), &stack_top)) == NULL)) {
+			mara_operand_t arity = operands & 0xff;
+			mara_operand_t cache_index = operands >> 8;
+			if (
+				MARA_EXPECT(arity == 3)
+				&& mara_map_put_cached(
+					ctx, sp[0], sp[1], sp[2],
+					cache_index != MARA_NO_INLINE_CACHE ? &function->inline_caches[cache_index] : NULL,
+					&stack_top
+				)
+			) {
+				*sp = stack_top;
+			} else if (MARA_EXPECT((error = mara_intrin_put(ctx, arity, sp, mara_nil(), &stack_top)) == NULL)) {
 				*sp = stack_top;
 			} else {
 				goto intrinsic_error;
@@ -539,12 +857,64 @@ mara_vm_execute(mara_exec_ctx_t* ctx, mara_value_t* result) {
 		MARA_END_OP()
 		MARA_BEGIN_OP(GET)
 			sp -= 1;
-			if (MARA_EXPECT((error = mara_intrin_get(ctx, operands, sp, mara_nil(), &stack_top)) == NULL)) {
+			mara_operand_t arity = operands & 0xff;
+			mara_operand_t cache_index = operands >> 8;
+			if (
+				MARA_EXPECT(arity == 2)
+				&& mara_map_get_cached(
+					sp[0], sp[1],
+					cache_index != MARA_NO_INLINE_CACHE ? &function->inline_caches[cache_index] : NULL,
+					&stack_top
+				)
+			) {
+				*sp = stack_top;
+			} else if (MARA_EXPECT((error = mara_intrin_get(ctx, arity, sp, mara_nil(), &stack_top)) == NULL)) {
 				*sp = stack_top;
 			} else {
 				goto intrinsic_error;
 			}
 		MARA_END_OP()
+		MARA_BEGIN_OP(MAKE_RECORD)
+			record_type = function->record_types[operands];
+			sp -= record_type->num_fields - 1;
+			*sp = stack_top = mara_obj_to_value(mara_header_of(
+				mara_new_record(ctx, mara_get_local_zone(ctx), record_type, sp)
+			));
+		MARA_END_OP()
+		MARA_BEGIN_OP(MAKE_RETURN_RECORD)
+			record_type = function->record_types[operands];
+			sp -= record_type->num_fields - 1;
+			*sp = stack_top = mara_obj_to_value(mara_header_of(
+				mara_new_record(ctx, fp->return_zone, record_type, sp)
+			));
+		MARA_END_OP()
+		MARA_BEGIN_OP(RECORD_GET)
+			record_type = function->record_types[operands >> 8];
+			mara_record_t* record = mara_vm_as_record(*sp, record_type);
+			if (MARA_EXPECT(record != NULL)) {
+				*sp = stack_top = record->fields[operands & 0xff];
+			} else {
+				stack_top = *sp;
+				goto invalid_record_type;
+			}
+		MARA_END_OP()
+		MARA_BEGIN_OP(RECORD_SET)
+			sp -= 1;
+			record_type = function->record_types[operands >> 8];
+			mara_record_t* record = mara_vm_as_record(sp[0], record_type);
+			if (MARA_EXPECT(record != NULL)) {
+				if ((error = mara_check_mutable(ctx, sp[0])) != NULL) {
+					goto intrinsic_error;
+				}
+				mara_value_t* field = &record->fields[operands & 0xff];
+				stack_top = *field;
+				*field = mara_copy(ctx, mara_header_of(record)->zone, sp[1]);
+				*sp = stack_top;
+			} else {
+				stack_top = sp[0];
+				goto invalid_record_type;
+			}
+		MARA_END_OP()
 		// Super instructions
 		MARA_BEGIN_OP(CALL_CAPTURE)
 			mara_operand_t capture_index = operands & 0xffff;
@@ -579,6 +949,24 @@ invalid_call_type:
 		mara_value_type_name(mara_value_type(stack_top, NULL))
 	);
 
+invalid_record_type:
+	MARA_VM_SAVE_STATE(vm);
+	{
+		mara_str_t type_name;
+		mara_small_str_buf_t type_name_buf;
+		mara_assert_no_error(mara_value_to_str_buf(ctx, record_type->name, &type_name_buf, &type_name));
+		return mara_errorf(
+			ctx,
+			mara_str_from_literal("core/unexpected-type"),
+			"Expecting record %.*s got %s",
+			stack_top,
+			type_name.len, type_name.data,
+			mara_value_is_record(stack_top)
+				? "another record"
+				: mara_value_type_name(mara_value_type(stack_top, NULL))
+		);
+	}
+
 intrinsic_error:
 	// Rebuild stacktrace with accurate sp and fp
 	MARA_VM_SAVE_STATE(vm);
@@ -118,16 +118,26 @@ MARA_PRIVATE MARA_FUNCTION(mara_intrin_minus) {
 	}
 }
 
+MARA_PRIVATE mara_list_t*
+mara_vm_new_list(
+	mara_exec_ctx_t* ctx,
+	mara_zone_t* zone,
+	mara_index_t argc,
+	const mara_value_t* argv
+) {
+	mara_list_t* list = mara_new_list(ctx, zone, argc);
+	for (mara_index_t i = 0; i < argc; ++i) {
+		mara_list_push(ctx, list, argv[i]);
+	}
+
+	return list;
+}
+
 MARA_PRIVATE MARA_FUNCTION(mara_intrin_make_list) {
 	(void)userdata;
 	mara_add_native_debug_info(ctx);
 
-	mara_list_t* list = mara_new_list(ctx, mara_get_local_zone(ctx), argc);
-	for (mara_index_t i = 0; i < argc; ++i) {
-		mara_list_push(ctx, list, argv[0]);
-	}
-
-	MARA_RETURN(list);
+	MARA_RETURN(mara_vm_new_list(ctx, mara_get_local_zone(ctx), argc, argv));
 }
 
 MARA_PRIVATE MARA_FUNCTION(mara_intrin_put) {
@@ -137,6 +147,7 @@ MARA_PRIVATE MARA_FUNCTION(mara_intrin_put) {
 
 	MARA_FN_ARG(mara_value_t, container, 0);
 	MARA_FN_ARG(mara_value_t, value, 2);
+	mara_check_error(mara_check_mutable(ctx, container));
 
 	if (mara_value_is_list(container)) {
 		mara_list_t* list;
@@ -145,6 +156,15 @@ MARA_PRIVATE MARA_FUNCTION(mara_intrin_put) {
 		MARA_FN_ARG(mara_index_t, index, 1);
 
 		MARA_RETURN(mara_list_set(ctx, list, index, value));
+	} else if (mara_value_is_array(container)) {
+		mara_array_t* array;
+		mara_assert_no_error(mara_value_to_array(ctx, container, &array));
+
+		MARA_FN_ARG(mara_index_t, index, 1);
+
+		mara_value_t old_value = mara_array_get(ctx, array, index);
+		mara_check_error(mara_array_set(ctx, array, index, value));
+		MARA_RETURN(old_value);
 	} else if (mara_value_is_map(container)) {
 		mara_map_t* map;
 		mara_assert_no_error(mara_value_to_map(ctx, container, &map));
@@ -152,11 +172,29 @@ MARA_PRIVATE MARA_FUNCTION(mara_intrin_put) {
 		MARA_FN_ARG(mara_value_t, key, 1);
 
 		MARA_RETURN(mara_map_set(ctx, map, key, value));
+	} else if (mara_value_is_record(container)) {
+		mara_record_t* record = (mara_record_t*)mara_value_to_obj(container)->body;
+
+		MARA_FN_ARG(mara_value_t, key, 1);
+
+		mara_index_t field = mara_record_find_field(record->type, key);
+		if (field < 0) {
+			return mara_errorf(
+				ctx,
+				mara_str_from_literal("core/no-such-field"),
+				"Record does not have this field",
+				key
+			);
+		}
+
+		mara_value_t old_value = record->fields[field];
+		record->fields[field] = mara_copy(ctx, mara_header_of(record)->zone, value);
+		MARA_RETURN(old_value);
 	} else {
 		return mara_errorf(
 			ctx,
 			mara_str_from_literal("core/unexpected-type"),
-			"Expecting map or list",
+			"Expecting map, list, array or record",
 			mara_value_from_int(0)
 		);
 	}
@@ -175,17 +213,30 @@ MARA_PRIVATE MARA_FUNCTION(mara_intrin_get) {
 
 		MARA_FN_ARG(mara_index_t, index, 1);
 		MARA_RETURN(mara_list_get(ctx, list, index));
+	} else if (mara_value_is_array(container)) {
+		mara_array_t* array;
+		mara_assert_no_error(mara_value_to_array(ctx, container, &array));
+
+		MARA_FN_ARG(mara_index_t, index, 1);
+		MARA_RETURN(mara_array_get(ctx, array, index));
 	} else if (mara_value_is_map(container)) {
 		mara_map_t* map;
 		mara_assert_no_error(mara_value_to_map(ctx, container, &map));
 
 		MARA_FN_ARG(mara_value_t, key, 1);
 		MARA_RETURN(mara_map_get(ctx, map, key));
+	} else if (mara_value_is_record(container)) {
+		mara_record_t* record = (mara_record_t*)mara_value_to_obj(container)->body;
+
+		MARA_FN_ARG(mara_value_t, key, 1);
+
+		mara_index_t field = mara_record_find_field(record->type, key);
+		MARA_RETURN(field >= 0 ? record->fields[field] : mara_nil());
 	} else {
 		return mara_errorf(
 			ctx,
 			mara_str_from_literal("core/unexpected-type"),
-			"Expecting map or list",
+			"Expecting map, list, array or record",
 			mara_value_from_int(0)
 		);
 	}
@@ -22,7 +22,10 @@ mara_zone_enter(mara_exec_ctx_t* ctx) {
 	if (MARA_EXPECT(new_zone < ctx->zones_end)) {
 		new_zone->level = current_zone->level + 1;
 		new_zone->finalizers = NULL;
-		new_zone->arena.current_chunk = NULL;
+		new_zone->arena = (mara_arena_t){
+			.quota = current_zone->arena.quota,
+			.chunk_cache = current_zone->arena.chunk_cache,
+		};
 
 		if (ctx->last_error.type.len) {
 			mara_zone_cleanup(ctx->env, &ctx->error_zone);
@@ -54,12 +57,26 @@ mara_add_finalizer(mara_exec_ctx_t* ctx, mara_zone_t* zone, mara_callback_t call
 
 void*
 mara_zone_alloc(mara_exec_ctx_t* ctx, mara_zone_t* zone, size_t size) {
-	return mara_arena_alloc(ctx->env, &zone->arena, size);
+	return mara_zone_alloc_ex(ctx, zone, size, _Alignof(MARA_ALIGN_TYPE));
 }
 
 void*
 mara_zone_alloc_ex(mara_exec_ctx_t* ctx, mara_zone_t* zone, size_t size, size_t alignment) {
-	return mara_arena_alloc_ex(ctx->env, &zone->arena, size, alignment);
+	// The permanent zone is shared by every context
+	if (MARA_EXPECT(zone != &ctx->env->permanent_zone)) {
+		return mara_arena_alloc_ex(ctx->env, &zone->arena, size, alignment);
+	} else {
+		return mara_permanent_alloc(ctx, size, alignment);
+	}
+}
+
+void*
+mara_permanent_alloc(mara_exec_ctx_t* ctx, size_t size, size_t alignment) {
+	mara_env_t* env = ctx->env;
+	mara_mutex_lock(&env->lock);
+	void* mem = mara_arena_alloc_ex(env, &env->permanent_zone.arena, size, alignment);
+	mara_mutex_unlock(&env->lock);
+	return mem;
 }
 
 mara_zone_t*
@@ -1,7 +1,12 @@
 #include "rktest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <mara.h>
 #include <mara/utils.h>
 #include "common.h"
+#include "../src/thread.h"
 
 static mara_fixture_t fixture;
 
@@ -96,3 +101,1602 @@ TEST(runtime, map) {
 
 	ASSERT_EQ(iterator_state.num_elements, 2);
 }
+
+static inline mara_error_t*
+check_map_order(
+	mara_exec_ctx_t* ctx,
+	int argc, const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)result;
+
+	void* itr_state_ptr;
+	mara_check_error(mara_value_to_ref(ctx, userdata, &fixture, &itr_state_ptr));
+	iterator_state_t* itr_state = itr_state_ptr;
+
+	// Only odd keys are left and they come in insertion order
+	mara_index_t key;
+	mara_check_error(mara_value_to_int(ctx, argv[1], &key));
+	ASSERT_EQ(key, itr_state->num_elements * 2 + 1);
+	itr_state->num_elements += 1;
+
+	return NULL;
+}
+
+TEST(runtime, map_order) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+	mara_map_t* map = mara_new_map(ctx, zone);
+
+	for (mara_index_t i = 0; i < 1000; ++i) {
+		mara_map_set(ctx, map, mara_value_from_int(i), mara_value_from_int(i));
+	}
+	for (mara_index_t i = 0; i < 1000; i += 2) {
+		mara_value_t old_value = mara_map_delete(ctx, map, mara_value_from_int(i));
+		ASSERT_FALSE(mara_value_is_nil(old_value));
+	}
+	ASSERT_EQ(mara_map_len(ctx, map), 500);
+	ASSERT_TRUE(mara_value_is_nil(mara_map_get(ctx, map, mara_value_from_int(10))));
+	ASSERT_FALSE(mara_value_is_nil(mara_map_get(ctx, map, mara_value_from_int(11))));
+
+	iterator_state_t iterator_state = { 0 };
+	mara_value_t userdata = mara_new_ref(ctx, zone, &fixture, &iterator_state);
+	mara_fn_t* fn = mara_new_fn(ctx, zone, check_map_order, userdata);
+	MARA_ASSERT_NO_ERROR(ctx, mara_map_foreach(ctx, map, fn));
+	ASSERT_EQ(iterator_state.num_elements, 500);
+}
+
+TEST(runtime, map_shape) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_value_t syms[20];
+	for (mara_index_t i = 0; i < (mara_index_t)mara_count_of(syms); ++i) {
+		char name[8];
+		snprintf(name, sizeof(name), "f%d", i);
+		syms[i] = mara_new_sym(ctx, mara_str_from_cstr(name));
+	}
+
+	mara_map_t* a = mara_new_map(ctx, zone);
+	mara_map_t* b = mara_new_map(ctx, zone);
+	for (mara_index_t i = 0; i < 4; ++i) {
+		mara_map_set(ctx, a, syms[i], mara_value_from_int(i));
+		mara_map_set(ctx, b, syms[i], mara_value_from_int(i * 2));
+	}
+
+	mara_map_delete(ctx, a, syms[1]);
+	ASSERT_EQ(mara_map_len(ctx, a), 3);
+	ASSERT_TRUE(mara_value_is_nil(mara_map_get(ctx, a, syms[1])));
+	mara_map_set(ctx, a, syms[1], mara_value_from_int(1));
+
+	// The same code works on both representations
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal("(fn (m x y) (put m y (+ (get m x) 1)) (get m y))"),
+		&fn
+	));
+	mara_value_t update;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &update));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, update, &fn));
+
+	mara_map_t* maps[] = { a, b, a, b };
+	mara_index_t expected[] = { 2, 3, 2, 3 };
+	for (mara_index_t i = 0; i < (mara_index_t)mara_count_of(maps); ++i) {
+		if (i == 2) {
+			// Too many fields for a shape
+			for (mara_index_t j = 4; j < (mara_index_t)mara_count_of(syms); ++j) {
+				mara_map_set(ctx, a, syms[j], mara_value_from_int(j));
+			}
+		} else if (i == 3) {
+			// A non-symbol key
+			mara_map_set(ctx, b, mara_value_from_int(0), mara_value_from_int(0));
+		}
+
+		mara_value_t args[] = { mara_value_from_map(maps[i]), syms[1], syms[3] };
+		mara_value_t result;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 3, args, &result));
+		mara_index_t value;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &value));
+		ASSERT_EQ(value, expected[i]);
+	}
+
+	ASSERT_EQ(mara_map_len(ctx, a), 20);
+	ASSERT_EQ(mara_map_len(ctx, b), 5);
+	for (mara_index_t i = 0; i < (mara_index_t)mara_count_of(syms); ++i) {
+		mara_index_t value;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_map_get(ctx, a, syms[i]), &value));
+		ASSERT_EQ(value, i == 3 ? 2 : i);
+	}
+}
+
+TEST(runtime, list_growth) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// Interleaved lists cannot always grow in place
+	mara_list_t* a = mara_new_list(ctx, zone, 0);
+	mara_list_t* b = mara_new_list(ctx, zone, 1);
+	for (mara_index_t i = 0; i < 5000; ++i) {
+		mara_list_push(ctx, a, mara_value_from_int(i));
+		if (i % 3 == 0) {
+			mara_list_push(ctx, b, mara_value_from_int(-i));
+		}
+	}
+	mara_list_resize(ctx, b, 3000);
+
+	ASSERT_EQ(mara_list_len(ctx, a), 5000);
+	ASSERT_EQ(mara_list_len(ctx, b), 3000);
+	for (mara_index_t i = 0; i < 5000; ++i) {
+		mara_index_t value;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, a, i), &value));
+		ASSERT_EQ(value, i);
+	}
+	for (mara_index_t i = 0; i < 1667; ++i) {
+		mara_index_t value;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, b, i), &value));
+		ASSERT_EQ(value, -i * 3);
+	}
+	ASSERT_TRUE(mara_value_is_nil(mara_list_get(ctx, b, 2999)));
+}
+
+TEST(runtime, compile_cache) {
+	mara_env_t* env = mara_create_env((mara_env_options_t){ .compile_cache_size = 2 });
+	mara_parse_options_t parse_options = { .filename = MARA_INLINE_SOURCE };
+	mara_str_t source = mara_str_from_literal("(def x 1) (fn (y) (+ x y))");
+
+	// Cached code must survive the context that compiled it
+	for (int i = 0; i < 2; ++i) {
+		mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+		mara_zone_t* zone = mara_get_local_zone(ctx);
+
+		mara_fn_t* fn;
+		MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+			ctx, zone,
+			parse_options, (mara_compile_options_t){ .standalone = true },
+			source, &fn
+		));
+
+		mara_value_t closure;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &closure));
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, closure, &fn));
+
+		mara_value_t arg = mara_value_from_int(2);
+		mara_value_t result;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 1, &arg, &result));
+		mara_index_t sum;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+		ASSERT_EQ(sum, 3);
+
+		mara_end(ctx);
+	}
+
+	mara_destroy_env(env);
+}
+
+TEST(runtime, compile_str_debug_info) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// Every other parse reuses the memory of an earlier one
+	mara_str_t sources[] = {
+		mara_str_from_literal("(def x 1) (missing-a x)"),
+		mara_str_from_literal("(def x 1) (missing-a x)"),
+		mara_str_from_literal("(def x 1)\n  (missing-b x)"),
+	};
+	mara_source_pos_t starts[] = {
+		{ .line = 1, .col = 11, .byte_offset = 10 },
+		{ .line = 1, .col = 11, .byte_offset = 10 },
+		{ .line = 2, .col = 3, .byte_offset = 12 },
+	};
+	for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i) {
+		mara_fn_t* fn;
+		mara_error_t* error = mara_compile_str(
+			ctx, zone,
+			(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+			(mara_compile_options_t){ .standalone = true },
+			sources[i],
+			&fn
+		);
+		ASSERT_TRUE(error != NULL);
+		MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/name-error"));
+		ASSERT_TRUE(error->stacktrace != NULL && error->stacktrace->len > 0);
+		mara_source_pos_t start = error->stacktrace->frames[0].range.start;
+		ASSERT_EQ(start.line, starts[i].line);
+		ASSERT_EQ(start.col, starts[i].col);
+		ASSERT_EQ(start.byte_offset, starts[i].byte_offset);
+	}
+}
+
+TEST(runtime, return_aggregates) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// The list and the closure are built directly in the caller's zone
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal("(fn (a b) (list a b (fn () b)))"),
+		&fn
+	));
+	mara_value_t make;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &make));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, make, &fn));
+
+	mara_value_t args[] = { mara_value_from_int(1), mara_value_from_int(2) };
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 2, args, &result));
+
+	mara_list_t* list;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, result, &list));
+	ASSERT_EQ(mara_list_len(ctx, list), 3);
+	for (mara_index_t i = 0; i < 2; ++i) {
+		mara_index_t elem;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, list, i), &elem));
+		ASSERT_EQ(elem, i + 1);
+	}
+
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, mara_list_get(ctx, list, 2), &fn));
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &result));
+	mara_index_t captured;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &captured));
+	ASSERT_EQ(captured, 2);
+}
+
+TEST(runtime, compile_parallel) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+	mara_compile_options_t compile_options = { .standalone = true };
+
+	mara_compile_job_t jobs[] = {
+		{ .compile_options = compile_options, .source = mara_str_from_literal("(+ 1 2)") },
+		{ .compile_options = compile_options, .source = mara_str_from_literal("(+ 3 4)") },
+		{ .compile_options = compile_options, .source = mara_str_from_literal("(+ 5 6)") },
+	};
+	mara_fn_t* results[3];
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_parallel(ctx, zone, 2, 3, jobs, results));
+
+	for (mara_index_t i = 0; i < 3; ++i) {
+		mara_value_t result;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, results[i], 0, NULL, &result));
+		mara_index_t sum;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+		ASSERT_EQ(sum, i * 4 + 3);
+	}
+
+	// Errors from workers are reported on the calling context
+	jobs[1].source = mara_str_from_literal("(+ 3");
+	mara_error_t* error = mara_compile_parallel(ctx, zone, 2, 3, jobs, results);
+	ASSERT_TRUE(error != NULL);
+	MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/syntax/bad-list"));
+}
+
+static inline void*
+counting_alloc(void* ptr, size_t new_size, void* userdata) {
+	mara_index_t* num_allocations = userdata;
+	if (ptr == NULL && new_size > 0) {
+		*num_allocations += 1;
+	} else if (ptr != NULL && new_size == 0) {
+		*num_allocations -= 1;
+	}
+
+	if (new_size == 0) {
+		free(ptr);
+		return NULL;
+	} else {
+		return realloc(ptr, new_size);
+	}
+}
+
+TEST(runtime, trim_free_chunks) {
+	mara_index_t num_allocations = 0;
+	mara_env_t* env = mara_create_env((mara_env_options_t){
+		.allocator = { .fn = counting_alloc, .userdata = &num_allocations },
+		.alloc_chunk_size = 4096,
+		.max_free_chunk_bytes = 4096 * 4,
+	});
+
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_index_t baseline = num_allocations;
+	for (int i = 0; i < 1024; ++i) {
+		mara_zone_alloc(ctx, mara_get_local_zone(ctx), 1024);
+	}
+	// Chunks grow geometrically so 1 MiB takes few allocations
+	ASSERT_TRUE(num_allocations - baseline < 16);
+	mara_end(ctx);
+
+	// Only a few free chunks stay around
+	ASSERT_TRUE(num_allocations - baseline <= 2);
+
+	mara_destroy_env(env);
+	ASSERT_EQ(num_allocations, 0);
+}
+
+TEST(runtime, page_chunk_provider) {
+	mara_index_t num_allocations = 0;
+	mara_env_t* env = mara_create_env((mara_env_options_t){
+		.allocator = { .fn = counting_alloc, .userdata = &num_allocations },
+		.alloc_chunk_size = 4096,
+		.max_free_chunk_bytes = 4096 * 4,
+		.chunk_provider = MARA_CHUNK_PROVIDER_PAGES,
+		.page_region_size = 1024 * 1024,
+		.use_huge_pages = true,
+	});
+
+	for (int i = 0; i < 2; ++i) {
+		mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+		mara_zone_t* zone = mara_get_local_zone(ctx);
+		// Bigger than a region and trimmed on exit
+		for (int j = 0; j < 2048; ++j) {
+			memset(mara_zone_alloc(ctx, zone, 1024), j, 1024);
+		}
+
+		mara_fn_t* fn;
+		MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+			ctx, zone,
+			(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+			(mara_compile_options_t){ .standalone = true },
+			mara_str_from_literal("(+ 1 2)"),
+			&fn
+		));
+		mara_value_t result;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &result));
+		mara_index_t sum;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+		ASSERT_EQ(sum, 3);
+
+		mara_end(ctx);
+	}
+
+	mara_destroy_env(env);
+	ASSERT_EQ(num_allocations, 0);
+}
+
+TEST(runtime, max_memory) {
+	mara_env_t* env = mara_create_env((mara_env_options_t){ .alloc_chunk_size = 4096 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ .max_memory = 64 * 1024 });
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal("(list 1 2 3)"),
+		&fn
+	));
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &result));
+
+	for (int i = 0; i < 128; ++i) {
+		mara_zone_alloc(ctx, zone, 1024);
+	}
+	mara_error_t* error = mara_call(ctx, zone, fn, 0, NULL, &result);
+	ASSERT_TRUE(error != NULL);
+	MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/limit-reached/memory"));
+
+	mara_end(ctx);
+	mara_destroy_env(env);
+}
+
+static bool native_scratch_freed;
+
+static mara_error_t*
+fill_native_zone(mara_exec_ctx_t* ctx, void* userdata) {
+	(void)userdata;
+	for (int i = 0; i < 1024; ++i) {
+		mara_zone_alloc(ctx, mara_get_local_zone(ctx), 1024);
+	}
+	return NULL;
+}
+
+static inline mara_error_t*
+fill_with_scratch(
+	mara_exec_ctx_t* ctx,
+	int argc, const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)argv;
+	(void)userdata;
+	char* scratch = malloc(1024);
+	mara_error_t* error = mara_protected_call(ctx, fill_native_zone, scratch);
+	free(scratch);
+	native_scratch_freed = true;
+
+	*result = mara_nil();
+	return error;
+}
+
+TEST(runtime, max_memory_native) {
+	mara_env_t* env = mara_create_env((mara_env_options_t){ .alloc_chunk_size = 4096 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ .max_memory = 64 * 1024 });
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// The native gets to free its own memory before the call fails
+	native_scratch_freed = false;
+	mara_fn_t* fn = mara_new_fn(ctx, zone, fill_with_scratch, mara_nil());
+	mara_value_t result;
+	mara_error_t* error = mara_call(ctx, zone, fn, 0, NULL, &result);
+	ASSERT_TRUE(error != NULL);
+	MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/limit-reached/memory"));
+	ASSERT_TRUE(native_scratch_freed);
+
+	mara_end(ctx);
+	mara_destroy_env(env);
+}
+
+static inline mara_error_t*
+run_main_module(mara_exec_ctx_t* ctx, mara_str_t source, mara_value_t* result) {
+	mara_fn_t* fn;
+	mara_check_error(mara_compile_str(
+		ctx, mara_get_local_zone(ctx),
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ 0 },
+		source,
+		&fn
+	));
+
+	return mara_init_module(
+		ctx,
+		(mara_module_options_t){
+			.ignore_export = true,
+			.module_name = mara_str_from_literal("*main*"),
+		},
+		fn,
+		result
+	);
+}
+
+// Refuses anything bigger than 1 MiB
+static void*
+capped_alloc(void* ptr, size_t new_size, void* userdata) {
+	size_t* largest_request = userdata;
+	if (new_size > *largest_request) { *largest_request = new_size; }
+
+	if (new_size == 0) {
+		free(ptr);
+		return NULL;
+	} else if (new_size > 1024 * 1024) {
+		return NULL;
+	} else {
+		return realloc(ptr, new_size);
+	}
+}
+
+TEST(runtime, max_memory_hard_limit) {
+	mara_str_t sources[] = {
+		mara_str_from_literal("(def list/new (import \"core\" \"list/new\")) (list/new 50000000)"),
+		mara_str_from_literal("(def list/new (import \"core\" \"list/new\")) (list/new 2000000000)"),
+	};
+	// The quota is checked before a chunk is acquired, then the allocator
+	// itself fails when the quota is too big to stop anything
+	size_t limits[] = { 64 * 1024, (size_t)1 << 40 };
+
+	for (int i = 0; i < (int)mara_count_of(limits); ++i) {
+		size_t largest_request = 0;
+		mara_env_t* env = mara_create_env((mara_env_options_t){
+			.allocator = { .fn = capped_alloc, .userdata = &largest_request },
+			.alloc_chunk_size = 4096,
+		});
+		mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ .max_memory = limits[i] });
+		mara_add_core_module(ctx);
+
+		mara_value_t result;
+		for (int j = 0; j < (int)mara_count_of(sources); ++j) {
+			mara_error_t* error = run_main_module(ctx, sources[j], &result);
+			ASSERT_TRUE(error != NULL);
+			MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/limit-reached/memory"));
+		}
+		if (i == 0) {
+			ASSERT_TRUE(largest_request <= 1024 * 1024);
+		}
+
+		// The failed calls left nothing behind
+		MARA_ASSERT_NO_ERROR(ctx, run_main_module(ctx, mara_str_from_literal("(+ 1 2)"), &result));
+		mara_index_t sum;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+		ASSERT_EQ(sum, 3);
+
+		mara_end(ctx);
+		mara_destroy_env(env);
+	}
+}
+
+TEST(runtime, snapshot) {
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_add_core_module(ctx);
+	mara_list_t* data = mara_new_list(ctx, mara_get_local_zone(ctx), 1);
+	mara_list_push(ctx, data, mara_value_from_int(42));
+	mara_map_t* config = mara_new_map(ctx, mara_get_local_zone(ctx));
+	mara_map_set(ctx, config, mara_new_sym(ctx, mara_str_from_literal("x")), mara_value_from_int(1));
+	mara_list_push(ctx, data, mara_value_from_map(config));
+	mara_snapshot_t* snapshot = mara_freeze(ctx, mara_value_from_list(data));
+	mara_end(ctx);
+
+	for (int i = 0; i < 2; ++i) {
+		ctx = mara_begin(env, (mara_exec_options_t){ .snapshot = snapshot });
+
+		// The core module is available without being added again
+		mara_value_t result;
+		MARA_ASSERT_NO_ERROR(ctx, run_main_module(ctx, mara_str_from_literal("(+ 1 2)"), &result));
+		mara_index_t sum;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+		ASSERT_EQ(sum, 3);
+
+		mara_list_t* frozen_data;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, mara_get_snapshot_data(ctx), &frozen_data));
+		ASSERT_EQ(mara_list_len(ctx, frozen_data), 2);
+
+		// Scripts cannot write to the shared data
+		mara_fn_t* fn;
+		MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+			ctx, mara_get_local_zone(ctx),
+			(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+			(mara_compile_options_t){ .standalone = true },
+			mara_str_from_literal("(fn (c k) (put c k 2))"),
+			&fn
+		));
+		mara_value_t put_fn;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, mara_get_local_zone(ctx), fn, 0, NULL, &put_fn));
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, put_fn, &fn));
+		mara_value_t targets[][2] = {
+			{ mara_value_from_list(frozen_data), mara_value_from_int(0) },
+			{ mara_list_get(ctx, frozen_data, 1), mara_new_sym(ctx, mara_str_from_literal("x")) },
+		};
+		for (mara_index_t j = 0; j < (mara_index_t)mara_count_of(targets); ++j) {
+			mara_error_t* error = mara_call(ctx, mara_get_local_zone(ctx), fn, 2, targets[j], &result);
+			ASSERT_TRUE(error != NULL);
+			MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/frozen"));
+		}
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, frozen_data, 0), &sum));
+		ASSERT_EQ(sum, 42);
+
+		// Copies the shared loader list instead of writing to it
+		mara_add_core_module(ctx);
+
+		mara_end(ctx);
+	}
+
+	mara_destroy_env(env);
+}
+
+typedef struct {
+	mara_env_t* env;
+	mara_thread_t thread;
+	int num_frozen_errors;
+} export_writer_t;
+
+static void
+write_to_exports(void* userdata) {
+	export_writer_t* writer = userdata;
+
+	for (int i = 0; i < 8; ++i) {
+		mara_exec_ctx_t* ctx = mara_begin(writer->env, (mara_exec_options_t){ 0 });
+
+		// Each iteration also compiles and pushes to a private list
+		mara_value_t result;
+		mara_error_t* error = run_main_module(ctx, mara_str_from_literal(
+			"(def list/push (import \"core\" \"list/push\"))\n"
+			"(def own (list 1 2 3))\n"
+			"(list/push own 4)\n"
+			"(list/push (import \"shared\" \"items\") 4)\n"
+		), &result);
+		if (error != NULL && mara_str_equal(error->type, mara_str_from_literal("core/frozen"))) {
+			writer->num_frozen_errors += 1;
+		}
+
+		error = run_main_module(ctx, mara_str_from_literal(
+			"(put (import \"shared\" \"items\") 0 42)"
+		), &result);
+		if (error != NULL && mara_str_equal(error->type, mara_str_from_literal("core/frozen"))) {
+			writer->num_frozen_errors += 1;
+		}
+
+		mara_end(ctx);
+	}
+}
+
+TEST(runtime, frozen_exports) {
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_add_core_module(ctx);
+
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, mara_get_local_zone(ctx),
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ 0 },
+		mara_str_from_literal(
+			"(import \"core\" \"list/push\")\n"
+			"(export \"items\" (list 1 2 3))\n"
+		),
+		&fn
+	));
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, mara_init_module(
+		ctx, (mara_module_options_t){ .module_name = mara_str_from_literal("shared") },
+		fn, &result
+	));
+	mara_end(ctx);
+
+	// Every context sees the same exported list in the module cache
+	export_writer_t writers[4];
+	for (int i = 0; i < (int)mara_count_of(writers); ++i) {
+		writers[i] = (export_writer_t){ .env = env };
+		ASSERT_TRUE(mara_thread_start(&writers[i].thread, write_to_exports, &writers[i]));
+	}
+	for (int i = 0; i < (int)mara_count_of(writers); ++i) {
+		mara_thread_join(&writers[i].thread);
+		ASSERT_EQ(writers[i].num_frozen_errors, 16);
+	}
+
+	ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	MARA_ASSERT_NO_ERROR(ctx, mara_import(
+		ctx, mara_str_from_literal("shared"), mara_str_from_literal("items"), &result
+	));
+	mara_list_t* items;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, result, &items));
+	ASSERT_EQ(mara_list_len(ctx, items), 3);
+	mara_index_t first;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, items, 0), &first));
+	ASSERT_EQ(first, 1);
+	mara_end(ctx);
+
+	mara_destroy_env(env);
+}
+
+static int32_t slow_module_entered;
+static int32_t slow_module_imported_again;
+
+static inline mara_error_t*
+slow_module_entry(
+	mara_exec_ctx_t* ctx,
+	int argc, const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)argv;
+	(void)userdata;
+	mara_atomic_store_i32(&slow_module_entered, 1);
+	while (mara_atomic_load_i32(&slow_module_imported_again) == 0) { }
+	// Give the other context time to find the module being loaded
+	clock_t start = clock();
+	while (clock() - start < CLOCKS_PER_SEC / 20) { }
+
+	mara_export(ctx, mara_str_from_literal("value"), mara_value_from_int(42));
+	*result = mara_nil();
+	return NULL;
+}
+
+static inline mara_error_t*
+load_slow_module(
+	mara_exec_ctx_t* ctx,
+	int argc, const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)argv;
+	(void)userdata;
+	mara_fn_t* entry = mara_new_fn(ctx, mara_get_local_zone(ctx), slow_module_entry, mara_nil());
+	*result = mara_value_from_fn(entry);
+	return NULL;
+}
+
+typedef struct {
+	mara_env_t* env;
+	mara_thread_t thread;
+	bool wait_for_entry;
+	mara_index_t value;
+} module_importer_t;
+
+static void
+import_slow_module(void* userdata) {
+	module_importer_t* importer = userdata;
+	mara_exec_ctx_t* ctx = mara_begin(importer->env, (mara_exec_options_t){ 0 });
+	mara_add_module_loader(ctx, mara_new_fn(ctx, mara_get_local_zone(ctx), load_slow_module, mara_nil()));
+
+	if (importer->wait_for_entry) {
+		while (mara_atomic_load_i32(&slow_module_entered) == 0) { }
+		mara_atomic_store_i32(&slow_module_imported_again, 1);
+	}
+
+	mara_value_t result;
+	mara_error_t* error = mara_import(
+		ctx, mara_str_from_literal("slow"), mara_str_from_literal("value"), &result
+	);
+	importer->value = -1;
+	if (error == NULL) {
+		mara_value_to_int(ctx, result, &importer->value);
+	}
+
+	mara_end(ctx);
+}
+
+TEST(runtime, concurrent_import) {
+	mara_env_t* env = mara_create_env((mara_env_options_t){ 0 });
+	mara_atomic_store_i32(&slow_module_entered, 0);
+	mara_atomic_store_i32(&slow_module_imported_again, 0);
+
+	// The second context waits for the first one to finish loading
+	module_importer_t importers[2];
+	for (int i = 0; i < (int)mara_count_of(importers); ++i) {
+		importers[i] = (module_importer_t){ .env = env, .wait_for_entry = i > 0 };
+		ASSERT_TRUE(mara_thread_start(&importers[i].thread, import_slow_module, &importers[i]));
+	}
+	for (int i = 0; i < (int)mara_count_of(importers); ++i) {
+		mara_thread_join(&importers[i].thread);
+		ASSERT_EQ(importers[i].value, 42);
+	}
+
+	// A module importing itself is still a circular dependency
+	mara_exec_ctx_t* ctx = mara_begin(env, (mara_exec_options_t){ 0 });
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, mara_get_local_zone(ctx),
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ 0 },
+		mara_str_from_literal("(import \"self\" \"value\")"),
+		&fn
+	));
+	mara_value_t result;
+	mara_error_t* error = mara_init_module(
+		ctx, (mara_module_options_t){ .module_name = mara_str_from_literal("self") },
+		fn, &result
+	);
+	ASSERT_TRUE(error != NULL);
+	MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/circular-dependency"));
+	mara_end(ctx);
+
+	mara_destroy_env(env);
+}
+
+TEST(runtime, persistent_containers) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_pvec_t* empty_vec = mara_new_pvec(ctx, zone);
+	mara_pvec_t* vec = empty_vec;
+	for (mara_index_t i = 0; i < 2000; ++i) {
+		vec = mara_pvec_push(ctx, zone, vec, mara_value_from_int(i));
+	}
+	ASSERT_EQ(mara_pvec_len(ctx, empty_vec), 0);
+	ASSERT_EQ(mara_pvec_len(ctx, vec), 2000);
+
+	mara_pvec_t* updated_vec = mara_pvec_set(ctx, zone, vec, 500, mara_value_from_int(-1));
+	mara_pvec_t* popped_vec = vec;
+	for (mara_index_t i = 0; i < 1500; ++i) {
+		popped_vec = mara_pvec_pop(ctx, zone, popped_vec);
+	}
+	ASSERT_EQ(mara_pvec_len(ctx, popped_vec), 500);
+	for (mara_index_t i = 0; i < 2000; ++i) {
+		mara_index_t elem;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_pvec_get(ctx, vec, i), &elem));
+		ASSERT_EQ(elem, i);
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_pvec_get(ctx, updated_vec, i), &elem));
+		ASSERT_EQ(elem, i == 500 ? -1 : i);
+	}
+	ASSERT_TRUE(mara_value_is_nil(mara_pvec_get(ctx, popped_vec, 500)));
+
+	mara_pmap_t* empty_map = mara_new_pmap(ctx, zone);
+	mara_pmap_t* map = empty_map;
+	for (mara_index_t i = 0; i < 1000; ++i) {
+		map = mara_pmap_set(ctx, zone, map, mara_value_from_int(i), mara_value_from_int(i * 2));
+	}
+	map = mara_pmap_set(
+		ctx, zone, map,
+		mara_new_str(ctx, zone, mara_str_from_literal("key")),
+		mara_value_from_int(42)
+	);
+	ASSERT_EQ(mara_pmap_len(ctx, map), 1001);
+
+	mara_pmap_t* trimmed_map = map;
+	for (mara_index_t i = 0; i < 1000; i += 2) {
+		trimmed_map = mara_pmap_delete(ctx, zone, trimmed_map, mara_value_from_int(i));
+	}
+	ASSERT_EQ(mara_pmap_len(ctx, empty_map), 0);
+	ASSERT_EQ(mara_pmap_len(ctx, trimmed_map), 501);
+	for (mara_index_t i = 0; i < 1000; ++i) {
+		mara_index_t value;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_pmap_get(ctx, map, mara_value_from_int(i)), &value));
+		ASSERT_EQ(value, i * 2);
+		ASSERT_EQ(mara_value_is_nil(mara_pmap_get(ctx, trimmed_map, mara_value_from_int(i))), i % 2 == 0);
+	}
+	mara_index_t value;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(
+		ctx,
+		mara_pmap_get(ctx, trimmed_map, mara_new_str(ctx, zone, mara_str_from_literal("key"))),
+		&value
+	));
+	ASSERT_EQ(value, 42);
+
+	// Every version crosses a zone on return
+	mara_add_core_module(ctx);
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def pvec/new (import \"core\" \"pvec/new\"))\n"
+			"(def pvec/push (import \"core\" \"pvec/push\"))\n"
+			"(def pvec/get (import \"core\" \"pvec/get\"))\n"
+			"(def pmap/new (import \"core\" \"pmap/new\"))\n"
+			"(def pmap/set (import \"core\" \"pmap/set\"))\n"
+			"(def pmap/get (import \"core\" \"pmap/get\"))\n"
+			"(def fill (fn (self vec map n)\n"
+			"  (if (<= n 0)\n"
+			"    (list vec map)\n"
+			"    (self self (pvec/push vec n) (pmap/set map n (- 0 n)) (- n 1)))))\n"
+			"(def result (fill fill (pvec/new) (pmap/new) 20))\n"
+			"(+ (pvec/get (get result 0) 19) (pmap/get (get result 1) 7))\n"
+		),
+		&result
+	));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &value));
+	ASSERT_EQ(value, 1 - 7);
+}
+
+TEST(runtime, map_bulk) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_value_t pairs[200];
+	for (mara_index_t i = 0; i < 100; ++i) {
+		pairs[i * 2] = mara_value_from_int(i);
+		pairs[i * 2 + 1] = mara_value_from_int(i * 10);
+	}
+	mara_map_t* a = mara_map_from_pairs(ctx, zone, 50, pairs);
+	mara_map_t* b = mara_map_from_pairs(ctx, zone, 75, pairs + 50);
+	ASSERT_EQ(mara_map_len(ctx, a), 50);
+	ASSERT_EQ(mara_map_len(ctx, b), 75);
+
+	mara_map_delete(ctx, a, mara_value_from_int(0));
+	mara_map_reserve(ctx, a, 1000);
+	mara_map_merge(ctx, a, b);
+	ASSERT_EQ(mara_map_len(ctx, a), 99);
+
+	mara_value_t keys[] = {
+		mara_value_from_int(0),
+		mara_value_from_int(1),
+		mara_value_from_int(49),
+		mara_value_from_int(99),
+		mara_value_from_int(100),
+	};
+	mara_value_t expected[] = {
+		mara_nil(),
+		mara_value_from_int(10),
+		mara_value_from_int(490),
+		mara_value_from_int(990),
+		mara_nil(),
+	};
+	mara_value_t values[mara_count_of(keys)];
+	mara_map_get_many(ctx, a, mara_count_of(keys), keys, values);
+	for (mara_index_t i = 0; i < (mara_index_t)mara_count_of(keys); ++i) {
+		ASSERT_EQ(values[i].internal, expected[i].internal);
+	}
+
+	// Symbol keys keep their shape across a merge
+	mara_value_t fields[] = {
+		mara_new_sym(ctx, mara_str_from_literal("x")), mara_value_from_int(1),
+		mara_new_sym(ctx, mara_str_from_literal("y")), mara_value_from_int(2),
+	};
+	mara_map_t* point = mara_map_from_pairs(ctx, zone, 2, fields);
+	mara_map_t* copy = mara_new_map(ctx, zone);
+	mara_map_merge(ctx, copy, point);
+	mara_map_set(ctx, point, fields[0], mara_value_from_int(3));
+	ASSERT_EQ(mara_map_len(ctx, copy), 2);
+	mara_value_t x = mara_map_get(ctx, copy, fields[0]);
+	ASSERT_EQ(x.internal, mara_value_from_int(1).internal);
+
+	mara_add_core_module(ctx);
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def map/from-pairs (import \"core\" \"map/from-pairs\"))\n"
+			"(def map/get-many (import \"core\" \"map/get-many\"))\n"
+			"(def map/merge (import \"core\" \"map/merge\"))\n"
+			"(def map/len (import \"core\" \"map/len\"))\n"
+			"(def m (map/merge (map/from-pairs (list 1 2 3 4)) (map/from-pairs (list 5 6))))\n"
+			"(def values (map/get-many m (list 3 7)))\n"
+			"(+ (map/len m) (get values 0))\n"
+		),
+		&result
+	));
+	mara_index_t sum;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+	ASSERT_EQ(sum, 7);
+}
+
+TEST(runtime, list_slice) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_list_t* list = mara_new_list(ctx, zone, 0);
+	for (mara_index_t i = 0; i < 10; ++i) {
+		mara_list_push(ctx, list, mara_value_from_int(i));
+	}
+
+	mara_list_t* slice = mara_list_slice(ctx, zone, list, 2, 5);
+	ASSERT_EQ(mara_list_len(ctx, slice), 3);
+	ASSERT_EQ(mara_list_len(ctx, mara_list_slice(ctx, zone, list, 8, 20)), 2);
+	ASSERT_EQ(mara_list_len(ctx, mara_list_slice(ctx, zone, list, 5, 2)), 0);
+
+	// Writes to a slice do not reach the list
+	mara_list_set(ctx, slice, 0, mara_value_from_int(-1));
+	mara_list_push(ctx, slice, mara_value_from_int(-2));
+	ASSERT_EQ(mara_list_get(ctx, list, 2).internal, mara_value_from_int(2).internal);
+	ASSERT_EQ(mara_list_get(ctx, list, 5).internal, mara_value_from_int(5).internal);
+	ASSERT_EQ(mara_list_len(ctx, slice), 4);
+	ASSERT_EQ(mara_list_get(ctx, slice, 0).internal, mara_value_from_int(-1).internal);
+	ASSERT_EQ(mara_list_get(ctx, slice, 1).internal, mara_value_from_int(3).internal);
+	ASSERT_EQ(mara_list_get(ctx, slice, 3).internal, mara_value_from_int(-2).internal);
+
+	// Writes to the list do not reach the slice, even when it grows
+	slice = mara_list_slice(ctx, zone, list, 2, 5);
+	mara_list_set(ctx, list, 2, mara_value_from_int(-3));
+	for (mara_index_t i = 0; i < 100; ++i) {
+		mara_list_push(ctx, list, mara_value_from_int(i));
+	}
+	mara_list_delete(ctx, list, 0);
+	ASSERT_EQ(mara_list_len(ctx, slice), 3);
+	for (mara_index_t i = 0; i < 3; ++i) {
+		ASSERT_EQ(mara_list_get(ctx, slice, i).internal, mara_value_from_int(2 + i).internal);
+	}
+
+	// Same for a delete right after slicing
+	slice = mara_list_slice(ctx, zone, list, 0, 3);
+	mara_list_delete(ctx, list, 0);
+	ASSERT_EQ(mara_list_get(ctx, slice, 0).internal, mara_value_from_int(1).internal);
+	ASSERT_EQ(mara_list_get(ctx, slice, 1).internal, mara_value_from_int(-3).internal);
+	ASSERT_EQ(mara_list_get(ctx, slice, 2).internal, mara_value_from_int(3).internal);
+
+	mara_add_core_module(ctx);
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def list/slice (import \"core\" \"list/slice\"))\n"
+			"(def list/len (import \"core\" \"list/len\"))\n"
+			"(def sum (fn (self l i acc)\n"
+			"  (if (< i (list/len l)) (self self l (+ i 1) (+ acc (get l i))) acc)))\n"
+			"(def window (fn (l) (list/slice l 1 3)))\n"
+			"(def l (list 1 2 3 4 5))\n"
+			"(+ (sum sum (window l) 0 0) (sum sum (list/slice (window (list 10 20 30 40)) 1) 0 0))\n"
+		),
+		&result
+	));
+	mara_index_t value;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &value));
+	ASSERT_EQ(value, 2 + 3 + 30);
+}
+
+TEST(runtime, list_higher_order) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_list_t* list = mara_new_list(ctx, zone, 0);
+	for (mara_index_t i = 0; i < 100; ++i) {
+		mara_list_push(ctx, list, mara_value_from_int((i * 37) % 100));
+	}
+	MARA_ASSERT_NO_ERROR(ctx, mara_list_sort(ctx, list, NULL));
+	for (mara_index_t i = 0; i < 100; ++i) {
+		ASSERT_EQ(mara_list_get(ctx, list, i).internal, mara_value_from_int(i).internal);
+	}
+
+	mara_add_core_module(ctx);
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def list/map (import \"core\" \"list/map\"))\n"
+			"(def list/filter (import \"core\" \"list/filter\"))\n"
+			"(def list/find (import \"core\" \"list/find\"))\n"
+			"(def list/reduce (import \"core\" \"list/reduce\"))\n"
+			"(def list/sort (import \"core\" \"list/sort\"))\n"
+			"(def + (import \"core\" \"+\"))\n"
+			"(def l (list 5 3 8 1 9 2))\n"
+			"(def doubled (list/map l (fn (x) (+ x x))))\n"
+			"(def pairs (list (list 2 1) (list 1 2) (list 2 3) (list 1 4)))\n"
+			"(list/sort pairs (fn (a b) (< (get a 0) (get b 0))))\n"
+			"(list\n"
+			"  (list/reduce (list/filter doubled (fn (x) (< 5 x))) + 0)\n"
+			"  (list/find l (fn (x) (< 7 x)))\n"
+			"  (list/map pairs (fn (p) (get p 1))))\n"
+		),
+		&result
+	));
+	mara_list_t* results;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, result, &results));
+	ASSERT_EQ(mara_list_get(ctx, results, 0).internal, mara_value_from_int(10 + 6 + 16 + 18).internal);
+	ASSERT_EQ(mara_list_get(ctx, results, 1).internal, mara_value_from_int(8).internal);
+
+	// Stable
+	mara_list_t* order;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, mara_list_get(ctx, results, 2), &order));
+	mara_index_t expected_order[] = { 2, 4, 1, 3 };
+	ASSERT_EQ(mara_list_len(ctx, order), 4);
+	for (mara_index_t i = 0; i < 4; ++i) {
+		ASSERT_EQ(mara_list_get(ctx, order, i).internal, mara_value_from_int(expected_order[i]).internal);
+	}
+
+	// A failing callback leaves the context usable
+	ASSERT_TRUE(run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def list/map (import \"core\" \"list/map\"))\n"
+			"(list/map (list 1 2) (fn (x) (get x 0)))\n"
+		),
+		&result
+	) != NULL);
+	ASSERT_TRUE(mara_get_local_zone(ctx) == zone);
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def list/reduce (import \"core\" \"list/reduce\"))\n"
+			"(list/reduce (list 1 2 3) (fn (acc x) (list acc x)) 0)\n"
+		),
+		&result
+	));
+	ASSERT_TRUE(mara_value_is_list(result));
+}
+
+TEST(runtime, call_batch) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal("(fn (x y) (list (- x y) x))"),
+		&fn
+	));
+	mara_value_t rule;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &rule));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, rule, &fn));
+
+	mara_value_t args[] = {
+		mara_value_from_int(5), mara_value_from_int(2),
+		mara_value_from_int(7), mara_value_from_int(10),
+		mara_nil(), mara_value_from_int(0),
+	};
+	mara_value_t results[3] = { mara_nil(), mara_nil(), mara_nil() };
+	MARA_ASSERT_NO_ERROR(ctx, mara_call_batch(ctx, zone, fn, 2, 2, args, results));
+	mara_index_t expected[] = { 3, -3 };
+	for (mara_index_t i = 0; i < 2; ++i) {
+		mara_list_t* result;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, results[i], &result));
+		ASSERT_EQ(mara_list_get(ctx, result, 0).internal, mara_value_from_int(expected[i]).internal);
+		ASSERT_EQ(mara_list_get(ctx, result, 1).internal, args[i * 2].internal);
+	}
+
+	// Stops at the failing row and leaves the context usable
+	results[0] = results[1] = mara_nil();
+	ASSERT_TRUE(mara_call_batch(ctx, zone, fn, 3, 2, args, results) != NULL);
+	ASSERT_TRUE(mara_value_is_list(results[1]));
+	ASSERT_TRUE(mara_value_is_nil(results[2]));
+	ASSERT_TRUE(mara_get_local_zone(ctx) == zone);
+	MARA_ASSERT_NO_ERROR(ctx, mara_call_batch(ctx, zone, fn, 1, 2, args, results));
+}
+
+TEST(runtime, strings) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// Long enough for the vectorized scan
+	mara_str_t text = mara_str_from_literal("the quick brown fox jumps over the lazy dog");
+	ASSERT_EQ(mara_str_find(text, mara_str_from_literal("the"), 1), 31);
+	ASSERT_EQ(mara_str_find(text, mara_str_from_literal("dog"), 0), 40);
+	ASSERT_EQ(mara_str_find(text, mara_str_from_literal("cat"), 0), -1);
+	ASSERT_EQ(mara_str_find(text, mara_str_from_literal("z"), 0), 37);
+	ASSERT_EQ(mara_str_compare(mara_str_from_literal("ab"), mara_str_from_literal("abc")), -1);
+	ASSERT_EQ(mara_str_compare(mara_str_from_literal("b"), mara_str_from_literal("abc")), 1);
+
+	mara_str_builder_t builder = { .zone = zone };
+	for (mara_index_t i = 0; i < 100; ++i) {
+		mara_str_builder_append(ctx, &builder, mara_str_from_literal("ab"));
+	}
+	mara_str_t built;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, mara_str_builder_build(ctx, &builder), &built));
+	ASSERT_EQ(built.len, 200);
+	ASSERT_EQ(mara_str_find(built, mara_str_from_literal("ba"), 100), 101);
+
+	mara_list_t* words = mara_str_split(ctx, zone, text, mara_str_from_literal(" "));
+	ASSERT_EQ(mara_list_len(ctx, words), 9);
+	mara_value_t joined;
+	MARA_ASSERT_NO_ERROR(ctx, mara_str_join(ctx, zone, words, mara_str_from_literal(" "), &joined));
+	mara_str_t joined_str;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, joined, &joined_str));
+	ASSERT_EQ(mara_str_compare(joined_str, text), 0);
+
+	mara_add_core_module(ctx);
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def str/concat (import \"core\" \"str/concat\"))\n"
+			"(def str/slice (import \"core\" \"str/slice\"))\n"
+			"(def str/find (import \"core\" \"str/find\"))\n"
+			"(def str/split (import \"core\" \"str/split\"))\n"
+			"(def str/join (import \"core\" \"str/join\"))\n"
+			"(def str/to-number (import \"core\" \"str/to-number\"))\n"
+			"(def str/from-number (import \"core\" \"str/from-number\"))\n"
+			"(def str/builder (import \"core\" \"str/builder\"))\n"
+			"(def str/append (import \"core\" \"str/append\"))\n"
+			"(def str/build (import \"core\" \"str/build\"))\n"
+			"(def csv (str/join (str/split \"1,22,333\" \",\") \";\"))\n"
+			"(def b (str/builder))\n"
+			"(str/append b (str/slice csv 2 4))\n"
+			"(str/append b (str/from-number 7))\n"
+			"(list\n"
+			"  (str/concat csv \"|\" (str/build b))\n"
+			"  (str/find csv \";\" 2)\n"
+			"  (str/find csv \"x\")\n"
+			"  (str/to-number \"-42\")\n"
+			"  (str/to-number \"2.5\")\n"
+			"  (str/to-number \"12ab\"))\n"
+		),
+		&result
+	));
+	mara_list_t* results;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, result, &results));
+	mara_str_t concat;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, mara_list_get(ctx, results, 0), &concat));
+	ASSERT_EQ(mara_str_compare(concat, mara_str_from_literal("1;22;333|227")), 0);
+	ASSERT_EQ(mara_list_get(ctx, results, 1).internal, mara_value_from_int(4).internal);
+	ASSERT_TRUE(mara_value_is_nil(mara_list_get(ctx, results, 2)));
+	ASSERT_EQ(mara_list_get(ctx, results, 3).internal, mara_value_from_int(-42).internal);
+	ASSERT_EQ(mara_list_get(ctx, results, 4).internal, mara_value_from_real(2.5).internal);
+	ASSERT_TRUE(mara_value_is_nil(mara_list_get(ctx, results, 5)));
+}
+
+TEST(runtime, small_strings) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// Short strings are immediate so every way of making one agrees bitwise
+	mara_value_t key = mara_new_str(ctx, zone, mara_str_from_literal("key"));
+	ASSERT_TRUE(mara_value_is_str(key));
+	ASSERT_EQ(mara_value_type(key, NULL), MARA_VAL_STR);
+	ASSERT_LONG_EQ(mara_new_strf(ctx, zone, "k%s", "ey").internal, key.internal);
+	ASSERT_LONG_EQ(mara_copy(ctx, zone, key).internal, key.internal);
+
+	mara_str_builder_t builder = { .zone = zone };
+	mara_str_builder_append(ctx, &builder, mara_str_from_literal("ke"));
+	mara_str_builder_append(ctx, &builder, mara_str_from_literal("y"));
+	ASSERT_LONG_EQ(mara_str_builder_build(ctx, &builder).internal, key.internal);
+
+	mara_str_t samples[] = {
+		mara_str_from_literal(""),
+		mara_str_from_literal("\0\xff"),
+		mara_str_from_literal("abcde"),
+		mara_str_from_literal("abcdef"),
+	};
+	mara_map_t* map = mara_new_map(ctx, zone);
+	for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+		mara_value_t value = mara_new_str(ctx, zone, samples[i]);
+		mara_str_t str;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, value, &str));
+		MARA_ASSERT_STR_EQ(str, samples[i]);
+
+		mara_map_set(ctx, map, value, mara_value_from_int((mara_index_t)i));
+	}
+	for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+		mara_value_t value = mara_map_get(ctx, map, mara_new_str(ctx, zone, samples[i]));
+		ASSERT_LONG_EQ(value.internal, mara_value_from_int((mara_index_t)i).internal);
+	}
+	ASSERT_TRUE(mara_value_is_nil(mara_map_get(ctx, map, mara_new_str(ctx, zone, mara_str_from_literal("abcd")))));
+
+	// Recent reads stay valid side by side without any allocation
+	mara_str_t lhs, rhs;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, mara_new_str(ctx, zone, mara_str_from_literal("lhs")), &lhs));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, mara_new_str(ctx, zone, mara_str_from_literal("rhs")), &rhs));
+	MARA_ASSERT_STR_EQ(lhs, mara_str_from_literal("lhs"));
+	MARA_ASSERT_STR_EQ(rhs, mara_str_from_literal("rhs"));
+}
+
+TEST(runtime, arrays) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	// Long enough to cover both the vectorized part and the tail
+	mara_array_t* ints = mara_new_array(ctx, zone, MARA_ARRAY_I32, 37);
+	mara_array_t* reals = mara_new_array(ctx, zone, MARA_ARRAY_F64, 37);
+	for (mara_index_t i = 0; i < 37; ++i) {
+		MARA_ASSERT_NO_ERROR(ctx, mara_array_set(ctx, ints, i, mara_value_from_int(i - 10)));
+		MARA_ASSERT_NO_ERROR(ctx, mara_array_set(ctx, reals, i, mara_value_from_int(i)));
+	}
+	ASSERT_TRUE(mara_array_set(ctx, ints, 0, mara_nil()) != NULL);
+	ASSERT_TRUE(mara_array_set(ctx, ints, 37, mara_value_from_int(0)) != NULL);
+	ASSERT_TRUE(mara_value_is_nil(mara_array_get(ctx, ints, 37)));
+
+	ASSERT_EQ(mara_array_sum(ctx, ints).internal, mara_value_from_int(296).internal);
+	ASSERT_EQ(mara_array_min(ctx, ints).internal, mara_value_from_int(-10).internal);
+	ASSERT_EQ(mara_array_max(ctx, ints).internal, mara_value_from_int(26).internal);
+	ASSERT_EQ(mara_array_max(ctx, reals).internal, mara_value_from_real(36.0).internal);
+
+	mara_value_t dot;
+	MARA_ASSERT_NO_ERROR(ctx, mara_array_dot(ctx, reals, reals, &dot));
+	ASSERT_EQ(dot.internal, mara_value_from_real(15540.0).internal);
+	ASSERT_TRUE(mara_array_dot(ctx, ints, reals, &dot) != NULL);
+
+	mara_array_t* scaled;
+	MARA_ASSERT_NO_ERROR(ctx, mara_array_scale(ctx, zone, ints, mara_value_from_int(-2), &scaled));
+	mara_array_t* sum;
+	MARA_ASSERT_NO_ERROR(ctx, mara_array_add(ctx, zone, ints, scaled, &sum));
+	mara_list_t* list = mara_array_to_list(ctx, zone, sum);
+	ASSERT_EQ(mara_list_len(ctx, list), 37);
+	for (mara_index_t i = 0; i < 37; ++i) {
+		ASSERT_EQ(mara_list_get(ctx, list, i).internal, mara_value_from_int(10 - i).internal);
+	}
+
+	mara_add_core_module(ctx);
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, run_main_module(
+		ctx,
+		mara_str_from_literal(
+			"(def array/f64 (import \"core\" \"array/f64\"))\n"
+			"(def array/dot (import \"core\" \"array/dot\"))\n"
+			"(def array/add (import \"core\" \"array/add\"))\n"
+			"(def make (fn () (array/f64 (list 1 2.5 3))))\n"
+			"(def a (make))\n"
+			"(put a 0 2)\n"
+			"(array/dot (array/add a a) (make))\n"
+		),
+		&result
+	));
+	mara_real_t value;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_real(ctx, result, &value));
+	ASSERT_EQ(value, 2.0 * (2.0 * 1.0 + 2.5 * 2.5 + 3.0 * 3.0));
+}
+
+typedef struct {
+	char data[4096];
+	mara_index_t len;
+} memory_buffer_t;
+
+static inline mara_index_t
+write_to_memory(const void* data, mara_index_t size, void* userdata) {
+	memory_buffer_t* buffer = userdata;
+	if (buffer->len + size > (mara_index_t)sizeof(buffer->data)) { return -1; }
+	memcpy(buffer->data + buffer->len, data, size);
+	buffer->len += size;
+	return size;
+}
+
+TEST(runtime, dump_load_code) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal(
+			"(def fib (fn (self n) (if (< n 2) n (+ (self self (- n 1)) (self self (- n 2))))))\n"
+			"(list (fib fib 20) 100000 \"str\" 1.5)"
+		),
+		&fn
+	));
+
+	static _Alignas(8) memory_buffer_t image;
+	image.len = 0;
+	mara_value_t size;
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(
+		ctx, mara_value_from_fn(fn),
+		(mara_writer_t){ .fn = write_to_memory, .userdata = &image },
+		&size
+	));
+	mara_index_t size_int;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, size, &size_int));
+	ASSERT_EQ(size_int, image.len);
+
+	mara_value_t loaded;
+	MARA_ASSERT_NO_ERROR(ctx, mara_load_from_buffer(ctx, zone, image.data, image.len, &loaded));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, loaded, &fn));
+
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &result));
+	mara_list_t* list;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, result, &list));
+	ASSERT_EQ(mara_list_len(ctx, list), 4);
+
+	mara_index_t fib;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, list, 0), &fib));
+	ASSERT_EQ(fib, 6765);
+
+	// Truncated images are rejected
+	mara_error_t* error = mara_load_from_buffer(ctx, zone, image.data, image.len - 8, &loaded);
+	ASSERT_TRUE(error != NULL);
+}
+
+static memory_buffer_t native_load_image;
+
+static inline mara_error_t*
+load_in_native(
+	mara_exec_ctx_t* ctx,
+	int argc, const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)argv;
+	(void)userdata;
+	mara_str_reader_t reader;
+	return mara_load(
+		ctx, mara_get_local_zone(ctx),
+		mara_init_str_reader(&reader, (mara_str_t){ .data = native_load_image.data, .len = native_load_image.len }),
+		result
+	);
+}
+
+static inline mara_error_t*
+scribble_in_native(
+	mara_exec_ctx_t* ctx,
+	int argc, const mara_value_t* argv,
+	mara_value_t userdata,
+	mara_value_t* result
+) {
+	(void)argc;
+	(void)argv;
+	(void)userdata;
+	for (int i = 0; i < 64; ++i) {
+		memset(mara_zone_alloc(ctx, mara_get_local_zone(ctx), 256), 0xff, 256);
+	}
+	*result = mara_nil();
+	return NULL;
+}
+
+TEST(runtime, load_in_native) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal(
+			"(defrecord point x y)\n"
+			"(def p (point/new 1 2))\n"
+			"(+ (point/x p) (point/y p))"
+		),
+		&fn
+	));
+	native_load_image.len = 0;
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(
+		ctx, mara_value_from_fn(fn),
+		(mara_writer_t){ .fn = write_to_memory, .userdata = &native_load_image },
+		NULL
+	));
+
+	// The loaded function escapes the zone of the native call
+	mara_fn_t* loader = mara_new_fn(ctx, zone, load_in_native, mara_nil());
+	mara_value_t loaded;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, loader, 0, NULL, &loaded));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, loaded, &fn));
+
+	// The next native call reuses the memory of that zone
+	mara_fn_t* scribbler = mara_new_fn(ctx, zone, scribble_in_native, mara_nil());
+	mara_value_t result;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, scribbler, 0, NULL, &result));
+
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 0, NULL, &result));
+	mara_index_t sum;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, result, &sum));
+	ASSERT_EQ(sum, 3);
+}
+
+TEST(runtime, records) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_fn_t* fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal(
+			"(defrecord point x y)\n"
+			"(fn (a b)\n"
+			"  (def p (point/new a b))\n"
+			"  (point/x p (+ (point/x p) (point/y p)))\n"
+			"  (list (point/x p) (get p 0) p (fn (r) (point/y r))))"
+		),
+		&fn
+	));
+
+	// The record type survives a dump and load
+	static _Alignas(8) memory_buffer_t image;
+	image.len = 0;
+	mara_value_t size;
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(
+		ctx, mara_value_from_fn(fn),
+		(mara_writer_t){ .fn = write_to_memory, .userdata = &image },
+		&size
+	));
+	mara_value_t loaded;
+	MARA_ASSERT_NO_ERROR(ctx, mara_load_from_buffer(ctx, zone, image.data, image.len, &loaded));
+
+	mara_fn_t* fns[2] = { fn };
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, loaded, &fns[1]));
+
+	mara_value_t records[2];
+	for (mara_index_t i = 0; i < 2; ++i) {
+		mara_value_t make;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fns[i], 0, NULL, &make));
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, make, &fn));
+
+		mara_value_t args[] = { mara_value_from_int(3), mara_value_from_int(4) };
+		mara_value_t result;
+		MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 2, args, &result));
+
+		mara_list_t* list;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, result, &list));
+		mara_index_t x;
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, list, 0), &x));
+		ASSERT_EQ(x, 7);
+		records[i] = mara_list_get(ctx, list, 2);
+		ASSERT_TRUE(mara_value_is_record(records[i]));
+		ASSERT_TRUE(mara_value_is_nil(mara_list_get(ctx, list, 1)));
+		MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, mara_list_get(ctx, list, 3), &fn));
+	}
+
+	// Records from either copy of the code have the same type
+	mara_value_t y;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, fn, 1, &records[0], &y));
+	mara_index_t y_int;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, y, &y_int));
+	ASSERT_EQ(y_int, 4);
+
+	mara_value_t not_a_record = mara_value_from_map(mara_new_map(ctx, zone));
+	mara_error_t* error = mara_call(ctx, zone, fn, 1, &not_a_record, &y);
+	ASSERT_TRUE(error != NULL);
+	MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/unexpected-type"));
+
+	// Generic access goes through field names
+	mara_value_t sym_y = mara_new_sym(ctx, mara_str_from_literal("y"));
+	mara_value_t get_args[] = { records[1], sym_y };
+	mara_fn_t* get_fn;
+	MARA_ASSERT_NO_ERROR(ctx, mara_compile_str(
+		ctx, zone,
+		(mara_parse_options_t){ .filename = MARA_INLINE_SOURCE },
+		(mara_compile_options_t){ .standalone = true },
+		mara_str_from_literal("(fn (r k) (get r k))"),
+		&get_fn
+	));
+	mara_value_t getter;
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, get_fn, 0, NULL, &getter));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_fn(ctx, getter, &get_fn));
+	MARA_ASSERT_NO_ERROR(ctx, mara_call(ctx, zone, get_fn, 2, get_args, &y));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, y, &y_int));
+	ASSERT_EQ(y_int, 4);
+}
+
+TEST(runtime, dump_load_data) {
+	mara_exec_ctx_t* ctx = fixture.ctx;
+	mara_zone_t* zone = mara_get_local_zone(ctx);
+
+	mara_value_t sym = mara_new_sym(ctx, mara_str_from_literal("sym"));
+	mara_list_t* shared = mara_new_list(ctx, zone, 0);
+	mara_list_push(ctx, shared, mara_value_from_int(-70000));
+	mara_list_push(ctx, shared, mara_value_from_real(2.5));
+	mara_list_push(ctx, shared, mara_new_str(ctx, zone, mara_str_from_literal("str")));
+	mara_list_push(ctx, shared, sym);
+	mara_list_push(ctx, shared, mara_nil());
+
+	mara_list_t* root = mara_new_list(ctx, zone, 0);
+	mara_map_t* map = mara_new_map(ctx, zone);
+	mara_map_set(ctx, map, sym, mara_value_from_list(shared));
+	mara_map_set(ctx, map, mara_value_from_bool(true), mara_value_from_list(root));
+	mara_list_push(ctx, root, mara_value_from_list(shared));
+	mara_list_push(ctx, root, mara_value_from_map(map));
+
+	static memory_buffer_t data;
+	data.len = 0;
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(
+		ctx, mara_value_from_list(root),
+		(mara_writer_t){ .fn = write_to_memory, .userdata = &data },
+		NULL
+	));
+
+	mara_str_reader_t str_reader;
+	mara_value_t loaded;
+	MARA_ASSERT_NO_ERROR(ctx, mara_load(
+		ctx, zone,
+		mara_init_str_reader(&str_reader, (mara_str_t){ .data = data.data, .len = data.len }),
+		&loaded
+	));
+
+	mara_list_t* loaded_root;
+	mara_list_t* loaded_shared;
+	mara_map_t* loaded_map;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, loaded, &loaded_root));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_list(ctx, mara_list_get(ctx, loaded_root, 0), &loaded_shared));
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_map(ctx, mara_list_get(ctx, loaded_root, 1), &loaded_map));
+	ASSERT_EQ(mara_list_len(ctx, loaded_shared), 5);
+
+	// Sharing and cycles are preserved
+	ASSERT_LONG_EQ(
+		mara_map_get(ctx, loaded_map, sym).internal,
+		mara_value_from_list(loaded_shared).internal
+	);
+	ASSERT_LONG_EQ(
+		mara_map_get(ctx, loaded_map, mara_value_from_bool(true)).internal,
+		loaded.internal
+	);
+
+	mara_index_t int_value;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_int(ctx, mara_list_get(ctx, loaded_shared, 0), &int_value));
+	ASSERT_EQ(int_value, -70000);
+	mara_real_t real_value;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_real(ctx, mara_list_get(ctx, loaded_shared, 1), &real_value));
+	ASSERT_TRUE(real_value == 2.5);
+	mara_str_t str;
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_str(ctx, mara_list_get(ctx, loaded_shared, 2), &str));
+	MARA_ASSERT_STR_EQ(str, mara_str_from_literal("str"));
+	ASSERT_LONG_EQ(mara_list_get(ctx, loaded_shared, 3).internal, sym.internal);
+	ASSERT_TRUE(mara_value_is_nil(mara_list_get(ctx, loaded_shared, 4)));
+
+	// Values dumped one after another load in sequence
+	data.len = 0;
+	mara_writer_t writer = { .fn = write_to_memory, .userdata = &data };
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(ctx, mara_value_from_int(1), writer, NULL));
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(ctx, mara_value_from_int(2), writer, NULL));
+	mara_reader_t reader = mara_init_str_reader(&str_reader, (mara_str_t){ .data = data.data, .len = data.len });
+	MARA_ASSERT_NO_ERROR(ctx, mara_load(ctx, zone, reader, &loaded));
+	ASSERT_LONG_EQ(loaded.internal, mara_value_from_int(1).internal);
+	MARA_ASSERT_NO_ERROR(ctx, mara_load(ctx, zone, reader, &loaded));
+	ASSERT_LONG_EQ(loaded.internal, mara_value_from_int(2).internal);
+
+	// A NaN payload which does not fit in a value loads as a plain NaN
+	data.len = 0;
+	MARA_ASSERT_NO_ERROR(ctx, mara_dump(ctx, mara_value_from_real(2.5), writer, NULL));
+	uint64_t nan_bits = 0xFFF9000012345678llu;
+	for (int i = 0; i < 8; ++i) {
+		data.data[data.len - 8 + i] = (char)(uint8_t)(nan_bits >> (i * 8));
+	}
+	MARA_ASSERT_NO_ERROR(ctx, mara_load(
+		ctx, zone,
+		mara_init_str_reader(&str_reader, (mara_str_t){ .data = data.data, .len = data.len }),
+		&loaded
+	));
+	ASSERT_EQ(mara_value_type(loaded, NULL), MARA_VAL_REAL);
+	MARA_ASSERT_NO_ERROR(ctx, mara_value_to_real(ctx, loaded, &real_value));
+	ASSERT_TRUE(real_value != real_value);
+
+	// A huge length with nothing behind it fails instead of reserving memory
+	mara_value_t named[] = {
+		mara_new_str(ctx, zone, mara_str_from_literal("abcdef")),
+		mara_new_sym(ctx, mara_str_from_literal("abcdef")),
+	};
+	for (size_t i = 0; i < sizeof(named) / sizeof(named[0]); ++i) {
+		data.len = 0;
+		MARA_ASSERT_NO_ERROR(ctx, mara_dump(ctx, named[i], writer, NULL));
+		// Replace the length and the characters with INT32_MAX
+		data.len -= 7;
+		const char huge_len[] = { '\xff', '\xff', '\xff', '\xff', '\x07' };
+		memcpy(data.data + data.len, huge_len, sizeof(huge_len));
+		data.len += sizeof(huge_len);
+
+		mara_error_t* error = mara_load(
+			ctx, zone,
+			mara_init_str_reader(&str_reader, (mara_str_t){ .data = data.data, .len = data.len }),
+			&loaded
+		);
+		ASSERT_TRUE(error != NULL);
+		MARA_ASSERT_STR_EQ(error->type, mara_str_from_literal("core/load-error/bad-format"));
+	}
+}